@@ -21,7 +21,8 @@ namespace client {
  */
 class ChatClient {
 public:
-  explicit ChatClient(const std::string &username, std::unique_ptr<ServerConnection> server_connection);
+  explicit ChatClient(const std::string &username, std::unique_ptr<ServerConnection> server_connection,
+                      const std::string &password = "");
   ~ChatClient() = default;
 
   bool connect_and_join(const std::string &server_address, int server_port);
@@ -49,6 +50,7 @@ private:
 
   std::unique_ptr<ServerConnection> server_connection_;
   std::string username_;
+  std::string password_;
   std::atomic<bool> is_running_{true};
   uint32_t user_id_{0};
   std::unordered_map<uint32_t, std::string> user_map_;
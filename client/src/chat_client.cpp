@@ -13,9 +13,12 @@ namespace client {
  *
  * @param username The username for the chat client.
  * @param server_connection A unique pointer to the ServerConnection instance.
+ * @param password Optional password. The first join with a password reserves the username for it.
  */
-ChatClient::ChatClient(const std::string &username, std::unique_ptr<ServerConnection> server_connection)
-    : username_(username), server_connection_(std::move(server_connection)), is_running_(false), user_id_(0) {}
+ChatClient::ChatClient(const std::string &username, std::unique_ptr<ServerConnection> server_connection,
+                       const std::string &password)
+    : server_connection_(std::move(server_connection)), username_(username), password_(password), is_running_(false),
+      user_id_(0) {}
 
 /**
  * @brief Connects to the chat server and sends a join request.
@@ -91,7 +94,9 @@ void ChatClient::run_user_input_handler() {
  * @brief Sends a join request to the server.
  */
 void ChatClient::send_join_request() {
-  common::Message join_message(common::MessageType::C2S_JOIN, common::INVALID_ID, common::SERVER_ID, username_);
+  // The password, if any, follows the username on a separate line.
+  const std::string payload = password_.empty() ? username_ : username_ + "\n" + password_;
+  common::Message join_message(common::MessageType::C2S_JOIN, common::INVALID_ID, common::SERVER_ID, payload);
   server_connection_->send_message(join_message);
 }
 
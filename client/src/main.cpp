@@ -3,10 +3,12 @@
 #include <iostream>
 
 void show_help() {
-  std::cout << "Usage: chat_client <host_ip> <port> <username>\n"
-            << "  host_ip   - The IP address of the chat server.\n"
-            << "  port      - The listening port number of the chat server.\n"
-            << "  username  - Your username for the chat.\n";
+  std::cout << "Usage: chat_client <host_ip> <port> <username> [password]\n"
+            << "  host_ip   - The IP address of the chat server, or unix:<path> for a local server's\n"
+            << "              Unix domain socket.\n"
+            << "  port      - The listening port number of the chat server (ignored for unix:<path>).\n"
+            << "  username  - Your username for the chat.\n"
+            << "  password  - Optional. Reserves the username on first use; required afterwards.\n";
 }
 
 void show_send_private_message_guide() {
@@ -17,7 +19,7 @@ void show_send_private_message_guide() {
 int main(int argc, char *argv[]) {
   chat_app::common::Logger::get_instance().set_level(chat_app::common::LogLevel::INFO);
 
-  if (argc != 4) {
+  if (argc != 4 && argc != 5) {
     show_help();
     return 1;
   }
@@ -34,6 +36,7 @@ int main(int argc, char *argv[]) {
     return 1;
   }
   std::string username = argv[3];
+  std::string password = argc == 5 ? argv[4] : "";
 
   if (username.empty() || username.length() > 32) {
     std::cerr << "Error: Username must be between 1 and 32 characters." << std::endl;
@@ -44,7 +47,7 @@ int main(int argc, char *argv[]) {
 
   // Create a server connection
   auto server_connection = std::make_unique<chat_app::client::ServerConnection>();
-  chat_app::client::ChatClient client(username, std::move(server_connection));
+  chat_app::client::ChatClient client(username, std::move(server_connection), password);
   
   if (client.connect_and_join(host, port)) {
     show_send_private_message_guide();
@@ -17,13 +17,17 @@ ServerConnection::~ServerConnection() { disconnect(); }
 /**
  * @brief Connects to the server at the specified host and port.
  *
- * @param host The hostname or IP address of the server.
- * @param port The port number on which the server is listening.
+ * @param host The hostname or IP address of the server, or "unix:<path>" for a server's Unix domain socket.
+ * @param port The port number on which the server is listening. Ignored for Unix domain sockets.
  * @return true if the connection was successful, false otherwise.
  */
 bool ServerConnection::connect(const std::string &host, int port) {
   LOG_INFO(SERVER_CONNECTION_COMPONENT, "Attempting to connect to server at {}:{}", host, port);
-  socket_ = common::PosixSocket::create_connector(host, port);
+  if (host.rfind(common::UNIX_ADDRESS_PREFIX, 0) == 0) {
+    socket_ = common::PosixSocket::create_unix_connector(host.substr(sizeof(common::UNIX_ADDRESS_PREFIX) - 1));
+  } else {
+    socket_ = common::PosixSocket::create_connector(host, port);
+  }
 
   if (!socket_ || !socket_->is_valid()) {
     LOG_ERROR(SERVER_CONNECTION_COMPONENT, "Failed to connect to server at {}:{}", host, port);
@@ -0,0 +1,65 @@
+#ifndef COMMON_AFFINITY_H
+#define COMMON_AFFINITY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace common {
+
+#define COMMON_AFFINITY_COMPONENT "Affinity"
+
+// CPU and NUMA placement. The memory policy calls go to the kernel directly rather than through
+// libnuma, and all of these fail softly: on a host without NUMA, or in a sandbox that forbids
+// them, the caller gets false or -1 and carries on unplaced.
+
+/**
+ * @brief Parses a CPU list in the kernel's format, such as "0-3,8".
+ * @param list The list.
+ * @return The CPUs, or an empty vector if the list is malformed.
+ */
+std::vector<int> parse_cpu_list(const std::string &list);
+
+/**
+ * @brief Pins the calling thread to one CPU.
+ * @param cpu The CPU.
+ * @return True on success, false otherwise.
+ */
+bool pin_current_thread(int cpu);
+
+/**
+ * @brief Gets the NUMA node of a CPU.
+ * @param cpu The CPU.
+ * @return The node, or -1 if unknown.
+ */
+int node_of_cpu(int cpu);
+
+/**
+ * @brief Gets the NUMA node holding the page at an address.
+ * @param address The address.
+ * @return The node, or -1 if unknown.
+ */
+int node_of_address(const void *address);
+
+/**
+ * @brief Makes the kernel place the memory the calling thread touches first on the node the
+ * thread runs on, whatever the process-wide policy is.
+ * @return True on success, false otherwise.
+ */
+bool prefer_local_memory();
+
+/**
+ * @brief Makes the kernel place the pages of a mapping on a node, moving those it already placed
+ * elsewhere. Pages stay usable from other nodes.
+ * @param address The page-aligned start of the range.
+ * @param length The length of the range.
+ * @param node The node.
+ * @return True on success, false otherwise.
+ */
+bool bind_memory_to_node(void *address, size_t length, int node);
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_AFFINITY_H
@@ -0,0 +1,35 @@
+#ifndef COMMON_COMPRESSION_H
+#define COMMON_COMPRESSION_H
+
+#include <cstddef>
+#include <vector>
+
+namespace chat_app {
+namespace common {
+
+/**
+ * @brief Compresses a buffer with a byte-oriented LZ77 codec in the style of LZ4.
+ *
+ * Chat traffic between servers is mostly small, repetitive frames (same headers, same
+ * usernames), which this kind of codec shrinks well at a cost of a few hundred MB/s per core.
+ * The output starts with the uncompressed size as a big-endian 32-bit integer.
+ *
+ * @param data The bytes to compress.
+ * @param size Number of bytes.
+ * @return The compressed bytes.
+ */
+std::vector<char> lz_compress(const char *data, size_t size);
+
+/**
+ * @brief Decompresses the output of lz_compress.
+ * @param data The compressed bytes.
+ * @param size Number of compressed bytes.
+ * @param out Receives the uncompressed bytes.
+ * @return True on success, false if the input is malformed.
+ */
+bool lz_decompress(const char *data, size_t size, std::vector<char> &out);
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_COMPRESSION_H
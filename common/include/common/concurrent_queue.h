@@ -0,0 +1,377 @@
+#ifndef COMMON_CONCURRENT_QUEUE_H
+#define COMMON_CONCURRENT_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace chat_app {
+namespace common {
+
+#define COMMON_CONCURRENT_QUEUE_COMPONENT "ConcurrentQueue"
+
+// Assumed size of a cache line. Indexes written by different threads are kept this far apart so
+// that they do not share a line.
+constexpr size_t CACHE_LINE_BYTES = 64;
+
+namespace detail {
+
+inline size_t round_up_to_power_of_two(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace detail
+
+/**
+ * @brief A bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Each side owns one index and keeps a cached copy of the other side's, so in the common case a
+ * push or pop touches no cache line the other thread writes. Batch operations publish all their
+ * elements with one store. The capacity is rounded up to a power of two.
+ */
+template <typename T> class SpscQueue {
+public:
+  using value_type = T;
+
+  explicit SpscQueue(size_t capacity)
+      : mask_(detail::round_up_to_power_of_two(std::max<size_t>(capacity, 2)) - 1), slots_(mask_ + 1) {}
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  bool try_push(T value) { return push_batch(&value, 1) == 1; }
+
+  // Moves up to count elements in; returns how many fit.
+  size_t push_batch(T *values, size_t count) {
+    const size_t tail = producer_.tail.load(std::memory_order_relaxed);
+    if (producer_.cached_head + capacity() - tail < count) {
+      producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+    }
+    const size_t pushed = std::min(count, producer_.cached_head + capacity() - tail);
+    for (size_t i = 0; i < pushed; ++i) {
+      slots_[(tail + i) & mask_] = std::move(values[i]);
+    }
+    if (pushed > 0) {
+      producer_.tail.store(tail + pushed, std::memory_order_release);
+    }
+    return pushed;
+  }
+
+  std::optional<T> try_pop() {
+    T value;
+    if (pop_batch(&value, 1) == 0) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // Moves up to max_count elements out; returns how many there were.
+  size_t pop_batch(T *out, size_t max_count) {
+    const size_t head = consumer_.head.load(std::memory_order_relaxed);
+    if (consumer_.cached_tail - head < max_count) {
+      consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+    }
+    const size_t popped = std::min(max_count, consumer_.cached_tail - head);
+    for (size_t i = 0; i < popped; ++i) {
+      out[i] = std::move(slots_[(head + i) & mask_]);
+    }
+    if (popped > 0) {
+      consumer_.head.store(head + popped, std::memory_order_release);
+    }
+    return popped;
+  }
+
+  // Exact from either end's own thread; a snapshot from anywhere else.
+  bool empty() const {
+    return consumer_.head.load(std::memory_order_acquire) == producer_.tail.load(std::memory_order_acquire);
+  }
+
+private:
+  struct alignas(CACHE_LINE_BYTES) Producer {
+    std::atomic<size_t> tail{0};
+    size_t cached_head{0};
+  };
+  struct alignas(CACHE_LINE_BYTES) Consumer {
+    std::atomic<size_t> head{0};
+    size_t cached_tail{0};
+  };
+
+  const size_t mask_;
+  std::vector<T> slots_;
+  Producer producer_;
+  Consumer consumer_;
+};
+
+/**
+ * @brief A bounded lock-free queue for any number of producer threads and one consumer thread.
+ *
+ * Every slot carries a sequence number that says whether it is free for, or filled at, a given
+ * position. Producers claim positions by compare-and-swap on the tail, a batch claiming a whole
+ * run at once, then fill and publish their slots independently; the consumer takes slots in order
+ * as they are published. The capacity is rounded up to a power of two.
+ */
+template <typename T> class MpscQueue {
+public:
+  using value_type = T;
+
+  explicit MpscQueue(size_t capacity)
+      : mask_(detail::round_up_to_power_of_two(std::max<size_t>(capacity, 2)) - 1),
+        slots_(new Slot[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  bool try_push(T value) { return push_batch(&value, 1) == 1; }
+
+  // Moves up to count elements in, as one contiguous run; returns how many fit.
+  size_t push_batch(T *values, size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t claimed = std::min(count, capacity());
+    while (claimed > 0) {
+      const size_t first = slots_[tail & mask_].sequence.load(std::memory_order_acquire);
+      if (first != tail) {
+        if (static_cast<std::ptrdiff_t>(first - tail) < 0) {
+          return 0; // Still filled from the previous lap: full
+        }
+        tail = tail_.load(std::memory_order_relaxed); // Another producer took this position
+        continue;
+      }
+      // The consumer frees slots in order, so if the run's last slot is free, all of it is.
+      const size_t last = tail + claimed - 1;
+      if (slots_[last & mask_].sequence.load(std::memory_order_acquire) != last) {
+        claimed /= 2;
+        continue;
+      }
+      if (tail_.compare_exchange_weak(tail, tail + claimed, std::memory_order_relaxed)) {
+        break;
+      }
+      claimed = std::min(count, capacity());
+    }
+    for (size_t i = 0; i < claimed; ++i) {
+      Slot &slot = slots_[(tail + i) & mask_];
+      slot.value = std::move(values[i]);
+      slot.sequence.store(tail + i + 1, std::memory_order_release);
+    }
+    return claimed;
+  }
+
+  std::optional<T> try_pop() {
+    T value;
+    if (pop_batch(&value, 1) == 0) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // Moves up to max_count published elements out; returns how many there were.
+  size_t pop_batch(T *out, size_t max_count) {
+    size_t popped = 0;
+    while (popped < max_count) {
+      Slot &slot = slots_[head_ & mask_];
+      if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+        break; // Empty, or the next producer has not published yet
+      }
+      out[popped++] = std::move(slot.value);
+      slot.sequence.store(head_ + capacity(), std::memory_order_release);
+      ++head_;
+    }
+    return popped;
+  }
+
+  // From the consumer thread only.
+  bool empty() const { return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) != head_ + 1; }
+
+private:
+  struct alignas(CACHE_LINE_BYTES) Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(CACHE_LINE_BYTES) std::atomic<size_t> tail_{0};
+  alignas(CACHE_LINE_BYTES) size_t head_{0}; // Consumer only
+};
+
+/**
+ * @brief A work-stealing deque (Chase-Lev): one owner thread pushes and takes at the bottom, any
+ * thread steals from the top.
+ *
+ * The owner works in LIFO order, so it keeps the most recently pushed, cache-warm work; thieves
+ * take the oldest. Only taking the last element, or stealing, costs a compare-and-swap. The
+ * buffer doubles when full; retired buffers are kept until the deque is destroyed, because a thief
+ * may still be reading one. T must be trivially copyable, typically a pointer.
+ */
+template <typename T> class ChaseLevDeque {
+  static_assert(std::is_trivially_copyable<T>::value, "ChaseLevDeque elements are copied by racing threads");
+
+public:
+  explicit ChaseLevDeque(size_t capacity = 256) {
+    buffers_.push_back(std::make_unique<Buffer>(detail::round_up_to_power_of_two(std::max<size_t>(capacity, 2))));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+  }
+
+  ChaseLevDeque(const ChaseLevDeque &) = delete;
+  ChaseLevDeque &operator=(const ChaseLevDeque &) = delete;
+
+  // Owner only.
+  void push(T value) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top >= static_cast<int64_t>(buffer->size())) {
+      buffer = grow(buffer, top, bottom);
+    }
+    buffer->put(bottom, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only: the most recently pushed element.
+  std::optional<T> take() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed); // Empty
+      return std::nullopt;
+    }
+    T value = buffer->get(bottom);
+    if (top == bottom) {
+      // The last element: race the thieves for it.
+      const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      if (!won) {
+        return std::nullopt;
+      }
+    }
+    return value;
+  }
+
+  // Any thread: the oldest element. Empty also when another thread won the race for it.
+  std::optional<T> steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return std::nullopt;
+    }
+    T value = buffer_.load(std::memory_order_acquire)->get(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // A snapshot from anywhere but the owner.
+  size_t size() const {
+    const int64_t size = bottom_.load(std::memory_order_acquire) - top_.load(std::memory_order_acquire);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+private:
+  class Buffer {
+  public:
+    explicit Buffer(size_t size) : mask_(size - 1), slots_(new std::atomic<T>[size]) {}
+    size_t size() const { return mask_ + 1; }
+    T get(int64_t index) const { return slots_[index & mask_].load(std::memory_order_relaxed); }
+    void put(int64_t index, T value) { slots_[index & mask_].store(value, std::memory_order_relaxed); }
+
+  private:
+    const size_t mask_;
+    std::unique_ptr<std::atomic<T>[]> slots_;
+  };
+
+  Buffer *grow(Buffer *old, int64_t top, int64_t bottom) {
+    buffers_.push_back(std::make_unique<Buffer>(old->size() * 2));
+    Buffer *grown = buffers_.back().get();
+    for (int64_t i = top; i < bottom; ++i) {
+      grown->put(i, old->get(i));
+    }
+    buffer_.store(grown, std::memory_order_release);
+    return grown;
+  }
+
+  alignas(CACHE_LINE_BYTES) std::atomic<int64_t> top_{0};
+  alignas(CACHE_LINE_BYTES) std::atomic<int64_t> bottom_{0};
+  std::atomic<Buffer *> buffer_{nullptr};
+  std::vector<std::unique_ptr<Buffer>> buffers_; // Owner only; every buffer ever used
+};
+
+/**
+ * @brief Wakes a reactor through an eventfd when its queue goes from empty to non-empty, and
+ * only then: producers signal only while the consumer has declared that it drained the queue.
+ *
+ * Producers call notify() after each push. The consumer watches get_fd() and, when it fires,
+ * calls drain(), which pops until the queue is empty, declares itself waiting and checks the
+ * queue once more, so a push racing with the declaration is not missed.
+ */
+class WakeupSignal {
+public:
+  WakeupSignal();
+  ~WakeupSignal();
+
+  WakeupSignal(const WakeupSignal &) = delete;
+  WakeupSignal &operator=(const WakeupSignal &) = delete;
+
+  bool is_valid() const { return event_fd_ != -1; }
+  int get_fd() const { return event_fd_; }
+  uint64_t signals_sent() const { return signals_sent_.load(std::memory_order_relaxed); }
+
+  void notify();
+
+  // Pops every element of the queue into handler, then waits for the next push. Returns the count.
+  template <typename Queue, typename Handler> size_t drain(Queue &queue, Handler &&handler) {
+    clear();
+    size_t drained = 0;
+    constexpr size_t BATCH = 64;
+    while (true) {
+      typename Queue::value_type batch[BATCH];
+      size_t popped;
+      while ((popped = queue.pop_batch(batch, BATCH)) > 0) {
+        for (size_t i = 0; i < popped; ++i) {
+          handler(std::move(batch[i]));
+        }
+        drained += popped;
+      }
+      waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in notify()
+      if (queue.empty()) {
+        return drained;
+      }
+      waiting_.store(false, std::memory_order_relaxed); // A push raced with the declaration
+    }
+  }
+
+private:
+  void clear();
+
+  int event_fd_{-1};
+  alignas(CACHE_LINE_BYTES) std::atomic<bool> waiting_{true};
+  std::atomic<uint64_t> signals_sent_{0};
+};
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_CONCURRENT_QUEUE_H
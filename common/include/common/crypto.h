@@ -0,0 +1,41 @@
+#ifndef COMMON_CRYPTO_H
+#define COMMON_CRYPTO_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace chat_app {
+namespace common {
+
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+constexpr size_t PASSWORD_SALT_SIZE = 16;
+
+using Sha256Digest = std::array<uint8_t, SHA256_DIGEST_SIZE>;
+
+Sha256Digest sha256(const void *data, size_t size);
+Sha256Digest hmac_sha256(const std::string &key, const void *data, size_t size);
+Sha256Digest pbkdf2_sha256(const std::string &password, const void *salt, size_t salt_size, uint32_t iterations);
+
+/**
+ * @brief A salted, deliberately slow password hash (PBKDF2-HMAC-SHA256).
+ * Fixed-size, so it can be copied around and written out without allocating.
+ */
+struct PasswordHash {
+  uint32_t iterations{0};
+  std::array<uint8_t, PASSWORD_SALT_SIZE> salt{};
+  Sha256Digest hash{};
+
+  static std::optional<PasswordHash> create(const std::string &password, uint32_t iterations);
+  bool verify(const std::string &password) const;
+
+  std::string encode() const;
+  static std::optional<PasswordHash> decode(const std::string &encoded);
+};
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_CRYPTO_H
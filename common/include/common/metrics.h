@@ -0,0 +1,68 @@
+#ifndef COMMON_METRICS_H
+#define COMMON_METRICS_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace chat_app {
+namespace common {
+
+/**
+ * @brief A thread-safe set of named gauges and counters.
+ * Rendered in the Prometheus text exposition format so it can be scraped from a file.
+ */
+class Metrics {
+public:
+  void set_gauge(const std::string &name, int64_t value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_[name] = value;
+  }
+
+  void increment_counter(const std::string &name, uint64_t delta = 1) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_[name] += delta;
+  }
+
+  int64_t get_gauge(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = gauges_.find(name);
+    return it != gauges_.end() ? it->second : 0;
+  }
+
+  uint64_t get_counter(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = counters_.find(name);
+    return it != counters_.end() ? it->second : 0;
+  }
+
+  void remove(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.erase(name);
+    counters_.erase(name);
+  }
+
+  std::string render() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream oss;
+    for (const auto &[name, value] : counters_) {
+      oss << name << " " << value << "\n";
+    }
+    for (const auto &[name, value] : gauges_) {
+      oss << name << " " << value << "\n";
+    }
+    return oss.str();
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, uint64_t> counters_;
+  std::map<std::string, int64_t> gauges_;
+};
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_METRICS_H
@@ -36,6 +36,30 @@ enum class MessageType : uint8_t {
   S2C_USER_JOINED_LIST = 0x16,
   S2C_SERVER_SHUTDOWN = 0x17,
 
+  // --- Server to Server ---
+  S2S_REPLICATION_HELLO = 0x20, // Standby -> primary. Payload: last applied log sequence.
+  S2S_REPLICATION_BATCH = 0x21, // Primary -> standby. Payload: primary's last sequence, '\n', encoded log records.
+  S2S_REPLICATION_ACK = 0x22,   // Standby -> primary. Payload: last applied log sequence.
+  S2S_USER_CREDENTIAL = 0x23,   // Message log only. Payload: username, '\n', encoded password hash.
+  S2S_PEER_HELLO = 0x24,        // Node -> node, on link setup. Payload: the sender's node ID.
+  S2S_PEER_BATCH = 0x25,        // Node -> node. Payload: '0' (raw) or '1' (LZ), then serialized chat events.
+  // Inside peer batches. Sender ID: the user; receiver ID: the node the user is connected to (0 = offline).
+  S2S_DIRECTORY_UPDATE = 0x26, // Connected node -> the user's home node.
+  S2S_DIRECTORY_LOOKUP = 0x27, // Any node -> the user's home node. Receiver ID unused.
+  S2S_DIRECTORY_REPLY = 0x28,  // Home node -> the node that looked the user up.
+  S2S_PRESENCE_DIGEST = 0x29,  // Inside peer batches. Payload: 'Q' or 'R' (reply), then "node version" lines.
+  S2S_PRESENCE_DELTA = 0x2A,   // Inside peer batches. Sender ID: the node whose presence changed. See PresenceTable.
+  S2S_GATEWAY_HELLO = 0x2B,    // Gateway -> routing server, on link setup. Payload: the gateway's instance ID.
+  S2S_GATEWAY_CLIENT = 0x2C,   // Gateway -> routing server. Sender ID: the session's channel. Payload: a client
+                               // message.
+  S2S_GATEWAY_CLOSE = 0x2D,    // Gateway -> routing server. Sender ID: the channel of a session that ended.
+  S2S_GATEWAY_DELIVER = 0x2E,  // Routing server -> gateway. Receiver ID: a channel, or BROADCAST_ID with the
+                               // excluded client as sender ID. Payload: a server message.
+  S2S_RELAY_BROADCAST = 0x2F,  // Inside peer batches. Sender ID: the origin node; receiver ID: the origin's sequence
+                               // number. Payload: an S2C_BROADCAST, relayed down the origin's tree.
+  S2S_GATEWAY_OPEN = 0x30,     // Gateway -> routing server, before a session's first message. Sender ID: the
+                               // session's channel. Payload: the client's address, its unit of auth fairness.
+
   S2C_ERROR = 0xFF
 };
 
@@ -96,6 +120,15 @@ struct Message {
   
 };
 
+/**
+ * @brief Checks whether a message carries chat. Chat is the bulk of the traffic; the control and
+ * presence messages (joins, errors, user lists, shutdown) are few and are handled ahead of it.
+ *
+ * @param type The message type.
+ * @return True for broadcasts and private messages.
+ */
+bool is_chat_message(MessageType type);
+
 /**
  * @brief Serializes a high-level Message struct into a network-ready byte buffer.
  *
@@ -115,6 +148,16 @@ std::vector<char> serialize_message(const Message &msg);
  */
 std::pair<std::optional<Message>, size_t> deserialize_message(const std::vector<char> &buffer);
 
+/**
+ * @brief Deserializes a message from the front of a raw byte range.
+ *
+ * @param data Pointer to the serialized bytes.
+ * @param size Number of bytes available.
+ * @return A pair containing the deserialized Message (if successful) and the
+ *         number of bytes consumed from the range.
+ */
+std::pair<std::optional<Message>, size_t> deserialize_message(const char *data, size_t size);
+
 } // namespace common
 } // namespace chat_app
 
@@ -0,0 +1,118 @@
+#ifndef COMMON_SHM_SOCKET_H
+#define COMMON_SHM_SOCKET_H
+
+#include "common/socket.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace chat_app {
+namespace common {
+
+#define COMMON_SHM_SOCKET_COMPONENT "ShmSocket"
+
+// Bytes of each direction's ring. A power of two.
+constexpr size_t SHM_RING_BYTES = 1024 * 1024;
+
+// Addresses starting with this name a ShmListener's Unix domain socket path rather than a host:port.
+constexpr char SHM_ADDRESS_PREFIX[] = "shm:";
+
+struct ShmSegment;
+
+/**
+ * @brief A stream socket between two processes (or threads) on the same host, carried by a pair
+ * of single-producer, single-consumer rings in a shared memory segment.
+ *
+ * Data is copied straight into the peer's ring with no system call while both ends are busy. An
+ * end that finds its ring empty (or the peer's ring full) flags that it waits, and the other end
+ * then wakes it through an eventfd; get_fd() returns an epoll FD that becomes readable on such a
+ * wakeup, so the socket plugs into an edge-triggered event loop like a TCP socket. A wakeup for
+ * free space also shows as readable: owners retry their pending writes on every loop iteration.
+ *
+ * The segment and eventfds are handed over as file descriptors on a Unix domain socket, which stays
+ * open for the life of the connection so that a peer that exits without closing is noticed. An end
+ * from connect_async() gets them from an event loop: get_fd() becomes readable when they arrive, and
+ * complete_handshake() then maps the segment.
+ */
+class ShmSocket : public IStreamSocket {
+public:
+  static std::pair<std::unique_ptr<IStreamSocket>, std::unique_ptr<IStreamSocket>>
+  create_pair(size_t ring_bytes = SHM_RING_BYTES);
+  static std::unique_ptr<IStreamSocket> connect(const std::string &path);
+  static std::unique_ptr<ShmSocket> connect_async(const std::string &path);
+  static std::unique_ptr<IStreamSocket> offer(int control_fd, size_t ring_bytes = SHM_RING_BYTES);
+  static std::unique_ptr<IStreamSocket> adopt(int control_fd);
+
+  ~ShmSocket() override;
+
+  ShmSocket(const ShmSocket &) = delete;
+  ShmSocket &operator=(const ShmSocket &) = delete;
+
+  SocketResult send_data(const std::vector<char> &data) override;
+  SocketResult raw_send(const char *data, size_t len) override;
+  SocketResult receive_data(std::vector<char> &buffer) override;
+  SocketResult raw_receive(char *buffer, size_t len) override;
+  void close_socket() override;
+  bool is_valid() const override;
+  int get_fd() const override;
+  void set_non_blocking(bool non_blocking) override;
+
+  SocketStatus complete_handshake();
+
+private:
+  static int connect_control(const std::string &path, bool non_blocking);
+  ShmSocket(int control_fd, int own_event_fd, int peer_event_fd, ShmSegment *segment, size_t mapped_bytes, int side);
+
+  SocketResult try_send(const char *data, size_t len);
+  SocketResult try_receive(char *buffer, size_t len);
+  void wake_peer();
+  bool drain_wakeups();
+  void wait_for_wakeup();
+
+  int control_fd_;
+  int own_event_fd_;  // Signaled by the peer
+  int peer_event_fd_; // Signaled by this end
+  int epoll_fd_{-1};  // Watches own_event_fd_ and control_fd_
+  ShmSegment *segment_; // Null until the handshake completed
+  size_t mapped_bytes_;
+  int side_; // 0 for the end that created the segment; it writes ring 0 and reads ring 1
+  bool non_blocking_{false};
+};
+
+/**
+ * @brief Accepts ShmSocket connections on a Unix domain socket path.
+ *
+ * bind_socket() binds the path given at construction; the port argument only exists for the
+ * IListeningSocket interface and is ignored. A stale socket file left by a previous run is replaced;
+ * a path some live listener is bound to is not.
+ */
+class ShmListener : public IListeningSocket {
+public:
+  explicit ShmListener(const std::string &path, size_t ring_bytes = SHM_RING_BYTES);
+  ~ShmListener() override;
+
+  ShmListener(const ShmListener &) = delete;
+  ShmListener &operator=(const ShmListener &) = delete;
+
+  bool bind_socket(int port) override;
+  bool listen_socket(int backlog) override;
+  std::unique_ptr<IStreamSocket> accept_connection() override;
+  void close_socket() override;
+  bool is_valid() const override;
+  int get_fd() const override;
+  void set_non_blocking(bool non_blocking) override;
+
+private:
+  const std::string path_;
+  const size_t ring_bytes_;
+  int socket_fd_{-1};
+  bool owns_path_{false}; // Bound by this listener, so removed again on close
+};
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_SHM_SOCKET_H
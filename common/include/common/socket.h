@@ -12,6 +12,9 @@ namespace common {
 
 #define COMMON_POSIX_SOCKET_COMPONENT "PosixSocket"
 
+// Addresses starting with this name a Unix domain socket path instead of a host.
+constexpr char UNIX_ADDRESS_PREFIX[] = "unix:";
+
 enum class SocketStatus { OK, WOULD_BLOCK, CLOSED, ERROR };
 
 /**
@@ -73,6 +76,7 @@ public:
   virtual ~IStreamSocket() = default;
 
   virtual SocketResult send_data(const std::vector<char> &data) = 0;
+  virtual SocketResult raw_send(const char *data, size_t len) = 0;
   virtual SocketResult receive_data(std::vector<char> &buffer) = 0;
   virtual SocketResult raw_receive(char *buffer, size_t len) = 0;
   virtual void close_socket() = 0;
@@ -83,11 +87,24 @@ public:
 
 /**
  * @brief Represents a POSIX socket that implements both IStreamSocket and IListeningSocket interfaces.
+ *
+ * Sockets are TCP by default. Unix domain stream sockets carry the same byte stream for processes
+ * on the same host without going through the TCP stack; a Unix domain listener binds the path it
+ * was created with and ignores the port passed to bind_socket(). A TCP listener created with
+ * reuse_port binds with SO_REUSEPORT, so that several processes accept on the same port and the
+ * kernel spreads connections between them.
+ *
+ * The class is final, so calls through a PosixSocket pointer are direct rather than virtual.
  */
-class PosixSocket : public IStreamSocket, public IListeningSocket {
+class PosixSocket final : public IStreamSocket, public IListeningSocket {
 public:
-  static std::unique_ptr<IListeningSocket> create_listener();
+  static std::unique_ptr<IListeningSocket> create_listener(bool reuse_port = false);
   static std::unique_ptr<IStreamSocket> create_connector(const std::string &ip_address, int port);
+  static std::unique_ptr<IStreamSocket> create_async_connector(const std::string &ip_address, int port);
+  static bool finish_connect(int fd);
+  static std::string peer_address(int fd);
+  static std::unique_ptr<IListeningSocket> create_unix_listener(const std::string &path);
+  static std::unique_ptr<IStreamSocket> create_unix_connector(const std::string &path);
 
   explicit PosixSocket(int fd);
   ~PosixSocket() override;
@@ -97,6 +114,7 @@ public:
 
   // IStreamSocket methods
   SocketResult send_data(const std::vector<char> &data) override;
+  SocketResult raw_send(const char *data, size_t len) override;
   SocketResult receive_data(std::vector<char> &buffer) override;
   SocketResult raw_receive(char *buffer, size_t len) override;
 
@@ -112,8 +130,13 @@ public:
   void set_non_blocking(bool non_blocking) override;
 
 private:
-  PosixSocket();
+  explicit PosixSocket(const std::string &unix_path = "");
+  bool bind_unix_path();
+
   int socket_fd_{-1};
+  std::string unix_path_; // Path a Unix domain listener binds; empty for TCP
+  bool owns_path_{false}; // The path was bound by this socket and is removed on close
+  bool reuse_port_{false};
 };
 
 } // namespace common
@@ -0,0 +1,126 @@
+#ifndef COMMON_WORK_STEALING_POOL_H
+#define COMMON_WORK_STEALING_POOL_H
+
+#include "common/concurrent_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace chat_app {
+namespace common {
+
+#define COMMON_WORK_STEALING_POOL_COMPONENT "WorkStealingPool"
+
+/**
+ * @brief A reactor's inbox for the results of work it offloaded: worker threads post completions,
+ * and the reactor, woken through get_fd() when the inbox goes from empty to non-empty, runs them.
+ */
+class CompletionQueue {
+public:
+  using Completion = std::function<void()>;
+
+  explicit CompletionQueue(size_t capacity = 1024) : queue_(capacity) {}
+
+  bool is_valid() const { return signal_.is_valid(); }
+  int get_fd() const { return signal_.get_fd(); }
+
+  void post(Completion completion);
+  size_t run();
+
+private:
+  MpscQueue<Completion> queue_;
+  WakeupSignal signal_;
+};
+
+/**
+ * @brief A pool of worker threads for CPU-heavy work that must not run on a reactor.
+ *
+ * Every worker owns one Chase-Lev deque per priority. Tasks submitted from outside the pool go to
+ * the workers' lock-free inboxes round-robin, and each worker moves its inbox into its deques;
+ * tasks submitted from a worker go straight to its own deques. A worker runs the most urgent task
+ * it can find: its own, in LIFO order, before the oldest of another worker's at the same priority,
+ * and any high-priority task before a normal one. Idle workers sleep and are woken when work
+ * arrives in their inbox or when a busy worker has work to spare.
+ */
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+  enum class Priority { HIGH = 0, NORMAL = 1, LOW = 2 };
+  static constexpr size_t PRIORITIES = 3;
+
+  explicit WorkStealingPool(size_t threads, size_t inbox_capacity = 1024);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  void set_cpus(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+  void start();
+  void stop();
+
+  bool submit(Task task, Priority priority = Priority::NORMAL);
+  template <typename Work, typename Done>
+  bool submit(Priority priority, CompletionQueue &completions, Work work, Done done);
+
+  size_t threads() const { return workers_.size(); }
+  uint64_t executed() const { return executed_.load(std::memory_order_relaxed); }
+  uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+private:
+  struct Job {
+    Task task;
+    Priority priority;
+  };
+  struct alignas(CACHE_LINE_BYTES) Worker {
+    explicit Worker(size_t inbox_capacity) : inbox(inbox_capacity) {}
+
+    MpscQueue<Job *> inbox;
+    ChaseLevDeque<Job *> deques[PRIORITIES];
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> sleeping{false};
+  };
+
+  void worker_loop(size_t index);
+  Job *find_job(size_t index);
+  void idle(Worker &self);
+  void wake(Worker &worker);
+  void wake_a_sleeper();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::vector<int> cpus_; // Workers are pinned to these round-robin; empty leaves them unpinned
+
+  std::atomic<bool> stopping_{false};
+  std::atomic<size_t> next_inbox_{0};
+  std::atomic<int64_t> stealable_{0}; // Tasks in the deques
+  std::atomic<size_t> sleepers_{0};
+  std::atomic<uint64_t> executed_{0};
+  std::atomic<uint64_t> stolen_{0};
+};
+
+/**
+ * @brief Runs work on the pool and then done(result) on the reactor that owns the completion
+ * queue. Work, done and the result must be copyable, as they are held in std::function.
+ * @return False if every worker's inbox is full; nothing runs then.
+ */
+template <typename Work, typename Done>
+bool WorkStealingPool::submit(Priority priority, CompletionQueue &completions, Work work, Done done) {
+  return submit(
+      [work = std::move(work), done = std::move(done), &completions]() mutable {
+        completions.post([result = work(), done]() mutable { done(std::move(result)); });
+      },
+      priority);
+}
+
+} // namespace common
+} // namespace chat_app
+
+#endif // COMMON_WORK_STEALING_POOL_H
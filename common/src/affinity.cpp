@@ -0,0 +1,112 @@
+#include "common/affinity.h"
+#include "common/logger.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace common {
+
+namespace {
+
+// Highest node the policy masks below cover.
+constexpr int MAX_NODE = 63;
+
+} // namespace
+
+std::vector<int> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  size_t position = 0;
+  while (position < list.size()) {
+    size_t end = list.find(',', position);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    const std::string range = list.substr(position, end - position);
+    const size_t dash = range.find('-');
+    try {
+      size_t parsed = 0;
+      const int first = std::stoi(range.substr(0, dash), &parsed);
+      int last = first;
+      if (dash != std::string::npos) {
+        last = std::stoi(range.substr(dash + 1), &parsed);
+        parsed += dash + 1;
+      }
+      if (parsed != range.size() || first < 0 || last < first || last >= CPU_SETSIZE) {
+        return {};
+      }
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::exception &) {
+      return {};
+    }
+    position = end + 1;
+  }
+  return cpus;
+}
+
+bool pin_current_thread(int cpu) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    LOG_WARNING(COMMON_AFFINITY_COMPONENT, "Failed to pin thread to CPU {}: {}", cpu, std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int node_of_cpu(int cpu) {
+  const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR *directory = opendir(path.c_str());
+  if (!directory) {
+    return -1;
+  }
+  int node = -1;
+  while (dirent *entry = readdir(directory)) {
+    if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = std::atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(directory);
+  return node;
+}
+
+int node_of_address(const void *address) {
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, address, MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+    return -1;
+  }
+  return node;
+}
+
+bool prefer_local_memory() {
+  if (syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) != 0) {
+    LOG_WARNING(COMMON_AFFINITY_COMPONENT, "Failed to set a local memory policy: {}", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool bind_memory_to_node(void *address, size_t length, int node) {
+  if (node < 0 || node > MAX_NODE) {
+    return false;
+  }
+  unsigned long mask = 1UL << node;
+  if (syscall(SYS_mbind, address, length, MPOL_PREFERRED, &mask, MAX_NODE + 2, MPOL_MF_MOVE) != 0) {
+    LOG_WARNING(COMMON_AFFINITY_COMPONENT, "Failed to bind memory to node {}: {}", node, std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+} // namespace common
+} // namespace chat_app
@@ -0,0 +1,170 @@
+#include "common/compression.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace chat_app {
+namespace common {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 12;
+// Upper bound on the uncompressed size accepted by the decoder, to reject garbage headers.
+constexpr uint32_t MAX_UNCOMPRESSED_SIZE = 64 * 1024 * 1024;
+
+inline uint32_t read32(const char *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t hash32(uint32_t value) { return (value * 2654435761U) >> (32 - HASH_BITS); }
+
+/**
+ * @brief Writes the extension bytes of a length that did not fit in its 4-bit token field.
+ */
+void put_length(std::vector<char> &out, size_t length) {
+  while (length >= 255) {
+    out.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  out.push_back(static_cast<char>(length));
+}
+
+/**
+ * @brief Emits one sequence: a run of literals followed by a match (match_length 0 for the final literals).
+ */
+void put_sequence(std::vector<char> &out, const char *literals, size_t literal_length, size_t offset,
+                  size_t match_length) {
+  const size_t match_code = match_length > 0 ? match_length - MIN_MATCH : 0;
+  const uint8_t token =
+      static_cast<uint8_t>((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(match_code, 15));
+  out.push_back(static_cast<char>(token));
+  if (literal_length >= 15) {
+    put_length(out, literal_length - 15);
+  }
+  out.insert(out.end(), literals, literals + literal_length);
+
+  if (match_length > 0) {
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15) {
+      put_length(out, match_code - 15);
+    }
+  }
+}
+
+/**
+ * @brief Reads a length whose 4-bit token field was 15.
+ */
+bool get_length(const uint8_t *&in, const uint8_t *end, size_t &length) {
+  uint8_t byte;
+  do {
+    if (in >= end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+} // namespace
+
+std::vector<char> lz_compress(const char *data, size_t size) {
+  std::vector<char> out;
+  out.reserve(4 + size + size / 255 + 16);
+  const uint32_t size_net = static_cast<uint32_t>(size);
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<char>(size_net >> shift));
+  }
+
+  // Most recent position (+1, so 0 means empty) of each hashed 4-byte prefix.
+  uint32_t table[1 << HASH_BITS] = {};
+  size_t anchor = 0;
+  size_t position = 0;
+  while (position + MIN_MATCH <= size) {
+    const uint32_t prefix = read32(data + position);
+    const uint32_t slot = hash32(prefix);
+    const size_t candidate = table[slot];
+    table[slot] = static_cast<uint32_t>(position + 1);
+
+    if (candidate == 0 || position + 1 - candidate > MAX_OFFSET || read32(data + candidate - 1) != prefix) {
+      ++position;
+      continue;
+    }
+
+    const size_t match_start = candidate - 1;
+    size_t length = MIN_MATCH;
+    while (position + length < size && data[match_start + length] == data[position + length]) {
+      ++length;
+    }
+    put_sequence(out, data + anchor, position - anchor, position - match_start, length);
+    position += length;
+    anchor = position;
+  }
+
+  put_sequence(out, data + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+bool lz_decompress(const char *data, size_t size, std::vector<char> &out) {
+  if (size < 4) {
+    return false;
+  }
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(data);
+  const uint8_t *end = in + size;
+  const uint32_t expected = (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | in[3];
+  if (expected > MAX_UNCOMPRESSED_SIZE) {
+    return false;
+  }
+  in += 4;
+
+  out.clear();
+  out.reserve(expected); // No reallocation below, so copying a match from `out` into itself is safe
+  bool terminated = false;
+  while (in < end) {
+    const uint8_t token = *in++;
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !get_length(in, end, literal_length)) {
+      return false;
+    }
+    if (literal_length > static_cast<size_t>(end - in) || out.size() + literal_length > expected) {
+      return false;
+    }
+    out.insert(out.end(), in, in + literal_length);
+    in += literal_length;
+
+    if (in == end) {
+      terminated = true; // The final sequence has literals only
+      break;
+    }
+
+    if (end - in < 2) {
+      return false;
+    }
+    const size_t offset = in[0] | (size_t(in[1]) << 8);
+    in += 2;
+    size_t match_length = token & 0x0f;
+    if (match_length == 15 && !get_length(in, end, match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > out.size() || out.size() + match_length > expected) {
+      return false;
+    }
+
+    // Byte by byte: the match may overlap the bytes it produces (runs).
+    size_t from = out.size() - offset;
+    for (size_t i = 0; i < match_length; ++i) {
+      out.push_back(out[from + i]);
+    }
+  }
+
+  return terminated && out.size() == expected;
+}
+
+} // namespace common
+} // namespace chat_app
@@ -0,0 +1,57 @@
+#include "common/concurrent_queue.h"
+#include "common/logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace common {
+
+/**
+ * @brief Constructs a WakeupSignal with its eventfd. Check is_valid() for failure.
+ */
+WakeupSignal::WakeupSignal() {
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ == -1) {
+    LOG_ERROR(COMMON_CONCURRENT_QUEUE_COMPONENT, "Failed to create eventfd: {}", std::strerror(errno));
+  }
+}
+
+/**
+ * @brief Destructor for WakeupSignal. Closes the eventfd.
+ */
+WakeupSignal::~WakeupSignal() {
+  if (event_fd_ != -1) {
+    close(event_fd_);
+  }
+}
+
+/**
+ * @brief Called by a producer after pushing: signals the eventfd if the consumer is waiting.
+ * Pushes while the consumer is busy draining cost no system call.
+ */
+void WakeupSignal::notify() {
+  std::atomic_thread_fence(std::memory_order_seq_cst); // Orders the push before reading waiting_
+  if (!waiting_.load(std::memory_order_relaxed) || !waiting_.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  signals_sent_.fetch_add(1, std::memory_order_relaxed);
+  const uint64_t one = 1;
+  if (write(event_fd_, &one, sizeof(one)) < 0) {
+    LOG_ERROR(COMMON_CONCURRENT_QUEUE_COMPONENT, "Failed to signal eventfd: {}", std::strerror(errno));
+  }
+}
+
+/**
+ * @brief Resets the eventfd's counter before the consumer drains.
+ */
+void WakeupSignal::clear() {
+  uint64_t count;
+  while (read(event_fd_, &count, sizeof(count)) > 0) {
+  }
+}
+
+} // namespace common
+} // namespace chat_app
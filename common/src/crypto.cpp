@@ -0,0 +1,302 @@
+#include "common/crypto.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/random.h>
+
+namespace chat_app {
+namespace common {
+
+namespace {
+
+constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+/**
+ * @brief Incremental SHA-256 (FIPS 180-4).
+ */
+class Sha256 {
+public:
+  Sha256() { reset(); }
+
+  void reset() {
+    static constexpr uint32_t INITIAL_STATE[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                                  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::memcpy(state_, INITIAL_STATE, sizeof(state_));
+    length_ = 0;
+    buffered_ = 0;
+  }
+
+  void update(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    length_ += size;
+    if (buffered_ > 0) {
+      size_t chunk = std::min(size, SHA256_BLOCK_SIZE - buffered_);
+      std::memcpy(buffer_ + buffered_, bytes, chunk);
+      buffered_ += chunk;
+      bytes += chunk;
+      size -= chunk;
+      if (buffered_ < SHA256_BLOCK_SIZE) {
+        return;
+      }
+      compress(buffer_);
+      buffered_ = 0;
+    }
+    for (; size >= SHA256_BLOCK_SIZE; bytes += SHA256_BLOCK_SIZE, size -= SHA256_BLOCK_SIZE) {
+      compress(bytes);
+    }
+    std::memcpy(buffer_, bytes, size);
+    buffered_ = size;
+  }
+
+  Sha256Digest finish() {
+    const uint64_t bit_length = length_ * 8;
+    const uint8_t pad = 0x80;
+    update(&pad, 1);
+    const uint8_t zero = 0;
+    while (buffered_ != SHA256_BLOCK_SIZE - 8) {
+      update(&zero, 1);
+    }
+    uint8_t length_bytes[8];
+    for (int i = 0; i < 8; ++i) {
+      length_bytes[i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+    }
+    update(length_bytes, sizeof(length_bytes));
+
+    Sha256Digest digest;
+    for (int i = 0; i < 8; ++i) {
+      digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+      digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+      digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+      digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+    }
+    return digest;
+  }
+
+private:
+  void compress(const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) | (uint32_t(block[4 * i + 2]) << 8) |
+             uint32_t(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+      uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+      uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+      uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+  }
+
+  uint32_t state_[8];
+  uint64_t length_;
+  uint8_t buffer_[SHA256_BLOCK_SIZE];
+  size_t buffered_;
+};
+
+/**
+ * @brief HMAC-SHA256 with the key schedule computed once, for the many HMACs of PBKDF2.
+ */
+class HmacSha256 {
+public:
+  explicit HmacSha256(const std::string &key) {
+    uint8_t block[SHA256_BLOCK_SIZE] = {};
+    if (key.size() > SHA256_BLOCK_SIZE) {
+      Sha256Digest digest = sha256(key.data(), key.size());
+      std::memcpy(block, digest.data(), digest.size());
+    } else {
+      std::memcpy(block, key.data(), key.size());
+    }
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+      pad[i] = block[i] ^ 0x36;
+    }
+    inner_.update(pad, sizeof(pad));
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+      pad[i] = block[i] ^ 0x5c;
+    }
+    outer_.update(pad, sizeof(pad));
+  }
+
+  Sha256Digest compute(const void *data, size_t size) const {
+    Sha256 inner = inner_;
+    inner.update(data, size);
+    Sha256Digest inner_digest = inner.finish();
+    Sha256 outer = outer_;
+    outer.update(inner_digest.data(), inner_digest.size());
+    return outer.finish();
+  }
+
+private:
+  Sha256 inner_;
+  Sha256 outer_;
+};
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+template <size_t N> std::string to_hex(const std::array<uint8_t, N> &bytes) {
+  std::string hex;
+  hex.reserve(N * 2);
+  for (uint8_t byte : bytes) {
+    hex += HEX_DIGITS[byte >> 4];
+    hex += HEX_DIGITS[byte & 0x0f];
+  }
+  return hex;
+}
+
+template <size_t N> bool from_hex(const std::string &hex, std::array<uint8_t, N> &bytes) {
+  if (hex.size() != N * 2) {
+    return false;
+  }
+  for (size_t i = 0; i < N; ++i) {
+    const char *high = std::strchr(HEX_DIGITS, hex[2 * i]);
+    const char *low = std::strchr(HEX_DIGITS, hex[2 * i + 1]);
+    if (!high || !low || !*high || !*low) {
+      return false;
+    }
+    bytes[i] = static_cast<uint8_t>(((high - HEX_DIGITS) << 4) | (low - HEX_DIGITS));
+  }
+  return true;
+}
+
+} // namespace
+
+/**
+ * @brief Computes the SHA-256 digest of a buffer.
+ */
+Sha256Digest sha256(const void *data, size_t size) {
+  Sha256 hasher;
+  hasher.update(data, size);
+  return hasher.finish();
+}
+
+/**
+ * @brief Computes HMAC-SHA256 (RFC 2104) of a buffer.
+ */
+Sha256Digest hmac_sha256(const std::string &key, const void *data, size_t size) {
+  return HmacSha256(key).compute(data, size);
+}
+
+/**
+ * @brief Derives a 32-byte key with PBKDF2-HMAC-SHA256 (RFC 8018).
+ * The cost grows linearly with the iteration count, which is the point: it makes guessing passwords expensive.
+ */
+Sha256Digest pbkdf2_sha256(const std::string &password, const void *salt, size_t salt_size, uint32_t iterations) {
+  const HmacSha256 hmac(password);
+
+  // A single block is enough for a 32-byte key: U1 = HMAC(salt || INT(1)).
+  std::string first_input(static_cast<const char *>(salt), salt_size);
+  first_input.append("\x00\x00\x00\x01", 4);
+  Sha256Digest u = hmac.compute(first_input.data(), first_input.size());
+  Sha256Digest result = u;
+  for (uint32_t i = 1; i < iterations; ++i) {
+    u = hmac.compute(u.data(), u.size());
+    for (size_t j = 0; j < result.size(); ++j) {
+      result[j] ^= u[j];
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Hashes a password with a fresh random salt.
+ * @param password The password.
+ * @param iterations The PBKDF2 iteration count.
+ * @return The hash, or std::nullopt if no randomness was available.
+ */
+std::optional<PasswordHash> PasswordHash::create(const std::string &password, uint32_t iterations) {
+  PasswordHash result;
+  result.iterations = iterations;
+  if (getrandom(result.salt.data(), result.salt.size(), 0) != static_cast<ssize_t>(result.salt.size())) {
+    return std::nullopt;
+  }
+  result.hash = pbkdf2_sha256(password, result.salt.data(), result.salt.size(), iterations);
+  return result;
+}
+
+/**
+ * @brief Checks a password against the hash, in time independent of where they differ.
+ * @param password The password to check.
+ * @return True if the password matches.
+ */
+bool PasswordHash::verify(const std::string &password) const {
+  Sha256Digest candidate = pbkdf2_sha256(password, salt.data(), salt.size(), iterations);
+  uint8_t difference = 0;
+  for (size_t i = 0; i < hash.size(); ++i) {
+    difference |= candidate[i] ^ hash[i];
+  }
+  return difference == 0;
+}
+
+/**
+ * @brief Encodes the hash as "<iterations>$<salt hex>$<hash hex>".
+ */
+std::string PasswordHash::encode() const { return std::to_string(iterations) + "$" + to_hex(salt) + "$" + to_hex(hash); }
+
+/**
+ * @brief Parses a hash produced by encode().
+ * @param encoded The encoded hash.
+ * @return The hash, or std::nullopt if the text is malformed.
+ */
+std::optional<PasswordHash> PasswordHash::decode(const std::string &encoded) {
+  size_t first = encoded.find('$');
+  size_t second = first == std::string::npos ? std::string::npos : encoded.find('$', first + 1);
+  if (second == std::string::npos || first == 0) {
+    return std::nullopt;
+  }
+
+  PasswordHash result;
+  unsigned long iterations = 0;
+  for (size_t i = 0; i < first; ++i) {
+    if (encoded[i] < '0' || encoded[i] > '9' || iterations > UINT32_MAX / 10) {
+      return std::nullopt;
+    }
+    iterations = iterations * 10 + (encoded[i] - '0');
+  }
+  if (iterations == 0 || iterations > UINT32_MAX) {
+    return std::nullopt;
+  }
+  result.iterations = static_cast<uint32_t>(iterations);
+
+  if (!from_hex(encoded.substr(first + 1, second - first - 1), result.salt) ||
+      !from_hex(encoded.substr(second + 1), result.hash)) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+} // namespace common
+} // namespace chat_app
@@ -5,6 +5,25 @@
 namespace chat_app {
 namespace common {
 
+/**
+ * @brief Checks whether a message carries chat rather than control or presence.
+ *
+ * @param type The message type.
+ * @return True for broadcasts and private messages.
+ */
+bool is_chat_message(MessageType type) {
+  switch (type) {
+  case MessageType::C2S_BROADCAST:
+  case MessageType::C2S_PRIVATE:
+  case MessageType::S2C_BROADCAST:
+  case MessageType::S2C_PRIVATE:
+  case MessageType::S2S_RELAY_BROADCAST:
+    return true;
+  default:
+    return false;
+  }
+}
+
 /**
  * @brief Serializes a Message object into a byte buffer.
  *
@@ -52,11 +71,22 @@ std::vector<char> serialize_message(const Message &msg) {
  * @return A pair containing an optional Message object and the number of bytes consumed.
  */
 std::pair<std::optional<Message>, size_t> deserialize_message(const std::vector<char> &buffer) {
-  if (buffer.size() < HEADER_SIZE) {
+  return deserialize_message(buffer.data(), buffer.size());
+}
+
+/**
+ * @brief Deserializes a message from the front of a raw byte range.
+ *
+ * @param data Pointer to the serialized bytes.
+ * @param size Number of bytes available.
+ * @return A pair containing an optional Message object and the number of bytes consumed.
+ */
+std::pair<std::optional<Message>, size_t> deserialize_message(const char *data, size_t size) {
+  if (size < HEADER_SIZE) {
     return {std::nullopt, 0}; // Not enough data for a header
   }
 
-  const char *ptr = buffer.data();
+  const char *ptr = data;
 
   // 1. Peek at the payload size from the header to see if the full message is present.
   uint32_t payload_size_net;
@@ -64,7 +94,7 @@ std::pair<std::optional<Message>, size_t> deserialize_message(const std::vector<
   uint32_t payload_size = ntohl(payload_size_net);
 
   const size_t total_message_size = HEADER_SIZE + payload_size;
-  if (buffer.size() < total_message_size) {
+  if (size < total_message_size) {
     return {std::nullopt, 0}; // Incomplete message
   }
 
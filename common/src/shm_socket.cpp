@@ -0,0 +1,699 @@
+#include "common/shm_socket.h"
+#include "common/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace common {
+
+namespace {
+
+constexpr uint64_t SHM_MAGIC = 0x31474553544d4853; // "SHMTSEG1"
+
+// File descriptors passed from the end creating the segment: the segment, the receiving end's
+// eventfd and the creating end's eventfd.
+constexpr size_t HANDOVER_FDS = 3;
+
+bool set_fd_non_blocking(int fd, bool non_blocking) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1) {
+    return false;
+  }
+  flags = non_blocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  return fcntl(fd, F_SETFL, flags) != -1;
+}
+
+bool send_fds(int socket_fd, const int *fds, size_t count) {
+  char byte = 0;
+  iovec iov{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOVER_FDS)] = {};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+  cmsghdr *header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+  std::memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+  return sendmsg(socket_fd, &message, MSG_NOSIGNAL) == 1;
+}
+
+SocketStatus receive_fds(int socket_fd, int *fds, size_t count) {
+  char byte = 0;
+  iovec iov{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOVER_FDS)] = {};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return SocketStatus::WOULD_BLOCK;
+  }
+  cmsghdr *header = received == 1 ? CMSG_FIRSTHDR(&message) : nullptr;
+  if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(sizeof(int) * count)) {
+    return SocketStatus::ERROR;
+  }
+  std::memcpy(fds, CMSG_DATA(header), sizeof(int) * count);
+  return SocketStatus::OK;
+}
+
+} // namespace
+
+/**
+ * @brief One direction of the connection. Positions count bytes since the start and only grow;
+ * the ring offset is the position modulo the ring size.
+ */
+struct ShmRing {
+  alignas(64) std::atomic<uint64_t> head{0}; // Advanced by the reader
+  alignas(64) std::atomic<uint64_t> tail{0}; // Advanced by the writer
+  alignas(64) std::atomic<uint32_t> reader_waiting{1}; // A new reader waits in its event loop
+  std::atomic<uint32_t> writer_waiting{0};
+  std::atomic<uint32_t> closed{0}; // Set by the writer; nothing follows what is in the ring
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory rings need lock-free atomics");
+
+/**
+ * @brief The start of the shared memory segment. The data of ring 0 and ring 1 follows.
+ */
+struct ShmSegment {
+  uint64_t magic{SHM_MAGIC};
+  uint64_t ring_bytes{0};
+  ShmRing rings[2];
+
+  char *data(int ring) { return reinterpret_cast<char *>(this) + sizeof(ShmSegment) + ring * ring_bytes; }
+};
+
+namespace {
+
+/**
+ * @brief Maps a segment handed over by the end that created it, and checks that it is one.
+ * @param memory_fd The segment's file descriptor; closed.
+ * @param mapped_bytes Set to the size of the mapping.
+ * @return The segment, or nullptr if it is not a valid one.
+ */
+ShmSegment *map_segment(int memory_fd, size_t &mapped_bytes) {
+  void *memory = MAP_FAILED;
+  struct stat info {};
+  if (fstat(memory_fd, &info) == 0 && static_cast<size_t>(info.st_size) > sizeof(ShmSegment)) {
+    mapped_bytes = static_cast<size_t>(info.st_size);
+    memory = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+  }
+  ::close(memory_fd);
+
+  auto *segment = static_cast<ShmSegment *>(memory);
+  if (memory != MAP_FAILED &&
+      (segment->magic != SHM_MAGIC || mapped_bytes != sizeof(ShmSegment) + 2 * segment->ring_bytes)) {
+    munmap(memory, mapped_bytes);
+    segment = nullptr;
+  }
+  return memory == MAP_FAILED ? nullptr : segment;
+}
+
+} // namespace
+
+/**
+ * @brief Creates two connected ends, for use by two threads of this process.
+ * @param ring_bytes Bytes of each direction's ring; a power of two.
+ * @return The ends, or two nullptrs on failure.
+ */
+std::pair<std::unique_ptr<IStreamSocket>, std::unique_ptr<IStreamSocket>> ShmSocket::create_pair(size_t ring_bytes) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to create socket pair: {}", strerror(errno));
+    return {nullptr, nullptr};
+  }
+  auto first = offer(fds[0], ring_bytes);
+  if (!first) {
+    ::close(fds[1]);
+    return {nullptr, nullptr};
+  }
+  auto second = adopt(fds[1]);
+  if (!second) {
+    return {nullptr, nullptr};
+  }
+  return {std::move(first), std::move(second)};
+}
+
+/**
+ * @brief Connects to a ShmListener, waiting for it to hand over the segment.
+ * @param path The listener's Unix domain socket path.
+ * @return The connected socket, or nullptr on failure.
+ */
+std::unique_ptr<IStreamSocket> ShmSocket::connect(const std::string &path) {
+  const int fd = connect_control(path, false);
+  return fd < 0 ? nullptr : adopt(fd);
+}
+
+/**
+ * @brief Connects to a ShmListener without waiting for the segment. The socket's FD becomes readable
+ * once the listener handed it over; complete_handshake() then finishes the connection.
+ * @param path The listener's Unix domain socket path.
+ * @return The connecting socket, or nullptr on failure.
+ */
+std::unique_ptr<ShmSocket> ShmSocket::connect_async(const std::string &path) {
+  const int fd = connect_control(path, true);
+  return fd < 0 ? nullptr : std::unique_ptr<ShmSocket>(new ShmSocket(fd, -1, -1, nullptr, 0, 1));
+}
+
+/**
+ * @brief Opens the Unix domain socket the segment is handed over on.
+ * @param path The listener's Unix domain socket path.
+ * @param non_blocking Whether the socket is non-blocking.
+ * @return The connected socket's FD, or -1 on failure.
+ */
+int ShmSocket::connect_control(const std::string &path, bool non_blocking) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Socket path too long: {}", path);
+    return -1;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | (non_blocking ? SOCK_NONBLOCK : 0), 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Connection to {} failed: {}", path, strerror(errno));
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Creates a segment and hands it to the process at the other end of a Unix domain socket,
+ * which calls adopt().
+ * @param control_fd The connected Unix domain socket. Owned by the result, or closed on failure.
+ * @param ring_bytes Bytes of each direction's ring; a power of two.
+ * @return This process's end, or nullptr on failure.
+ */
+std::unique_ptr<IStreamSocket> ShmSocket::offer(int control_fd, size_t ring_bytes) {
+  if (ring_bytes == 0 || (ring_bytes & (ring_bytes - 1)) != 0) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Ring size {} is not a power of two", ring_bytes);
+    ::close(control_fd);
+    return nullptr;
+  }
+
+  const size_t mapped_bytes = sizeof(ShmSegment) + 2 * ring_bytes;
+  int memory_fd = memfd_create("chat_shm_socket", MFD_CLOEXEC);
+  int own_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  int peer_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  void *memory = MAP_FAILED;
+  if (memory_fd >= 0 && own_event_fd >= 0 && peer_event_fd >= 0 &&
+      ftruncate(memory_fd, static_cast<off_t>(mapped_bytes)) == 0) {
+    memory = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+  }
+
+  bool handed_over = false;
+  if (memory != MAP_FAILED) {
+    auto *segment = new (memory) ShmSegment();
+    segment->ring_bytes = ring_bytes;
+    const int fds[HANDOVER_FDS] = {memory_fd, peer_event_fd, own_event_fd};
+    handed_over = send_fds(control_fd, fds, HANDOVER_FDS);
+  }
+  if (memory_fd >= 0) {
+    ::close(memory_fd); // The mapping keeps the segment alive
+  }
+  if (!handed_over) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to set up shared memory connection: {}", strerror(errno));
+    if (memory != MAP_FAILED) {
+      munmap(memory, mapped_bytes);
+    }
+    for (int fd : {own_event_fd, peer_event_fd, control_fd}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return nullptr;
+  }
+  return std::unique_ptr<IStreamSocket>(
+      new ShmSocket(control_fd, own_event_fd, peer_event_fd, static_cast<ShmSegment *>(memory), mapped_bytes, 0));
+}
+
+/**
+ * @brief Maps the segment offered by the process at the other end of a Unix domain socket.
+ * @param control_fd The connected, blocking Unix domain socket. Owned by the result, or closed on failure.
+ * @return This process's end, or nullptr on failure.
+ */
+std::unique_ptr<IStreamSocket> ShmSocket::adopt(int control_fd) {
+  int fds[HANDOVER_FDS] = {-1, -1, -1};
+  size_t mapped_bytes = 0;
+  ShmSegment *segment = nullptr;
+  if (receive_fds(control_fd, fds, HANDOVER_FDS) == SocketStatus::OK) {
+    segment = map_segment(fds[0], mapped_bytes);
+  }
+  if (!segment) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Did not receive a valid shared memory segment");
+    for (int fd : {fds[1], fds[2], control_fd}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return nullptr;
+  }
+  return std::unique_ptr<IStreamSocket>(new ShmSocket(control_fd, fds[1], fds[2], segment, mapped_bytes, 1));
+}
+
+ShmSocket::ShmSocket(int control_fd, int own_event_fd, int peer_event_fd, ShmSegment *segment, size_t mapped_bytes,
+                     int side)
+    : control_fd_(control_fd), own_event_fd_(own_event_fd), peer_event_fd_(peer_event_fd), segment_(segment),
+      mapped_bytes_(mapped_bytes), side_(side) {
+  // The peer never writes to the control socket after the handover: any event on it means it is gone.
+  set_fd_non_blocking(control_fd_, true);
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event{};
+  if (own_event_fd_ >= 0) {
+    event.events = EPOLLIN;
+    event.data.fd = own_event_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, own_event_fd_, &event);
+  }
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.fd = control_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, control_fd_, &event);
+  LOG_DEBUG(COMMON_SHM_SOCKET_COMPONENT, "Shared memory socket created with fd {}", epoll_fd_);
+}
+
+/**
+ * @brief Finishes a connection from connect_async() once its FD is readable: maps the segment the
+ * listener handed over.
+ * @return OK once connected, WOULD_BLOCK while the segment has not arrived, ERROR if the handshake failed.
+ */
+SocketStatus ShmSocket::complete_handshake() {
+  if (!is_valid()) {
+    return SocketStatus::ERROR;
+  }
+  if (segment_) {
+    return SocketStatus::OK;
+  }
+
+  int fds[HANDOVER_FDS] = {-1, -1, -1};
+  const SocketStatus status = receive_fds(control_fd_, fds, HANDOVER_FDS);
+  if (status == SocketStatus::WOULD_BLOCK) {
+    return status;
+  }
+  size_t mapped_bytes = 0;
+  ShmSegment *segment = status == SocketStatus::OK ? map_segment(fds[0], mapped_bytes) : nullptr;
+  if (!segment) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Did not receive a valid shared memory segment");
+    for (int fd : {fds[1], fds[2]}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    return SocketStatus::ERROR;
+  }
+
+  own_event_fd_ = fds[1];
+  peer_event_fd_ = fds[2];
+  segment_ = segment;
+  mapped_bytes_ = mapped_bytes;
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = own_event_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, own_event_fd_, &event);
+  return SocketStatus::OK;
+}
+
+/**
+ * @brief Destructor for ShmSocket. Closes the socket.
+ */
+ShmSocket::~ShmSocket() { close_socket(); }
+
+/**
+ * @brief Sends data. In non-blocking mode, writes as much as the peer's ring has room for.
+ * @param data The data to send.
+ * @return A SocketResult indicating the status of the operation and the number of bytes sent.
+ */
+SocketResult ShmSocket::send_data(const std::vector<char> &data) { return raw_send(data.data(), data.size()); }
+
+/**
+ * @brief Sends data from a raw buffer. In non-blocking mode, writes as much as the peer's ring has room for.
+ * @param data The data to send.
+ * @param len The number of bytes to send.
+ * @return A SocketResult indicating the status of the operation and the number of bytes sent.
+ */
+SocketResult ShmSocket::raw_send(const char *data, size_t len) {
+  if (!is_valid())
+    return {SocketStatus::ERROR, 0};
+  if (!segment_)
+    return {SocketStatus::WOULD_BLOCK, 0}; // The handshake has not completed
+  if (len == 0)
+    return {SocketStatus::OK, 0};
+
+  if (non_blocking_) {
+    return try_send(data, len);
+  }
+  size_t sent = 0;
+  while (sent < len) {
+    auto result = try_send(data + sent, len - sent);
+    if (result.status == SocketStatus::OK) {
+      sent += result.bytes_transferred;
+    } else if (result.status == SocketStatus::WOULD_BLOCK) {
+      wait_for_wakeup();
+    } else {
+      return result;
+    }
+  }
+  return {SocketStatus::OK, sent};
+}
+
+/**
+ * @brief Receives data into a buffer.
+ * @param buffer The buffer to receive data into, which should be pre-allocated with sufficient capacity.
+ */
+SocketResult ShmSocket::receive_data(std::vector<char> &buffer) {
+  if (!is_valid())
+    return {SocketStatus::ERROR, 0};
+
+  return raw_receive(buffer.data(), buffer.capacity());
+}
+
+/**
+ * @brief Receives data into a raw buffer. In blocking mode, waits until some data arrived.
+ * @param buffer The raw buffer to receive data into.
+ * @param len The length of the buffer.
+ * @return A SocketResult indicating the status of the operation and the number of bytes received.
+ */
+SocketResult ShmSocket::raw_receive(char *buffer, size_t len) {
+  if (!is_valid())
+    return {SocketStatus::ERROR, 0};
+  if (!segment_)
+    return {SocketStatus::WOULD_BLOCK, 0}; // The handshake has not completed
+
+  while (true) {
+    auto result = try_receive(buffer, len);
+    if (result.status != SocketStatus::WOULD_BLOCK || non_blocking_) {
+      return result;
+    }
+    wait_for_wakeup();
+  }
+}
+
+/**
+ * @brief Closes this end. The peer reads what is left in its ring, then sees the socket closed.
+ */
+void ShmSocket::close_socket() {
+  if (!is_valid()) {
+    return;
+  }
+  if (segment_) {
+    segment_->rings[side_].closed.store(1, std::memory_order_release);
+    wake_peer();
+    munmap(segment_, mapped_bytes_);
+    segment_ = nullptr;
+  }
+  for (int fd : {epoll_fd_, own_event_fd_, peer_event_fd_, control_fd_}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  epoll_fd_ = own_event_fd_ = peer_event_fd_ = control_fd_ = -1;
+}
+
+/**
+ * @brief Checks if the socket is valid.
+ * @return True if the socket is valid, false otherwise.
+ */
+bool ShmSocket::is_valid() const { return control_fd_ != -1; }
+
+/**
+ * @brief Gets the file descriptor to wait on: it becomes readable when the peer wakes this end
+ * (data arrived, room freed up) or goes away.
+ * @return The file descriptor.
+ */
+int ShmSocket::get_fd() const { return epoll_fd_; }
+
+/**
+ * @brief Sets the socket to non-blocking mode or blocking mode.
+ * @param non_blocking If true, sets the socket to non-blocking mode; otherwise, sets it to blocking mode.
+ */
+void ShmSocket::set_non_blocking(bool non_blocking) { non_blocking_ = non_blocking; }
+
+/**
+ * @brief Copies as much data as fits into the peer's ring, waking the peer if it waits for data.
+ */
+SocketResult ShmSocket::try_send(const char *data, size_t len) {
+  ShmRing &ring = segment_->rings[side_];
+  if (segment_->rings[1 - side_].closed.load(std::memory_order_acquire)) {
+    return {SocketStatus::CLOSED, 0};
+  }
+
+  const size_t capacity = segment_->ring_bytes;
+  const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+  size_t room = capacity - static_cast<size_t>(tail - ring.head.load(std::memory_order_acquire));
+  if (room == 0) {
+    // Flag before looking again, so that the reader either sees the flag or this end sees its progress.
+    ring.writer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    room = capacity - static_cast<size_t>(tail - ring.head.load(std::memory_order_acquire));
+    if (room == 0) {
+      return {SocketStatus::WOULD_BLOCK, 0};
+    }
+    ring.writer_waiting.store(0, std::memory_order_relaxed);
+  }
+
+  const size_t count = std::min(room, len);
+  const size_t offset = static_cast<size_t>(tail & (capacity - 1));
+  const size_t first = std::min(count, capacity - offset);
+  char *ring_data = segment_->data(side_);
+  std::memcpy(ring_data + offset, data, first);
+  std::memcpy(ring_data, data + first, count - first);
+  ring.tail.store(tail + count, std::memory_order_release);
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring.reader_waiting.load(std::memory_order_relaxed) && ring.reader_waiting.exchange(0)) {
+    wake_peer();
+  }
+  return {SocketStatus::OK, count};
+}
+
+/**
+ * @brief Copies what the peer wrote out of this end's ring, waking the peer if it waits for room.
+ */
+SocketResult ShmSocket::try_receive(char *buffer, size_t len) {
+  ShmRing &ring = segment_->rings[1 - side_];
+  const uint64_t head = ring.head.load(std::memory_order_relaxed);
+  uint64_t tail = ring.tail.load(std::memory_order_acquire);
+  if (tail == head) {
+    // Consume old wakeups before flagging, so that a wakeup for data written from now on is kept.
+    const bool peer_alive = drain_wakeups();
+    ring.reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    tail = ring.tail.load(std::memory_order_acquire);
+    if (tail == head) {
+      if (!peer_alive || ring.closed.load(std::memory_order_acquire)) {
+        return {SocketStatus::CLOSED, 0};
+      }
+      return {SocketStatus::WOULD_BLOCK, 0};
+    }
+    ring.reader_waiting.store(0, std::memory_order_relaxed);
+  }
+
+  const size_t capacity = segment_->ring_bytes;
+  const size_t count = std::min(static_cast<size_t>(tail - head), len);
+  const size_t offset = static_cast<size_t>(head & (capacity - 1));
+  const size_t first = std::min(count, capacity - offset);
+  const char *ring_data = segment_->data(1 - side_);
+  std::memcpy(buffer, ring_data + offset, first);
+  std::memcpy(buffer + first, ring_data, count - first);
+  ring.head.store(head + count, std::memory_order_release);
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring.writer_waiting.load(std::memory_order_relaxed) && ring.writer_waiting.exchange(0)) {
+    wake_peer();
+  }
+  return {SocketStatus::OK, count};
+}
+
+/**
+ * @brief Signals the peer's eventfd.
+ */
+void ShmSocket::wake_peer() {
+  const uint64_t one = 1;
+  if (write(peer_event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to wake peer: {}", strerror(errno));
+  }
+}
+
+/**
+ * @brief Resets this end's eventfd.
+ * @return False if the peer went away, true otherwise.
+ */
+bool ShmSocket::drain_wakeups() {
+  epoll_event events[2];
+  const int count = epoll_wait(epoll_fd_, events, 2, 0);
+  bool peer_alive = true;
+  for (int i = 0; i < count; ++i) {
+    if (events[i].data.fd == own_event_fd_) {
+      uint64_t value;
+      (void)!read(own_event_fd_, &value, sizeof(value));
+    } else {
+      peer_alive = false;
+    }
+  }
+  return peer_alive;
+}
+
+/**
+ * @brief Blocks until the peer wakes this end.
+ */
+void ShmSocket::wait_for_wakeup() {
+  pollfd descriptor{epoll_fd_, POLLIN, 0};
+  if (poll(&descriptor, 1, -1) > 0) {
+    drain_wakeups();
+  }
+}
+
+/**
+ * @brief Constructor for ShmListener.
+ * @param path The Unix domain socket path to listen on.
+ * @param ring_bytes Bytes of each direction's ring of accepted connections; a power of two.
+ */
+ShmListener::ShmListener(const std::string &path, size_t ring_bytes) : path_(path), ring_bytes_(ring_bytes) {
+  socket_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_fd_ < 0) {
+    LOG_CRITICAL(COMMON_SHM_SOCKET_COMPONENT, "Failed to create socket: {}", strerror(errno));
+  }
+}
+
+/**
+ * @brief Destructor for ShmListener. Closes the socket and removes its path.
+ */
+ShmListener::~ShmListener() { close_socket(); }
+
+/**
+ * @brief Binds the socket to the path given at construction. A socket file left by a listener that is
+ * no longer running is replaced; a path some live listener is bound to is not.
+ * @param port Ignored.
+ * @return True if the binding was successful, false otherwise.
+ */
+bool ShmListener::bind_socket(int /*port*/) {
+  if (!is_valid())
+    return false;
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Socket path too long: {}", path_);
+    return false;
+  }
+  std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+
+  bool bound = bind(socket_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+  if (!bound && errno == EADDRINUSE) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const bool in_use = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    if (probe >= 0) {
+      ::close(probe);
+    }
+    if (!in_use) {
+      ::unlink(path_.c_str());
+      bound = bind(socket_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    } else {
+      errno = EADDRINUSE;
+    }
+  }
+  if (!bound) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to bind {}: {}", path_, strerror(errno));
+    return false;
+  }
+
+  owns_path_ = true;
+  return true;
+}
+
+/**
+ * @brief Listens for incoming connections on the socket.
+ * @param backlog The maximum length of the queue of pending connections.
+ * @return True if the socket is successfully set to listen, false otherwise.
+ */
+bool ShmListener::listen_socket(int backlog) {
+  if (!is_valid())
+    return false;
+
+  if (listen(socket_fd_, backlog) < 0) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to listen on {}: {}", path_, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Accepts a connection and hands it a new shared memory segment.
+ * @return The connected socket, or nullptr if no connection was pending or the setup failed.
+ */
+std::unique_ptr<IStreamSocket> ShmListener::accept_connection() {
+  if (!is_valid())
+    return nullptr;
+
+  int control_fd = accept4(socket_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+  if (control_fd < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to accept connection: {}", strerror(errno));
+    }
+    return nullptr;
+  }
+  return ShmSocket::offer(control_fd, ring_bytes_);
+}
+
+/**
+ * @brief Closes the socket and removes its path.
+ */
+void ShmListener::close_socket() {
+  if (is_valid()) {
+    ::close(socket_fd_);
+    socket_fd_ = -1;
+  }
+  if (owns_path_) {
+    ::unlink(path_.c_str());
+    owns_path_ = false;
+  }
+}
+
+/**
+ * @brief Checks if the socket is valid.
+ * @return True if the socket is valid, false otherwise.
+ */
+bool ShmListener::is_valid() const { return socket_fd_ != -1; }
+
+/**
+ * @brief Gets the file descriptor of the socket.
+ * @return The file descriptor of the socket.
+ */
+int ShmListener::get_fd() const { return socket_fd_; }
+
+/**
+ * @brief Sets the socket to non-blocking mode or blocking mode.
+ * @param non_blocking If true, sets the socket to non-blocking mode; otherwise, sets it to blocking mode.
+ */
+void ShmListener::set_non_blocking(bool non_blocking) {
+  if (is_valid() && !set_fd_non_blocking(socket_fd_, non_blocking)) {
+    LOG_ERROR(COMMON_SHM_SOCKET_COMPONENT, "Failed to set socket flags: {}", strerror(errno));
+  }
+}
+
+} // namespace common
+} // namespace chat_app
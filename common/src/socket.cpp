@@ -8,17 +8,39 @@
 #include <netinet/in.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 namespace chat_app {
 namespace common {
 
+namespace {
+
+/**
+ * @brief Fills in a Unix domain socket address.
+ * @return False if the path does not fit.
+ */
+bool make_unix_address(const std::string &path, sockaddr_un &address) {
+  address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Invalid Unix domain socket path: {}", path);
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+} // namespace
+
 /**
  * @brief Constructor for PosixSocket.
- * The socket is created in the AF_INET domain (IPv4), with a SOCK_STREAM type (TCP).
+ * The socket is created in the AF_INET domain (IPv4), or the AF_UNIX domain if a path is given,
+ * with a SOCK_STREAM type.
+ * @param unix_path The path a Unix domain listener binds, or empty for TCP.
  */
-PosixSocket::PosixSocket() {
-  socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+PosixSocket::PosixSocket(const std::string &unix_path) : unix_path_(unix_path) {
+  socket_fd_ = socket(unix_path_.empty() ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
   if (socket_fd_ < 0) {
     LOG_CRITICAL(COMMON_POSIX_SOCKET_COMPONENT, "Failed to create socket: {}", strerror(errno));
   } else {
@@ -53,6 +75,10 @@ void PosixSocket::close_socket() {
     ::close(socket_fd_);
     socket_fd_ = -1;
   }
+  if (owns_path_) {
+    ::unlink(unix_path_.c_str());
+    owns_path_ = false;
+  }
 }
 
 /**
@@ -94,13 +120,15 @@ void PosixSocket::set_non_blocking(bool non_blocking) {
 
 /**
  * @brief Creates a new listening socket.
+ * @param reuse_port Whether other sockets may bind the same port with SO_REUSEPORT too.
  * @return A unique pointer to the created listening socket, or nullptr if the socket creation failed.
  */
-std::unique_ptr<IListeningSocket> PosixSocket::create_listener() {
+std::unique_ptr<IListeningSocket> PosixSocket::create_listener(bool reuse_port) {
   auto sock = std::unique_ptr<PosixSocket>(new PosixSocket());
   if (!sock->is_valid()) {
     return nullptr;
   }
+  sock->reuse_port_ = reuse_port;
   return sock;
 }
 
@@ -134,7 +162,124 @@ std::unique_ptr<IStreamSocket> PosixSocket::create_connector(const std::string &
 }
 
 /**
- * @brief Binds the socket to a specified port.
+ * @brief Starts connecting a non-blocking socket to a specified IP address and port, without waiting for the
+ * connection. The socket becomes writable once the connect is over; finish_connect() then tells whether it worked.
+ * @param ip_address The IP address to connect to.
+ * @param port The port number to connect to.
+ * @return A unique pointer to the non-blocking stream socket, or nullptr if the connect could not be started.
+ */
+std::unique_ptr<IStreamSocket> PosixSocket::create_async_connector(const std::string &ip_address, int port) {
+  auto sock = std::unique_ptr<PosixSocket>(new PosixSocket());
+  if (!sock->is_valid()) {
+    return nullptr;
+  }
+  sock->set_non_blocking(true);
+
+  sockaddr_in server_addr{};
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(port);
+
+  if (inet_pton(AF_INET, ip_address.c_str(), &server_addr.sin_addr) <= 0) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Invalid IP address: {}", ip_address);
+    return nullptr;
+  }
+
+  if (connect(sock->get_fd(), reinterpret_cast<sockaddr *>(&server_addr), sizeof(server_addr)) < 0 &&
+      errno != EINPROGRESS) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Connection failed: {}", strerror(errno));
+    return nullptr;
+  }
+
+  return sock;
+}
+
+/**
+ * @brief Checks how a connect started by create_async_connector() ended. Called once the socket is writable.
+ * @param fd The socket's file descriptor.
+ * @return True if the socket is connected, false if the connect failed.
+ */
+bool PosixSocket::finish_connect(int fd) {
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    LOG_DEBUG(COMMON_POSIX_SOCKET_COMPONENT, "Connection failed: {}", strerror(error));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Gets the IP address of a connected socket's peer, the unit of fairness for the auth queue.
+ * Peers on a Unix domain socket are identified by their user ID.
+ * @param fd The socket's file descriptor.
+ * @return The address, or an empty string if there is none.
+ */
+std::string PosixSocket::peer_address(int fd) {
+  sockaddr_storage address{};
+  socklen_t length = sizeof(address);
+  if (getpeername(fd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+    return "";
+  }
+
+  char text[INET6_ADDRSTRLEN] = "";
+  if (address.ss_family == AF_INET) {
+    inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in *>(&address)->sin_addr, text, sizeof(text));
+  } else if (address.ss_family == AF_INET6) {
+    inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6 *>(&address)->sin6_addr, text, sizeof(text));
+  } else if (address.ss_family == AF_UNIX) {
+    // Local clients have no address; their user ID is the unit of fairness instead.
+    ucred credentials{};
+    socklen_t credentials_length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_length) == 0) {
+      return "uid:" + std::to_string(credentials.uid);
+    }
+  }
+  return text;
+}
+
+/**
+ * @brief Creates a new Unix domain listening socket.
+ * @param path The path to listen on, bound by bind_socket().
+ * @return A unique pointer to the created listening socket, or nullptr if the socket creation failed.
+ */
+std::unique_ptr<IListeningSocket> PosixSocket::create_unix_listener(const std::string &path) {
+  auto sock = std::unique_ptr<PosixSocket>(new PosixSocket(path));
+  if (!sock->is_valid()) {
+    return nullptr;
+  }
+  return sock;
+}
+
+/**
+ * @brief Creates a new Unix domain socket connected to a local listener.
+ * @param path The path the listener is bound to.
+ * @return A unique pointer to the created stream socket, or nullptr if the connection failed.
+ */
+std::unique_ptr<IStreamSocket> PosixSocket::create_unix_connector(const std::string &path) {
+  sockaddr_un server_addr{};
+  if (!make_unix_address(path, server_addr)) {
+    return nullptr;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG_CRITICAL(COMMON_POSIX_SOCKET_COMPONENT, "Failed to create socket: {}", strerror(errno));
+    return nullptr;
+  }
+  auto sock = std::make_unique<PosixSocket>(fd);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&server_addr), sizeof(server_addr)) < 0) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Connection to {} failed: {}", path, strerror(errno));
+    return nullptr;
+  }
+
+  return sock;
+}
+
+/**
+ * @brief Binds the socket to a specified port, or a Unix domain listener to its path.
  * @param port The port number to bind the socket to.
  * @return True if the binding was successful, false otherwise.
  */
@@ -142,11 +287,19 @@ bool PosixSocket::bind_socket(int port) {
   if (!is_valid())
     return false;
 
+  if (!unix_path_.empty()) {
+    return bind_unix_path();
+  }
+
   int opt = 1;
   if (setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
     LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Failed to set socket options: {}", strerror(errno));
     return false;
   }
+  if (reuse_port_ && setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Failed to set SO_REUSEPORT: {}", strerror(errno));
+    return false;
+  }
 
   sockaddr_in addr{};
   addr.sin_family = AF_INET;
@@ -161,6 +314,40 @@ bool PosixSocket::bind_socket(int port) {
   return true;
 }
 
+/**
+ * @brief Binds a Unix domain listener to its path. A socket file left by a server that is no
+ * longer running is replaced; a path some live server listens on is not.
+ * @return True if the binding was successful, false otherwise.
+ */
+bool PosixSocket::bind_unix_path() {
+  sockaddr_un addr{};
+  if (!make_unix_address(unix_path_, addr)) {
+    return false;
+  }
+
+  bool bound = bind(socket_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+  if (!bound && errno == EADDRINUSE) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    const bool in_use = probe >= 0 && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    if (probe >= 0) {
+      ::close(probe);
+    }
+    if (!in_use) {
+      ::unlink(unix_path_.c_str());
+      bound = bind(socket_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    } else {
+      errno = EADDRINUSE;
+    }
+  }
+  if (!bound) {
+    LOG_ERROR(COMMON_POSIX_SOCKET_COMPONENT, "Failed to bind {}: {}", unix_path_, strerror(errno));
+    return false;
+  }
+
+  owns_path_ = true;
+  return true;
+}
+
 /**
  * @brief Listens for incoming connections on the socket.
  * @param backlog The maximum length of the queue of pending connections.
@@ -202,11 +389,19 @@ std::unique_ptr<IStreamSocket> PosixSocket::accept_connection() {
  * @param data The data to send as a vector of characters.
  * @return A SocketResult indicating the status of the operation and the number of bytes sent.
  */
-SocketResult PosixSocket::send_data(const std::vector<char> &data) {
+SocketResult PosixSocket::send_data(const std::vector<char> &data) { return raw_send(data.data(), data.size()); }
+
+/**
+ * @brief Sends data from a raw buffer over the socket.
+ * @param data The data to send.
+ * @param len The number of bytes to send.
+ * @return A SocketResult indicating the status of the operation and the number of bytes sent.
+ */
+SocketResult PosixSocket::raw_send(const char *data, size_t len) {
   if (!is_valid())
     return {SocketStatus::ERROR, 0};
 
-  ssize_t bytes_sent = send(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL);
+  ssize_t bytes_sent = send(socket_fd_, data, len, MSG_NOSIGNAL);
   if (bytes_sent < 0) {
     if (errno == EAGAIN || errno == EWOULDBLOCK) {
       return {SocketStatus::WOULD_BLOCK, 0};
@@ -0,0 +1,227 @@
+#include "common/work_stealing_pool.h"
+#include "common/affinity.h"
+#include "common/logger.h"
+#include <algorithm>
+
+namespace chat_app {
+namespace common {
+
+namespace {
+
+// The pool and worker the calling thread belongs to, if it is a pool worker.
+thread_local const WorkStealingPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+// Submissions a worker moves from its inbox into its deques at a time.
+constexpr size_t INBOX_BATCH = 64;
+
+} // namespace
+
+/**
+ * @brief Posts a completion and wakes the reactor if its inbox was empty. Waits for room when the
+ * inbox is full, since dropping a completion would lose the work's result.
+ * @param completion Run on the reactor.
+ */
+void CompletionQueue::post(Completion completion) {
+  while (queue_.push_batch(&completion, 1) == 0) {
+    std::this_thread::yield();
+  }
+  signal_.notify();
+}
+
+/**
+ * @brief Runs every posted completion. Reactor thread only.
+ * @return The number of completions run.
+ */
+size_t CompletionQueue::run() {
+  return signal_.drain(queue_, [](Completion &&completion) { completion(); });
+}
+
+/**
+ * @brief Constructs a WorkStealingPool. No threads run until start() is called.
+ * @param threads Number of worker threads.
+ * @param inbox_capacity Tasks each worker's inbox holds for submissions from outside the pool.
+ */
+WorkStealingPool::WorkStealingPool(size_t threads, size_t inbox_capacity) {
+  for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+    workers_.push_back(std::make_unique<Worker>(inbox_capacity));
+  }
+}
+
+/**
+ * @brief Destructor for WorkStealingPool. Stops the workers.
+ */
+WorkStealingPool::~WorkStealingPool() { stop(); }
+
+/**
+ * @brief Starts the worker threads.
+ */
+void WorkStealingPool::start() {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    threads_.emplace_back([this, i]() {
+      if (!cpus_.empty() && pin_current_thread(cpus_[i % cpus_.size()])) {
+        prefer_local_memory();
+      }
+      worker_loop(i);
+    });
+  }
+  LOG_INFO(COMMON_WORK_STEALING_POOL_COMPONENT, "Started {} workers", workers_.size());
+}
+
+/**
+ * @brief Stops the workers. Tasks still queued are dropped.
+ */
+void WorkStealingPool::stop() {
+  stopping_.store(true);
+  for (auto &worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->sleeping.store(false);
+    worker->wakeup.notify_one();
+  }
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  for (auto &worker : workers_) {
+    while (auto job = worker->inbox.try_pop()) {
+      delete *job;
+    }
+    for (auto &deque : worker->deques) {
+      while (auto job = deque.take()) {
+        delete *job;
+      }
+    }
+  }
+  stealable_.store(0);
+}
+
+/**
+ * @brief Queues a task. From a worker of this pool the task goes to that worker's own deque;
+ * from any other thread, to the next worker's inbox that has room.
+ * @param task The task.
+ * @param priority The task's priority.
+ * @return False if every inbox is full or the pool is stopping.
+ */
+bool WorkStealingPool::submit(Task task, Priority priority) {
+  if (stopping_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  Job *job = new Job{std::move(task), priority};
+
+  if (current_pool == this) {
+    workers_[current_worker]->deques[static_cast<size_t>(priority)].push(job);
+    stealable_.fetch_add(1);
+    wake_a_sleeper();
+    return true;
+  }
+
+  const size_t first = next_inbox_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker &worker = *workers_[(first + i) % workers_.size()];
+    if (worker.inbox.try_push(job)) {
+      std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in idle()
+      if (worker.sleeping.load(std::memory_order_relaxed)) {
+        wake(worker);
+      }
+      return true;
+    }
+  }
+  delete job;
+  return false;
+}
+
+void WorkStealingPool::worker_loop(size_t index) {
+  current_pool = this;
+  current_worker = index;
+  Worker &self = *workers_[index];
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    if (Job *job = find_job(index)) {
+      job->task();
+      delete job;
+      executed_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      idle(self);
+    }
+  }
+}
+
+/**
+ * @brief Finds the most urgent task for a worker: at each priority, its own newest, then the
+ * oldest of another worker's.
+ * @return The task, or nullptr if none was found.
+ */
+WorkStealingPool::Job *WorkStealingPool::find_job(size_t index) {
+  Worker &self = *workers_[index];
+
+  // Submissions move to the deques, where the other workers can steal them.
+  Job *batch[INBOX_BATCH];
+  const size_t received = self.inbox.pop_batch(batch, INBOX_BATCH);
+  for (size_t i = 0; i < received; ++i) {
+    self.deques[static_cast<size_t>(batch[i]->priority)].push(batch[i]);
+  }
+  if (received > 0) {
+    stealable_.fetch_add(static_cast<int64_t>(received));
+    if (received > 1) {
+      wake_a_sleeper();
+    }
+  }
+
+  for (size_t priority = 0; priority < PRIORITIES; ++priority) {
+    if (auto job = self.deques[priority].take()) {
+      stealable_.fetch_sub(1);
+      return *job;
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      if (auto job = workers_[(index + i) % workers_.size()]->deques[priority].steal()) {
+        stolen_.fetch_add(1, std::memory_order_relaxed);
+        if (stealable_.fetch_sub(1) > 1) {
+          wake_a_sleeper(); // Still more than this thief can take
+        }
+        return *job;
+      }
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Puts a worker to sleep until it is woken, unless work showed up meanwhile.
+ */
+void WorkStealingPool::idle(Worker &self) {
+  std::unique_lock<std::mutex> lock(self.mutex);
+  self.sleeping.store(true);
+  sleepers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in submit()
+  if (!stopping_.load() && stealable_.load() <= 0 && self.inbox.empty()) {
+    self.wakeup.wait(lock, [&self]() { return !self.sleeping.load(); });
+  }
+  self.sleeping.store(false);
+  sleepers_.fetch_sub(1);
+}
+
+void WorkStealingPool::wake(Worker &worker) {
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.sleeping.load()) {
+    worker.sleeping.store(false);
+    worker.wakeup.notify_one();
+  }
+}
+
+/**
+ * @brief Wakes one sleeping worker, if any, to steal work.
+ */
+void WorkStealingPool::wake_a_sleeper() {
+  if (sleepers_.load() == 0) {
+    return;
+  }
+  for (auto &worker : workers_) {
+    if (worker->sleeping.load()) {
+      wake(*worker);
+      return;
+    }
+  }
+}
+
+} // namespace common
+} // namespace chat_app
@@ -0,0 +1,96 @@
+#ifndef SERVER_AUTH_POOL_H
+#define SERVER_AUTH_POOL_H
+
+#include "common/concurrent_queue.h"
+#include "common/crypto.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define AUTH_POOL_COMPONENT "AuthPool"
+
+/**
+ * @brief A join waiting for its password to be checked (or hashed, for a first-time registration).
+ */
+struct AuthRequest {
+  int fd{-1};
+  uint32_t session_id{0}; // Lets the reactor detect that the client left and the FD was reused
+  std::string client_key; // Requests are queued per key (the client's IP address) for fairness
+  std::string username;
+  std::string password;
+  std::optional<common::PasswordHash> stored_hash; // Empty for a name without a password yet
+};
+
+/**
+ * @brief The outcome of an AuthRequest, handed back to the reactor.
+ */
+struct AuthResult {
+  int fd{-1};
+  uint32_t session_id{0};
+  std::string username;
+  bool accepted{false};
+  std::optional<common::PasswordHash> new_hash; // Set when a password was registered for the name
+};
+
+/**
+ * @brief Runs password hashing on worker threads so a login storm cannot stall the reactor.
+ *
+ * Requests wait in one queue per client key and the workers serve the keys round-robin, so a
+ * single address flooding joins only delays itself. The queue is bounded both in total and per
+ * key; submit() refuses work beyond that instead of letting latency grow without limit.
+ * Results go to the reactor through a lock-free completion queue, whose eventfd is signaled only
+ * when the queue goes from empty to non-empty.
+ */
+class AuthPool {
+public:
+  AuthPool(size_t threads, size_t max_queued, size_t max_queued_per_client, uint32_t hash_iterations);
+  ~AuthPool();
+
+  AuthPool(const AuthPool &) = delete;
+  AuthPool &operator=(const AuthPool &) = delete;
+
+  void set_cpus(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+  bool start();
+  void stop();
+
+  bool submit(AuthRequest request);
+  std::vector<AuthResult> take_results();
+
+  int get_event_fd() const { return completions_signal_.get_fd(); }
+  size_t queued() const;
+
+private:
+  void worker_loop();
+  AuthResult process(AuthRequest &request) const;
+
+  const size_t thread_count_;
+  const size_t max_queued_;
+  const size_t max_queued_per_client_;
+  const uint32_t hash_iterations_;
+  std::vector<int> cpus_; // Workers are pinned to these round-robin; empty leaves them unpinned
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::unordered_map<std::string, std::deque<AuthRequest>> queues_;
+  std::deque<std::string> ready_clients_; // Keys with queued requests, in round-robin order
+  size_t queued_{0};
+  bool stopping_{false};
+  std::vector<std::thread> workers_;
+
+  common::MpscQueue<AuthResult> completions_;
+  common::WakeupSignal completions_signal_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_AUTH_POOL_H
@@ -2,6 +2,7 @@
 #define SERVER_CLIENT_MANAGER_H
 
 #include "client_session.h"
+#include "server/fan_out_pool.h"
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -14,6 +15,20 @@ namespace server {
 
 #define CLIENT_MANAGER_COMPONENT "ClientManager"
 
+/**
+ * @brief A serialized broadcast and the sender it must not be echoed to.
+ */
+struct BroadcastFrame {
+  const std::vector<char> *frame;
+  uint32_t exclude_sender_id;
+};
+
+// Recipients a fan-out helper takes at a time.
+constexpr size_t BROADCAST_FAN_OUT_CHUNK = 256;
+
+// Sessions get an ID from this range until they join and are bound to their registered user ID.
+constexpr uint32_t FIRST_PROVISIONAL_CLIENT_ID = 0x80000000;
+
 /**
  * @brief Manages client sessions in the chat server.
  */
@@ -24,6 +39,9 @@ public:
 
   ClientSession *add_client(std::unique_ptr<common::IStreamSocket> socket);
   void remove_client(int fd);
+  size_t reclaim_retired();
+  size_t retired_count() const { return retired_.size(); }
+  bool assign_id(ClientSession &session, uint32_t id);
 
   ClientSession *get_client_by_id(uint32_t id);
   ClientSession *get_client_by_fd(int fd);
@@ -33,12 +51,20 @@ public:
   bool is_username_taken(const std::string &username) const;
 
   void broadcast_message(const common::Message &message, uint32_t exclude_sender_id);
+  void broadcast_frames(const std::vector<BroadcastFrame> &frames);
+  void set_fan_out(FanOutPool *pool, size_t threshold);
 
 private:
-  uint32_t next_client_id_{1}; // Start from 1 to avoid confusion with SERVER_ID
+  bool should_fan_out() const { return fan_out_ && session_by_fd_.size() >= fan_out_threshold_; }
+  std::vector<ClientSession *> get_broadcast_recipients() const;
+
+  uint32_t next_client_id_{FIRST_PROVISIONAL_CLIENT_ID}; // Kept apart from registered user IDs
   std::unordered_map<int, std::unique_ptr<ClientSession>> session_by_fd_;
   std::unordered_map<uint32_t, ClientSession *> session_by_id_;
   std::unordered_set<std::string> usernames_;
+  std::vector<std::unique_ptr<ClientSession>> retired_; // Removed this tick, freed by reclaim_retired()
+  FanOutPool *fan_out_{nullptr}; // Splits broadcasts to at least fan_out_threshold_ clients, when set
+  size_t fan_out_threshold_{0};
 };
 
 } // namespace server
@@ -0,0 +1,182 @@
+#ifndef SERVER_CLIENT_PIPELINE_H
+#define SERVER_CLIENT_PIPELINE_H
+
+#include "common/concurrent_queue.h"
+#include "common/metrics.h"
+#include "common/protocol.h"
+#include "common/socket.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define CLIENT_PIPELINE_COMPONENT "ClientPipeline"
+
+// Slots of each ring between two stages.
+constexpr size_t PIPELINE_QUEUE_CAPACITY = 4096;
+// Replies a connection may leave unread before it is disconnected, in bytes.
+constexpr size_t PIPELINE_MAX_UNSENT_BYTES = 4 * 1024 * 1024;
+// Chat handed to a client's socket at a time, in bytes; control replies queued meanwhile go next.
+constexpr size_t PIPELINE_WRITE_CHUNK = 64 * 1024;
+
+/**
+ * @brief Splits the handling of client connections into stages connected by batched ring buffers
+ * (SEDA): decode threads read the client sockets and deserialize their messages, the reactor
+ * thread routes them, and encode threads serialize the replies and write them to the sockets.
+ *
+ * Routing touches all of the server's state, so it stays on the reactor; only the decode and
+ * encode stages get threads of their own, and each can be given more threads and its own CPUs
+ * when it is the expensive one. Connections are split between a stage's threads by FD, so every
+ * connection's messages are read and written in order. The reactor queues the work of one round
+ * of events and hands it to the stages in one batch per thread when flush() is called.
+ *
+ * Replies travel in two lanes: control and presence messages in one, chat in the other. An encode
+ * thread takes from the control lane first, so a join reply or an error overtakes the chat queued
+ * before it instead of waiting behind a flood of broadcasts; each lane keeps its own order.
+ *
+ * The lanes go on past the rings: each connection queues its replies per lane until its socket takes
+ * them, and hands the socket all of its control replies, then at most PIPELINE_WRITE_CHUNK of chat, at
+ * a time. A client whose socket is full therefore gets its next control reply right after the chunk
+ * in flight. The encode thread watches full sockets until they are writable again.
+ *
+ * A connection is shared by its session's socket and the jobs queued for it, and is closed with
+ * the last of them: replies queued before a disconnect are still written, and decoded messages
+ * of a connection that was detached meanwhile are dropped instead of reaching a new session that
+ * got the same FD.
+ */
+class ClientPipeline {
+public:
+  using MessageHandler = std::function<void(int fd, const common::Message &message)>;
+  using CloseHandler = std::function<void(int fd)>;
+
+  ClientPipeline(size_t decode_threads, size_t encode_threads, size_t queue_capacity = PIPELINE_QUEUE_CAPACITY);
+  ~ClientPipeline();
+
+  ClientPipeline(const ClientPipeline &) = delete;
+  ClientPipeline &operator=(const ClientPipeline &) = delete;
+
+  void set_cpus(std::vector<int> decode_cpus, std::vector<int> encode_cpus);
+  bool start();
+  void stop();
+
+  // Becomes readable when decoded messages wait to be routed.
+  int get_event_fd() const { return routed_signal_.get_fd(); }
+
+  // Reactor thread only.
+  std::unique_ptr<common::IStreamSocket> attach(std::unique_ptr<common::IStreamSocket> socket);
+  void detach(int fd);
+  void read(int fd);
+  bool send(int fd, const common::Message &message);
+  size_t route(const MessageHandler &on_message, const CloseHandler &on_close);
+  void flush();
+  bool has_backlog() const;
+  void report(common::Metrics &metrics) const;
+
+private:
+  class StagedSocket;
+
+  // The lanes of the encode stage; replies in CONTROL_LANE are written first.
+  enum Lane : size_t { CONTROL_LANE = 0, CHAT_LANE = 1, ENCODE_LANES = 2 };
+
+  struct Connection {
+    std::unique_ptr<common::IStreamSocket> socket;
+    int fd{-1};
+    std::atomic<bool> closed{false}; // Detached by the reactor or closed by the peer
+    std::vector<char> read_buffer;   // Decode stage only
+    // Encode stage only: the bytes handed to the socket, from unsent_offset on, and the frames queued
+    // behind them per lane.
+    std::vector<char> unsent;
+    size_t unsent_offset{0};
+    std::array<std::deque<std::vector<char>>, ENCODE_LANES> queued;
+    size_t queued_bytes{0};
+    bool waiting{false}; // In its encode thread's list of connections waiting to be writable
+  };
+  struct DecodeJob {
+    std::shared_ptr<Connection> connection;
+  };
+  struct EncodeJob {
+    std::shared_ptr<Connection> connection;
+    common::Message message; // Serialized by the encode stage, unless frame is already set
+    std::vector<char> frame;
+  };
+  struct Routed {
+    std::shared_ptr<Connection> connection;
+    common::Message message;
+    bool closed{false}; // The peer closed the connection; message is unset
+  };
+
+  // The inbound rings of a stage thread, one per lane. Popping takes from the first lane with jobs.
+  template <typename Job> struct Lanes {
+    using value_type = Job;
+
+    Lanes(size_t count, size_t capacity) {
+      for (size_t i = 0; i < count; ++i) {
+        rings.push_back(std::make_unique<common::SpscQueue<Job>>(capacity));
+      }
+    }
+
+    size_t pop_batch(Job *out, size_t max_count) {
+      for (auto &ring : rings) {
+        if (size_t popped = ring->pop_batch(out, max_count)) {
+          return popped;
+        }
+      }
+      return 0;
+    }
+    bool empty() const {
+      return std::all_of(rings.begin(), rings.end(), [](const auto &ring) { return ring->empty(); });
+    }
+
+    std::vector<std::unique_ptr<common::SpscQueue<Job>>> rings;
+  };
+
+  // One thread of a stage and its inbound rings. The reactor collects jobs in pending, per lane, until flush().
+  template <typename Job> struct Stage {
+    Stage(size_t lanes, size_t capacity) : queue(lanes, capacity), pending(lanes) {}
+
+    Lanes<Job> queue;
+    common::WakeupSignal signal;
+    std::atomic<int64_t> depth{0}; // Jobs in the rings
+    std::vector<std::deque<Job>> pending;
+    std::thread thread;
+  };
+
+  template <typename Job> static bool flush_stage(Stage<Job> &stage);
+  template <typename Job, typename Handler, typename Finish, typename Watch>
+  void stage_loop(Stage<Job> &stage, int cpu, Handler &&handler, Finish &&finish, Watch &&watch);
+
+  void decode(const std::shared_ptr<Connection> &connection, std::vector<Routed> &routed);
+  void emit(std::vector<Routed> &routed);
+  static Lane lane_of(common::MessageType type);
+  void encode(EncodeJob &job, std::shared_ptr<Connection> &writing, std::vector<std::shared_ptr<Connection>> &waiting);
+  static void write(std::shared_ptr<Connection> &writing, std::vector<std::shared_ptr<Connection>> &waiting);
+  static bool write_unsent(Connection &connection);
+  static void retry_waiting(std::vector<std::shared_ptr<Connection>> &waiting);
+
+  std::vector<std::unique_ptr<Stage<DecodeJob>>> decoders_;
+  std::vector<std::unique_ptr<Stage<EncodeJob>>> encoders_;
+  std::vector<int> decode_cpus_;
+  std::vector<int> encode_cpus_;
+  std::atomic<bool> stopping_{false};
+
+  common::MpscQueue<Routed> routed_; // From the decode threads to the reactor
+  common::WakeupSignal routed_signal_;
+  std::atomic<int64_t> routed_depth_{0};
+
+  std::unordered_map<int, std::shared_ptr<Connection>> connections_; // Attached connections, by FD
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_CLIENT_PIPELINE_H
@@ -11,6 +11,10 @@
 namespace chat_app {
 namespace server {
 
+// Chat messages of one client processed per loop tick. A client sending more is read on in the next
+// tick, so the joins and other control messages of the rest are not held up behind its flood.
+constexpr size_t CLIENT_CHAT_BUDGET = 32;
+
   /**
    * @brief Represents a client session in the chat server.
    * Each session is associated with a unique ID and a socket for communication.
@@ -22,19 +26,42 @@ public:
   uint32_t get_id() const { return id_; }
   int get_fd() const { return socket_->get_fd(); }
   const std::string &get_username() const { return username_; }
+  const std::string &get_remote_address() const { return remote_address_; }
   bool is_authenticated() const { return is_authenticated_; }
+  bool is_auth_pending() const { return is_auth_pending_; }
+  bool is_closed() const { return is_closed_; }
+  size_t get_chat_budget() const { return chat_budget_; }
 
+  void set_id(uint32_t id) { id_ = id; }
   void set_username(const std::string &username) { username_ = std::move(username); }
+  void set_remote_address(const std::string &address) { remote_address_ = address; }
   void set_authenticated(bool authenticated) { is_authenticated_ = authenticated; }
+  void set_auth_pending(bool pending) { is_auth_pending_ = pending; }
+  void set_closed() { is_closed_ = true; }
+  void set_chat_budget(size_t budget) { chat_budget_ = budget; }
 
   common::IStreamSocket *get_socket() const { return socket_.get(); }
+
+  // The per-message socket calls. A PosixSocket, the socket of every directly connected client, is
+  // called directly; other sockets (relayed, staged or mocked) through the interface.
+  common::SocketResult send(const std::vector<char> &data) {
+    return posix_socket_ ? posix_socket_->send_data(data) : socket_->send_data(data);
+  }
+  common::SocketResult receive(char *buffer, size_t len) {
+    return posix_socket_ ? posix_socket_->raw_receive(buffer, len) : socket_->raw_receive(buffer, len);
+  }
   std::vector<char>& get_read_buffer() { return read_buffer_; }
 
 private:
   uint32_t id_;
   std::unique_ptr<common::IStreamSocket> socket_;
+  common::PosixSocket *posix_socket_; // socket_, if it is a PosixSocket
   std::string username_;
+  std::string remote_address_; // Relayed sessions: the client's address at the gateway
   bool is_authenticated_{false};
+  bool is_auth_pending_{false}; // A join is being checked by the auth workers
+  bool is_closed_{false};       // Disconnected; kept until the end of the loop tick
+  size_t chat_budget_{CLIENT_CHAT_BUDGET}; // Chat messages it may still send this loop tick
   std::vector<char> read_buffer_;
 };
 
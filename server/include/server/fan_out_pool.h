@@ -0,0 +1,69 @@
+#ifndef SERVER_FAN_OUT_POOL_H
+#define SERVER_FAN_OUT_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define FAN_OUT_POOL_COMPONENT "FanOutPool"
+
+/**
+ * @brief Helper threads that split one large loop, such as the writes of a broadcast to a very
+ * large audience, with the reactor thread.
+ *
+ * run() hands out the range in chunks: the helpers and the calling thread take chunks until none
+ * are left, and run() returns only when every chunk is done. The caller therefore sends nothing
+ * else in the meantime, and whatever it sends a recipient afterwards arrives after the broadcast.
+ */
+class FanOutPool {
+public:
+  using Task = std::function<void(size_t begin, size_t end)>;
+
+  explicit FanOutPool(size_t threads);
+  ~FanOutPool();
+
+  FanOutPool(const FanOutPool &) = delete;
+  FanOutPool &operator=(const FanOutPool &) = delete;
+
+  void start();
+  void stop();
+
+  void run(size_t count, size_t chunk, const Task &task);
+
+  size_t threads() const { return thread_count_; }
+  uint64_t jobs() const { return jobs_.load(std::memory_order_relaxed); }
+
+private:
+  void helper_loop();
+  void run_chunks();
+
+  const size_t thread_count_;
+  std::vector<std::thread> helpers_;
+
+  std::mutex mutex_;
+  std::condition_variable job_posted_;
+  std::condition_variable helpers_done_;
+  uint64_t generation_{0};
+  bool stopping_{false};
+  size_t busy_helpers_{0};
+
+  // The current job; set by run() under mutex_ while it waits.
+  const Task *task_{nullptr};
+  size_t count_{0};
+  size_t chunk_{1};
+  std::atomic<size_t> next_{0};
+  std::atomic<uint64_t> jobs_{0};
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_FAN_OUT_POOL_H
@@ -0,0 +1,179 @@
+#ifndef SERVER_FEDERATION_H
+#define SERVER_FEDERATION_H
+
+#include "common/metrics.h"
+#include "common/protocol.h"
+#include "common/shm_socket.h"
+#include "common/socket.h"
+#include "server/epoll_manager.h"
+#include "server/hash_ring.h"
+#include "server/peer_connection.h"
+#include "server/presence_table.h"
+#include "server/user_directory.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define FEDERATION_COMPONENT "Federation"
+
+// Batches smaller than this are sent uncompressed; compression would not pay for itself.
+constexpr size_t FEDERATION_COMPRESS_MIN_BYTES = 512;
+
+// Output queued on a peer link above which the node stops reading (backpressure), and below which it resumes.
+constexpr size_t FEDERATION_HIGH_WATER_BYTES = 8 * 1024 * 1024;
+constexpr size_t FEDERATION_LOW_WATER_BYTES = 2 * 1024 * 1024;
+
+// User IDs carry the ID of the node that registered them in their top bits, so they are unique cluster-wide:
+// 6 bits of node ID and 25 bits, about 33 million users, per node. Bit 31 is left to FIRST_PROVISIONAL_CLIENT_ID.
+constexpr int NODE_ID_SHIFT = 25;
+constexpr uint32_t MAX_NODE_ID = 63;
+constexpr uint32_t MAX_LOCAL_USER_ID = (1u << NODE_ID_SHIFT) - 1;
+
+/**
+ * @brief A user connected to another node of the cluster.
+ */
+struct RemoteUser {
+  uint32_t node_id;
+  std::string username;
+};
+
+/**
+ * @brief Links this chat_server to the other nodes of a cluster.
+ *
+ * Every node keeps one peer link to every other node (full mesh; when two nodes dial each other
+ * at once, the link dialed by the lower node ID wins). Chat events are forwarded once per peer
+ * and fanned out to local clients by the receiving node, which never forwards them further.
+ * Events queued while handling one round of reactor events travel as one batch per peer,
+ * LZ-compressed when large enough.
+ *
+ * The federation also tracks which users are online on the other nodes, so the user list can
+ * cover the whole cluster. Presence spreads by gossip (see PresenceTable) rather than with every
+ * join and leave: each round, and right after local changes, a node sends a digest of the
+ * versions it knows to GOSSIP_FANOUT random peers, which answer with what it is missing. A newly
+ * linked pair exchanges digests at once.
+ *
+ * With a relay fan-out k, broadcasts travel down a k-ary tree instead: the origin sends one copy
+ * to each of its k children, and every node delivers the copy to its clients and passes it on to
+ * its own children. The tree of an origin is laid over the node IDs in ring order starting at the
+ * origin, so all nodes agree on it and each origin's broadcasts always take the same (ordered)
+ * links. Sequence numbers per origin drop duplicates and stale copies while membership changes.
+ *
+ * When a peer link's queued output passes FEDERATION_HIGH_WATER_BYTES, the node is congested: it
+ * stops reading from its peers (and the server from its clients) until the output drains. The
+ * peers' writes then back up in turn, so backpressure travels up the tree to the origin.
+ *
+ * Private messages go only to the recipient's node, found through the directory: the linked
+ * nodes form a HashRing, and each user is registered at its home node on the ring. A node that
+ * does not know where a recipient is asks the home node once, holds the recipient's messages
+ * until the answer arrives, and caches it. Messages to one node share its link, so their order
+ * is kept. When nodes join or leave, only the users whose home moved are registered again.
+ */
+class Federation {
+public:
+  // Delivers an event from another node to the local clients: to the receiver, or to everyone for BROADCAST_ID.
+  using DeliverCallback = std::function<void(const common::Message &)>;
+
+  Federation(EpollManager &epoll_manager, uint32_t node_id, common::Metrics &metrics, DeliverCallback deliver);
+  ~Federation();
+
+  Federation(const Federation &) = delete;
+  Federation &operator=(const Federation &) = delete;
+
+  bool start(int port, const std::vector<std::string> &peer_addresses, size_t relay_fanout = 0,
+             const std::string &shm_path = "");
+  void close();
+
+  bool owns_fd(int fd) const;
+  void handle_event(int fd, uint32_t events);
+
+  void forward(const common::Message &message);
+  void route_private(const common::Message &message);
+  void flush();
+  void maintain();
+  bool is_congested() const { return congested_; }
+
+  uint32_t get_node_id() const { return node_id_; }
+  size_t peer_count() const { return link_by_node_.size(); }
+  const std::unordered_map<uint32_t, RemoteUser> &get_remote_users() const { return remote_users_; }
+  bool is_username_online(const std::string &username) const;
+  const HashRing &get_ring() const { return ring_; }
+
+private:
+  struct Link {
+    std::unique_ptr<PeerConnection> connection;
+    bool outbound{false};
+    std::string address; // Set for outbound links
+    bool connecting{false}; // Outbound link whose connect has not finished; introduced once it has
+    common::ShmSocket *handshake{nullptr}; // The connection's socket while its shared memory handshake is pending
+    uint32_t node_id{0}; // Known once the peer's hello arrived
+    std::vector<char> pending; // Serialized events waiting for the next flush()
+  };
+
+  struct DialState {
+    uint32_t node_id{0}; // Node last seen behind this address
+    std::chrono::steady_clock::time_point next_attempt;
+    std::chrono::milliseconds backoff{0};
+  };
+
+  common::IListeningSocket *find_listener(int fd) const;
+  void accept_links(common::IListeningSocket &listener);
+  void dial(const std::string &address);
+  void schedule_redial(const std::string &address);
+  Link &add_link(std::unique_ptr<common::IStreamSocket> socket, bool outbound, const std::string &address);
+  void send_hello(Link &link);
+  void handle_hello(int fd, const common::Message &message);
+  void handle_batch(Link &link, const common::Message &message);
+  void handle_remote_event(uint32_t node_id, const common::Message &event);
+  void handle_directory_event(uint32_t node_id, const common::Message &event);
+  void gossip();
+  void apply_presence(uint32_t node_id, const std::vector<common::Message> &events);
+  void relay(const common::Message &envelope);
+  void update_congestion();
+  std::vector<uint32_t> relay_children(uint32_t origin) const;
+  void queue(Link &link, const common::Message &message);
+  bool queue_to_node(uint32_t node_id, const common::Message &message);
+  void publish_location(uint32_t user_id, uint32_t node_id);
+  void resolve(uint32_t user_id, uint32_t node_id);
+  void change_membership(uint32_t node_id, bool joined);
+  void drop_link(int fd);
+
+  EpollManager &epoll_manager_;
+  const uint32_t node_id_;
+  common::Metrics &metrics_;
+  DeliverCallback deliver_;
+
+  std::vector<std::unique_ptr<common::IListeningSocket>> listeners_;
+  std::unordered_map<int, Link> links_;
+  std::unordered_map<uint32_t, int> link_by_node_;
+  std::unordered_map<std::string, DialState> dial_states_;
+  std::unordered_map<uint32_t, RemoteUser> remote_users_;
+  std::unordered_map<std::string, size_t> remote_usernames_; // Users in remote_users_ per name, for join checks
+  PresenceTable presence_;
+  bool presence_changed_{false};
+  std::minstd_rand random_;
+
+  size_t relay_fanout_{0}; // 0 sends broadcasts to every peer directly
+  uint32_t relay_sequence_{0};
+  std::unordered_map<uint32_t, uint32_t> relay_received_; // Origin -> last sequence number delivered
+  bool congested_{false};
+  std::unordered_set<int> unread_links_; // Links with input left unread while congested
+
+  HashRing ring_;
+  UserDirectory directory_;
+  // Private messages held until their recipient's home node answers the lookup, by recipient.
+  std::unordered_map<uint32_t, std::vector<common::Message>> unresolved_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_FEDERATION_H
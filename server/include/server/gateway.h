@@ -0,0 +1,148 @@
+#ifndef SERVER_GATEWAY_H
+#define SERVER_GATEWAY_H
+
+#include "common/metrics.h"
+#include "common/protocol.h"
+#include "common/shm_socket.h"
+#include "common/socket.h"
+#include "server/client_session.h"
+#include "server/epoll_manager.h"
+#include "server/peer_connection.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define GATEWAY_COMPONENT "Gateway"
+
+/**
+ * @brief The routing server's side of the gateway tier: accepts links from chat_gateway processes
+ * and turns the client sessions they relay into ordinary ClientSessions.
+ *
+ * A relayed session's socket wraps everything sent to it into an S2S_GATEWAY_DELIVER on its
+ * gateway's link, and its FD is a negative, virtual one that never reaches epoll. Broadcasts skip
+ * relayed sessions in ClientManager and go to each gateway once instead, which fans them out to
+ * its own clients. A gateway may open several links; they are told apart from other gateways by
+ * the instance ID in their hello, and broadcasts use one of them. Output to a gateway is written
+ * once per reactor loop iteration.
+ *
+ * Gateways on the same host can connect over a shared memory transport instead of TCP.
+ */
+class GatewayHub {
+public:
+  // Registers a relayed session, given the client's address at the gateway, and returns it.
+  using OpenCallback = std::function<ClientSession *(std::unique_ptr<common::IStreamSocket>, const std::string &)>;
+  // Handles a client message of the relayed session with the given virtual FD.
+  using MessageCallback = std::function<void(int, const common::Message &)>;
+  // Disconnects the relayed session with the given virtual FD.
+  using CloseCallback = std::function<void(int)>;
+
+  GatewayHub(EpollManager &epoll_manager, common::Metrics &metrics, OpenCallback on_open, MessageCallback on_message,
+             CloseCallback on_close);
+  ~GatewayHub();
+
+  GatewayHub(const GatewayHub &) = delete;
+  GatewayHub &operator=(const GatewayHub &) = delete;
+
+  bool start(int port, const std::string &shm_path = "");
+  void close();
+
+  bool owns_fd(int fd) const;
+  void handle_event(int fd, uint32_t events);
+
+  void broadcast(const common::Message &message, uint32_t exclude_sender_id);
+  void flush();
+  size_t gateway_count() const { return gateways_.size(); }
+
+private:
+  struct Gateway {
+    std::unique_ptr<PeerConnection> connection;
+    std::string instance; // From the hello; empty until it arrived
+    std::unordered_map<uint32_t, int> session_fds; // Gateway's channel -> virtual FD
+  };
+
+  common::IListeningSocket *find_listener(int fd) const;
+  void handle_envelope(Gateway &gateway, const common::Message &envelope);
+  std::unordered_map<uint32_t, int>::iterator open_session(Gateway &gateway, uint32_t channel,
+                                                          const std::string &client_address);
+  void drop_gateway(int fd);
+
+  EpollManager &epoll_manager_;
+  common::Metrics &metrics_;
+  OpenCallback on_open_;
+  MessageCallback on_message_;
+  CloseCallback on_close_;
+
+  std::vector<std::unique_ptr<common::IListeningSocket>> listeners_; // TCP and/or shared memory
+  std::unordered_map<int, Gateway> gateways_;
+  int next_virtual_fd_{-2}; // -1 is the invalid FD
+};
+
+/**
+ * @brief The chat_gateway side: carries the client sessions a gateway terminates to the routing
+ * server over a few persistent links.
+ *
+ * Each session is a channel, named by its FD on the gateway, bound to one upstream link when it
+ * first sends something. Sessions of a lost link are disconnected; the link is redialed with
+ * exponential backoff.
+ */
+class GatewayUplink {
+public:
+  // Handles an S2S_GATEWAY_DELIVER from the routing server.
+  using DeliverCallback = std::function<void(const common::Message &)>;
+  // Disconnects the client sessions of a lost link.
+  using LostCallback = std::function<void(const std::vector<int> &)>;
+
+  GatewayUplink(EpollManager &epoll_manager, common::Metrics &metrics, DeliverCallback deliver, LostCallback on_lost);
+  ~GatewayUplink();
+
+  GatewayUplink(const GatewayUplink &) = delete;
+  GatewayUplink &operator=(const GatewayUplink &) = delete;
+
+  bool start(const std::vector<std::string> &upstreams);
+  void close();
+
+  bool owns_fd(int fd) const;
+  void handle_event(int fd, uint32_t events);
+
+  bool forward(int channel, const common::Message &message);
+  void close_channel(int channel);
+  void flush();
+  void maintain();
+
+private:
+  struct Upstream {
+    std::string address;
+    std::unique_ptr<PeerConnection> connection; // Null while disconnected
+    bool connecting{false}; // Until the non-blocking connect finished; output is held back meanwhile
+    std::chrono::steady_clock::time_point next_attempt;
+    std::chrono::milliseconds backoff{0};
+    common::ShmSocket *handshake{nullptr}; // The connection's socket while its shared memory handshake is pending
+  };
+
+  bool dial(Upstream &upstream);
+  void schedule_redial(Upstream &upstream);
+  void drop_upstream(Upstream &upstream);
+  Upstream *find_by_fd(int fd);
+
+  EpollManager &epoll_manager_;
+  common::Metrics &metrics_;
+  DeliverCallback deliver_;
+  LostCallback on_lost_;
+
+  const std::string instance_; // Sent in every link's hello
+  std::vector<Upstream> upstreams_;
+  std::unordered_map<int, size_t> channel_links_; // Channel -> index in upstreams_
+  size_t next_link_{0};
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_GATEWAY_H
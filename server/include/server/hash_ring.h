@@ -0,0 +1,43 @@
+#ifndef SERVER_HASH_RING_H
+#define SERVER_HASH_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+// Points each node places on the ring. More points even out the share of keys per node.
+constexpr size_t HASH_RING_POINTS_PER_NODE = 64;
+
+/**
+ * @brief Consistent-hash ring assigning keys (user IDs, usernames) to cluster nodes.
+ *
+ * Each node owns the arcs ending at its points. Adding or removing a node only moves the keys on
+ * the arcs it gains or loses; every other key keeps its node. All nodes build the ring from the
+ * same node IDs with the same hash, so they agree on every key's node without coordination.
+ */
+class HashRing {
+public:
+  void add_node(uint32_t node_id);
+  void remove_node(uint32_t node_id);
+  bool contains(uint32_t node_id) const;
+  bool empty() const { return points_.empty(); }
+  size_t node_count() const { return points_.size() / HASH_RING_POINTS_PER_NODE; }
+
+  uint32_t node_for(uint32_t user_id) const;
+  uint32_t node_for(const std::string &username) const;
+
+private:
+  uint32_t node_for_hash(uint64_t hash) const;
+
+  std::vector<std::pair<uint64_t, uint32_t>> points_; // (position, node ID), sorted by position
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_HASH_RING_H
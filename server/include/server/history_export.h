@@ -0,0 +1,77 @@
+#ifndef SERVER_HISTORY_EXPORT_H
+#define SERVER_HISTORY_EXPORT_H
+
+#include "common/protocol.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define HISTORY_EXPORT_COMPONENT "HistoryExport"
+
+// Rows per row group. Each row group holds every column for its rows and is written with one write().
+constexpr size_t EXPORT_ROW_GROUP_ROWS = 64 * 1024;
+
+/**
+ * @brief Which part of the message log goes into an export.
+ */
+struct ExportOptions {
+  uint64_t after_sequence{0}; // Only records after this sequence, for incremental exports
+  uint64_t from_ms{0};        // Only records with from_ms <= timestamp < to_ms
+  uint64_t to_ms{UINT64_MAX};
+};
+
+/**
+ * @brief What an export did.
+ */
+struct ExportStats {
+  uint64_t rows{0};
+  uint64_t segments{0};
+  uint64_t bytes_read{0};
+  uint64_t last_sequence{0}; // Last sequence seen in the log; pass as after_sequence to continue later
+};
+
+/**
+ * @brief An export file decoded back into its columns. Row i of the export is element i of every column.
+ */
+struct ExportedHistory {
+  std::vector<uint64_t> sequences;
+  std::vector<uint64_t> timestamps_ms;
+  std::vector<uint32_t> sender_ids;
+  std::vector<common::MessageType> types;
+  std::vector<uint32_t> lengths; // Payload sizes
+  std::vector<uint32_t> scopes;  // Indexes into scope_dictionary
+  std::vector<std::string> scope_dictionary;
+};
+
+/**
+ * @brief Exports the chat traffic in a message log directory to a columnar file.
+ *
+ * Segments are memory-mapped read-only and walked sequentially, and nothing in the data directory
+ * is modified, so it is safe to run against a live server. The output holds one row per chat
+ * event with the columns sequence, timestamp, sender ID, type, payload length and scope; the
+ * scope ("broadcast", "dm:<id>-<id>" or "presence") is dictionary-encoded. Payloads themselves
+ * are not exported.
+ *
+ * @param data_dir The server's data directory.
+ * @param output_path The export file to write.
+ * @param options Which records to export.
+ * @return Statistics of the export, or std::nullopt on error.
+ */
+std::optional<ExportStats> export_history(const std::string &data_dir, const std::string &output_path,
+                                          const ExportOptions &options = ExportOptions());
+
+/**
+ * @brief Reads an export file back into memory.
+ * @param path The export file.
+ * @return The decoded columns, or std::nullopt if the file is not a valid export.
+ */
+std::optional<ExportedHistory> read_history_export(const std::string &path);
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_HISTORY_EXPORT_H
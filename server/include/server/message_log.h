@@ -0,0 +1,89 @@
+#ifndef SERVER_MESSAGE_LOG_H
+#define SERVER_MESSAGE_LOG_H
+
+#include "common/protocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define MESSAGE_LOG_COMPONENT "MessageLog"
+
+/**
+ * @brief A single entry of the append-only message log.
+ */
+struct LogRecord {
+  uint64_t sequence{0};
+  uint64_t timestamp_ms{0};
+  common::Message message;
+};
+
+// On-disk record header: 4 (record size) + 4 (checksum) + 8 (sequence) + 8 (timestamp) = 24 bytes.
+// The record size covers everything after the size field itself.
+constexpr size_t LOG_RECORD_HEADER_SIZE = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2;
+
+/**
+ * @brief Encodes a log record into its on-disk (and on-wire) representation.
+ * @param record The record to encode.
+ * @return The encoded bytes.
+ */
+std::vector<char> encode_log_record(const LogRecord &record);
+
+/**
+ * @brief Decodes one log record from the front of a byte range.
+ * @param data Pointer to the encoded bytes.
+ * @param size Number of bytes available.
+ * @param record Receives the decoded record.
+ * @return The number of bytes consumed, or 0 if the range holds no complete, valid record.
+ */
+size_t decode_log_record(const char *data, size_t size, LogRecord &record);
+
+/**
+ * @brief Append-only log of everything the server accepted, split into fixed-size segment files.
+ *
+ * Segments are named after the first sequence number they hold, so a reader can skip whole
+ * files when it only needs the tail after a snapshot.
+ */
+class MessageLog {
+public:
+  explicit MessageLog(const std::string &directory, size_t segment_size = 64 * 1024 * 1024);
+  ~MessageLog();
+
+  MessageLog(const MessageLog &) = delete;
+  MessageLog &operator=(const MessageLog &) = delete;
+
+  bool open();
+  void close();
+
+  uint64_t append(const common::Message &message);
+  bool append_record(const LogRecord &record);
+  bool flush();
+
+  uint64_t last_sequence() const { return last_sequence_; }
+  const std::string &get_directory() const { return directory_; }
+
+  size_t replay(uint64_t after_sequence, const std::function<void(const LogRecord &)> &visitor,
+                size_t max_records = SIZE_MAX) const;
+
+  static std::vector<std::string> list_segments(const std::string &directory);
+  static uint64_t segment_first_sequence(const std::string &segment_path);
+
+private:
+  bool roll_segment(uint64_t first_sequence);
+  bool write_record(const LogRecord &record);
+
+  std::string directory_;
+  size_t segment_size_;
+  int segment_fd_{-1};
+  size_t segment_bytes_{0};
+  uint64_t last_sequence_{0};
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_MESSAGE_LOG_H
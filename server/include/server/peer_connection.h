@@ -0,0 +1,50 @@
+#ifndef SERVER_PEER_CONNECTION_H
+#define SERVER_PEER_CONNECTION_H
+
+#include "common/protocol.h"
+#include "common/socket.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define PEER_CONNECTION_COMPONENT "PeerConnection"
+
+/**
+ * @brief A non-blocking, message-framed connection between two server processes.
+ *
+ * Unlike client sessions, peer links carry bulk traffic, so partial writes are buffered and
+ * flushed when the socket becomes writable instead of being dropped.
+ */
+class PeerConnection {
+public:
+  explicit PeerConnection(std::unique_ptr<common::IStreamSocket> socket);
+
+  int get_fd() const { return socket_->get_fd(); }
+  common::IStreamSocket *get_socket() const { return socket_.get(); }
+
+  bool send_message(const common::Message &message);
+  bool send_bytes(const std::vector<char> &bytes);
+  void queue_message(const common::Message &message);
+  bool flush();
+  bool receive(const std::function<void(const common::Message &)> &on_message);
+
+  size_t pending_bytes() const { return write_buffer_.size() - write_offset_; }
+  bool has_pending_writes() const { return pending_bytes() > 0; }
+  bool is_open() const { return open_; }
+
+private:
+  std::unique_ptr<common::IStreamSocket> socket_;
+  std::vector<char> read_buffer_;
+  std::vector<char> write_buffer_;
+  size_t write_offset_{0};
+  bool open_{true};
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_PEER_CONNECTION_H
@@ -0,0 +1,207 @@
+#ifndef SERVER_PREFORK_H
+#define SERVER_PREFORK_H
+
+#include "common/metrics.h"
+#include "common/protocol.h"
+#include "server/epoll_manager.h"
+#include "server/server_config.h"
+#include "server/worker_bus.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define PREFORK_COMPONENT "Prefork"
+
+// Longest username the shared directory stores.
+constexpr size_t PREFORK_MAX_USERNAME = 32;
+// Bytes of each worker's mailbox. Events posted to a full mailbox are dropped.
+constexpr size_t PREFORK_MAILBOX_BYTES = 4 * 1024 * 1024;
+
+/**
+ * @brief A mutex in shared memory that survives the death of the process holding it: the next
+ * locker is told the state it guards may be half-updated.
+ */
+class SharedMutex {
+public:
+  void init();
+  bool lock(); // False if the previous owner died while holding the mutex
+  void unlock();
+
+private:
+  pthread_mutex_t mutex_;
+};
+
+/**
+ * @brief The sessions of all prefork workers: user ID to worker and slot (the session's FD in
+ * that worker), indexed by user ID and by username. Lives in memory shared by the workers, which
+ * is why it is a fixed-capacity open-addressing table rather than standard containers.
+ *
+ * Claiming a username is atomic across workers, so two workers cannot admit the same name.
+ */
+class SharedDirectory {
+public:
+  struct Location {
+    uint32_t worker;
+    int32_t slot;
+  };
+
+  using Entry = WorkerSession;
+
+  static size_t bytes_for(size_t capacity);
+  static SharedDirectory *create(void *memory, size_t capacity);
+
+  bool claim(uint32_t user_id, const std::string &username, uint32_t worker, int32_t slot);
+  void release(uint32_t user_id);
+  std::optional<Location> find(uint32_t user_id);
+  bool is_username_taken(const std::string &username);
+  std::vector<Entry> entries();
+  std::vector<Entry> purge_worker(uint32_t worker);
+
+private:
+  enum : uint32_t { EMPTY = 0, USED = 1, DELETED = 2 };
+
+  struct NameSlot {
+    uint32_t state;
+    uint32_t user_id;
+    uint32_t worker;
+    int32_t slot;
+    char username[PREFORK_MAX_USERNAME + 1];
+  };
+
+  struct IdSlot {
+    uint32_t state;
+    uint32_t user_id;
+    uint32_t position; // Of the user's NameSlot
+  };
+
+  NameSlot *names();
+  IdSlot *ids();
+  void lock();
+  size_t find_name(const std::string &username);
+  size_t find_id(uint32_t user_id);
+  void erase(size_t id_position);
+  void rebuild();
+
+  SharedMutex mutex_;
+  size_t table_size_; // Power of two, twice the capacity
+  size_t capacity_;
+  size_t used_;
+  size_t deleted_; // Tombstones made since the last rebuild
+};
+
+/**
+ * @brief One inbox per prefork worker for events other workers send it: broadcasts, presence and
+ * private messages. Each inbox is a byte ring of serialized messages in shared memory, guarded
+ * by a SharedMutex, with an eventfd the poster signals when the inbox was empty.
+ */
+class SharedMailboxes {
+public:
+  static size_t bytes_for(size_t workers);
+  static SharedMailboxes *create(void *memory, size_t workers);
+
+  size_t workers() const { return workers_; }
+  int event_fd(uint32_t worker) const;
+  bool post(uint32_t worker, const common::Message &message, int32_t slot);
+  void drain(uint32_t worker, const std::function<void(const common::Message &, int32_t)> &on_message);
+  void reset(uint32_t worker);
+  bool bind_to_node(uint32_t worker, int node);
+
+private:
+  struct Mailbox {
+    SharedMutex mutex;
+    int event_fd;
+    size_t head; // Both only grow; offsets are modulo PREFORK_MAILBOX_BYTES
+    size_t tail;
+    char data[PREFORK_MAILBOX_BYTES];
+  };
+
+  Mailbox &mailbox(uint32_t worker);
+  void lock(Mailbox &box);
+
+  size_t workers_;
+};
+
+/**
+ * @brief The memory shared by the supervisor and the workers of a prefork server, mapped before
+ * the workers are forked.
+ */
+class PreforkShared {
+public:
+  static std::unique_ptr<PreforkShared> create(size_t workers, size_t directory_capacity);
+  ~PreforkShared();
+
+  PreforkShared(const PreforkShared &) = delete;
+  PreforkShared &operator=(const PreforkShared &) = delete;
+
+  SharedDirectory &directory() { return *directory_; }
+  SharedMailboxes &mailboxes() { return *mailboxes_; }
+  WorkerStats &worker_stats(uint32_t worker) { return stats_[worker]; }
+
+private:
+  PreforkShared() = default;
+
+  void *memory_{nullptr};
+  size_t bytes_{0};
+  SharedDirectory *directory_{nullptr};
+  SharedMailboxes *mailboxes_{nullptr};
+  WorkerStats *stats_{nullptr};
+};
+
+/**
+ * @brief A prefork worker's bus: sessions are published in the shared directory and events are
+ * exchanged through the workers' mailboxes.
+ */
+class PreforkBus : public IWorkerBus {
+public:
+  // Delivers an event from another worker to the local clients; the slot, if not -1, is the
+  // receiver's FD in this worker.
+  using DeliverCallback = std::function<void(const common::Message &, int32_t)>;
+
+  PreforkBus(EpollManager &epoll_manager, PreforkShared &shared, uint32_t worker, common::Metrics &metrics,
+             DeliverCallback deliver);
+  ~PreforkBus() override;
+
+  PreforkBus(const PreforkBus &) = delete;
+  PreforkBus &operator=(const PreforkBus &) = delete;
+
+  bool owns_fd(int fd) const override { return fd == event_fd_; }
+  void handle_event() override;
+
+  bool claim(uint32_t user_id, const std::string &username, int32_t slot) override;
+  void release(uint32_t user_id) override;
+  bool is_username_online(const std::string &username) override;
+  std::vector<WorkerSession> get_remote_users() override;
+
+  void forward(const common::Message &event) override;
+  void route_private(const common::Message &message) override;
+
+  void place_mailbox(int node) override;
+  void note_connection_opened(int fd) override;
+  void note_connection_closed() override;
+  void report_balance() override;
+
+private:
+  EpollManager &epoll_manager_;
+  PreforkShared &shared_;
+  SharedDirectory &directory_;
+  SharedMailboxes &mailboxes_;
+  const uint32_t worker_;
+  common::Metrics &metrics_;
+  DeliverCallback deliver_;
+  const int event_fd_;
+};
+
+int run_prefork(int port, const ServerConfig &config, size_t workers);
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_PREFORK_H
@@ -0,0 +1,71 @@
+#ifndef SERVER_PRESENCE_TABLE_H
+#define SERVER_PRESENCE_TABLE_H
+
+#include "common/protocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+// Presence changes kept per node to answer gossip with deltas; peers further behind get a full copy.
+constexpr size_t PRESENCE_LOG_LENGTH = 256;
+
+/**
+ * @brief The users online on each node of the cluster, as disseminated by gossip.
+ *
+ * Every node owns the presence of its own users and versions it: each join or leave bumps the
+ * version by one. The first version is the node's start time in microseconds, so a restarted
+ * node's versions supersede what the cluster remembers from its previous run.
+ *
+ * Gossip is push-pull anti-entropy. A digest lists the version known for every node; the
+ * receiver answers with a delta for each node the sender is behind on (the changes since the
+ * sender's version, or the node's full presence if they are no longer logged), and sends its own
+ * digest back if the sender knows something newer. Deltas are applied only on top of the
+ * version they start from, so presence never goes back in time or skips a change.
+ */
+class PresenceTable {
+public:
+  PresenceTable(uint32_t local_node_id, uint64_t initial_version);
+
+  void local_join(uint32_t user_id, const std::string &username);
+  void local_leave(uint32_t user_id);
+
+  common::Message make_digest(bool reply) const;
+  std::vector<common::Message> answer_digest(const common::Message &digest, bool &peer_is_ahead) const;
+  std::vector<common::Message> apply_delta(const common::Message &delta);
+  std::vector<common::Message> drop_node(uint32_t node_id);
+
+  uint64_t version_of(uint32_t node_id) const;
+  const std::unordered_map<uint32_t, std::string> &users_of(uint32_t node_id) const;
+
+private:
+  struct Change {
+    uint64_t version;
+    uint32_t user_id;
+    bool joined;
+    std::string username;
+  };
+
+  struct NodePresence {
+    uint64_t version{0};
+    uint64_t log_base{0}; // Version just before the oldest logged change
+    std::unordered_map<uint32_t, std::string> users;
+    std::deque<Change> log;
+  };
+
+  void record(NodePresence &presence, Change change);
+  common::Message make_delta(uint32_t node_id, const NodePresence &presence, uint64_t since) const;
+
+  const uint32_t local_node_id_;
+  std::unordered_map<uint32_t, NodePresence> nodes_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_PRESENCE_TABLE_H
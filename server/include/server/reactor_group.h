@@ -0,0 +1,135 @@
+#ifndef SERVER_REACTOR_GROUP_H
+#define SERVER_REACTOR_GROUP_H
+
+#include "common/concurrent_queue.h"
+#include "common/metrics.h"
+#include "server/client_manager.h"
+#include "server/epoll_manager.h"
+#include "server/server_config.h"
+#include "server/session_directory.h"
+#include "server/worker_bus.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define REACTOR_GROUP_COMPONENT "ReactorGroup"
+
+// Deliveries each mailbox between two reactors holds before the sender spills into its backlog.
+constexpr size_t REACTOR_MAILBOX_CAPACITY = 1024;
+
+/**
+ * @brief A message one reactor hands to another: the frame is serialized once by the sender and
+ * shared by every reactor it goes to.
+ */
+struct ReactorDelivery {
+  std::shared_ptr<const std::vector<char>> frame;
+  uint32_t receiver_id{0};       // common::BROADCAST_ID for a broadcast
+  uint32_t exclude_sender_id{0}; // Broadcasts: the sender, which does not get its own echo
+  int32_t slot{-1};              // The receiver's FD on the receiving reactor, or -1 to look it up by ID
+};
+
+/**
+ * @brief The state shared by the reactor threads of one server: a mailbox for every ordered pair
+ * of reactors, a wakeup per reactor, the directory of all sessions and the connection counts.
+ */
+class ReactorGroup {
+public:
+  explicit ReactorGroup(size_t reactors, size_t mailbox_capacity = REACTOR_MAILBOX_CAPACITY);
+
+  ReactorGroup(const ReactorGroup &) = delete;
+  ReactorGroup &operator=(const ReactorGroup &) = delete;
+
+  size_t reactors() const { return reactors_; }
+  bool is_valid() const;
+
+  // Written only by reactor `from`, read only by reactor `to`.
+  common::SpscQueue<ReactorDelivery> &mailbox(size_t from, size_t to) { return *mailboxes_[from * reactors_ + to]; }
+  common::WakeupSignal &signal(size_t reactor) { return *signals_[reactor]; }
+  WorkerStats &worker_stats(size_t reactor) { return stats_[reactor]; }
+  SessionDirectory &directory() { return directory_; } // Reader i is reactor i
+
+private:
+  const size_t reactors_;
+  std::vector<std::unique_ptr<common::SpscQueue<ReactorDelivery>>> mailboxes_;
+  std::vector<std::unique_ptr<common::WakeupSignal>> signals_;
+  std::unique_ptr<WorkerStats[]> stats_;
+  SessionDirectory directory_;
+};
+
+/**
+ * @brief A reactor's bus to the other reactors of its group. Events for other reactors are
+ * serialized once and posted as one delivery per reactor, however many of its sessions they are
+ * for; inbound deliveries are drained once per loop iteration and broadcasts among them are
+ * written to each local session in one batch.
+ */
+class ReactorBus : public IWorkerBus {
+public:
+  using FrameCallback = std::function<void(const std::vector<char> &frame, uint32_t receiver_id, int32_t slot)>;
+  using BroadcastCallback = std::function<void(const std::vector<BroadcastFrame> &frames)>;
+
+  ReactorBus(EpollManager &epoll_manager, ReactorGroup &group, uint32_t reactor, common::Metrics &metrics,
+             FrameCallback deliver, BroadcastCallback broadcast);
+  ~ReactorBus() override;
+
+  bool owns_fd(int fd) const override { return fd == group_.signal(reactor_).get_fd(); }
+  void handle_event() override;
+  void poll() override;
+
+  bool claim(uint32_t user_id, const std::string &username, int32_t slot) override;
+  void release(uint32_t user_id) override;
+  bool is_username_online(const std::string &username) override;
+  std::vector<WorkerSession> get_remote_users() override;
+
+  void forward(const common::Message &event) override;
+  void route_private(const common::Message &message) override;
+
+  void place_mailbox(int node) override;
+  void note_connection_opened(int fd) override;
+  void note_connection_closed() override;
+  void report_balance() override;
+
+private:
+  // All mailboxes into one reactor, drained as one queue.
+  class Inbox {
+  public:
+    using value_type = ReactorDelivery;
+
+    Inbox(ReactorGroup &group, uint32_t reactor) : group_(group), reactor_(reactor) {}
+    size_t pop_batch(ReactorDelivery *out, size_t max_count);
+    bool empty() const;
+
+  private:
+    ReactorGroup &group_;
+    const uint32_t reactor_;
+  };
+
+  void post(uint32_t reactor, ReactorDelivery delivery);
+  void flush_backlog();
+  void drain_inbox();
+  void deliver_received();
+
+  EpollManager &epoll_manager_;
+  ReactorGroup &group_;
+  const uint32_t reactor_;
+  common::Metrics &metrics_;
+  FrameCallback deliver_;
+  BroadcastCallback broadcast_;
+  Inbox inbox_;
+  std::vector<std::deque<ReactorDelivery>> backlog_; // Per reactor: deliveries its full mailbox did not take
+  std::vector<ReactorDelivery> received_;
+  std::vector<BroadcastFrame> broadcast_run_;
+};
+
+int run_reactors(int port, const ServerConfig &config, size_t reactors);
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_REACTOR_GROUP_H
@@ -0,0 +1,113 @@
+#ifndef SERVER_REPLICATION_H
+#define SERVER_REPLICATION_H
+
+#include "common/metrics.h"
+#include "common/socket.h"
+#include "server/epoll_manager.h"
+#include "server/message_log.h"
+#include "server/peer_connection.h"
+#include "server/state_snapshot.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define REPLICATION_COMPONENT "Replication"
+
+// Upper bound on the encoded records carried by one S2S_REPLICATION_BATCH.
+constexpr size_t REPLICATION_BATCH_BYTES = 256 * 1024;
+// Records a standby may have in flight (shipped but not acknowledged) before shipping pauses.
+constexpr uint64_t REPLICATION_WINDOW_RECORDS = 16 * 1024;
+
+/**
+ * @brief Primary side of log-shipping replication.
+ *
+ * Accepts standby connections and streams every appended log record to them. Batches are
+ * pipelined up to REPLICATION_WINDOW_RECORDS ahead of the last acknowledgement; standbys that
+ * fall behind the in-memory tail are caught up from the log segments on disk.
+ */
+class ReplicationSource {
+public:
+  ReplicationSource(EpollManager &epoll_manager, const MessageLog &message_log, common::Metrics &metrics);
+  ~ReplicationSource();
+
+  bool start(int port);
+  void close();
+
+  bool owns_fd(int fd) const;
+  void handle_event(int fd, uint32_t events);
+
+  void on_append(const LogRecord &record);
+  void ship();
+  void update_metrics();
+
+  size_t standby_count() const { return standbys_.size(); }
+
+private:
+  struct Standby {
+    std::unique_ptr<PeerConnection> connection;
+    bool ready{false};
+    uint64_t sent_sequence{0};
+    uint64_t acked_sequence{0};
+  };
+
+  struct TailEntry {
+    uint64_t sequence;
+    uint64_t timestamp_ms;
+    std::vector<char> encoded;
+  };
+
+  void accept_standbys();
+  void handle_standby_message(Standby &standby, const common::Message &message);
+  void ship_to(Standby &standby);
+  void drop_standby(int fd);
+
+  EpollManager &epoll_manager_;
+  const MessageLog &message_log_;
+  common::Metrics &metrics_;
+  std::unique_ptr<common::IListeningSocket> listener_;
+  std::unordered_map<int, Standby> standbys_;
+  std::deque<TailEntry> tail_;
+  size_t tail_bytes_{0};
+};
+
+/**
+ * @brief Standby side of log-shipping replication.
+ *
+ * Connects to the primary, appends every shipped record to the local log (when there is one)
+ * and applies it to the in-memory state, so the standby is ready to take over at any time.
+ */
+class ReplicationSink {
+public:
+  ReplicationSink(EpollManager &epoll_manager, MessageLog *message_log, const ServerState &state,
+                  common::Metrics &metrics, std::function<void(const LogRecord &)> apply);
+
+  bool connect(const std::string &host, int port);
+  void close();
+
+  bool owns_fd(int fd) const { return connection_ && connection_->get_fd() == fd; }
+  bool handle_event(uint32_t events);
+
+  uint64_t applied_sequence() const { return state_.last_sequence; }
+
+private:
+  void handle_batch(const common::Message &message);
+
+  EpollManager &epoll_manager_;
+  MessageLog *message_log_;
+  const ServerState &state_;
+  common::Metrics &metrics_;
+  std::function<void(const LogRecord &)> apply_;
+  std::unique_ptr<PeerConnection> connection_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_REPLICATION_H
@@ -1,10 +1,28 @@
 #ifndef SERVER_SERVER_H
 #define SERVER_SERVER_H
 
+#include "server/auth_pool.h"
 #include "server/client_manager.h"
+#include "server/client_pipeline.h"
 #include "server/epoll_manager.h"
+#include "server/fan_out_pool.h"
+#include "server/federation.h"
+#include "server/gateway.h"
+#include "common/metrics.h"
+#include "server/message_log.h"
+#include "server/prefork.h"
+#include "server/reactor_group.h"
+#include "server/replication.h"
+#include "server/server_config.h"
+#include "server/session_flows.h"
+#include "server/state_snapshot.h"
+#include "server/user_registry.h"
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
 
 namespace chat_app {
 namespace server {
@@ -17,31 +35,92 @@ namespace server {
  */
 class Server {
 public:
-  explicit Server(int port);
+  explicit Server(int port, ServerConfig config = ServerConfig());
   ~Server() = default;
 
   void run();
   void stop();
 
+  void set_prefork(PreforkShared *shared, uint32_t worker);
+  void set_reactor_group(ReactorGroup *group, uint32_t reactor);
+  void adopt_listener(std::unique_ptr<common::IListeningSocket> listener);
+
+  bool is_standby() const { return standby_; }
+  const common::Metrics &get_metrics() const { return metrics_; }
+
 private:
-  void handle_new_connection();
+  void handle_new_connection(common::IListeningSocket &listener);
   void handle_client_message(int fd);
+  bool process_client_messages(ClientSession &session);
   void handle_client_disconnection(int fd);
-  
+  void handle_housekeeping();
+  void handle_auth_results();
+  void handle_pipeline_messages();
+
   void process_message(ClientSession &session, const common::Message &message);
   void process_join_message(ClientSession &session, const common::Message &message);
+  void complete_join(ClientSession &session, const std::string &username,
+                     const std::optional<common::PasswordHash> &new_hash);
+  void reject_join(ClientSession &session, const std::string &reason);
+  void send_message(ClientSession &session, const common::Message &message);
+  bool is_username_online(const std::string &username) const;
   void process_user_joined_list(ClientSession &session);
   void process_broadcast_message(ClientSession &session, const common::Message &message);
   void process_private_message(ClientSession &session, const common::Message &message);
 
+  bool restore_state();
+  bool start_replication();
+  bool start_federation();
+  void deliver_cluster_event(const common::Message &event);
+  void deliver_worker_event(const common::Message &event, int32_t slot);
+  void deliver_reactor_frame(const std::vector<char> &frame, uint32_t receiver_id, int32_t slot);
+  bool start_gateway();
+  void deliver_from_upstream(const common::Message &envelope);
+  void broadcast(const common::Message &message, uint32_t exclude_sender_id);
+  void promote_to_primary();
+  void apply_record(const LogRecord &record);
+  bool record_event(const common::Message &message);
+  void write_metrics_file();
+  void report_numa_placement();
   void shutdown();
 
   int port_;
+  ServerConfig config_;
   std::unique_ptr<common::IListeningSocket> listener_;
+  std::unique_ptr<common::IListeningSocket> unix_listener_; // Local clients, when a Unix socket path is configured
   EpollManager epoll_manager_;
   ClientManager client_manager_;
+  SessionFlows flows_{epoll_manager_}; // Session coroutines; destroyed before the sessions they refer to
   std::atomic<bool> running_{true};
   int server_event_fd_{-1};
+  int timer_fd_{-1};
+  int reactor_node_{-1}; // NUMA node of the CPU the reactor is pinned to
+  std::unique_ptr<AuthPool> auth_pool_;
+  std::unique_ptr<FanOutPool> fan_out_pool_; // Helpers for broadcasts to large audiences, when configured
+  std::unique_ptr<ClientPipeline> pipeline_; // Decode and encode stages, in pipeline mode
+
+  ServerState state_;
+  std::unique_ptr<UserRegistry> user_registry_;
+  std::unique_ptr<MessageLog> message_log_;
+  std::unique_ptr<StateSnapshotter> snapshotter_;
+  std::chrono::steady_clock::time_point last_snapshot_time_;
+
+  common::Metrics metrics_;
+  std::unique_ptr<ReplicationSource> replication_source_;
+  std::unique_ptr<ReplicationSink> replication_sink_;
+  std::atomic<bool> standby_{false};
+
+  std::unique_ptr<Federation> federation_;
+  std::unordered_set<int> deferred_client_reads_; // Clients not read while the cluster links are backed up
+  std::unordered_set<int> over_budget_clients_;   // Clients with chat left over for the next tick
+  std::unordered_set<int> budget_spent_clients_;  // Clients whose chat budget is refilled at the next tick
+  std::unique_ptr<GatewayHub> gateway_hub_;       // Routing server: sessions relayed by gateways
+  std::unique_ptr<GatewayUplink> gateway_uplink_; // Gateway: links to the routing servers
+
+  PreforkShared *prefork_shared_{nullptr}; // Set in a prefork worker
+  ReactorGroup *reactor_group_{nullptr};   // Set in a reactor of a multi-reactor server
+  uint32_t worker_index_{0};
+  std::unique_ptr<IWorkerBus> worker_bus_;
 };
 
 } // namespace server
@@ -0,0 +1,86 @@
+#ifndef SERVER_SERVER_CONFIG_H
+#define SERVER_SERVER_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Optional settings of the chat server. The defaults give a purely in-memory server.
+ */
+struct ServerConfig {
+  // Directory for the message log and state snapshots. Empty disables persistence.
+  std::string data_dir;
+  // How often a state snapshot is taken, in milliseconds.
+  int snapshot_interval_ms{60 * 1000};
+  // Period of the housekeeping timer (log flush, snapshot scheduling), in milliseconds.
+  int housekeeping_interval_ms{1000};
+  // File the metrics are written to on every housekeeping tick. Empty disables the export.
+  std::string metrics_file;
+  // Unix domain socket path on which local clients connect, in addition to the TCP port. Empty disables it.
+  std::string unix_socket_path;
+  // Bind the client port with SO_REUSEPORT, so that several processes accept on it. Set for prefork workers.
+  bool reuse_port{false};
+  // CPU the reactor thread is pinned to; its memory then comes from that CPU's NUMA node. -1 leaves it to the scheduler.
+  int reactor_cpu{-1};
+  // CPUs the auth worker threads are pinned to, round-robin. Empty leaves them to the scheduler.
+  std::vector<int> auth_cpus;
+  // Prefork: pin worker i to CPU i and hand each connection to the worker on the CPU that received it.
+  bool cpu_steering{false};
+
+  // Port on which a primary accepts standby servers. 0 disables log shipping. Requires data_dir.
+  int replication_port{0};
+  // "host:port" of the primary's replication port. When set, the server starts as a warm standby.
+  std::string replicate_from;
+
+  // Worker threads that check and hash passwords off the reactor thread.
+  int auth_threads{2};
+  // Joins that may wait for an auth worker, in total and per client IP address. Joins beyond that are refused.
+  size_t auth_queue_limit{1024};
+  size_t auth_queue_per_client{8};
+  // PBKDF2 iteration count for newly registered passwords.
+  uint32_t password_iterations{100000};
+
+  // Helper threads that split broadcasts to large audiences with the reactor. 0 sends every broadcast from the reactor.
+  size_t broadcast_threads{0};
+  // Connected clients from which a broadcast is split between the helpers.
+  size_t broadcast_fan_out_threshold{10000};
+
+  // Split client handling into stages: decode threads read and deserialize client messages, the reactor routes
+  // them, and encode threads serialize and write the replies. Cannot be combined with broadcast_threads.
+  bool pipeline{false};
+  size_t decode_threads{1};
+  size_t encode_threads{1};
+  // CPUs the decode and encode threads are pinned to, round-robin. Empty leaves them to the scheduler.
+  std::vector<int> decode_cpus;
+  std::vector<int> encode_cpus;
+
+  // This node's ID within a cluster (1..63). 0 runs a standalone server. Cluster nodes only serve names
+  // without a password, as the password hashes are not shared between nodes.
+  uint32_t node_id{0};
+  // Port on which other cluster nodes connect. 0 only dials out.
+  int cluster_port{0};
+  // Unix domain socket path on which cluster nodes of this host connect over shared memory. Empty disables it.
+  std::string cluster_shm_path;
+  // "host:port" of the other nodes' cluster ports, or "shm:<path>" of the cluster_shm_path of a node on this host.
+  std::vector<std::string> peers;
+  // Children per node in the tree broadcasts are relayed down. 0 sends each broadcast to every node directly.
+  size_t relay_fanout{0};
+
+  // Port on which chat_gateway processes connect to relay their clients. 0 disables the gateway tier.
+  int gateway_port{0};
+  // Unix domain socket path on which chat_gateway processes of this host connect over shared memory. Empty disables it.
+  std::string gateway_shm_path;
+  // "host:port" of the routing servers' gateway ports. When set, the server runs as a chat_gateway:
+  // it terminates client connections and relays their messages upstream.
+  std::vector<std::string> upstreams;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_SERVER_CONFIG_H
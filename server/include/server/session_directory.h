@@ -0,0 +1,90 @@
+#ifndef SERVER_SESSION_DIRECTORY_H
+#define SERVER_SESSION_DIRECTORY_H
+
+#include "common/concurrent_queue.h"
+#include "server/worker_bus.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+// Shards each table is split into; a join or leave copies one shard of each.
+constexpr size_t SESSION_DIRECTORY_SHARDS = 64;
+
+/**
+ * @brief The sessions of all reactors of a server, by user ID and by name, for lookups from any
+ * reactor thread.
+ *
+ * Reads are wait-free: each table is an array of shards published through atomic pointers, and a
+ * read loads a shard and looks into it without locking or writing anything shared. Joins and
+ * leaves are rare next to reads, so a write copies the one shard it changes, publishes the copy
+ * and retires the old shard. Retired shards are freed by quiescent-state-based reclamation (RCU):
+ * every reader thread calls quiesce() between lookups, once per loop iteration, holding nothing it
+ * read across the call; a shard retired in an epoch is freed once every reader has quiesced since.
+ */
+class SessionDirectory {
+public:
+  struct Entry {
+    WorkerSession session;
+    int32_t slot; // The session's FD on its worker
+  };
+
+  explicit SessionDirectory(size_t readers);
+  ~SessionDirectory();
+
+  SessionDirectory(const SessionDirectory &) = delete;
+  SessionDirectory &operator=(const SessionDirectory &) = delete;
+
+  // Writers: any thread, one at a time.
+  bool claim(uint32_t user_id, const std::string &username, uint32_t worker, int32_t slot);
+  void release(uint32_t user_id);
+
+  // Readers: wait-free, from the reader threads.
+  std::optional<Entry> find(uint32_t user_id) const;
+  bool is_username_taken(const std::string &username) const;
+  std::vector<WorkerSession> sessions() const;
+  void quiesce(size_t reader);
+
+  size_t retired_shards() const;
+
+private:
+  using IdShard = std::unordered_map<uint32_t, Entry>;
+  using NameShard = std::unordered_map<std::string, uint32_t>;
+
+  struct alignas(common::CACHE_LINE_BYTES) Reader {
+    std::atomic<uint64_t> epoch{0}; // The last epoch this reader quiesced in
+  };
+  struct Retired {
+    uint64_t epoch;
+    std::unique_ptr<const IdShard> ids;
+    std::unique_ptr<const NameShard> names;
+  };
+
+  static size_t id_shard(uint32_t user_id) { return user_id % SESSION_DIRECTORY_SHARDS; }
+  static size_t name_shard(const std::string &username);
+
+  void publish(size_t id_index, std::unique_ptr<IdShard> ids, size_t name_index, std::unique_ptr<NameShard> names);
+  void reclaim();
+
+  std::atomic<const IdShard *> ids_[SESSION_DIRECTORY_SHARDS];
+  std::atomic<const NameShard *> names_[SESSION_DIRECTORY_SHARDS];
+  std::unique_ptr<Reader[]> readers_;
+  const size_t reader_count_;
+  std::atomic<uint64_t> epoch_{1};
+
+  mutable std::mutex write_mutex_;
+  std::vector<Retired> retired_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_SESSION_DIRECTORY_H
@@ -0,0 +1,198 @@
+#ifndef SERVER_SESSION_FLOWS_H
+#define SERVER_SESSION_FLOWS_H
+
+#include "common/protocol.h"
+#include "server/client_session.h"
+#include "server/epoll_manager.h"
+#include "server/timer_wheel.h"
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define SESSION_FLOWS_COMPONENT "SessionFlows"
+
+// Resolution and size of the timer wheel behind sleep_for().
+constexpr std::chrono::milliseconds SESSION_FLOW_TICK(10);
+constexpr size_t SESSION_FLOW_TIMER_SLOTS = 512;
+
+/**
+ * @brief Per-thread free lists for coroutine frames, by size class. A session coroutine's frame is
+ * taken from the list when the coroutine starts and goes back when it finishes, so a reactor
+ * running flows all day reaches a steady state without touching the heap.
+ */
+class CoroutineFramePool {
+public:
+  static void *allocate(size_t size);
+  static void release(void *frame, size_t size);
+
+  // Frames this thread took from the heap, and frames it took from its free lists.
+  static uint64_t allocated();
+  static uint64_t reused();
+};
+
+/**
+ * @brief The return type of a session coroutine. The coroutine starts at once, runs on the reactor
+ * thread until its first co_await that has to wait, and destroys itself when it finishes; one still
+ * waiting when its SessionFlows is destroyed is destroyed with it. Coroutines must not throw.
+ */
+class SessionTask {
+public:
+  struct promise_type {
+    SessionTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(size_t size) { return CoroutineFramePool::allocate(size); }
+    static void operator delete(void *frame, size_t size) { CoroutineFramePool::release(frame, size); }
+  };
+};
+
+/**
+ * @brief Runs session logic written as coroutines on the reactor: a flow such as a multi-step
+ * handshake awaits the session's next message, a write or a delay in sequence, and the reactor goes
+ * on serving other clients while it waits.
+ *
+ * The server feeds in what the coroutines wait for: deliver() the messages of the sessions whose
+ * input a SessionInput has claimed, writable() when a client socket that returned EWOULDBLOCK can
+ * take more, close() when a session disconnects, and handle_timer() when get_timer_fd() is readable.
+ * Everything runs on the reactor thread.
+ */
+class SessionFlows {
+public:
+  class RecvAwaiter;
+  class SendAwaiter;
+  class SleepAwaiter;
+
+  explicit SessionFlows(EpollManager &epoll_manager, std::chrono::milliseconds tick = SESSION_FLOW_TICK);
+  ~SessionFlows();
+
+  SessionFlows(const SessionFlows &) = delete;
+  SessionFlows &operator=(const SessionFlows &) = delete;
+
+  bool start();
+  int get_timer_fd() const { return timer_fd_; }
+
+  bool deliver(int fd, const common::Message &message);
+  void writable(int fd);
+  void close(int fd);
+  void handle_timer();
+
+  SendAwaiter send_frame(ClientSession &session, const common::Message &message);
+  SleepAwaiter sleep_for(std::chrono::milliseconds delay);
+
+  size_t suspended() const { return suspended_.size(); }
+
+private:
+  friend class SessionInput;
+
+  struct Input {
+    std::deque<common::Message> messages;
+    std::coroutine_handle<> reader; // Waiting in recv_frame()
+    bool closed{false};
+  };
+
+  void suspend(std::coroutine_handle<> handle) { suspended_.insert(handle.address()); }
+  void resume(std::coroutine_handle<> handle);
+  bool write(SendAwaiter &send);
+  void arm_timer(bool armed);
+
+  EpollManager &epoll_manager_;
+  TimerWheel wheel_;
+  int timer_fd_{-1};
+  bool timer_armed_{false};
+  std::unordered_map<int, Input> inputs_;          // By FD, while a SessionInput claims the session
+  std::unordered_map<int, SendAwaiter *> writers_; // By FD, while a send waits for the socket
+  std::unordered_set<void *> suspended_;           // Frames of the waiting coroutines
+};
+
+/**
+ * @brief co_await recv_frame() gives the session's next message, or nothing once it has disconnected.
+ */
+class SessionFlows::RecvAwaiter {
+public:
+  RecvAwaiter(SessionFlows &flows, int fd) : flows_(flows), fd_(fd) {}
+
+  bool await_ready() const;
+  void await_suspend(std::coroutine_handle<> handle);
+  std::optional<common::Message> await_resume();
+
+private:
+  SessionFlows &flows_;
+  int fd_;
+};
+
+/**
+ * @brief co_await send_frame() writes a message whole, waiting for the socket while it is full, and
+ * gives false if the session disconnected first.
+ */
+class SessionFlows::SendAwaiter {
+public:
+  SendAwaiter(SessionFlows &flows, ClientSession &session, std::vector<char> bytes)
+      : flows_(flows), session_(session), bytes_(std::move(bytes)) {}
+
+  bool await_ready() { return flows_.write(*this); }
+  void await_suspend(std::coroutine_handle<> handle);
+  bool await_resume() const { return ok_; }
+
+private:
+  friend class SessionFlows;
+
+  SessionFlows &flows_;
+  ClientSession &session_;
+  std::vector<char> bytes_;
+  size_t sent_{0};
+  bool ok_{true};
+  std::coroutine_handle<> handle_;
+};
+
+/**
+ * @brief co_await sleep_for() resumes the coroutine after the delay, rounded up to the wheel's tick.
+ */
+class SessionFlows::SleepAwaiter {
+public:
+  SleepAwaiter(SessionFlows &flows, std::chrono::milliseconds delay) : flows_(flows), delay_(delay) {}
+
+  bool await_ready() const { return delay_.count() <= 0; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() const {}
+
+private:
+  SessionFlows &flows_;
+  std::chrono::milliseconds delay_;
+};
+
+/**
+ * @brief Claims a session's messages for the coroutine that holds it: while it lives, deliver()
+ * queues them for recv_frame() instead of the server processing them. One per session at a time.
+ */
+class SessionInput {
+public:
+  SessionInput(SessionFlows &flows, int fd);
+  ~SessionInput();
+
+  SessionInput(const SessionInput &) = delete;
+  SessionInput &operator=(const SessionInput &) = delete;
+
+  SessionFlows::RecvAwaiter recv_frame() { return SessionFlows::RecvAwaiter(flows_, fd_); }
+
+private:
+  SessionFlows &flows_;
+  int fd_;
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_SESSION_FLOWS_H
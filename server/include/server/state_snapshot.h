@@ -0,0 +1,68 @@
+#ifndef SERVER_STATE_SNAPSHOT_H
+#define SERVER_STATE_SNAPSHOT_H
+
+#include "common/crypto.h"
+#include "server/message_log.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+
+namespace chat_app {
+namespace server {
+
+#define STATE_SNAPSHOT_COMPONENT "StateSnapshot"
+
+/**
+ * @brief The durable part of the server state, rebuilt from the latest snapshot plus the log tail.
+ * The username registry persists itself (see UserRegistry); the snapshot records the log position it covers.
+ */
+struct ServerState {
+  uint64_t last_sequence{0};
+  std::unordered_map<std::string, common::PasswordHash> password_hashes;
+
+  void apply(const LogRecord &record);
+};
+
+/**
+ * @brief Writes periodic snapshots of ServerState and loads the latest one on startup.
+ *
+ * Snapshots are written by a forked child, so the reactor only pays for the fork itself and
+ * the kernel's copy-on-write keeps the child's view of the state consistent.
+ */
+class StateSnapshotter {
+public:
+  explicit StateSnapshotter(const std::string &directory);
+  ~StateSnapshotter();
+
+  StateSnapshotter(const StateSnapshotter &) = delete;
+  StateSnapshotter &operator=(const StateSnapshotter &) = delete;
+
+  bool begin(const ServerState &state);
+  bool poll();
+  void wait();
+  bool in_progress() const { return child_pid_ > 0; }
+  uint64_t last_snapshot_sequence() const { return last_snapshot_sequence_; }
+
+  bool write_now(const ServerState &state);
+  std::optional<ServerState> load_latest() const;
+
+  std::string get_snapshot_path() const;
+
+private:
+  static bool write_to_fd(int fd, const ServerState &state);
+  bool write_file(const ServerState &state) const;
+
+  std::string directory_;
+  std::string snapshot_path_;
+  std::string temp_path_;
+  pid_t child_pid_{-1};
+  uint64_t pending_sequence_{0};
+  uint64_t last_snapshot_sequence_{0};
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_STATE_SNAPSHOT_H
@@ -0,0 +1,52 @@
+#ifndef SERVER_TIMER_WHEEL_H
+#define SERVER_TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief A hashed timer wheel: timers are kept in one slot per tick, modulo the number of slots,
+ * and a timer further away than one turn of the wheel waits for as many turns. Scheduling,
+ * cancelling and firing a timer take constant time however many timers are pending; the price is
+ * a resolution of one tick. The owner advances the wheel as ticks pass, e.g. from a timerfd.
+ */
+class TimerWheel {
+public:
+  using Callback = std::function<void()>;
+
+  TimerWheel(std::chrono::milliseconds tick, size_t slots);
+
+  uint64_t schedule(std::chrono::milliseconds delay, Callback callback);
+  bool cancel(uint64_t id);
+  size_t advance(uint64_t ticks);
+
+  std::chrono::milliseconds tick() const { return tick_; }
+  size_t pending() const { return timers_.size(); }
+
+private:
+  struct Timer {
+    uint64_t id;
+    uint64_t turns; // Times the wheel passes the timer's slot before it fires
+    Callback callback;
+  };
+  using Slot = std::list<Timer>;
+
+  const std::chrono::milliseconds tick_;
+  std::vector<Slot> slots_;
+  size_t current_{0};
+  uint64_t next_id_{1};
+  std::unordered_map<uint64_t, std::pair<size_t, Slot::iterator>> timers_; // By ID: slot and position
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_TIMER_WHEEL_H
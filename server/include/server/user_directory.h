@@ -0,0 +1,62 @@
+#ifndef SERVER_USER_DIRECTORY_H
+#define SERVER_USER_DIRECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Where users are connected in the cluster, as known by one node.
+ *
+ * Home entries are authoritative: every user is registered at its home node (chosen by the
+ * HashRing) by the node it is connected to. The cache remembers the answers to recent lookups
+ * made to other home nodes, so a conversation costs one lookup rather than one per message.
+ * Both are hash tables, so every lookup is O(1).
+ */
+class UserDirectory {
+public:
+  explicit UserDirectory(size_t cache_capacity = 4096);
+
+  void set_home(uint32_t user_id, uint32_t node_id);
+  void remove_home(uint32_t user_id, uint32_t node_id);
+  std::optional<uint32_t> find_home(uint32_t user_id) const;
+
+  void cache(uint32_t user_id, uint32_t node_id);
+  std::optional<uint32_t> find_cached(uint32_t user_id);
+  void forget(uint32_t user_id);
+
+  void forget_node(uint32_t node_id);
+  template <typename Predicate> void drop_homes_if(Predicate predicate);
+
+  size_t home_count() const { return homes_.size(); }
+  size_t cache_size() const { return cache_.size(); }
+
+private:
+  using LruList = std::list<std::pair<uint32_t, uint32_t>>; // (user ID, node ID), most recent first
+
+  std::unordered_map<uint32_t, uint32_t> homes_;
+  size_t cache_capacity_;
+  LruList lru_;
+  std::unordered_map<uint32_t, LruList::iterator> cache_;
+};
+
+/**
+ * @brief Drops the home entries of the users a predicate selects, e.g. the ones whose home moved to another node.
+ * @param predicate Called with each user ID; returns true to drop the entry.
+ */
+template <typename Predicate> void UserDirectory::drop_homes_if(Predicate predicate) {
+  for (auto it = homes_.begin(); it != homes_.end();) {
+    it = predicate(it->first) ? homes_.erase(it) : std::next(it);
+  }
+}
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_USER_DIRECTORY_H
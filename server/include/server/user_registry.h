@@ -0,0 +1,78 @@
+#ifndef SERVER_USER_REGISTRY_H
+#define SERVER_USER_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+
+namespace chat_app {
+namespace server {
+
+#define USER_REGISTRY_COMPONENT "UserRegistry"
+
+// Longest username the registry can hold; it has to fit in one 64-byte slot.
+constexpr size_t MAX_REGISTERED_USERNAME = 51;
+
+/**
+ * @brief Persistent mapping of usernames to stable user IDs.
+ *
+ * The table is a memory-mapped file of cache-line sized slots with open addressing and linear
+ * probing, kept at most half full so a lookup is almost always a single slot (one cache line).
+ * A slot's tag is published last, so a crash mid-insert leaves either the old or the new entry,
+ * never a torn one. Growing writes a new file and renames it over the old one.
+ *
+ * With an empty path the table lives in anonymous memory and is not persisted.
+ */
+class UserRegistry {
+public:
+  explicit UserRegistry(const std::string &path = "");
+  ~UserRegistry();
+
+  UserRegistry(const UserRegistry &) = delete;
+  UserRegistry &operator=(const UserRegistry &) = delete;
+
+  bool open(size_t initial_capacity = 1024, uint32_t first_user_id = 1,
+            uint32_t last_user_id = std::numeric_limits<uint32_t>::max() - 1);
+  void close();
+  bool flush();
+
+  std::optional<uint32_t> find(const std::string &username) const;
+  std::optional<uint32_t> register_user(const std::string &username);
+  bool insert(const std::string &username, uint32_t user_id);
+
+  size_t size() const;
+  size_t capacity() const;
+  uint32_t next_user_id() const;
+
+private:
+  struct Header;
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> tag; // 0 = empty, otherwise the username's hash
+    uint32_t user_id;
+    uint8_t name_size;
+    char name[MAX_REGISTERED_USERNAME];
+  };
+  static_assert(sizeof(Slot) == 64, "A registry slot must be exactly one cache line");
+
+  static uint64_t hash(const std::string &username);
+
+  bool map_table(size_t capacity, bool create);
+  bool grow();
+  Slot *find_slot(const std::string &username, uint64_t tag) const;
+  void write_slot(const std::string &username, uint64_t tag, uint32_t user_id);
+
+  std::string path_;
+  void *mapping_{nullptr};
+  size_t mapping_size_{0};
+  Header *header_{nullptr};
+  Slot *slots_{nullptr};
+  uint32_t last_user_id_{std::numeric_limits<uint32_t>::max() - 1}; // Highest ID register_user() hands out
+};
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_USER_REGISTRY_H
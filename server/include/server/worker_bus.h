@@ -0,0 +1,77 @@
+#ifndef SERVER_WORKER_BUS_H
+#define SERVER_WORKER_BUS_H
+
+#include "common/metrics.h"
+#include "common/socket.h"
+#include "common/protocol.h"
+#include "server/server_config.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace chat_app {
+namespace server {
+
+#define WORKER_BUS_COMPONENT "WorkerBus"
+
+/**
+ * @brief A session of one of the workers (prefork processes or reactor threads) of a server.
+ */
+struct WorkerSession {
+  uint32_t user_id;
+  uint32_t worker;
+  std::string username;
+};
+
+/**
+ * @brief Connection counts of one worker, shared with the others so that every worker can report
+ * the balance between all of them.
+ */
+struct WorkerStats {
+  std::atomic<uint64_t> accepted{0};
+  std::atomic<uint64_t> off_cpu{0}; // Accepted on another CPU than the one the connection arrived on
+  std::atomic<int64_t> connected{0};
+};
+
+/**
+ * @brief A worker's view of the other workers of the same server, in the role Federation plays
+ * for a cluster: it publishes the worker's sessions in a directory all workers share and carries
+ * events (presence, broadcasts, private messages) between workers. Implemented over shared
+ * memory for prefork processes and over in-process queues for reactor threads.
+ */
+class IWorkerBus {
+public:
+  virtual ~IWorkerBus() = default;
+
+  virtual bool owns_fd(int fd) const = 0;
+  virtual void handle_event() = 0;
+  virtual void poll() {} // Called once per reactor loop iteration
+
+  // Publishes a joining session; false if another worker admitted the name first.
+  virtual bool claim(uint32_t user_id, const std::string &username, int32_t slot) = 0;
+  virtual void release(uint32_t user_id) = 0;
+  virtual bool is_username_online(const std::string &username) = 0;
+  virtual std::vector<WorkerSession> get_remote_users() = 0;
+
+  virtual void forward(const common::Message &event) = 0;
+  virtual void route_private(const common::Message &message) = 0;
+
+  virtual void place_mailbox(int node) = 0;
+  virtual void note_connection_opened(int fd) = 0;
+  virtual void note_connection_closed() = 0;
+  virtual void report_balance() = 0;
+};
+
+void count_connection(WorkerStats &stats, int fd, common::Metrics &metrics);
+void publish_worker_balance(common::Metrics &metrics, const WorkerStats *stats, size_t workers);
+bool check_worker_config(const ServerConfig &config, size_t workers, const char *mode);
+bool attach_cpu_steering(int listener_fd, size_t group_size);
+std::vector<std::unique_ptr<common::IListeningSocket>> bind_steered_listeners(int port, size_t workers);
+
+} // namespace server
+} // namespace chat_app
+
+#endif // SERVER_WORKER_BUS_H
@@ -0,0 +1,166 @@
+#include "server/auth_pool.h"
+#include "common/affinity.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <thread>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructs an AuthPool. No threads run until start() is called.
+ * @param threads Number of worker threads.
+ * @param max_queued Maximum number of requests waiting in total.
+ * @param max_queued_per_client Maximum number of requests waiting per client key.
+ * @param hash_iterations PBKDF2 iteration count for newly registered passwords.
+ */
+AuthPool::AuthPool(size_t threads, size_t max_queued, size_t max_queued_per_client, uint32_t hash_iterations)
+    : thread_count_(std::max<size_t>(threads, 1)), max_queued_(max_queued),
+      max_queued_per_client_(max_queued_per_client), hash_iterations_(std::max<uint32_t>(hash_iterations, 1)),
+      completions_(max_queued + thread_count_) {}
+
+/**
+ * @brief Destructor for AuthPool. Stops the workers.
+ */
+AuthPool::~AuthPool() { stop(); }
+
+/**
+ * @brief Starts the worker threads.
+ * @return True on success, false if the completion eventfd could not be created.
+ */
+bool AuthPool::start() {
+  if (!completions_signal_.is_valid()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < thread_count_; ++i) {
+    workers_.emplace_back([this, i]() {
+      if (!cpus_.empty() && common::pin_current_thread(cpus_[i % cpus_.size()])) {
+        common::prefer_local_memory();
+      }
+      worker_loop();
+    });
+  }
+  LOG_INFO(AUTH_POOL_COMPONENT, "Started {} authentication workers", thread_count_);
+  return true;
+}
+
+/**
+ * @brief Stops the workers. Requests still queued are dropped.
+ */
+void AuthPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queues_.clear();
+    ready_clients_.clear();
+    queued_ = 0;
+  }
+  work_available_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+/**
+ * @brief Queues a request for a worker.
+ * @param request The request.
+ * @return True if queued, false if the pool or the client's share of it is full.
+ */
+bool AuthPool::submit(AuthRequest request) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || queued_ >= max_queued_) {
+      return false;
+    }
+
+    auto &queue = queues_[request.client_key];
+    if (queue.size() >= max_queued_per_client_) {
+      return false;
+    }
+    if (queue.empty()) {
+      ready_clients_.push_back(request.client_key);
+    }
+    queue.push_back(std::move(request));
+    ++queued_;
+  }
+  work_available_.notify_one();
+  return true;
+}
+
+/**
+ * @brief Collects the results completed since the last call. Called by the reactor when the eventfd is readable.
+ * @return The completed results.
+ */
+std::vector<AuthResult> AuthPool::take_results() {
+  std::vector<AuthResult> results;
+  completions_signal_.drain(completions_, [&results](AuthResult result) { results.push_back(std::move(result)); });
+  return results;
+}
+
+/**
+ * @brief Gets the number of requests waiting for a worker.
+ */
+size_t AuthPool::queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_;
+}
+
+/**
+ * @brief Worker thread: serves the client keys round-robin, one request at a time.
+ */
+void AuthPool::worker_loop() {
+  while (true) {
+    AuthRequest request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this] { return stopping_ || !ready_clients_.empty(); });
+      if (stopping_) {
+        return;
+      }
+
+      std::string key = std::move(ready_clients_.front());
+      ready_clients_.pop_front();
+      auto it = queues_.find(key);
+      request = std::move(it->second.front());
+      it->second.pop_front();
+      --queued_;
+      if (it->second.empty()) {
+        queues_.erase(it);
+      } else {
+        ready_clients_.push_back(std::move(key));
+      }
+    }
+
+    AuthResult result = process(request);
+    // The queue holds every request the pool admits; it only fills if the reactor stalls.
+    while (completions_.push_batch(&result, 1) == 0) {
+      std::this_thread::yield();
+    }
+    completions_signal_.notify();
+  }
+}
+
+/**
+ * @brief Checks the password against the stored hash, or hashes it if the name has none yet.
+ * @param request The request.
+ * @return The result.
+ */
+AuthResult AuthPool::process(AuthRequest &request) const {
+  AuthResult result;
+  result.fd = request.fd;
+  result.session_id = request.session_id;
+  result.username = std::move(request.username);
+
+  if (request.stored_hash) {
+    result.accepted = request.stored_hash->verify(request.password);
+  } else {
+    result.new_hash = common::PasswordHash::create(request.password, hash_iterations_);
+    result.accepted = result.new_hash.has_value();
+  }
+  return result;
+}
+
+} // namespace server
+} // namespace chat_app
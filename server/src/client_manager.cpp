@@ -27,7 +27,11 @@ ClientSession *ClientManager::add_client(std::unique_ptr<common::IStreamSocket>
 }
 
 /**
- * @brief Removes a client session by its file descriptor.
+ * @brief Removes a client session by its file descriptor. The session is marked closed and can no
+ * longer be looked up, but it is only destroyed, and its socket closed, by the next
+ * reclaim_retired(): a handler further up the stack, such as the one decoding the session's read
+ * buffer, may still hold it. Keeping the socket open until then also keeps its FD from being
+ * reused by a connection accepted in the same loop tick.
  * @param fd The file descriptor of the client to remove.
  */
 void ClientManager::remove_client(int fd) {
@@ -37,14 +41,45 @@ void ClientManager::remove_client(int fd) {
     
     LOG_INFO(CLIENT_MANAGER_COMPONENT, "Client removed: ID = {}, FD = {}", session->get_id(), fd);
     
+    session->set_closed();
     session_by_id_.erase(session->get_id());
     usernames_.erase(session->get_username());
+    retired_.push_back(std::move(it->second));
     session_by_fd_.erase(it);
   } else {
     LOG_WARNING(CLIENT_MANAGER_COMPONENT, "Attempted to remove non-existent client with FD = {}", fd);
   }
 }
 
+/**
+ * @brief Destroys the sessions removed since the last call, closing their sockets in one batch. Called
+ * at the end of every loop tick, once no handler holds a session any more.
+ * @return The number of sessions destroyed.
+ */
+size_t ClientManager::reclaim_retired() {
+  const size_t reclaimed = retired_.size();
+  retired_.clear();
+  return reclaimed;
+}
+
+/**
+ * @brief Re-keys a session under a new ID, e.g. its registered user ID once it has joined.
+ * @param session The session to re-key.
+ * @param id The new ID.
+ * @return True on success, false if another session already uses the ID.
+ */
+bool ClientManager::assign_id(ClientSession &session, uint32_t id) {
+  auto it = session_by_id_.find(id);
+  if (it != session_by_id_.end() && it->second != &session) {
+    return false;
+  }
+
+  session_by_id_.erase(session.get_id());
+  session.set_id(id);
+  session_by_id_[id] = &session;
+  return true;
+}
+
 /**
  * @brief Retrieves a client session by its unique ID.
  * @param id The unique ID of the client.
@@ -94,17 +129,29 @@ bool ClientManager::is_username_taken(const std::string &username) const {
 
 /**
  * @brief Broadcasts a message to all authenticated clients, excluding the sender.
+ * Sessions relayed by a gateway (negative FDs) are skipped: the gateway gets one copy for all of them.
  * @param message The message to broadcast.
  * @param exclude_sender_id The ID of the client that should not receive the message.
  */
 void ClientManager::broadcast_message(const common::Message &message, uint32_t exclude_sender_id) {
   auto serialize_message = common::serialize_message(message);
 
+  if (should_fan_out()) {
+    auto recipients = get_broadcast_recipients();
+    fan_out_->run(recipients.size(), BROADCAST_FAN_OUT_CHUNK, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        if (recipients[i]->get_id() != exclude_sender_id) {
+          recipients[i]->send(serialize_message);
+        }
+      }
+    });
+    return;
+  }
+
   for (auto const &[fd, session] : session_by_fd_) {
-    if (session->is_authenticated() && session->get_id() != exclude_sender_id) {
-      auto socket = session->get_socket();
-      if (socket) {
-        socket->send_data(serialize_message);
+    if (fd >= 0 && session->is_authenticated() && session->get_id() != exclude_sender_id) {
+      if (session->get_socket()) {
+        session->send(serialize_message);
       } else {
         LOG_ERROR(CLIENT_MANAGER_COMPONENT, "Socket for client ID {} is null", session->get_id());
       }
@@ -112,5 +159,67 @@ void ClientManager::broadcast_message(const common::Message &message, uint32_t e
   }
 }
 
+/**
+ * @brief Broadcasts a run of serialized messages to all authenticated clients, each client getting
+ * the ones it did not send concatenated in one write. Clients relayed by a gateway are skipped.
+ * @param frames The messages, in order.
+ */
+void ClientManager::broadcast_frames(const std::vector<BroadcastFrame> &frames) {
+  auto send_batch = [&frames](ClientSession &session, std::vector<char> &batch) {
+    batch.clear();
+    for (const auto &frame : frames) {
+      if (session.get_id() != frame.exclude_sender_id) {
+        batch.insert(batch.end(), frame.frame->begin(), frame.frame->end());
+      }
+    }
+    if (!batch.empty()) {
+      session.send(batch);
+    }
+  };
+
+  if (should_fan_out()) {
+    auto recipients = get_broadcast_recipients();
+    fan_out_->run(recipients.size(), BROADCAST_FAN_OUT_CHUNK, [&](size_t begin, size_t end) {
+      std::vector<char> batch;
+      for (size_t i = begin; i < end; ++i) {
+        send_batch(*recipients[i], batch);
+      }
+    });
+    return;
+  }
+
+  std::vector<char> batch;
+  for (auto const &[fd, session] : session_by_fd_) {
+    if (fd >= 0 && session->is_authenticated() && session->get_socket()) {
+      send_batch(*session, batch);
+    }
+  }
+}
+
+/**
+ * @brief Makes broadcasts to large audiences run on a pool of helper threads. Each broadcast still
+ * completes before the call returns, so every client gets its messages in order.
+ * @param pool The pool, or nullptr to send every broadcast from the calling thread.
+ * @param threshold The number of clients from which broadcasts are split.
+ */
+void ClientManager::set_fan_out(FanOutPool *pool, size_t threshold) {
+  fan_out_ = pool;
+  fan_out_threshold_ = threshold;
+}
+
+/**
+ * @brief Lists the clients a broadcast goes to directly, so the list can be split between threads.
+ */
+std::vector<ClientSession *> ClientManager::get_broadcast_recipients() const {
+  std::vector<ClientSession *> recipients;
+  recipients.reserve(session_by_fd_.size());
+  for (auto const &[fd, session] : session_by_fd_) {
+    if (fd >= 0 && session->is_authenticated() && session->get_socket()) {
+      recipients.push_back(session.get());
+    }
+  }
+  return recipients;
+}
+
 } // namespace server
 } // namespace chat_app
\ No newline at end of file
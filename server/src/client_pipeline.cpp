@@ -0,0 +1,520 @@
+#include "server/client_pipeline.h"
+#include "common/affinity.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// Jobs handed to a stage's ring at a time.
+constexpr size_t FLUSH_BATCH = 64;
+// Bytes a decode thread asks a socket for at a time.
+constexpr size_t READ_CHUNK = 4096;
+// How long an idle stage thread waits before it checks whether the pipeline is stopping, in milliseconds.
+constexpr int STAGE_IDLE_POLL_MS = 100;
+
+} // namespace
+
+/**
+ * @brief The socket a session owns in pipeline mode. Writes are queued for the encode stage of the
+ * connection, in the lane of the first message they hold; there is nothing to receive, as the decode
+ * stage reads the connection.
+ */
+class ClientPipeline::StagedSocket : public common::IStreamSocket {
+public:
+  StagedSocket(ClientPipeline &pipeline, std::shared_ptr<Connection> connection)
+      : pipeline_(pipeline), connection_(std::move(connection)) {}
+
+  common::SocketResult send_data(const std::vector<char> &data) override {
+    if (connection_->closed.load(std::memory_order_relaxed)) {
+      return {common::SocketStatus::CLOSED, 0};
+    }
+    auto &stage = *pipeline_.encoders_[static_cast<size_t>(connection_->fd) % pipeline_.encoders_.size()];
+    const auto type = data.empty() ? common::MessageType::S2C_ERROR : static_cast<common::MessageType>(data[0]);
+    stage.pending[lane_of(type)].push_back(EncodeJob{connection_, common::Message(), data});
+    return {common::SocketStatus::OK, data.size()};
+  }
+  common::SocketResult raw_send(const char *data, size_t len) override {
+    return send_data(std::vector<char>(data, data + len));
+  }
+  common::SocketResult receive_data(std::vector<char> &) override { return {common::SocketStatus::WOULD_BLOCK, 0}; }
+  common::SocketResult raw_receive(char *, size_t) override { return {common::SocketStatus::WOULD_BLOCK, 0}; }
+  void close_socket() override { connection_->closed.store(true); }
+  bool is_valid() const override { return !connection_->closed.load() && connection_->socket->is_valid(); }
+  int get_fd() const override { return connection_->fd; }
+  void set_non_blocking(bool non_blocking) override { connection_->socket->set_non_blocking(non_blocking); }
+
+private:
+  ClientPipeline &pipeline_;
+  std::shared_ptr<Connection> connection_;
+};
+
+/**
+ * @brief Constructs a ClientPipeline. No threads run until start() is called.
+ * @param decode_threads Threads that read and deserialize client messages.
+ * @param encode_threads Threads that serialize and write replies.
+ * @param queue_capacity Slots of each ring between two stages.
+ */
+ClientPipeline::ClientPipeline(size_t decode_threads, size_t encode_threads, size_t queue_capacity)
+    : routed_(queue_capacity) {
+  for (size_t i = 0; i < std::max<size_t>(decode_threads, 1); ++i) {
+    decoders_.push_back(std::make_unique<Stage<DecodeJob>>(1, queue_capacity));
+  }
+  for (size_t i = 0; i < std::max<size_t>(encode_threads, 1); ++i) {
+    encoders_.push_back(std::make_unique<Stage<EncodeJob>>(ENCODE_LANES, queue_capacity));
+  }
+}
+
+/**
+ * @brief Destructor for ClientPipeline. Stops the stage threads.
+ */
+ClientPipeline::~ClientPipeline() { stop(); }
+
+/**
+ * @brief Pins the stage threads to CPUs, round-robin per stage. Must be called before start().
+ * @param decode_cpus CPUs of the decode threads; empty leaves them to the scheduler.
+ * @param encode_cpus CPUs of the encode threads; empty leaves them to the scheduler.
+ */
+void ClientPipeline::set_cpus(std::vector<int> decode_cpus, std::vector<int> encode_cpus) {
+  decode_cpus_ = std::move(decode_cpus);
+  encode_cpus_ = std::move(encode_cpus);
+}
+
+/**
+ * @brief Starts the decode and encode threads.
+ * @return False if a wakeup eventfd could not be created.
+ */
+bool ClientPipeline::start() {
+  bool valid = routed_signal_.is_valid();
+  for (auto &stage : decoders_) {
+    valid = valid && stage->signal.is_valid();
+  }
+  for (auto &stage : encoders_) {
+    valid = valid && stage->signal.is_valid();
+  }
+  if (!valid) {
+    LOG_ERROR(CLIENT_PIPELINE_COMPONENT, "Failed to create the stage wakeup eventfds");
+    return false;
+  }
+
+  for (size_t i = 0; i < decoders_.size(); ++i) {
+    const int cpu = decode_cpus_.empty() ? -1 : decode_cpus_[i % decode_cpus_.size()];
+    decoders_[i]->thread = std::thread([this, i, cpu]() {
+      std::vector<Routed> routed;
+      stage_loop(
+          *decoders_[i], cpu, [&](DecodeJob &&job) { decode(job.connection, routed); }, [&]() { emit(routed); },
+          [](std::vector<pollfd> &) {});
+    });
+  }
+  for (size_t i = 0; i < encoders_.size(); ++i) {
+    const int cpu = encode_cpus_.empty() ? -1 : encode_cpus_[i % encode_cpus_.size()];
+    encoders_[i]->thread = std::thread([this, i, cpu]() {
+      std::shared_ptr<Connection> writing;
+      std::vector<std::shared_ptr<Connection>> waiting; // Connections with replies their socket did not take
+      stage_loop(
+          *encoders_[i], cpu, [&](EncodeJob &&job) { encode(job, writing, waiting); },
+          [&]() {
+            write(writing, waiting);
+            retry_waiting(waiting);
+          },
+          [&](std::vector<pollfd> &watched) {
+            for (const auto &connection : waiting) {
+              watched.push_back(pollfd{connection->fd, POLLOUT, 0});
+            }
+          });
+    });
+  }
+  LOG_INFO(CLIENT_PIPELINE_COMPONENT, "Started {} decode and {} encode threads", decoders_.size(), encoders_.size());
+  return true;
+}
+
+/**
+ * @brief Stops the stage threads. Replies already queued are written first; reads not yet done are dropped.
+ */
+void ClientPipeline::stop() {
+  if (stopping_.load()) {
+    return;
+  }
+  for (auto &stage : encoders_) {
+    while (stage->thread.joinable() && !flush_stage(*stage)) {
+      std::this_thread::yield(); // The encode thread makes room
+    }
+  }
+  stopping_.store(true);
+  for (auto &stage : decoders_) {
+    stage->signal.notify();
+  }
+  for (auto &stage : encoders_) {
+    stage->signal.notify();
+  }
+  for (auto &stage : decoders_) {
+    if (stage->thread.joinable()) {
+      stage->thread.join();
+    }
+  }
+  for (auto &stage : encoders_) {
+    if (stage->thread.joinable()) {
+      stage->thread.join();
+    }
+  }
+}
+
+/**
+ * @brief Takes over a client connection.
+ * @param socket The connection's socket.
+ * @return The socket the connection's session uses instead: writes to it go through the encode stage.
+ */
+std::unique_ptr<common::IStreamSocket> ClientPipeline::attach(std::unique_ptr<common::IStreamSocket> socket) {
+  auto connection = std::make_shared<Connection>();
+  connection->fd = socket->get_fd();
+  connection->socket = std::move(socket);
+  connections_[connection->fd] = connection;
+  return std::make_unique<StagedSocket>(*this, std::move(connection));
+}
+
+/**
+ * @brief Lets go of a client connection whose session is going away. Messages of the connection that
+ * are still being decoded are dropped; replies already queued are still written.
+ * @param fd The connection's FD.
+ */
+void ClientPipeline::detach(int fd) {
+  auto it = connections_.find(fd);
+  if (it != connections_.end()) {
+    it->second->closed.store(true);
+    connections_.erase(it);
+  }
+}
+
+/**
+ * @brief Queues a connection that became readable for its decode thread.
+ * @param fd The connection's FD.
+ */
+void ClientPipeline::read(int fd) {
+  auto it = connections_.find(fd);
+  if (it != connections_.end()) {
+    decoders_[static_cast<size_t>(fd) % decoders_.size()]->pending.front().push_back(DecodeJob{it->second});
+  }
+}
+
+/**
+ * @brief Queues a message for a connection's encode thread, which serializes and writes it. Control and
+ * presence messages go ahead of the chat queued for the thread.
+ * @param fd The connection's FD.
+ * @param message The message.
+ * @return False if the FD is not an attached connection; the caller then writes the message itself.
+ */
+bool ClientPipeline::send(int fd, const common::Message &message) {
+  auto it = connections_.find(fd);
+  if (it == connections_.end()) {
+    return false;
+  }
+  auto &stage = *encoders_[static_cast<size_t>(fd) % encoders_.size()];
+  stage.pending[lane_of(message.header.type)].push_back(EncodeJob{it->second, message, {}});
+  return true;
+}
+
+/**
+ * @brief Hands every decoded message to the router, in the order each connection sent them.
+ * @param on_message Routes a message of the connection with the given FD.
+ * @param on_close Disconnects the connection with the given FD, which the peer closed.
+ * @return The number of decoded messages and closes taken from the decode stage.
+ */
+size_t ClientPipeline::route(const MessageHandler &on_message, const CloseHandler &on_close) {
+  return routed_signal_.drain(routed_, [&](Routed &&routed) {
+    routed_depth_.fetch_sub(1, std::memory_order_relaxed);
+    const int fd = routed.connection->fd;
+    auto it = connections_.find(fd);
+    if (it == connections_.end() || it->second != routed.connection) {
+      return; // Detached since, e.g. by an earlier message of the same batch
+    }
+    if (routed.closed) {
+      on_close(fd);
+    } else {
+      on_message(fd, routed.message);
+    }
+  });
+}
+
+/**
+ * @brief Hands the reads and writes queued since the last flush to the stage threads, in one batch
+ * per thread. Whatever does not fit into a full ring stays queued for the next flush.
+ */
+void ClientPipeline::flush() {
+  for (auto &stage : decoders_) {
+    flush_stage(*stage);
+  }
+  for (auto &stage : encoders_) {
+    flush_stage(*stage);
+  }
+}
+
+/**
+ * @brief Checks whether work is waiting for room in a full ring, so the reactor should flush again soon.
+ */
+bool ClientPipeline::has_backlog() const {
+  auto waiting = [](const auto &stages) {
+    return std::any_of(stages.begin(), stages.end(), [](const auto &stage) {
+      return std::any_of(stage->pending.begin(), stage->pending.end(), [](const auto &lane) { return !lane.empty(); });
+    });
+  };
+  return waiting(decoders_) || waiting(encoders_);
+}
+
+/**
+ * @brief Publishes the queue depth of each stage: the jobs in its rings and those still waiting for room.
+ * @param metrics Receives the gauges.
+ */
+void ClientPipeline::report(common::Metrics &metrics) const {
+  auto depth = [](const auto &stages) {
+    int64_t total = 0;
+    for (const auto &stage : stages) {
+      total += stage->depth.load(std::memory_order_relaxed);
+      for (const auto &lane : stage->pending) {
+        total += static_cast<int64_t>(lane.size());
+      }
+    }
+    return total;
+  };
+  metrics.set_gauge("pipeline_decode_queue_depth", depth(decoders_));
+  metrics.set_gauge("pipeline_route_queue_depth", routed_depth_.load(std::memory_order_relaxed));
+  metrics.set_gauge("pipeline_encode_queue_depth", depth(encoders_));
+}
+
+/**
+ * @brief Moves a stage's pending jobs into the rings of their lanes and wakes its thread. A full ring
+ * holds back only its own lane.
+ * @return True if every pending job fit.
+ */
+template <typename Job> bool ClientPipeline::flush_stage(Stage<Job> &stage) {
+  size_t flushed = 0;
+  bool all_fit = true;
+  for (size_t lane = 0; lane < stage.pending.size(); ++lane) {
+    auto &pending = stage.pending[lane];
+    auto &ring = *stage.queue.rings[lane];
+    while (!pending.empty()) {
+      Job batch[FLUSH_BATCH];
+      const size_t count = std::min(pending.size(), FLUSH_BATCH);
+      std::move(pending.begin(), pending.begin() + count, batch);
+      const size_t pushed = ring.push_batch(batch, count);
+      std::move(batch + pushed, batch + count, pending.begin() + pushed); // Not taken by a full ring
+      pending.erase(pending.begin(), pending.begin() + pushed);
+      stage.depth.fetch_add(static_cast<int64_t>(pushed), std::memory_order_relaxed);
+      flushed += pushed;
+      if (pushed < count) {
+        break;
+      }
+    }
+    all_fit = all_fit && pending.empty();
+  }
+  if (flushed > 0) {
+    stage.signal.notify();
+  }
+  return all_fit;
+}
+
+/**
+ * @brief Runs a stage thread: waits for its ring to become non-empty or for one of the sockets watch
+ * adds to become ready, hands each job to handler and calls finish once the ring is empty again.
+ */
+template <typename Job, typename Handler, typename Finish, typename Watch>
+void ClientPipeline::stage_loop(Stage<Job> &stage, int cpu, Handler &&handler, Finish &&finish, Watch &&watch) {
+  if (cpu >= 0 && common::pin_current_thread(cpu)) {
+    common::prefer_local_memory();
+  }
+  std::vector<pollfd> watched;
+  while (true) {
+    watched.assign(1, pollfd{stage.signal.get_fd(), POLLIN, 0});
+    watch(watched);
+    poll(watched.data(), watched.size(), STAGE_IDLE_POLL_MS);
+    stage.signal.drain(stage.queue, [&](Job &&job) {
+      handler(std::move(job));
+      stage.depth.fetch_sub(1, std::memory_order_relaxed);
+    });
+    finish();
+    if (stopping_.load() && stage.queue.empty()) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Reads what a connection has received and deserializes every complete message. Decode stage.
+ * @param connection The connection.
+ * @param routed Collects the messages, and the close if the peer closed, for emit().
+ */
+void ClientPipeline::decode(const std::shared_ptr<Connection> &connection, std::vector<Routed> &routed) {
+  if (connection->closed.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  auto &read_buffer = connection->read_buffer;
+  bool peer_closed = false;
+  while (true) {
+    const size_t current_size = read_buffer.size();
+    read_buffer.resize(current_size + READ_CHUNK);
+    auto result = connection->socket->raw_receive(read_buffer.data() + current_size, READ_CHUNK);
+    if (result.status == common::SocketStatus::OK) {
+      read_buffer.resize(current_size + result.bytes_transferred);
+      continue;
+    }
+    read_buffer.resize(current_size);
+    peer_closed = result.status != common::SocketStatus::WOULD_BLOCK;
+    break;
+  }
+
+  // Messages that arrived before the peer closed are still routed, ahead of the close.
+  while (true) {
+    auto [message, bytes_read] = common::deserialize_message(read_buffer);
+    if (!message) {
+      break;
+    }
+    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + bytes_read);
+    routed.push_back(Routed{connection, std::move(*message), false});
+  }
+  if (peer_closed) {
+    connection->closed.store(true);
+    routed.push_back(Routed{connection, common::Message(), true});
+  }
+  if (routed.size() >= FLUSH_BATCH) {
+    emit(routed);
+  }
+}
+
+/**
+ * @brief Hands decoded messages to the reactor in one batch, waiting for room while its ring is full.
+ * Decode stage.
+ * @param routed The messages; emptied.
+ */
+void ClientPipeline::emit(std::vector<Routed> &routed) {
+  size_t emitted = 0;
+  while (emitted < routed.size() && !stopping_.load(std::memory_order_relaxed)) {
+    const size_t pushed = routed_.push_batch(routed.data() + emitted, routed.size() - emitted);
+    routed_depth_.fetch_add(static_cast<int64_t>(pushed), std::memory_order_relaxed);
+    emitted += pushed;
+    if (pushed == 0) {
+      routed_signal_.notify(); // Make sure the reactor is draining
+      std::this_thread::yield();
+    }
+  }
+  if (emitted > 0) {
+    routed_signal_.notify();
+  }
+  routed.clear();
+}
+
+/**
+ * @brief Picks the encode lane of a reply: chat waits behind control and presence messages.
+ * @param type The reply's message type.
+ */
+ClientPipeline::Lane ClientPipeline::lane_of(common::MessageType type) {
+  return common::is_chat_message(type) ? CHAT_LANE : CONTROL_LANE;
+}
+
+/**
+ * @brief Serializes a reply unless it already is, and queues it on its connection in its lane. Replies
+ * to the same connection that follow each other in the ring go out in one write. Encode stage.
+ * @param job The reply.
+ * @param writing The connection replies are being queued for.
+ * @param waiting The connections waiting to be writable.
+ */
+void ClientPipeline::encode(EncodeJob &job, std::shared_ptr<Connection> &writing,
+                            std::vector<std::shared_ptr<Connection>> &waiting) {
+  if (writing != job.connection) {
+    write(writing, waiting);
+    writing = std::move(job.connection);
+  }
+  auto frame = job.frame.empty() ? common::serialize_message(job.message) : std::move(job.frame);
+  const Lane lane = lane_of(static_cast<common::MessageType>(frame[0]));
+  writing->queued_bytes += frame.size();
+  writing->queued[lane].push_back(std::move(frame));
+}
+
+/**
+ * @brief Writes the replies queued on a connection. A connection whose socket does not take them all
+ * waits for it to become writable. Encode stage.
+ * @param writing The connection; reset.
+ * @param waiting The connections waiting to be writable.
+ */
+void ClientPipeline::write(std::shared_ptr<Connection> &writing, std::vector<std::shared_ptr<Connection>> &waiting) {
+  if (writing && !writing->waiting && !write_unsent(*writing)) {
+    writing->waiting = true;
+    waiting.push_back(writing);
+  }
+  writing.reset();
+}
+
+/**
+ * @brief Writes as much of a connection's replies as its socket takes: the bytes already handed to it,
+ * then all queued control replies and up to PIPELINE_WRITE_CHUNK of chat at a time. A connection that
+ * lets too much pile up, or whose socket failed, loses its replies and is shut down; the decode stage
+ * then sees it closed. Encode stage.
+ * @return True if nothing is left to write.
+ */
+bool ClientPipeline::write_unsent(Connection &connection) {
+  auto &unsent = connection.unsent;
+  while (true) {
+    if (connection.unsent_offset == unsent.size()) {
+      unsent.clear();
+      connection.unsent_offset = 0;
+      for (size_t lane = CONTROL_LANE; lane < ENCODE_LANES; ++lane) {
+        auto &frames = connection.queued[lane];
+        while (!frames.empty() && (lane == CONTROL_LANE || unsent.size() < PIPELINE_WRITE_CHUNK)) {
+          unsent.insert(unsent.end(), frames.front().begin(), frames.front().end());
+          connection.queued_bytes -= frames.front().size();
+          frames.pop_front();
+        }
+      }
+      if (unsent.empty()) {
+        return true;
+      }
+    }
+
+    auto result = connection.socket->raw_send(unsent.data() + connection.unsent_offset,
+                                              unsent.size() - connection.unsent_offset);
+    if (result.status == common::SocketStatus::OK) {
+      connection.unsent_offset += result.bytes_transferred;
+      continue;
+    }
+    if (result.status == common::SocketStatus::WOULD_BLOCK &&
+        unsent.size() - connection.unsent_offset + connection.queued_bytes <= PIPELINE_MAX_UNSENT_BYTES) {
+      return false;
+    }
+    if (result.status == common::SocketStatus::WOULD_BLOCK) {
+      LOG_WARNING(CLIENT_PIPELINE_COMPONENT, "Client on FD {} left {} bytes unread, disconnecting", connection.fd,
+                  unsent.size() - connection.unsent_offset + connection.queued_bytes);
+      ::shutdown(connection.fd, SHUT_RDWR);
+    }
+    break;
+  }
+  unsent.clear();
+  connection.unsent_offset = 0;
+  for (auto &lane : connection.queued) {
+    lane.clear();
+  }
+  connection.queued_bytes = 0;
+  return true;
+}
+
+/**
+ * @brief Writes on for the connections waiting to be writable, and lets go of those that are done.
+ * Encode stage.
+ * @param waiting The connections waiting to be writable.
+ */
+void ClientPipeline::retry_waiting(std::vector<std::shared_ptr<Connection>> &waiting) {
+  auto done = std::remove_if(waiting.begin(), waiting.end(), [](const std::shared_ptr<Connection> &connection) {
+    if (!write_unsent(*connection)) {
+      return false;
+    }
+    connection->waiting = false;
+    return true;
+  });
+  waiting.erase(done, waiting.end());
+}
+
+} // namespace server
+} // namespace chat_app
@@ -9,7 +9,7 @@ namespace server {
  * @param socket A unique pointer to the socket used for communication.
  */
 ClientSession::ClientSession(uint32_t id, std::unique_ptr<common::IStreamSocket> socket)
-    : id_(id), socket_(std::move(socket)) {}
+    : id_(id), socket_(std::move(socket)), posix_socket_(dynamic_cast<common::PosixSocket *>(socket_.get())) {}
 
 } // namespace server
 } // namespace chat_app
\ No newline at end of file
@@ -87,7 +87,9 @@ bool EpollManager::remove_fd(int fd) {
 int EpollManager::wait(int timeout) {
   int num_events = epoll_wait(epoll_fd_, events_.data(), events_.size(), timeout);
   if (num_events == -1) {
-    LOG_ERROR(EPOLL_MANAGER_COMPONENT, "Epoll wait failed: {}", std::strerror(errno));
+    if (errno != EINTR) { // A signal, e.g. the one stopping a prefork worker
+      LOG_ERROR(EPOLL_MANAGER_COMPONENT, "Epoll wait failed: {}", std::strerror(errno));
+    }
     return -1;
   }
 
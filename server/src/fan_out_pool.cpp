@@ -0,0 +1,113 @@
+#include "server/fan_out_pool.h"
+#include "common/logger.h"
+#include <algorithm>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructs a FanOutPool. No threads run until start() is called.
+ * @param threads Number of helper threads, besides the thread calling run().
+ */
+FanOutPool::FanOutPool(size_t threads) : thread_count_(threads) {}
+
+/**
+ * @brief Destructor for FanOutPool. Stops the helpers.
+ */
+FanOutPool::~FanOutPool() { stop(); }
+
+/**
+ * @brief Starts the helper threads.
+ */
+void FanOutPool::start() {
+  for (size_t i = 0; i < thread_count_; ++i) {
+    helpers_.emplace_back([this]() { helper_loop(); });
+  }
+  LOG_INFO(FAN_OUT_POOL_COMPONENT, "Started {} broadcast fan-out helpers", thread_count_);
+}
+
+/**
+ * @brief Stops the helpers. Must not be called during run().
+ */
+void FanOutPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_posted_.notify_all();
+  for (auto &helper : helpers_) {
+    helper.join();
+  }
+  helpers_.clear();
+}
+
+/**
+ * @brief Runs task over [0, count) in chunks, on the helpers and the calling thread.
+ * @param count The size of the range.
+ * @param chunk The size of the chunks the range is handed out in.
+ * @param task Called with each chunk's bounds, from any of the threads.
+ */
+void FanOutPool::run(size_t count, size_t chunk, const Task &task) {
+  if (helpers_.empty() || count <= chunk) {
+    task(0, count);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    chunk_ = std::max<size_t>(chunk, 1);
+    next_.store(0, std::memory_order_relaxed);
+    ++generation_;
+  }
+  job_posted_.notify_all();
+  jobs_.fetch_add(1, std::memory_order_relaxed);
+
+  run_chunks();
+
+  // Helpers that joined the job may still be in their last chunk; late ones find it gone.
+  std::unique_lock<std::mutex> lock(mutex_);
+  helpers_done_.wait(lock, [this]() { return busy_helpers_ == 0; });
+  task_ = nullptr;
+}
+
+/**
+ * @brief Takes chunks of the current job until none are left.
+ */
+void FanOutPool::run_chunks() {
+  while (true) {
+    const size_t begin = next_.fetch_add(chunk_, std::memory_order_relaxed);
+    if (begin >= count_) {
+      return;
+    }
+    (*task_)(begin, std::min(begin + chunk_, count_));
+  }
+}
+
+/**
+ * @brief Helper thread: joins each job posted while it is still running.
+ */
+void FanOutPool::helper_loop() {
+  uint64_t seen_generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    job_posted_.wait(lock, [this, seen_generation]() { return stopping_ || generation_ != seen_generation; });
+    if (stopping_) {
+      return;
+    }
+    seen_generation = generation_;
+    if (!task_) {
+      continue; // Finished before this helper woke
+    }
+    ++busy_helpers_;
+    lock.unlock();
+    run_chunks();
+    lock.lock();
+    if (--busy_helpers_ == 0) {
+      helpers_done_.notify_one();
+    }
+  }
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,826 @@
+#include "server/federation.h"
+#include "common/compression.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// A peer that stops reading is dropped once this much output is queued for it.
+constexpr size_t MAX_PEER_PENDING_BYTES = 64 * 1024 * 1024;
+constexpr std::chrono::milliseconds MIN_REDIAL_BACKOFF(1000);
+constexpr std::chrono::milliseconds MAX_REDIAL_BACKOFF(30000);
+
+// Peers sent a presence digest per gossip round.
+constexpr size_t GOSSIP_FANOUT = 3;
+
+// First byte of an S2S_PEER_BATCH payload.
+constexpr char BATCH_RAW = '0';
+constexpr char BATCH_LZ = '1';
+
+} // namespace
+
+/**
+ * @brief Constructs a Federation for the given node.
+ * @param epoll_manager The reactor's epoll instance, used to watch the peer links.
+ * @param node_id This node's ID, unique within the cluster (1..MAX_NODE_ID).
+ * @param metrics Receives the cluster gauges and traffic counters.
+ * @param deliver Called for every event received from another node.
+ */
+Federation::Federation(EpollManager &epoll_manager, uint32_t node_id, common::Metrics &metrics,
+                       DeliverCallback deliver)
+    : epoll_manager_(epoll_manager), node_id_(node_id), metrics_(metrics), deliver_(std::move(deliver)),
+      presence_(node_id, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   std::chrono::system_clock::now().time_since_epoch())
+                                                   .count())),
+      random_(node_id) {
+  ring_.add_node(node_id_);
+}
+
+/**
+ * @brief Destructor for Federation. Closes all peer links.
+ */
+Federation::~Federation() { close(); }
+
+/**
+ * @brief Starts accepting peer links and dials the configured peers.
+ * @param port The cluster port, or 0 to only dial out.
+ * @param peer_addresses "host:port" of the other nodes' cluster ports, or "shm:<path>" of the shared memory
+ * paths of nodes on this host.
+ * @param relay_fanout Children per node in the broadcast relay tree, or 0 to send broadcasts to every peer.
+ * @param shm_path Unix domain socket path on which nodes of this host connect over shared memory, or empty for none.
+ * @return True on success, false otherwise.
+ */
+bool Federation::start(int port, const std::vector<std::string> &peer_addresses, size_t relay_fanout,
+                       const std::string &shm_path) {
+  relay_fanout_ = relay_fanout;
+  if (port > 0) {
+    auto listener = common::PosixSocket::create_listener();
+    if (!listener || !listener->bind_socket(port) || !listener->listen_socket(64)) {
+      LOG_ERROR(FEDERATION_COMPONENT, "Failed to listen for peers on port {}", port);
+      return false;
+    }
+    listeners_.push_back(std::move(listener));
+  }
+  if (!shm_path.empty()) {
+    auto listener = std::make_unique<common::ShmListener>(shm_path);
+    if (!listener->bind_socket(0) || !listener->listen_socket(64)) {
+      LOG_ERROR(FEDERATION_COMPONENT, "Failed to listen for peers on {}", shm_path);
+      return false;
+    }
+    listeners_.push_back(std::move(listener));
+    LOG_INFO(FEDERATION_COMPONENT, "Accepting shared memory peers on {}", shm_path);
+  }
+  for (auto &listener : listeners_) {
+    listener->set_non_blocking(true);
+    epoll_manager_.add_fd(listener->get_fd(), EPOLLIN | EPOLLET);
+  }
+
+  for (const auto &address : peer_addresses) {
+    dial_states_[address];
+  }
+  LOG_INFO(FEDERATION_COMPONENT, "Node {} accepting peers on port {}, {} peers configured", node_id_, port,
+           peer_addresses.size());
+  maintain();
+  return true;
+}
+
+/**
+ * @brief Closes all peer links and stops listening.
+ */
+void Federation::close() {
+  while (!links_.empty()) {
+    drop_link(links_.begin()->first);
+  }
+  for (auto &listener : listeners_) {
+    epoll_manager_.remove_fd(listener->get_fd());
+    listener->close_socket();
+  }
+  listeners_.clear();
+}
+
+/**
+ * @brief Checks whether a file descriptor belongs to the federation.
+ * @param fd The file descriptor.
+ * @return True if it is a cluster listener or a peer link.
+ */
+bool Federation::owns_fd(int fd) const { return find_listener(fd) != nullptr || links_.count(fd) > 0; }
+
+/**
+ * @brief Finds the listener with a file descriptor.
+ * @return The listener, or nullptr if the FD is not a listener's.
+ */
+common::IListeningSocket *Federation::find_listener(int fd) const {
+  for (const auto &listener : listeners_) {
+    if (listener->get_fd() == fd) {
+      return listener.get();
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Handles an epoll event on a cluster listener or a peer link.
+ * @param fd The file descriptor that became ready.
+ * @param events The epoll event mask.
+ */
+void Federation::handle_event(int fd, uint32_t events) {
+  if (auto *listener = find_listener(fd)) {
+    accept_links(*listener);
+    return;
+  }
+
+  auto it = links_.find(fd);
+  if (it == links_.end()) {
+    return;
+  }
+
+  Link &link = it->second;
+  if (link.connecting) {
+    bool connected;
+    if (link.handshake) {
+      const common::SocketStatus status = link.handshake->complete_handshake();
+      if (status == common::SocketStatus::WOULD_BLOCK) {
+        return;
+      }
+      connected = status == common::SocketStatus::OK;
+    } else {
+      if (!(events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+        return;
+      }
+      connected = common::PosixSocket::finish_connect(fd);
+    }
+    if (!connected) {
+      const std::string address = link.address;
+      drop_link(fd);
+      schedule_redial(address);
+      return;
+    }
+    link.connecting = false;
+    link.handshake = nullptr;
+    dial_states_[link.address].backoff = std::chrono::milliseconds(0);
+    send_hello(link);
+  }
+
+  bool open = !(events & (EPOLLHUP | EPOLLERR));
+  bool rejected = false;
+  if (open && (events & EPOLLIN) && congested_) {
+    unread_links_.insert(fd); // Read once the output drained
+  } else if (open && (events & EPOLLIN)) {
+    open = link.connection->receive([this, fd, &link, &rejected](const common::Message &message) {
+      if (rejected) {
+        return;
+      }
+      if (message.header.type == common::MessageType::S2S_PEER_HELLO) {
+        handle_hello(fd, message);
+        rejected = link.node_id == 0 || link_by_node_.count(link.node_id) == 0 ||
+                   link_by_node_.at(link.node_id) != fd;
+      } else if (message.header.type == common::MessageType::S2S_PEER_BATCH) {
+        handle_batch(link, message);
+      }
+    });
+  }
+  if (open && !rejected && (events & EPOLLOUT)) {
+    open = link.connection->flush();
+  }
+
+  if (!open || rejected) {
+    drop_link(fd);
+  }
+}
+
+/**
+ * @brief Shares a local event with the cluster. Broadcasts are queued for every linked peer and
+ * sent with the next flush(). Joins and leaves update the local presence, which spreads by gossip,
+ * and the users' directory entries.
+ * @param message The event.
+ */
+void Federation::forward(const common::Message &message) {
+  switch (message.header.type) {
+  case common::MessageType::S2C_USER_JOINED:
+    presence_.local_join(message.header.sender_id, message.payload);
+    presence_changed_ = true;
+    publish_location(message.header.sender_id, node_id_);
+    break;
+  case common::MessageType::S2C_USER_LEFT:
+    presence_.local_leave(message.header.sender_id);
+    presence_changed_ = true;
+    publish_location(message.header.sender_id, 0);
+    break;
+  case common::MessageType::S2C_BROADCAST:
+    if (relay_fanout_ > 0) {
+      const auto bytes = common::serialize_message(message);
+      relay(common::Message(common::MessageType::S2S_RELAY_BROADCAST, node_id_, ++relay_sequence_,
+                            std::string(bytes.begin(), bytes.end())));
+      break;
+    }
+    [[fallthrough]];
+  default:
+    for (const auto &[node_id, fd] : link_by_node_) {
+      queue(links_.at(fd), message);
+    }
+    break;
+  }
+}
+
+/**
+ * @brief Sends a private message to the node its recipient is connected to. If that node is not
+ * known yet, the message waits for the answer of the recipient's home node. A recipient that
+ * turns out to be offline is reported to the sender with an S2C_ERROR.
+ * @param message The S2C_PRIVATE event, for a recipient that is not connected to this node.
+ */
+void Federation::route_private(const common::Message &message) {
+  const uint32_t user_id = message.header.receiver_id;
+  auto waiting = unresolved_.find(user_id);
+  if (waiting != unresolved_.end()) {
+    waiting->second.push_back(message); // Behind the earlier messages to the same recipient
+    return;
+  }
+
+  if (auto node_id = directory_.find_cached(user_id)) {
+    if (queue_to_node(*node_id, message)) {
+      return;
+    }
+    directory_.forget(user_id);
+  }
+
+  const uint32_t home = ring_.node_for(user_id);
+  if (home == node_id_) {
+    unresolved_[user_id].push_back(message);
+    resolve(user_id, directory_.find_home(user_id).value_or(0));
+    return;
+  }
+
+  metrics_.increment_counter("directory_lookups");
+  unresolved_[user_id].push_back(message);
+  queue_to_node(home, common::Message(common::MessageType::S2S_DIRECTORY_LOOKUP, user_id, 0, ""));
+}
+
+/**
+ * @brief Sends the events queued since the last call, one batch per peer. Called once per reactor loop iteration.
+ * Input left unread while congested is read first if the output has drained.
+ */
+void Federation::flush() {
+  update_congestion();
+  // Local presence changes start a gossip round right away rather than at the next maintain().
+  if (presence_changed_) {
+    gossip();
+    presence_changed_ = false;
+  }
+
+  std::vector<int> stalled;
+  for (auto &[fd, link] : links_) {
+    if (link.pending.empty()) {
+      continue;
+    }
+
+    std::string payload(1, BATCH_RAW);
+    if (link.pending.size() >= FEDERATION_COMPRESS_MIN_BYTES) {
+      auto compressed = common::lz_compress(link.pending.data(), link.pending.size());
+      if (compressed.size() < link.pending.size()) {
+        payload[0] = BATCH_LZ;
+        payload.append(compressed.begin(), compressed.end());
+      }
+    }
+    if (payload[0] == BATCH_RAW) {
+      payload.append(link.pending.begin(), link.pending.end());
+    }
+
+    metrics_.increment_counter("federation_bytes_raw", link.pending.size());
+    metrics_.increment_counter("federation_bytes_sent", payload.size());
+    link.pending.clear();
+
+    common::Message batch(common::MessageType::S2S_PEER_BATCH, common::SERVER_ID, link.node_id, payload);
+    if (!link.connection->send_message(batch) || link.connection->pending_bytes() > MAX_PEER_PENDING_BYTES) {
+      stalled.push_back(fd);
+    }
+  }
+
+  for (int fd : stalled) {
+    LOG_WARNING(FEDERATION_COMPONENT, "Dropping peer link on FD {}: peer is not keeping up", fd);
+    drop_link(fd);
+  }
+}
+
+/**
+ * @brief Pauses reading from the peers when the output to one of them passed the high-water mark,
+ * and resumes, reading what was left unread, once all are below the low-water mark.
+ */
+void Federation::update_congestion() {
+  size_t most_queued = 0;
+  for (const auto &[fd, link] : links_) {
+    most_queued = std::max(most_queued, link.connection->pending_bytes());
+  }
+  if (!congested_ && most_queued > FEDERATION_HIGH_WATER_BYTES) {
+    congested_ = true;
+    metrics_.increment_counter("federation_congestion_events");
+    LOG_WARNING(FEDERATION_COMPONENT, "Peer output backed up ({} bytes), pausing input", most_queued);
+  } else if (congested_ && most_queued < FEDERATION_LOW_WATER_BYTES) {
+    congested_ = false;
+    LOG_INFO(FEDERATION_COMPONENT, "Peer output drained, resuming input");
+    auto unread = std::move(unread_links_);
+    unread_links_.clear();
+    for (int fd : unread) {
+      handle_event(fd, EPOLLIN);
+    }
+  }
+  metrics_.set_gauge("federation_congested", congested_ ? 1 : 0);
+}
+
+/**
+ * @brief Periodic upkeep: redials configured peers that are not linked, with exponential backoff,
+ * runs a round of presence gossip and publishes the cluster gauges.
+ */
+void Federation::maintain() {
+  const auto now = std::chrono::steady_clock::now();
+  for (auto &[address, state] : dial_states_) {
+    const bool dialed = std::any_of(links_.begin(), links_.end(), [&address = address](const auto &entry) {
+      return entry.second.outbound && entry.second.address == address;
+    });
+    const bool linked = state.node_id != 0 && link_by_node_.count(state.node_id) > 0;
+    if (dialed || linked || now < state.next_attempt) {
+      continue;
+    }
+    dial(address);
+  }
+  gossip();
+
+  metrics_.set_gauge("cluster_peers", static_cast<int64_t>(link_by_node_.size()));
+  metrics_.set_gauge("cluster_remote_users", static_cast<int64_t>(remote_users_.size()));
+  metrics_.set_gauge("directory_home_entries", static_cast<int64_t>(directory_.home_count()));
+  metrics_.set_gauge("directory_cached_entries", static_cast<int64_t>(directory_.cache_size()));
+}
+
+/**
+ * @brief Checks whether a username is online on another node.
+ * @param username The username.
+ * @return True if a remote user has this name.
+ */
+bool Federation::is_username_online(const std::string &username) const {
+  return remote_usernames_.count(username) > 0;
+}
+
+/**
+ * @brief Accepts all pending peer links of a listener.
+ */
+void Federation::accept_links(common::IListeningSocket &listener) {
+  while (auto socket = listener.accept_connection()) {
+    add_link(std::move(socket), false, "");
+  }
+}
+
+/**
+ * @brief Dials a configured peer. The connect or shared memory handshake finishes in handle_event(), so a
+ * peer that is down or firewalled does not hold up the reactor.
+ * @param address "host:port" of the peer's cluster port, or "shm:<path>" of its shared memory path.
+ */
+void Federation::dial(const std::string &address) {
+  std::unique_ptr<common::IStreamSocket> socket;
+  common::ShmSocket *handshake = nullptr;
+  if (address.rfind(common::SHM_ADDRESS_PREFIX, 0) == 0) {
+    auto shm_socket = common::ShmSocket::connect_async(address.substr(sizeof(common::SHM_ADDRESS_PREFIX) - 1));
+    handshake = shm_socket.get();
+    socket = std::move(shm_socket);
+  } else {
+    size_t colon = address.rfind(':');
+    int port = colon == std::string::npos ? 0 : std::atoi(address.c_str() + colon + 1);
+    socket = port > 0 ? common::PosixSocket::create_async_connector(address.substr(0, colon), port) : nullptr;
+  }
+  if (!socket) {
+    schedule_redial(address);
+    return;
+  }
+  add_link(std::move(socket), true, address).handshake = handshake;
+}
+
+/**
+ * @brief Backs off before the next attempt to dial a peer whose dial failed.
+ * @param address The peer's address.
+ */
+void Federation::schedule_redial(const std::string &address) {
+  DialState &state = dial_states_[address];
+  state.backoff = std::clamp(state.backoff * 2, MIN_REDIAL_BACKOFF, MAX_REDIAL_BACKOFF);
+  state.next_attempt = std::chrono::steady_clock::now() + state.backoff;
+  LOG_DEBUG(FEDERATION_COMPONENT, "Peer {} unreachable, retrying in {} ms", address, state.backoff.count());
+}
+
+/**
+ * @brief Registers a new peer link with epoll. Inbound links are introduced right away, outbound ones
+ * once their connect has finished.
+ * @param socket The socket; connecting, for outbound links.
+ * @param outbound True if this node dialed the link.
+ * @param address The dialed address, for outbound links.
+ * @return The new link.
+ */
+Federation::Link &Federation::add_link(std::unique_ptr<common::IStreamSocket> socket, bool outbound,
+                                       const std::string &address) {
+  auto connection = std::make_unique<PeerConnection>(std::move(socket));
+  const int fd = connection->get_fd();
+  epoll_manager_.add_fd(fd, EPOLLIN | EPOLLOUT | EPOLLET);
+
+  Link &link = links_[fd];
+  link.connection = std::move(connection);
+  link.outbound = outbound;
+  link.address = address;
+  link.connecting = outbound;
+  if (!outbound) {
+    send_hello(link);
+  }
+  LOG_DEBUG(FEDERATION_COMPONENT, "Peer link on FD {} opened ({})", fd, outbound ? address : "inbound");
+  return link;
+}
+
+/**
+ * @brief Introduces this node on a connected peer link.
+ */
+void Federation::send_hello(Link &link) {
+  link.connection->send_message(common::Message(common::MessageType::S2S_PEER_HELLO, common::SERVER_ID,
+                                                common::SERVER_ID, std::to_string(node_id_)));
+}
+
+/**
+ * @brief Handles a peer's introduction. Decides which link to keep when two nodes dialed each other.
+ * @param fd The link the hello arrived on.
+ * @param message The hello, carrying the peer's node ID.
+ */
+void Federation::handle_hello(int fd, const common::Message &message) {
+  Link &link = links_.at(fd);
+  const uint32_t peer_id = static_cast<uint32_t>(std::strtoul(message.payload.c_str(), nullptr, 10));
+  if (peer_id == 0 || peer_id == node_id_ || link.node_id != 0) {
+    LOG_WARNING(FEDERATION_COMPONENT, "Rejecting peer link on FD {} with node ID '{}'", fd, message.payload);
+    return;
+  }
+
+  link.node_id = peer_id;
+  if (link.outbound) {
+    dial_states_[link.address].node_id = peer_id;
+  }
+
+  auto existing = link_by_node_.find(peer_id);
+  if (existing != link_by_node_.end()) {
+    // Both nodes must pick the same link: the one dialed by the lower node ID. If both were
+    // dialed by the same node, the older one is a leftover of a restart and the new one wins.
+    const Link &other = links_.at(existing->second);
+    const uint32_t dialer = link.outbound ? node_id_ : peer_id;
+    const uint32_t other_dialer = other.outbound ? node_id_ : peer_id;
+    if (dialer != other_dialer && dialer != std::min(node_id_, peer_id)) {
+      return; // Keep the existing link; the caller closes this one
+    }
+    const int old_fd = existing->second;
+    existing->second = fd;
+    drop_link(old_fd);
+  } else {
+    link_by_node_[peer_id] = fd;
+    LOG_INFO(FEDERATION_COMPONENT, "Linked to node {} on FD {}", peer_id, fd);
+    change_membership(peer_id, true);
+  }
+
+  // Both sides send a digest, so each learns everything the other knows.
+  queue(link, presence_.make_digest(false));
+}
+
+/**
+ * @brief Unpacks a batch of events from a peer.
+ * @param link The link the batch arrived on.
+ * @param message The batch.
+ */
+void Federation::handle_batch(Link &link, const common::Message &message) {
+  if (link.node_id == 0 || message.payload.empty()) {
+    return;
+  }
+
+  const std::string &payload = message.payload;
+  std::vector<char> decompressed;
+  const char *data = payload.data() + 1;
+  size_t size = payload.size() - 1;
+  if (payload[0] == BATCH_LZ) {
+    if (!common::lz_decompress(data, size, decompressed)) {
+      LOG_ERROR(FEDERATION_COMPONENT, "Corrupt batch from node {}", link.node_id);
+      return;
+    }
+    data = decompressed.data();
+    size = decompressed.size();
+  }
+
+  size_t offset = 0;
+  while (offset < size) {
+    auto [event, consumed] = common::deserialize_message(data + offset, size - offset);
+    if (!event) {
+      break;
+    }
+    offset += consumed;
+    handle_remote_event(link.node_id, *event);
+  }
+}
+
+/**
+ * @brief Handles one event from another node: hands chat events to the local clients and
+ * processes gossip and directory traffic.
+ * @param node_id The node the event came from.
+ * @param event The event.
+ */
+void Federation::handle_remote_event(uint32_t node_id, const common::Message &event) {
+  switch (event.header.type) {
+  case common::MessageType::S2S_PRESENCE_DIGEST: {
+    bool peer_is_ahead = false;
+    auto deltas = presence_.answer_digest(event, peer_is_ahead);
+    for (const auto &delta : deltas) {
+      queue_to_node(node_id, delta);
+    }
+    if (peer_is_ahead) {
+      queue_to_node(node_id, presence_.make_digest(true));
+    }
+    metrics_.increment_counter("presence_deltas_sent", deltas.size());
+    return;
+  }
+  case common::MessageType::S2S_PRESENCE_DELTA:
+    // Presence of nodes this node is not linked to is stale: they left or are partitioned away.
+    if (link_by_node_.count(event.header.sender_id) > 0) {
+      apply_presence(event.header.sender_id, presence_.apply_delta(event));
+    }
+    return;
+  case common::MessageType::S2S_RELAY_BROADCAST: {
+    uint32_t &last = relay_received_[event.header.sender_id];
+    if (event.header.receiver_id <= last) {
+      return; // Duplicate or stale copy
+    }
+    last = event.header.receiver_id;
+    relay(event);
+    auto [broadcast, consumed] = common::deserialize_message(event.payload.data(), event.payload.size());
+    if (broadcast && broadcast->header.type == common::MessageType::S2C_BROADCAST) {
+      deliver_(*broadcast);
+    }
+    return;
+  }
+  case common::MessageType::S2C_BROADCAST:
+  case common::MessageType::S2C_PRIVATE:
+    break;
+  case common::MessageType::S2S_DIRECTORY_UPDATE:
+  case common::MessageType::S2S_DIRECTORY_LOOKUP:
+  case common::MessageType::S2S_DIRECTORY_REPLY:
+    handle_directory_event(node_id, event);
+    return;
+  default:
+    LOG_WARNING(FEDERATION_COMPONENT, "Unexpected event type {} from node {}", static_cast<int>(event.header.type),
+                node_id);
+    return;
+  }
+  deliver_(event);
+}
+
+/**
+ * @brief Applies a directory update, answers a lookup, or releases the messages waiting for a lookup.
+ * @param node_id The node the event came from (this node for its own updates).
+ * @param event The directory event.
+ */
+void Federation::handle_directory_event(uint32_t node_id, const common::Message &event) {
+  const uint32_t user_id = event.header.sender_id;
+  switch (event.header.type) {
+  case common::MessageType::S2S_DIRECTORY_UPDATE:
+    if (event.header.receiver_id != 0) {
+      directory_.set_home(user_id, event.header.receiver_id);
+    } else {
+      directory_.remove_home(user_id, node_id);
+    }
+    break;
+  case common::MessageType::S2S_DIRECTORY_LOOKUP:
+    queue_to_node(node_id, common::Message(common::MessageType::S2S_DIRECTORY_REPLY, user_id,
+                                           directory_.find_home(user_id).value_or(0), ""));
+    break;
+  case common::MessageType::S2S_DIRECTORY_REPLY:
+    resolve(user_id, event.header.receiver_id);
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Sends a presence digest to a few random peers.
+ */
+void Federation::gossip() {
+  std::vector<uint32_t> peers;
+  for (const auto &[node_id, fd] : link_by_node_) {
+    peers.push_back(node_id);
+  }
+  std::vector<uint32_t> targets;
+  std::sample(peers.begin(), peers.end(), std::back_inserter(targets), GOSSIP_FANOUT, random_);
+
+  const common::Message digest = presence_.make_digest(false);
+  for (uint32_t node_id : targets) {
+    queue_to_node(node_id, digest);
+  }
+  metrics_.increment_counter("presence_digests_sent", targets.size());
+}
+
+/**
+ * @brief Passes a relayed broadcast on to this node's children in its origin's tree.
+ * @param envelope The S2S_RELAY_BROADCAST.
+ */
+void Federation::relay(const common::Message &envelope) {
+  for (uint32_t child : relay_children(envelope.header.sender_id)) {
+    if (queue_to_node(child, envelope)) {
+      metrics_.increment_counter("relay_copies_sent");
+    }
+  }
+}
+
+/**
+ * @brief Computes this node's children in the relay tree of an origin. The nodes (linked peers,
+ * this node and the origin) are numbered in ring order from the origin; node i has children
+ * i*k+1 .. i*k+k.
+ * @param origin The origin node ID.
+ * @return The children's node IDs.
+ */
+std::vector<uint32_t> Federation::relay_children(uint32_t origin) const {
+  std::vector<uint32_t> members{node_id_};
+  for (const auto &[node_id, fd] : link_by_node_) {
+    members.push_back(node_id);
+  }
+  if (std::find(members.begin(), members.end(), origin) == members.end()) {
+    members.push_back(origin);
+  }
+  std::sort(members.begin(), members.end());
+
+  const size_t count = members.size();
+  const size_t root = static_cast<size_t>(std::find(members.begin(), members.end(), origin) - members.begin());
+  const size_t self = static_cast<size_t>(std::find(members.begin(), members.end(), node_id_) - members.begin());
+  const size_t position = (self + count - root) % count;
+
+  std::vector<uint32_t> children;
+  for (size_t child = position * relay_fanout_ + 1; child <= position * relay_fanout_ + relay_fanout_ && child < count;
+       ++child) {
+    children.push_back(members[(root + child) % count]);
+  }
+  return children;
+}
+
+/**
+ * @brief Updates the remote user table with presence changes of another node and hands them to the local clients.
+ * @param node_id The node whose users changed.
+ * @param events S2C_USER_JOINED and S2C_USER_LEFT events.
+ */
+void Federation::apply_presence(uint32_t node_id, const std::vector<common::Message> &events) {
+  auto forget_name = [this](const std::string &username) {
+    auto it = remote_usernames_.find(username);
+    if (it != remote_usernames_.end() && --it->second == 0) {
+      remote_usernames_.erase(it);
+    }
+  };
+  for (const auto &event : events) {
+    auto existing = remote_users_.find(event.header.sender_id);
+    if (existing != remote_users_.end()) {
+      forget_name(existing->second.username);
+    }
+    if (event.header.type == common::MessageType::S2C_USER_JOINED) {
+      remote_users_[event.header.sender_id] = RemoteUser{node_id, event.payload};
+      ++remote_usernames_[event.payload];
+    } else {
+      if (existing != remote_users_.end()) {
+        remote_users_.erase(existing);
+      }
+      directory_.forget(event.header.sender_id);
+    }
+    deliver_(event);
+  }
+}
+
+/**
+ * @brief Appends an event to a link's next batch.
+ */
+void Federation::queue(Link &link, const common::Message &message) {
+  auto bytes = common::serialize_message(message);
+  link.pending.insert(link.pending.end(), bytes.begin(), bytes.end());
+}
+
+/**
+ * @brief Appends an event to the next batch for a node.
+ * @return True if the node is linked, false otherwise.
+ */
+bool Federation::queue_to_node(uint32_t node_id, const common::Message &message) {
+  auto it = link_by_node_.find(node_id);
+  if (it == link_by_node_.end()) {
+    return false;
+  }
+  queue(links_.at(it->second), message);
+  return true;
+}
+
+/**
+ * @brief Registers where a local user is connected at the user's home node.
+ * @param user_id The user ID.
+ * @param node_id This node's ID, or 0 when the user left.
+ */
+void Federation::publish_location(uint32_t user_id, uint32_t node_id) {
+  const common::Message update(common::MessageType::S2S_DIRECTORY_UPDATE, user_id, node_id, "");
+  const uint32_t home = ring_.node_for(user_id);
+  if (home == node_id_) {
+    handle_directory_event(node_id_, update);
+  } else {
+    queue_to_node(home, update);
+  }
+}
+
+/**
+ * @brief Sends the private messages waiting for a recipient's location, in the order they were routed.
+ * @param user_id The recipient.
+ * @param node_id The node the recipient is connected to, or 0 if the recipient is offline.
+ */
+void Federation::resolve(uint32_t user_id, uint32_t node_id) {
+  auto waiting = unresolved_.find(user_id);
+  if (waiting == unresolved_.end()) {
+    return;
+  }
+  std::vector<common::Message> messages = std::move(waiting->second);
+  unresolved_.erase(waiting);
+
+  if (node_id != 0 && node_id != node_id_) {
+    directory_.cache(user_id, node_id);
+  }
+  for (const auto &message : messages) {
+    if (node_id == node_id_) {
+      deliver_(message); // The recipient connected here while the lookup was in flight
+    } else if (node_id == 0 || !queue_to_node(node_id, message)) {
+      metrics_.increment_counter("federation_undeliverable");
+      deliver_(common::Message(common::MessageType::S2C_ERROR, common::SERVER_ID, message.header.sender_id,
+                               "Receiver not found or not connected."));
+    }
+  }
+}
+
+/**
+ * @brief Updates the ring when a node joins or leaves the cluster. Only the users whose home node
+ * changed are affected: this node registers its own such users at their new home and drops the
+ * entries it no longer owns, which their nodes register at the new home in turn.
+ * @param node_id The node ID.
+ * @param joined True if the node joined, false if it left.
+ */
+void Federation::change_membership(uint32_t node_id, bool joined) {
+  const HashRing previous = ring_;
+  if (joined) {
+    ring_.add_node(node_id);
+  } else {
+    ring_.remove_node(node_id);
+    directory_.forget_node(node_id);
+  }
+
+  size_t moved = 0;
+  for (const auto &[user_id, username] : presence_.users_of(node_id_)) {
+    if (previous.node_for(user_id) != ring_.node_for(user_id)) {
+      publish_location(user_id, node_id_);
+      ++moved;
+    }
+  }
+  directory_.drop_homes_if([this](uint32_t user_id) { return ring_.node_for(user_id) != node_id_; });
+  LOG_INFO(FEDERATION_COMPONENT, "Node {} {} the ring, {} local users moved home", node_id, joined ? "joined" : "left",
+           moved);
+
+  if (!joined) {
+    // Lookups sent to the lost node will not be answered: ask the recipients' new home nodes.
+    std::vector<common::Message> orphaned;
+    for (auto it = unresolved_.begin(); it != unresolved_.end();) {
+      if (previous.node_for(it->first) == node_id) {
+        orphaned.insert(orphaned.end(), it->second.begin(), it->second.end());
+        it = unresolved_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (const auto &message : orphaned) {
+      route_private(message);
+    }
+  }
+}
+
+/**
+ * @brief Closes a peer link. If it was the node's active link, the node's users are reported as gone.
+ * @param fd The link's file descriptor.
+ */
+void Federation::drop_link(int fd) {
+  auto it = links_.find(fd);
+  if (it == links_.end()) {
+    return;
+  }
+
+  const uint32_t peer_id = it->second.node_id;
+  epoll_manager_.remove_fd(fd);
+  links_.erase(it);
+  unread_links_.erase(fd);
+
+  auto active = link_by_node_.find(peer_id);
+  if (peer_id == 0 || active == link_by_node_.end() || active->second != fd) {
+    return;
+  }
+  link_by_node_.erase(active);
+  LOG_WARNING(FEDERATION_COMPONENT, "Lost link to node {}", peer_id);
+  change_membership(peer_id, false);
+  apply_presence(peer_id, presence_.drop_node(peer_id));
+  relay_received_.erase(peer_id); // A restarted node numbers its broadcasts from 1 again
+}
+
+} // namespace server
+} // namespace chat_app
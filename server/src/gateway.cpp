@@ -0,0 +1,559 @@
+#include "server/gateway.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <unordered_set>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+constexpr std::chrono::milliseconds MIN_REDIAL_BACKOFF(1000);
+constexpr std::chrono::milliseconds MAX_REDIAL_BACKOFF(30000);
+
+/**
+ * @brief The socket of a session relayed by a gateway. Sending wraps the bytes into an
+ * S2S_GATEWAY_DELIVER for the session's channel; there is nothing to receive, as the session's
+ * messages arrive through the gateway link.
+ */
+class RelayedSocket : public common::IStreamSocket {
+public:
+  RelayedSocket(PeerConnection *link, uint32_t channel, int virtual_fd)
+      : link_(link), channel_(channel), virtual_fd_(virtual_fd) {}
+
+  common::SocketResult send_data(const std::vector<char> &data) override {
+    if (!link_) {
+      return {common::SocketStatus::CLOSED, 0};
+    }
+    link_->queue_message(common::Message(common::MessageType::S2S_GATEWAY_DELIVER, common::SERVER_ID, channel_,
+                                         std::string(data.begin(), data.end())));
+    return {common::SocketStatus::OK, data.size()};
+  }
+  common::SocketResult raw_send(const char *data, size_t len) override {
+    return send_data(std::vector<char>(data, data + len));
+  }
+  common::SocketResult receive_data(std::vector<char> &) override { return {common::SocketStatus::WOULD_BLOCK, 0}; }
+  common::SocketResult raw_receive(char *, size_t) override { return {common::SocketStatus::WOULD_BLOCK, 0}; }
+  void close_socket() override { link_ = nullptr; }
+  bool is_valid() const override { return link_ != nullptr; }
+  int get_fd() const override { return virtual_fd_; }
+  void set_non_blocking(bool) override {}
+
+private:
+  PeerConnection *link_;
+  uint32_t channel_;
+  int virtual_fd_;
+};
+
+} // namespace
+
+/**
+ * @brief Constructs a GatewayHub.
+ * @param epoll_manager The reactor's epoll instance, used to watch the gateway links.
+ * @param metrics Receives the gateway gauges.
+ * @param on_open Registers a new relayed session.
+ * @param on_message Handles a message of a relayed session.
+ * @param on_close Disconnects a relayed session.
+ */
+GatewayHub::GatewayHub(EpollManager &epoll_manager, common::Metrics &metrics, OpenCallback on_open,
+                       MessageCallback on_message, CloseCallback on_close)
+    : epoll_manager_(epoll_manager), metrics_(metrics), on_open_(std::move(on_open)),
+      on_message_(std::move(on_message)), on_close_(std::move(on_close)) {}
+
+/**
+ * @brief Destructor for GatewayHub. Disconnects all relayed sessions and closes the links.
+ */
+GatewayHub::~GatewayHub() { close(); }
+
+/**
+ * @brief Starts accepting gateway links.
+ * @param port The TCP port gateways connect to, or 0 for none.
+ * @param shm_path Unix domain socket path on which gateways of this host connect over shared memory, or empty for none.
+ * @return True on success, false otherwise.
+ */
+bool GatewayHub::start(int port, const std::string &shm_path) {
+  if (port > 0) {
+    auto listener = common::PosixSocket::create_listener();
+    if (!listener || !listener->bind_socket(port) || !listener->listen_socket(64)) {
+      LOG_ERROR(GATEWAY_COMPONENT, "Failed to listen for gateways on port {}", port);
+      return false;
+    }
+    listeners_.push_back(std::move(listener));
+    LOG_INFO(GATEWAY_COMPONENT, "Accepting gateways on port {}", port);
+  }
+  if (!shm_path.empty()) {
+    auto listener = std::make_unique<common::ShmListener>(shm_path);
+    if (!listener->bind_socket(0) || !listener->listen_socket(64)) {
+      LOG_ERROR(GATEWAY_COMPONENT, "Failed to listen for gateways on {}", shm_path);
+      return false;
+    }
+    listeners_.push_back(std::move(listener));
+    LOG_INFO(GATEWAY_COMPONENT, "Accepting shared memory gateways on {}", shm_path);
+  }
+  for (auto &listener : listeners_) {
+    listener->set_non_blocking(true);
+    epoll_manager_.add_fd(listener->get_fd(), EPOLLIN | EPOLLET);
+  }
+  return true;
+}
+
+/**
+ * @brief Closes all gateway links and stops listening.
+ */
+void GatewayHub::close() {
+  while (!gateways_.empty()) {
+    drop_gateway(gateways_.begin()->first);
+  }
+  for (auto &listener : listeners_) {
+    epoll_manager_.remove_fd(listener->get_fd());
+    listener->close_socket();
+  }
+  listeners_.clear();
+}
+
+/**
+ * @brief Checks whether a file descriptor belongs to the hub.
+ * @param fd The file descriptor.
+ * @return True if it is the gateway listener or a gateway link.
+ */
+bool GatewayHub::owns_fd(int fd) const { return find_listener(fd) != nullptr || gateways_.count(fd) > 0; }
+
+/**
+ * @brief Finds the listener with a file descriptor.
+ * @return The listener, or nullptr if the FD is not a listener's.
+ */
+common::IListeningSocket *GatewayHub::find_listener(int fd) const {
+  for (const auto &listener : listeners_) {
+    if (listener->get_fd() == fd) {
+      return listener.get();
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Handles an epoll event on the gateway listener or a gateway link.
+ * @param fd The file descriptor that became ready.
+ * @param events The epoll event mask.
+ */
+void GatewayHub::handle_event(int fd, uint32_t events) {
+  if (auto *listener = find_listener(fd)) {
+    while (auto socket = listener->accept_connection()) {
+      auto connection = std::make_unique<PeerConnection>(std::move(socket));
+      const int link_fd = connection->get_fd();
+      epoll_manager_.add_fd(link_fd, EPOLLIN | EPOLLOUT | EPOLLET);
+      gateways_[link_fd].connection = std::move(connection);
+      LOG_INFO(GATEWAY_COMPONENT, "Gateway connected on FD {}", link_fd);
+    }
+    metrics_.set_gauge("gateways", static_cast<int64_t>(gateways_.size()));
+    return;
+  }
+
+  auto it = gateways_.find(fd);
+  if (it == gateways_.end()) {
+    return;
+  }
+  Gateway &gateway = it->second;
+  bool open = !(events & (EPOLLHUP | EPOLLERR));
+  if (open && (events & EPOLLIN)) {
+    open = gateway.connection->receive(
+        [this, &gateway](const common::Message &envelope) { handle_envelope(gateway, envelope); });
+  }
+  if (open && (events & EPOLLOUT)) {
+    open = gateway.connection->flush();
+  }
+  if (!open) {
+    drop_gateway(fd);
+  }
+}
+
+/**
+ * @brief Queues one copy of a broadcast for every gateway, which delivers it to its clients.
+ * @param message The message.
+ * @param exclude_sender_id The ID of the client that should not receive the message.
+ */
+void GatewayHub::broadcast(const common::Message &message, uint32_t exclude_sender_id) {
+  if (gateways_.empty()) {
+    return;
+  }
+  const auto bytes = common::serialize_message(message);
+  const common::Message envelope(common::MessageType::S2S_GATEWAY_DELIVER, exclude_sender_id, common::BROADCAST_ID,
+                                 std::string(bytes.begin(), bytes.end()));
+  std::unordered_set<std::string> reached;
+  for (auto &[fd, gateway] : gateways_) {
+    if (!gateway.instance.empty() && reached.insert(gateway.instance).second) {
+      gateway.connection->queue_message(envelope);
+    }
+  }
+}
+
+/**
+ * @brief Writes the output queued for the gateways. Called once per reactor loop iteration.
+ */
+void GatewayHub::flush() {
+  std::vector<int> closed;
+  for (auto &[fd, gateway] : gateways_) {
+    if (gateway.connection->has_pending_writes() && !gateway.connection->flush()) {
+      closed.push_back(fd);
+    }
+  }
+  for (int fd : closed) {
+    drop_gateway(fd);
+  }
+}
+
+/**
+ * @brief Handles one envelope from a gateway: its hello, the start of one of its sessions, a client message of one,
+ * or the end of one.
+ * @param gateway The gateway the envelope came from.
+ * @param envelope The S2S_GATEWAY_HELLO, S2S_GATEWAY_OPEN, S2S_GATEWAY_CLIENT or S2S_GATEWAY_CLOSE.
+ */
+void GatewayHub::handle_envelope(Gateway &gateway, const common::Message &envelope) {
+  if (envelope.header.type == common::MessageType::S2S_GATEWAY_HELLO) {
+    gateway.instance = envelope.payload;
+    return;
+  }
+  const uint32_t channel = envelope.header.sender_id;
+  auto session = gateway.session_fds.find(channel);
+
+  if (envelope.header.type == common::MessageType::S2S_GATEWAY_OPEN) {
+    if (session == gateway.session_fds.end()) {
+      open_session(gateway, channel, envelope.payload);
+    }
+    return;
+  }
+  if (envelope.header.type == common::MessageType::S2S_GATEWAY_CLOSE) {
+    if (session != gateway.session_fds.end()) {
+      const int virtual_fd = session->second;
+      gateway.session_fds.erase(session);
+      on_close_(virtual_fd);
+    }
+    return;
+  }
+  if (envelope.header.type != common::MessageType::S2S_GATEWAY_CLIENT) {
+    return;
+  }
+
+  auto [message, consumed] = common::deserialize_message(envelope.payload.data(), envelope.payload.size());
+  if (!message) {
+    LOG_WARNING(GATEWAY_COMPONENT, "Malformed client message on channel {}", channel);
+    return;
+  }
+  if (session == gateway.session_fds.end()) {
+    // A gateway that does not announce its sessions: the channel stands in for the client's address.
+    session = open_session(gateway, channel, "gateway:" + gateway.instance + "/" + std::to_string(channel));
+  }
+  on_message_(session->second, *message);
+}
+
+/**
+ * @brief Registers a session relayed by a gateway.
+ * @param gateway The gateway relaying the session.
+ * @param channel The session's channel on the gateway.
+ * @param client_address The client's address at the gateway, the session's unit of auth fairness.
+ * @return The session's entry in the gateway's channels.
+ */
+std::unordered_map<uint32_t, int>::iterator GatewayHub::open_session(Gateway &gateway, uint32_t channel,
+                                                                     const std::string &client_address) {
+  const int virtual_fd = next_virtual_fd_--;
+  on_open_(std::make_unique<RelayedSocket>(gateway.connection.get(), channel, virtual_fd), client_address);
+  metrics_.increment_counter("gateway_sessions_opened");
+  return gateway.session_fds.emplace(channel, virtual_fd).first;
+}
+
+/**
+ * @brief Closes a gateway link after disconnecting the sessions it relayed.
+ * @param fd The link's file descriptor.
+ */
+void GatewayHub::drop_gateway(int fd) {
+  auto it = gateways_.find(fd);
+  if (it == gateways_.end()) {
+    return;
+  }
+  LOG_WARNING(GATEWAY_COMPONENT, "Gateway on FD {} disconnected, dropping {} sessions", fd,
+              it->second.session_fds.size());
+
+  // The sessions' sockets point at the link, so they go first.
+  auto sessions = std::move(it->second.session_fds);
+  for (const auto &[channel, virtual_fd] : sessions) {
+    on_close_(virtual_fd);
+  }
+  epoll_manager_.remove_fd(fd);
+  gateways_.erase(fd);
+  metrics_.set_gauge("gateways", static_cast<int64_t>(gateways_.size()));
+}
+
+/**
+ * @brief Constructs a GatewayUplink.
+ * @param epoll_manager The reactor's epoll instance, used to watch the upstream links.
+ * @param metrics Receives the upstream gauges.
+ * @param deliver Handles the deliveries from the routing server.
+ * @param on_lost Disconnects the sessions of a lost link.
+ */
+GatewayUplink::GatewayUplink(EpollManager &epoll_manager, common::Metrics &metrics, DeliverCallback deliver,
+                             LostCallback on_lost)
+    : epoll_manager_(epoll_manager), metrics_(metrics), deliver_(std::move(deliver)), on_lost_(std::move(on_lost)),
+      instance_(std::to_string(std::random_device()()) + "-" + std::to_string(std::random_device()())) {}
+
+/**
+ * @brief Destructor for GatewayUplink. Closes the upstream links.
+ */
+GatewayUplink::~GatewayUplink() { close(); }
+
+/**
+ * @brief Connects to the routing servers.
+ * @param upstreams "host:port" of the routing servers' gateway ports. An address may be repeated to open several links.
+ * @return True if at least one link is up or connecting, false otherwise.
+ */
+bool GatewayUplink::start(const std::vector<std::string> &upstreams) {
+  for (const auto &address : upstreams) {
+    upstreams_.push_back(Upstream{address, nullptr, false, {}, std::chrono::milliseconds(0)});
+  }
+  size_t dialed = 0;
+  for (auto &upstream : upstreams_) {
+    dialed += dial(upstream) ? 1 : 0;
+  }
+  metrics_.set_gauge("upstream_links", 0); // Set by maintain() once the links are up
+  if (dialed == 0) {
+    LOG_ERROR(GATEWAY_COMPONENT, "No routing server reachable");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Closes all upstream links.
+ */
+void GatewayUplink::close() {
+  for (auto &upstream : upstreams_) {
+    drop_upstream(upstream);
+  }
+}
+
+/**
+ * @brief Checks whether a file descriptor is an upstream link.
+ * @param fd The file descriptor.
+ * @return True if it is an upstream link.
+ */
+bool GatewayUplink::owns_fd(int fd) const {
+  return std::any_of(upstreams_.begin(), upstreams_.end(), [fd](const Upstream &upstream) {
+    return upstream.connection && upstream.connection->get_fd() == fd;
+  });
+}
+
+/**
+ * @brief Handles an epoll event on an upstream link.
+ * @param fd The file descriptor that became ready.
+ * @param events The epoll event mask.
+ */
+void GatewayUplink::handle_event(int fd, uint32_t events) {
+  Upstream *upstream = find_by_fd(fd);
+  if (!upstream) {
+    return;
+  }
+  if (upstream->connecting) {
+    bool connected;
+    if (upstream->handshake) {
+      const common::SocketStatus status = upstream->handshake->complete_handshake();
+      if (status == common::SocketStatus::WOULD_BLOCK) {
+        return;
+      }
+      connected = status == common::SocketStatus::OK;
+    } else {
+      if (!(events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+        return;
+      }
+      connected = common::PosixSocket::finish_connect(fd);
+    }
+    if (!connected) {
+      drop_upstream(*upstream);
+      schedule_redial(*upstream);
+      return;
+    }
+    upstream->connecting = false;
+    upstream->handshake = nullptr;
+    upstream->backoff = std::chrono::milliseconds(0);
+    LOG_INFO(GATEWAY_COMPONENT, "Connected to routing server {}", upstream->address);
+  }
+
+  bool open = !(events & (EPOLLHUP | EPOLLERR));
+  if (open && (events & EPOLLIN)) {
+    open = upstream->connection->receive([this](const common::Message &envelope) {
+      if (envelope.header.type == common::MessageType::S2S_GATEWAY_DELIVER) {
+        deliver_(envelope);
+      }
+    });
+  }
+  if (open && (events & EPOLLOUT)) {
+    open = upstream->connection->flush();
+  }
+  if (!open) {
+    drop_upstream(*upstream);
+  }
+}
+
+/**
+ * @brief Queues a client message for the routing server, binding a new session to a link and announcing it
+ * with the client's address.
+ * @param channel The session's FD on this gateway.
+ * @param message The client message.
+ * @return True if queued, false if no routing server is reachable.
+ */
+bool GatewayUplink::forward(int channel, const common::Message &message) {
+  auto it = channel_links_.find(channel);
+  if (it == channel_links_.end()) {
+    // Round-robin over the links that are up.
+    for (size_t tried = 0; tried < upstreams_.size() && it == channel_links_.end(); ++tried) {
+      const size_t index = next_link_++ % upstreams_.size();
+      if (upstreams_[index].connection) {
+        it = channel_links_.emplace(channel, index).first;
+      }
+    }
+    if (it == channel_links_.end()) {
+      return false;
+    }
+    upstreams_[it->second].connection->queue_message(common::Message(common::MessageType::S2S_GATEWAY_OPEN,
+                                                                     static_cast<uint32_t>(channel), 0,
+                                                                     common::PosixSocket::peer_address(channel)));
+  }
+
+  const auto bytes = common::serialize_message(message);
+  upstreams_[it->second].connection->queue_message(common::Message(common::MessageType::S2S_GATEWAY_CLIENT,
+                                                                   static_cast<uint32_t>(channel), 0,
+                                                                   std::string(bytes.begin(), bytes.end())));
+  return true;
+}
+
+/**
+ * @brief Tells the routing server that a session ended.
+ * @param channel The session's FD on this gateway.
+ */
+void GatewayUplink::close_channel(int channel) {
+  auto it = channel_links_.find(channel);
+  if (it == channel_links_.end()) {
+    return;
+  }
+  auto &connection = upstreams_[it->second].connection;
+  if (connection) {
+    connection->queue_message(
+        common::Message(common::MessageType::S2S_GATEWAY_CLOSE, static_cast<uint32_t>(channel), 0, ""));
+  }
+  channel_links_.erase(it);
+}
+
+/**
+ * @brief Writes the output queued for the routing servers. Called once per reactor loop iteration.
+ */
+void GatewayUplink::flush() {
+  for (auto &upstream : upstreams_) {
+    if (upstream.connection && !upstream.connecting && upstream.connection->has_pending_writes() &&
+        !upstream.connection->flush()) {
+      drop_upstream(upstream);
+    }
+  }
+}
+
+/**
+ * @brief Periodic upkeep: redials lost links, with exponential backoff.
+ */
+void GatewayUplink::maintain() {
+  const auto now = std::chrono::steady_clock::now();
+  int64_t connected = 0;
+  for (auto &upstream : upstreams_) {
+    if (!upstream.connection && now >= upstream.next_attempt) {
+      dial(upstream);
+    }
+    connected += upstream.connection && !upstream.connecting ? 1 : 0;
+  }
+  metrics_.set_gauge("upstream_links", connected);
+  metrics_.set_gauge("relayed_sessions", static_cast<int64_t>(channel_links_.size()));
+}
+
+/**
+ * @brief Connects one upstream link without blocking; the TCP connect or the shared memory handshake is
+ * finished in handle_event(). Sessions may be bound to the link meanwhile, their messages queue behind the hello.
+ * @return True if the link is connecting, false otherwise.
+ */
+bool GatewayUplink::dial(Upstream &upstream) {
+  std::unique_ptr<common::IStreamSocket> socket;
+  common::ShmSocket *handshake = nullptr;
+  if (upstream.address.rfind(common::SHM_ADDRESS_PREFIX, 0) == 0) {
+    auto shm_socket =
+        common::ShmSocket::connect_async(upstream.address.substr(sizeof(common::SHM_ADDRESS_PREFIX) - 1));
+    handshake = shm_socket.get();
+    socket = std::move(shm_socket);
+  } else {
+    const size_t colon = upstream.address.rfind(':');
+    const int port = colon == std::string::npos ? 0 : std::atoi(upstream.address.c_str() + colon + 1);
+    socket = port > 0 ? common::PosixSocket::create_async_connector(upstream.address.substr(0, colon), port) : nullptr;
+  }
+  if (!socket) {
+    schedule_redial(upstream);
+    return false;
+  }
+
+  upstream.connection = std::make_unique<PeerConnection>(std::move(socket));
+  upstream.connecting = true;
+  upstream.handshake = handshake;
+  upstream.connection->queue_message(common::Message(common::MessageType::S2S_GATEWAY_HELLO, 0, 0, instance_));
+  epoll_manager_.add_fd(upstream.connection->get_fd(), EPOLLIN | EPOLLOUT | EPOLLET);
+  return true;
+}
+
+/**
+ * @brief Backs off before the next attempt to dial an upstream link whose dial failed.
+ */
+void GatewayUplink::schedule_redial(Upstream &upstream) {
+  upstream.backoff = std::clamp(upstream.backoff * 2, MIN_REDIAL_BACKOFF, MAX_REDIAL_BACKOFF);
+  upstream.next_attempt = std::chrono::steady_clock::now() + upstream.backoff;
+}
+
+/**
+ * @brief Closes an upstream link and disconnects the sessions bound to it.
+ */
+void GatewayUplink::drop_upstream(Upstream &upstream) {
+  if (!upstream.connection) {
+    return;
+  }
+  const size_t index = static_cast<size_t>(&upstream - upstreams_.data());
+  std::vector<int> channels;
+  for (auto it = channel_links_.begin(); it != channel_links_.end();) {
+    if (it->second == index) {
+      channels.push_back(it->first);
+      it = channel_links_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  if (upstream.connecting) {
+    LOG_DEBUG(GATEWAY_COMPONENT, "Routing server {} unreachable, disconnecting {} sessions", upstream.address,
+              channels.size());
+  } else {
+    LOG_WARNING(GATEWAY_COMPONENT, "Lost routing server {}, disconnecting {} sessions", upstream.address,
+                channels.size());
+  }
+  epoll_manager_.remove_fd(upstream.connection->get_fd());
+  upstream.connection.reset();
+  upstream.connecting = false;
+  upstream.handshake = nullptr;
+  upstream.next_attempt = std::chrono::steady_clock::now() + MIN_REDIAL_BACKOFF;
+  on_lost_(channels);
+}
+
+/**
+ * @brief Finds the upstream link with the given file descriptor.
+ */
+GatewayUplink::Upstream *GatewayUplink::find_by_fd(int fd) {
+  for (auto &upstream : upstreams_) {
+    if (upstream.connection && upstream.connection->get_fd() == fd) {
+      return &upstream;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,64 @@
+#include "common/logger.h"
+#include "server/server.h"
+#include <iostream>
+#include <string>
+
+namespace {
+
+void show_help(const char *program) {
+  std::cerr << "Usage: " << program << " <port> --upstream <host:port> [options]\n"
+            << "  --upstream <host:port>  Relay clients to the routing server's gateway port (repeatable;\n"
+            << "                          repeat an address to open several links to it). Use shm:<path>\n"
+            << "                          for a routing server of this host started with --gateway-shm <path>.\n"
+            << "  --metrics-file <path>   Export metrics to <path> every second.\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  chat_app::common::Logger::get_instance().set_level(chat_app::common::LogLevel::INFO);
+
+  if (argc < 2) {
+    show_help(argv[0]);
+    return 1;
+  }
+
+  int port;
+  chat_app::server::ServerConfig config;
+  // Passwords are checked by the routing server.
+  config.auth_threads = 1;
+  try {
+    port = std::stoi(argv[1]);
+
+    for (int i = 2; i < argc; ++i) {
+      std::string option = argv[i];
+      if (i + 1 >= argc) {
+        show_help(argv[0]);
+        return 1;
+      }
+      std::string value = argv[++i];
+
+      if (option == "--upstream") {
+        config.upstreams.push_back(value);
+      } else if (option == "--metrics-file") {
+        config.metrics_file = value;
+      } else {
+        show_help(argv[0]);
+        return 1;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: Invalid argument: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if (port <= 0 || port > 65535 || config.upstreams.empty()) {
+    show_help(argv[0]);
+    return 1;
+  }
+
+  chat_app::server::Server server(port, config);
+  server.run();
+
+  return 0;
+}
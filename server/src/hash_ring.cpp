@@ -0,0 +1,86 @@
+#include "server/hash_ring.h"
+#include <algorithm>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+/**
+ * @brief Finalizer of SplitMix64: spreads nearby integers (consecutive user IDs) over the whole ring.
+ */
+uint64_t mix64(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+} // namespace
+
+/**
+ * @brief Places a node's points on the ring. Does nothing if the node is already present.
+ * @param node_id The node ID.
+ */
+void HashRing::add_node(uint32_t node_id) {
+  if (contains(node_id)) {
+    return;
+  }
+  for (uint64_t i = 0; i < HASH_RING_POINTS_PER_NODE; ++i) {
+    points_.emplace_back(mix64((uint64_t(node_id) << 32) | i), node_id);
+  }
+  std::sort(points_.begin(), points_.end());
+}
+
+/**
+ * @brief Removes a node's points. Its keys fall to the next points clockwise.
+ * @param node_id The node ID.
+ */
+void HashRing::remove_node(uint32_t node_id) {
+  points_.erase(std::remove_if(points_.begin(), points_.end(),
+                               [node_id](const auto &point) { return point.second == node_id; }),
+                points_.end());
+}
+
+/**
+ * @brief Checks whether a node is on the ring.
+ * @param node_id The node ID.
+ * @return True if the node owns points.
+ */
+bool HashRing::contains(uint32_t node_id) const {
+  return std::any_of(points_.begin(), points_.end(), [node_id](const auto &point) { return point.second == node_id; });
+}
+
+/**
+ * @brief Finds the node owning a user ID.
+ * @param user_id The user ID.
+ * @return The node ID, or 0 if the ring is empty.
+ */
+uint32_t HashRing::node_for(uint32_t user_id) const { return node_for_hash(mix64(user_id)); }
+
+/**
+ * @brief Finds the node owning a username.
+ * @param username The username.
+ * @return The node ID, or 0 if the ring is empty.
+ */
+uint32_t HashRing::node_for(const std::string &username) const {
+  uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+  for (unsigned char c : username) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return node_for_hash(mix64(hash));
+}
+
+/**
+ * @brief Finds the first point at or after a position, wrapping around.
+ */
+uint32_t HashRing::node_for_hash(uint64_t hash) const {
+  if (points_.empty()) {
+    return 0;
+  }
+  auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(hash, uint32_t(0)));
+  return it == points_.end() ? points_.front().second : it->second;
+}
+
+} // namespace server
+} // namespace chat_app
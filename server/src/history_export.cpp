@@ -0,0 +1,472 @@
+#include "server/history_export.h"
+#include "common/logger.h"
+#include "server/message_log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+constexpr char EXPORT_MAGIC[8] = {'C', 'H', 'A', 'T', 'C', 'O', 'L', '1'};
+
+// Column IDs, in the order they appear in every row group.
+enum class Column : uint8_t { SEQUENCE = 0, TIMESTAMP = 1, SENDER = 2, TYPE = 3, LENGTH = 4, SCOPE = 5 };
+constexpr size_t COLUMN_COUNT = 6;
+
+// Bytes of a segment mapped and scanned at a time; pages behind the scan are released as it advances.
+constexpr size_t SCAN_WINDOW_BYTES = 8 * 1024 * 1024;
+
+void put_varint(std::vector<char> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+
+int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+void put_u32(std::vector<char> &out, uint32_t value) {
+  uint32_t net = htobe32(value);
+  out.insert(out.end(), reinterpret_cast<char *>(&net), reinterpret_cast<char *>(&net) + sizeof(net));
+}
+
+void put_u64(std::vector<char> &out, uint64_t value) {
+  uint64_t net = htobe64(value);
+  out.insert(out.end(), reinterpret_cast<char *>(&net), reinterpret_cast<char *>(&net) + sizeof(net));
+}
+
+/**
+ * @brief Bounds-checked reader over an export file.
+ */
+class ExportReader {
+public:
+  ExportReader(const char *data, size_t size) : data_(data), size_(size) {}
+
+  bool get(void *out, size_t size) {
+    if (size > size_ - offset_) {
+      return false;
+    }
+    std::memcpy(out, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  bool get_u8(uint8_t &value) { return get(&value, sizeof(value)); }
+
+  bool get_u32(uint32_t &value) {
+    if (!get(&value, sizeof(value)))
+      return false;
+    value = be32toh(value);
+    return true;
+  }
+
+  bool get_u64(uint64_t &value) {
+    if (!get(&value, sizeof(value)))
+      return false;
+    value = be64toh(value);
+    return true;
+  }
+
+  bool get_varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && offset_ < size_; shift += 7) {
+      const uint8_t byte = static_cast<uint8_t>(data_[offset_++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t offset() const { return offset_; }
+  void seek(size_t offset) { offset_ = std::min(offset, size_); }
+
+private:
+  const char *data_;
+  size_t size_;
+  size_t offset_{0};
+};
+
+/**
+ * @brief Dictionary of the scopes seen so far. Lookups avoid building the scope string for
+ * every row; a string is only created the first time a scope appears.
+ */
+class ScopeDictionary {
+public:
+  uint32_t index_of(const common::Message &message) {
+    switch (message.header.type) {
+    case common::MessageType::S2C_BROADCAST:
+      return named_index(broadcast_index_, "broadcast");
+    case common::MessageType::S2C_PRIVATE: {
+      const uint32_t low = std::min(message.header.sender_id, message.header.receiver_id);
+      const uint32_t high = std::max(message.header.sender_id, message.header.receiver_id);
+      const uint64_t key = (static_cast<uint64_t>(low) << 32) | high;
+      auto it = direct_indexes_.find(key);
+      if (it != direct_indexes_.end()) {
+        return it->second;
+      }
+      const uint32_t index = add("dm:" + std::to_string(low) + "-" + std::to_string(high));
+      direct_indexes_.emplace(key, index);
+      return index;
+    }
+    default:
+      return named_index(presence_index_, "presence");
+    }
+  }
+
+  const std::vector<std::string> &entries() const { return entries_; }
+
+private:
+  uint32_t named_index(int64_t &slot, const char *name) {
+    if (slot < 0) {
+      slot = add(name);
+    }
+    return static_cast<uint32_t>(slot);
+  }
+
+  uint32_t add(std::string scope) {
+    entries_.push_back(std::move(scope));
+    return static_cast<uint32_t>(entries_.size() - 1);
+  }
+
+  std::vector<std::string> entries_;
+  std::unordered_map<uint64_t, uint32_t> direct_indexes_;
+  int64_t broadcast_index_{-1};
+  int64_t presence_index_{-1};
+};
+
+bool is_chat_event(common::MessageType type) {
+  return type == common::MessageType::S2C_BROADCAST || type == common::MessageType::S2C_PRIVATE ||
+         type == common::MessageType::S2C_USER_JOINED || type == common::MessageType::S2C_USER_LEFT;
+}
+
+/**
+ * @brief Accumulates rows column by column and writes them out one row group at a time.
+ */
+class ColumnarWriter {
+public:
+  explicit ColumnarWriter(int fd) : fd_(fd) {
+    // Buffers are reused across row groups, so steady-state exporting does not allocate.
+    for (auto &column : columns_) {
+      column.reserve(EXPORT_ROW_GROUP_ROWS * 4);
+    }
+    std::vector<char> header(EXPORT_MAGIC, EXPORT_MAGIC + sizeof(EXPORT_MAGIC));
+    ok_ = write_all(header);
+    offset_ = header.size();
+  }
+
+  void add_row(const LogRecord &record, uint32_t scope) {
+    const auto &header = record.message.header;
+    put_varint(column(Column::SEQUENCE), record.sequence - previous_sequence_);
+    put_varint(column(Column::TIMESTAMP),
+               zigzag(static_cast<int64_t>(record.timestamp_ms) - static_cast<int64_t>(previous_timestamp_)));
+    put_varint(column(Column::SENDER), header.sender_id);
+    column(Column::TYPE).push_back(static_cast<char>(header.type));
+    put_varint(column(Column::LENGTH), record.message.payload.size());
+    put_varint(column(Column::SCOPE), scope);
+    previous_sequence_ = record.sequence;
+    previous_timestamp_ = record.timestamp_ms;
+
+    if (++group_rows_ == EXPORT_ROW_GROUP_ROWS) {
+      flush_row_group();
+    }
+  }
+
+  bool finish(const std::vector<std::string> &dictionary) {
+    flush_row_group();
+
+    std::vector<char> footer;
+    put_u32(footer, static_cast<uint32_t>(dictionary.size()));
+    for (const auto &scope : dictionary) {
+      put_varint(footer, scope.size());
+      footer.insert(footer.end(), scope.begin(), scope.end());
+    }
+    put_u64(footer, total_rows_);
+    put_u32(footer, static_cast<uint32_t>(row_group_offsets_.size()));
+    for (uint64_t offset : row_group_offsets_) {
+      put_u64(footer, offset);
+    }
+    put_u64(footer, offset_);
+    footer.insert(footer.end(), EXPORT_MAGIC, EXPORT_MAGIC + sizeof(EXPORT_MAGIC));
+    return write_all(footer) && ok_;
+  }
+
+  uint64_t rows() const { return total_rows_; }
+
+private:
+  std::vector<char> &column(Column id) { return columns_[static_cast<size_t>(id)]; }
+
+  void flush_row_group() {
+    if (group_rows_ == 0) {
+      return;
+    }
+
+    group_.clear();
+    put_u32(group_, static_cast<uint32_t>(group_rows_));
+    for (size_t id = 0; id < COLUMN_COUNT; ++id) {
+      group_.push_back(static_cast<char>(id));
+      put_u32(group_, static_cast<uint32_t>(columns_[id].size()));
+      group_.insert(group_.end(), columns_[id].begin(), columns_[id].end());
+      columns_[id].clear();
+    }
+
+    row_group_offsets_.push_back(offset_);
+    ok_ = ok_ && write_all(group_);
+    offset_ += group_.size();
+    total_rows_ += group_rows_;
+    group_rows_ = 0;
+    // Deltas restart in every row group so groups can be decoded independently.
+    previous_sequence_ = 0;
+    previous_timestamp_ = 0;
+  }
+
+  bool write_all(const std::vector<char> &bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+      ssize_t n = ::write(fd_, bytes.data() + written, bytes.size() - written);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG_ERROR(HISTORY_EXPORT_COMPONENT, "Failed to write export: {}", std::strerror(errno));
+        return false;
+      }
+      written += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  int fd_;
+  bool ok_{true};
+  uint64_t offset_{0};
+  std::vector<char> columns_[COLUMN_COUNT];
+  std::vector<char> group_;
+  size_t group_rows_{0};
+  uint64_t total_rows_{0};
+  uint64_t previous_sequence_{0};
+  uint64_t previous_timestamp_{0};
+  std::vector<uint64_t> row_group_offsets_;
+};
+
+/**
+ * @brief Scans one segment in windows of SCAN_WINDOW_BYTES, handing every complete record to the visitor.
+ * The segment is never written; a torn record at the end (the live server mid-append) ends the scan.
+ *
+ * @param path The segment file.
+ * @param sealed True if the server has moved on to a later segment, so this one no longer changes.
+ * @param visitor Receives each record.
+ * @return The number of bytes scanned.
+ */
+template <typename Visitor> uint64_t scan_segment(const std::string &path, bool sealed, Visitor &&visitor) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_ERROR(HISTORY_EXPORT_COMPONENT, "Failed to open segment {}: {}", path, std::strerror(errno));
+    return 0;
+  }
+
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return 0;
+  }
+  const size_t file_size = static_cast<size_t>(st.st_size);
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  LogRecord record;
+  size_t offset = 0; // File offset of the next record
+  while (offset < file_size) {
+    // Map a page-aligned window starting at or before the next record.
+    const size_t window_start = offset - offset % page_size;
+    const size_t window_size = std::min(SCAN_WINDOW_BYTES, file_size - window_start);
+    void *mapped = mmap(nullptr, window_size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(window_start));
+    if (mapped == MAP_FAILED) {
+      LOG_ERROR(HISTORY_EXPORT_COMPONENT, "Failed to map segment {}: {}", path, std::strerror(errno));
+      break;
+    }
+    madvise(mapped, window_size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    const size_t window_end = window_start + window_size;
+    const size_t offset_before = offset;
+    while (offset < window_end) {
+      size_t consumed = decode_log_record(data + (offset - window_start), window_end - offset, record);
+      if (consumed == 0) {
+        break;
+      }
+      offset += consumed;
+      visitor(record);
+    }
+    munmap(mapped, window_size);
+
+    if (offset == offset_before) {
+      // No complete record in a full window: either the end of the written data or a record
+      // larger than the window, which the log never produces.
+      break;
+    }
+  }
+
+  if (sealed) {
+    // Sealed segments are read once; keep them from displacing the live server's pages.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  }
+  ::close(fd);
+  return offset;
+}
+
+} // namespace
+
+std::optional<ExportStats> export_history(const std::string &data_dir, const std::string &output_path,
+                                          const ExportOptions &options) {
+  const auto segments = MessageLog::list_segments(data_dir);
+  if (segments.empty()) {
+    LOG_ERROR(HISTORY_EXPORT_COMPONENT, "No log segments in {}", data_dir);
+    return std::nullopt;
+  }
+
+  int out_fd = ::open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out_fd < 0) {
+    LOG_ERROR(HISTORY_EXPORT_COMPONENT, "Failed to create {}: {}", output_path, std::strerror(errno));
+    return std::nullopt;
+  }
+
+  ExportStats stats;
+  ColumnarWriter writer(out_fd);
+  ScopeDictionary scopes;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    // Segments wholly before after_sequence are skipped without being read.
+    if (i + 1 < segments.size() && MessageLog::segment_first_sequence(segments[i + 1]) <= options.after_sequence + 1) {
+      continue;
+    }
+
+    const bool sealed = i + 1 < segments.size();
+    stats.bytes_read += scan_segment(segments[i], sealed, [&](const LogRecord &record) {
+      stats.last_sequence = std::max(stats.last_sequence, record.sequence);
+      if (record.sequence <= options.after_sequence || record.timestamp_ms < options.from_ms ||
+          record.timestamp_ms >= options.to_ms || !is_chat_event(record.message.header.type)) {
+        return;
+      }
+      writer.add_row(record, scopes.index_of(record.message));
+    });
+    ++stats.segments;
+  }
+
+  const bool ok = writer.finish(scopes.entries()) && fsync(out_fd) == 0;
+  ::close(out_fd);
+  if (!ok) {
+    return std::nullopt;
+  }
+
+  stats.rows = writer.rows();
+  return stats;
+}
+
+std::optional<ExportedHistory> read_history_export(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::nullopt;
+  }
+  const std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  const size_t trailer_size = sizeof(uint64_t) + sizeof(EXPORT_MAGIC);
+  if (file.size() < sizeof(EXPORT_MAGIC) + trailer_size ||
+      std::memcmp(file.data(), EXPORT_MAGIC, sizeof(EXPORT_MAGIC)) != 0 ||
+      std::memcmp(file.data() + file.size() - sizeof(EXPORT_MAGIC), EXPORT_MAGIC, sizeof(EXPORT_MAGIC)) != 0) {
+    return std::nullopt;
+  }
+
+  ExportReader reader(file.data(), file.size() - sizeof(EXPORT_MAGIC));
+  uint64_t footer_offset = 0;
+  reader.seek(file.size() - trailer_size);
+  if (!reader.get_u64(footer_offset)) {
+    return std::nullopt;
+  }
+
+  ExportedHistory history;
+  uint32_t dictionary_size = 0;
+  uint64_t total_rows = 0;
+  uint32_t group_count = 0;
+  reader.seek(footer_offset);
+  bool ok = reader.get_u32(dictionary_size);
+  for (uint32_t i = 0; ok && i < dictionary_size; ++i) {
+    uint64_t length = 0;
+    ok = reader.get_varint(length) && length <= file.size();
+    std::string scope(ok ? length : 0, '\0');
+    ok = ok && reader.get(scope.data(), scope.size());
+    history.scope_dictionary.push_back(std::move(scope));
+  }
+  ok = ok && reader.get_u64(total_rows) && reader.get_u32(group_count);
+
+  std::vector<uint64_t> group_offsets(ok ? group_count : 0);
+  for (auto &offset : group_offsets) {
+    ok = ok && reader.get_u64(offset);
+  }
+
+  for (uint64_t group_offset : group_offsets) {
+    reader.seek(group_offset);
+    uint32_t rows = 0;
+    ok = ok && reader.get_u32(rows);
+    for (size_t id = 0; ok && id < COLUMN_COUNT; ++id) {
+      uint8_t column_id = 0;
+      uint32_t column_size = 0;
+      ok = reader.get_u8(column_id) && column_id == id && reader.get_u32(column_size);
+      const size_t column_end = reader.offset() + column_size;
+
+      uint64_t previous = 0;
+      for (uint32_t row = 0; ok && row < rows; ++row) {
+        uint64_t value = 0;
+        if (static_cast<Column>(id) == Column::TYPE) {
+          uint8_t type = 0;
+          ok = reader.get_u8(type);
+          history.types.push_back(static_cast<common::MessageType>(type));
+          continue;
+        }
+        ok = reader.get_varint(value);
+        switch (static_cast<Column>(id)) {
+        case Column::SEQUENCE:
+          previous += value;
+          history.sequences.push_back(previous);
+          break;
+        case Column::TIMESTAMP:
+          previous += static_cast<uint64_t>(unzigzag(value));
+          history.timestamps_ms.push_back(previous);
+          break;
+        case Column::SENDER:
+          history.sender_ids.push_back(static_cast<uint32_t>(value));
+          break;
+        case Column::LENGTH:
+          history.lengths.push_back(static_cast<uint32_t>(value));
+          break;
+        case Column::SCOPE:
+          ok = ok && value < history.scope_dictionary.size();
+          history.scopes.push_back(static_cast<uint32_t>(value));
+          break;
+        default:
+          break;
+        }
+      }
+      ok = ok && reader.offset() == column_end;
+    }
+  }
+
+  if (!ok || history.sequences.size() != total_rows) {
+    return std::nullopt;
+  }
+  return history;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -1,20 +1,137 @@
+#include "common/affinity.h"
 #include "common/logger.h"
+#include "server/prefork.h"
+#include "server/reactor_group.h"
 #include "server/server.h"
 #include <iostream>
+#include <string>
+
+void show_help(const char *program) {
+  std::cerr << "Usage: " << program << " <port> [options]\n"
+            << "  --data-dir <dir>              Persist the message log and state snapshots in <dir>.\n"
+            << "  --snapshot-interval <seconds> Interval between state snapshots (default 60).\n"
+            << "  --metrics-file <path>         Export metrics to <path> every second.\n"
+            << "  --unix-socket <path>          Also accept local clients on the Unix domain socket <path>.\n"
+            << "  --workers <count>             Run <count> worker processes sharing the port (SO_REUSEPORT).\n"
+            << "  --reactors <count>            Run <count> reactor threads sharing the port in this process.\n"
+            << "  --cpu-steering <on|off>       With --workers or --reactors, pin worker i to CPU i and give it\n"
+            << "                                the connections that arrive on that CPU (default off).\n"
+            << "  --replication-port <port>     Ship the message log to standbys connecting on <port>.\n"
+            << "  --replicate-from <host:port>  Run as a warm standby of the primary at <host:port>.\n"
+            << "  --auth-threads <count>        Worker threads for password checks (default 2).\n"
+            << "  --reactor-cpu <cpu>           Pin the reactor thread to <cpu> and keep its memory on that CPU's node.\n"
+            << "  --auth-cpus <list>            Pin the password check threads to the CPUs in <list>, e.g. 2-3,6.\n"
+            << "  --password-iterations <count> PBKDF2 iterations for new passwords (default 100000).\n"
+            << "  --broadcast-threads <count>   Helper threads that split broadcasts to large audiences (default 0).\n"
+            << "  --broadcast-threshold <count> Clients from which a broadcast is split (default 10000).\n"
+            << "  --pipeline <on|off>           Decode, route and encode messages in separate stages (default off).\n"
+            << "  --decode-threads <count>      With --pipeline, threads that read and decode messages (default 1).\n"
+            << "  --encode-threads <count>      With --pipeline, threads that encode and write messages (default 1).\n"
+            << "  --decode-cpus <list>          Pin the decode threads to the CPUs in <list>.\n"
+            << "  --encode-cpus <list>          Pin the encode threads to the CPUs in <list>.\n"
+            << "  --node-id <id>                Run as node <id> (1-63) of a cluster.\n"
+            << "  --cluster-port <port>         Accept links from other cluster nodes on <port>.\n"
+            << "  --cluster-shm <path>          Accept links from cluster nodes of this host over shared memory,\n"
+            << "                                rendezvousing on the Unix domain socket <path>.\n"
+            << "  --peer <host:port>            Link to the cluster node at <host:port> (repeatable), or at\n"
+            << "                                shm:<path> for a node of this host started with --cluster-shm <path>.\n"
+            << "  --relay-fanout <count>        Relay broadcasts down a tree with <count> children per node.\n"
+            << "  --gateway-port <port>         Accept chat_gateway processes on <port>.\n"
+            << "  --gateway-shm <path>          Accept chat_gateway processes of this host over shared memory,\n"
+            << "                                rendezvousing on the Unix domain socket <path>.\n";
+}
 
 int main(int argc, char *argv[]) {
   chat_app::common::Logger::get_instance().set_level(chat_app::common::LogLevel::INFO);
 
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+  if (argc < 2) {
+    show_help(argv[0]);
     return 1;
   }
 
   int port;
+  chat_app::server::ServerConfig config;
+  size_t workers = 0;
+  size_t reactors = 0;
   try {
     port = std::stoi(argv[1]);
+
+    for (int i = 2; i < argc; ++i) {
+      std::string option = argv[i];
+      if (i + 1 >= argc) {
+        show_help(argv[0]);
+        return 1;
+      }
+      std::string value = argv[++i];
+
+      if (option == "--data-dir") {
+        config.data_dir = value;
+      } else if (option == "--snapshot-interval") {
+        config.snapshot_interval_ms = std::stoi(value) * 1000;
+      } else if (option == "--metrics-file") {
+        config.metrics_file = value;
+      } else if (option == "--unix-socket") {
+        config.unix_socket_path = value;
+      } else if (option == "--workers") {
+        workers = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--reactors") {
+        reactors = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--cpu-steering") {
+        config.cpu_steering = value == "on";
+      } else if (option == "--replication-port") {
+        config.replication_port = std::stoi(value);
+      } else if (option == "--replicate-from") {
+        config.replicate_from = value;
+      } else if (option == "--auth-threads") {
+        config.auth_threads = std::stoi(value);
+      } else if (option == "--reactor-cpu") {
+        config.reactor_cpu = std::stoi(value);
+      } else if (option == "--auth-cpus") {
+        config.auth_cpus = chat_app::common::parse_cpu_list(value);
+        if (config.auth_cpus.empty()) {
+          std::cerr << "Error: Invalid CPU list: " << value << std::endl;
+          return 1;
+        }
+      } else if (option == "--password-iterations") {
+        config.password_iterations = static_cast<uint32_t>(std::stoul(value));
+      } else if (option == "--broadcast-threads") {
+        config.broadcast_threads = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--broadcast-threshold") {
+        config.broadcast_fan_out_threshold = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--pipeline") {
+        config.pipeline = value == "on";
+      } else if (option == "--decode-threads") {
+        config.decode_threads = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--encode-threads") {
+        config.encode_threads = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--decode-cpus" || option == "--encode-cpus") {
+        auto &cpus = option == "--decode-cpus" ? config.decode_cpus : config.encode_cpus;
+        cpus = chat_app::common::parse_cpu_list(value);
+        if (cpus.empty()) {
+          std::cerr << "Error: Invalid CPU list: " << value << std::endl;
+          return 1;
+        }
+      } else if (option == "--node-id") {
+        config.node_id = static_cast<uint32_t>(std::stoul(value));
+      } else if (option == "--cluster-port") {
+        config.cluster_port = std::stoi(value);
+      } else if (option == "--cluster-shm") {
+        config.cluster_shm_path = value;
+      } else if (option == "--peer") {
+        config.peers.push_back(value);
+      } else if (option == "--relay-fanout") {
+        config.relay_fanout = static_cast<size_t>(std::stoul(value));
+      } else if (option == "--gateway-port") {
+        config.gateway_port = std::stoi(value);
+      } else if (option == "--gateway-shm") {
+        config.gateway_shm_path = value;
+      } else {
+        show_help(argv[0]);
+        return 1;
+      }
+    }
   } catch (const std::exception &e) {
-    std::cerr << "Error: Invalid port number: " << e.what() << std::endl;
+    std::cerr << "Error: Invalid argument: " << e.what() << std::endl;
     return 1;
   }
 
@@ -23,8 +140,23 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  chat_app::server::Server server(port);
+  if (workers > 0 && reactors > 0) {
+    std::cerr << "Error: --workers and --reactors cannot be combined." << std::endl;
+    return 1;
+  }
+  if (config.pipeline && config.broadcast_threads > 0) {
+    std::cerr << "Error: --pipeline and --broadcast-threads cannot be combined." << std::endl;
+    return 1;
+  }
+  if (workers > 0) {
+    return chat_app::server::run_prefork(port, config, workers);
+  }
+  if (reactors > 0) {
+    return chat_app::server::run_reactors(port, config, reactors);
+  }
+
+  chat_app::server::Server server(port, config);
   server.run();
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,392 @@
+#include "server/message_log.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+constexpr const char *SEGMENT_PREFIX = "segment-";
+constexpr const char *SEGMENT_SUFFIX = ".log";
+
+/**
+ * @brief 32-bit FNV-1a hash, used to detect torn or corrupted records.
+ */
+uint32_t checksum(const char *data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string segment_name(uint64_t first_sequence) {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%s%020llu%s", SEGMENT_PREFIX, static_cast<unsigned long long>(first_sequence),
+                SEGMENT_SUFFIX);
+  return name;
+}
+
+} // namespace
+
+/**
+ * @brief Encodes a log record into its on-disk representation.
+ * All integers are stored in network byte order, the same as the wire protocol.
+ *
+ * @param record The record to encode.
+ * @return The encoded bytes.
+ */
+std::vector<char> encode_log_record(const LogRecord &record) {
+  auto message_bytes = common::serialize_message(record.message);
+  std::vector<char> buffer(LOG_RECORD_HEADER_SIZE + message_bytes.size());
+  char *ptr = buffer.data();
+
+  uint32_t record_size_net = htonl(static_cast<uint32_t>(buffer.size() - sizeof(uint32_t)));
+  std::memcpy(ptr, &record_size_net, sizeof(uint32_t));
+
+  uint64_t sequence_net = htobe64(record.sequence);
+  std::memcpy(ptr + sizeof(uint32_t) * 2, &sequence_net, sizeof(uint64_t));
+
+  uint64_t timestamp_net = htobe64(record.timestamp_ms);
+  std::memcpy(ptr + sizeof(uint32_t) * 2 + sizeof(uint64_t), &timestamp_net, sizeof(uint64_t));
+
+  std::memcpy(ptr + LOG_RECORD_HEADER_SIZE, message_bytes.data(), message_bytes.size());
+
+  // The checksum covers everything after the checksum field.
+  const size_t checked_offset = sizeof(uint32_t) * 2;
+  uint32_t checksum_net = htonl(checksum(ptr + checked_offset, buffer.size() - checked_offset));
+  std::memcpy(ptr + sizeof(uint32_t), &checksum_net, sizeof(uint32_t));
+
+  return buffer;
+}
+
+/**
+ * @brief Decodes one log record from the front of a byte range.
+ *
+ * @param data Pointer to the encoded bytes.
+ * @param size Number of bytes available.
+ * @param record Receives the decoded record.
+ * @return The number of bytes consumed, or 0 if the range holds no complete, valid record.
+ */
+size_t decode_log_record(const char *data, size_t size, LogRecord &record) {
+  if (size < LOG_RECORD_HEADER_SIZE + common::HEADER_SIZE) {
+    return 0;
+  }
+
+  uint32_t record_size_net;
+  std::memcpy(&record_size_net, data, sizeof(uint32_t));
+  const size_t total_size = sizeof(uint32_t) + ntohl(record_size_net);
+  if (total_size < LOG_RECORD_HEADER_SIZE + common::HEADER_SIZE || total_size > size) {
+    return 0;
+  }
+
+  uint32_t checksum_net;
+  std::memcpy(&checksum_net, data + sizeof(uint32_t), sizeof(uint32_t));
+  const size_t checked_offset = sizeof(uint32_t) * 2;
+  if (ntohl(checksum_net) != checksum(data + checked_offset, total_size - checked_offset)) {
+    return 0;
+  }
+
+  uint64_t sequence_net;
+  std::memcpy(&sequence_net, data + checked_offset, sizeof(uint64_t));
+  uint64_t timestamp_net;
+  std::memcpy(&timestamp_net, data + checked_offset + sizeof(uint64_t), sizeof(uint64_t));
+
+  const size_t message_size = total_size - LOG_RECORD_HEADER_SIZE;
+  auto [message, consumed] = common::deserialize_message(data + LOG_RECORD_HEADER_SIZE, message_size);
+  if (!message || consumed != message_size) {
+    return 0;
+  }
+
+  record.sequence = be64toh(sequence_net);
+  record.timestamp_ms = be64toh(timestamp_net);
+  record.message = std::move(*message);
+  return total_size;
+}
+
+/**
+ * @brief Constructs a MessageLog rooted at the given directory.
+ * @param directory The directory holding the segment files. Created on open() if missing.
+ * @param segment_size The size after which the active segment is closed and a new one started.
+ */
+MessageLog::MessageLog(const std::string &directory, size_t segment_size)
+    : directory_(directory), segment_size_(segment_size) {}
+
+/**
+ * @brief Destructor for MessageLog. Flushes and closes the active segment.
+ */
+MessageLog::~MessageLog() { close(); }
+
+/**
+ * @brief Opens the log, recovering the last sequence number from the newest segment.
+ *
+ * A torn record at the end of the newest segment (e.g. after a crash mid-write) is truncated away.
+ * @return True if the log is ready for appends, false otherwise.
+ */
+bool MessageLog::open() {
+  std::error_code ec;
+  std::filesystem::create_directories(directory_, ec);
+  if (ec) {
+    LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to create log directory {}: {}", directory_, ec.message());
+    return false;
+  }
+
+  auto segments = list_segments(directory_);
+  if (segments.empty()) {
+    return true; // The first segment is created lazily by the first append.
+  }
+
+  const std::string &path = segments.back();
+  segment_fd_ = ::open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+  if (segment_fd_ < 0) {
+    LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to open segment {}: {}", path, std::strerror(errno));
+    return false;
+  }
+
+  // Find the end of the last complete record, counting records as we go.
+  size_t valid_bytes = 0;
+  last_sequence_ = segment_first_sequence(path) > 0 ? segment_first_sequence(path) - 1 : 0;
+  struct stat st {};
+  if (fstat(segment_fd_, &st) == 0 && st.st_size > 0) {
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, segment_fd_, 0);
+    if (mapped != MAP_FAILED) {
+      const char *data = static_cast<const char *>(mapped);
+      LogRecord record;
+      while (size_t consumed = decode_log_record(data + valid_bytes, st.st_size - valid_bytes, record)) {
+        valid_bytes += consumed;
+        last_sequence_ = record.sequence;
+      }
+      munmap(mapped, st.st_size);
+    }
+
+    if (valid_bytes < static_cast<size_t>(st.st_size)) {
+      LOG_WARNING(MESSAGE_LOG_COMPONENT, "Truncating {} torn bytes at the end of {}", st.st_size - valid_bytes, path);
+      if (ftruncate(segment_fd_, valid_bytes) != 0) {
+        LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to truncate segment {}: {}", path, std::strerror(errno));
+        return false;
+      }
+    }
+  }
+
+  segment_bytes_ = valid_bytes;
+  LOG_INFO(MESSAGE_LOG_COMPONENT, "Opened message log at {} (last sequence {})", directory_, last_sequence_);
+  return true;
+}
+
+/**
+ * @brief Flushes and closes the active segment.
+ */
+void MessageLog::close() {
+  if (segment_fd_ != -1) {
+    fdatasync(segment_fd_);
+    ::close(segment_fd_);
+    segment_fd_ = -1;
+  }
+}
+
+/**
+ * @brief Appends a message to the log, assigning it the next sequence number.
+ * @param message The message to append.
+ * @return The sequence number of the new record, or 0 on failure.
+ */
+uint64_t MessageLog::append(const common::Message &message) {
+  LogRecord record;
+  record.sequence = last_sequence_ + 1;
+  record.timestamp_ms = now_ms();
+  record.message = message;
+  return write_record(record) ? record.sequence : 0;
+}
+
+/**
+ * @brief Appends a record that already carries its sequence number, e.g. one received from a primary.
+ * Records at or below the current last sequence are ignored so that re-delivery is harmless.
+ *
+ * @param record The record to append.
+ * @return True if the record was appended or was already present, false on failure or a sequence gap.
+ */
+bool MessageLog::append_record(const LogRecord &record) {
+  if (record.sequence <= last_sequence_) {
+    return true;
+  }
+  if (record.sequence != last_sequence_ + 1) {
+    LOG_ERROR(MESSAGE_LOG_COMPONENT, "Sequence gap: expected {}, got {}", last_sequence_ + 1, record.sequence);
+    return false;
+  }
+  return write_record(record);
+}
+
+/**
+ * @brief Forces appended records down to stable storage.
+ * @return True on success, false otherwise.
+ */
+bool MessageLog::flush() {
+  if (segment_fd_ != -1 && fdatasync(segment_fd_) != 0) {
+    LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to sync segment: {}", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Visits, in order, every record with a sequence number greater than after_sequence.
+ *
+ * Whole segments that end before after_sequence are skipped without being read.
+ * @param after_sequence Records up to and including this sequence number are skipped.
+ * @param visitor Called once per record.
+ * @param max_records Stop after visiting this many records.
+ * @return The number of records visited.
+ */
+size_t MessageLog::replay(uint64_t after_sequence, const std::function<void(const LogRecord &)> &visitor,
+                          size_t max_records) const {
+  auto segments = list_segments(directory_);
+  size_t visited = 0;
+
+  for (size_t i = 0; i < segments.size() && visited < max_records; ++i) {
+    // The next segment starts after this one ends; skip segments that are entirely covered.
+    if (i + 1 < segments.size() && segment_first_sequence(segments[i + 1]) <= after_sequence + 1) {
+      continue;
+    }
+
+    int fd = ::open(segments[i].c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to open segment {}: {}", segments[i], std::strerror(errno));
+      continue;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+        const char *data = static_cast<const char *>(mapped);
+        size_t offset = 0;
+        LogRecord record;
+        while (visited < max_records) {
+          size_t consumed = decode_log_record(data + offset, st.st_size - offset, record);
+          if (consumed == 0) {
+            break;
+          }
+          offset += consumed;
+          if (record.sequence > after_sequence) {
+            visitor(record);
+            ++visited;
+          }
+        }
+        munmap(mapped, st.st_size);
+      }
+    }
+    ::close(fd);
+  }
+
+  return visited;
+}
+
+/**
+ * @brief Lists the segment files of a log directory, oldest first.
+ * @param directory The log directory.
+ * @return Full paths of the segment files.
+ */
+std::vector<std::string> MessageLog::list_segments(const std::string &directory) {
+  std::vector<std::string> segments;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(directory, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind(SEGMENT_PREFIX, 0) == 0 && entry.path().extension() == SEGMENT_SUFFIX) {
+      segments.push_back(entry.path().string());
+    }
+  }
+  // Zero-padded names sort in sequence order.
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+/**
+ * @brief Extracts the first sequence number from a segment file name.
+ * @param segment_path Path to the segment file.
+ * @return The first sequence number stored in the segment, or 0 if the name is malformed.
+ */
+uint64_t MessageLog::segment_first_sequence(const std::string &segment_path) {
+  const std::string name = std::filesystem::path(segment_path).filename().string();
+  const size_t prefix_len = std::strlen(SEGMENT_PREFIX);
+  if (name.size() <= prefix_len) {
+    return 0;
+  }
+  return std::strtoull(name.c_str() + prefix_len, nullptr, 10);
+}
+
+/**
+ * @brief Closes the active segment and starts a new one.
+ * @param first_sequence The sequence number of the first record of the new segment.
+ * @return True on success, false otherwise.
+ */
+bool MessageLog::roll_segment(uint64_t first_sequence) {
+  close();
+
+  const std::string path = (std::filesystem::path(directory_) / segment_name(first_sequence)).string();
+  segment_fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (segment_fd_ < 0) {
+    LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to create segment {}: {}", path, std::strerror(errno));
+    return false;
+  }
+
+  segment_bytes_ = 0;
+  LOG_DEBUG(MESSAGE_LOG_COMPONENT, "Started segment {}", path);
+  return true;
+}
+
+/**
+ * @brief Writes one encoded record to the active segment, rolling to a new segment when it is full.
+ * A record that fails partway is cut off again, so that later records do not land behind a torn one.
+ * @param record The record to write.
+ * @return True on success, false otherwise.
+ */
+bool MessageLog::write_record(const LogRecord &record) {
+  if (segment_fd_ == -1 || segment_bytes_ >= segment_size_) {
+    if (!roll_segment(record.sequence)) {
+      return false;
+    }
+  }
+
+  auto bytes = encode_log_record(record);
+  size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t n = ::write(segment_fd_, bytes.data() + written, bytes.size() - written);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to append record {}: {}", record.sequence, std::strerror(errno));
+      if (written > 0 && ftruncate(segment_fd_, static_cast<off_t>(segment_bytes_)) != 0) {
+        // Leave the torn segment behind; open() truncates it on the next start, the next append rolls.
+        LOG_ERROR(MESSAGE_LOG_COMPONENT, "Failed to cut off record {}: {}", record.sequence, std::strerror(errno));
+        close();
+      }
+      return false;
+    }
+    written += static_cast<size_t>(n);
+  }
+
+  segment_bytes_ += bytes.size();
+  last_sequence_ = record.sequence;
+  return true;
+}
+
+} // namespace server
+} // namespace chat_app
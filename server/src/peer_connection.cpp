@@ -0,0 +1,116 @@
+#include "server/peer_connection.h"
+#include "common/logger.h"
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructs a PeerConnection over a connected socket and switches it to non-blocking mode.
+ * @param socket The connected socket.
+ */
+PeerConnection::PeerConnection(std::unique_ptr<common::IStreamSocket> socket) : socket_(std::move(socket)) {
+  socket_->set_non_blocking(true);
+}
+
+/**
+ * @brief Serializes a message and queues it for sending.
+ * @param message The message to send.
+ * @return False if the connection is closed, true otherwise.
+ */
+bool PeerConnection::send_message(const common::Message &message) {
+  return send_bytes(common::serialize_message(message));
+}
+
+/**
+ * @brief Queues already-framed bytes for sending and tries to write them right away.
+ * @param bytes The bytes to send.
+ * @return False if the connection is closed, true otherwise.
+ */
+bool PeerConnection::send_bytes(const std::vector<char> &bytes) {
+  if (!open_) {
+    return false;
+  }
+  write_buffer_.insert(write_buffer_.end(), bytes.begin(), bytes.end());
+  return flush();
+}
+
+/**
+ * @brief Serializes a message and queues it without writing, so that several messages go out
+ * with one write at the next flush().
+ * @param message The message to send.
+ */
+void PeerConnection::queue_message(const common::Message &message) {
+  if (open_) {
+    auto bytes = common::serialize_message(message);
+    write_buffer_.insert(write_buffer_.end(), bytes.begin(), bytes.end());
+  }
+}
+
+/**
+ * @brief Writes as much of the pending output as the socket accepts.
+ * @return False if the connection is closed, true otherwise.
+ */
+bool PeerConnection::flush() {
+  while (open_ && has_pending_writes()) {
+    auto result = socket_->raw_send(write_buffer_.data() + write_offset_, pending_bytes());
+    if (result.status == common::SocketStatus::OK) {
+      write_offset_ += result.bytes_transferred;
+    } else if (result.status == common::SocketStatus::WOULD_BLOCK) {
+      break;
+    } else {
+      LOG_WARNING(PEER_CONNECTION_COMPONENT, "Peer on FD {} closed while sending", get_fd());
+      open_ = false;
+    }
+  }
+
+  if (write_offset_ == write_buffer_.size()) {
+    write_buffer_.clear();
+    write_offset_ = 0;
+  } else if (write_offset_ > write_buffer_.size() / 2) {
+    // A link that drains slowly but never fully would otherwise keep growing its buffer.
+    write_buffer_.erase(write_buffer_.begin(), write_buffer_.begin() + write_offset_);
+    write_offset_ = 0;
+  }
+  return open_;
+}
+
+/**
+ * @brief Reads everything available and hands each complete message to the callback.
+ * @param on_message Called once per complete message.
+ * @return False if the peer closed the connection, true otherwise.
+ */
+bool PeerConnection::receive(const std::function<void(const common::Message &)> &on_message) {
+  constexpr size_t chunk_size = 64 * 1024;
+
+  while (open_) {
+    size_t current_size = read_buffer_.size();
+    read_buffer_.resize(current_size + chunk_size);
+
+    auto result = socket_->raw_receive(read_buffer_.data() + current_size, chunk_size);
+    if (result.status == common::SocketStatus::OK) {
+      read_buffer_.resize(current_size + result.bytes_transferred);
+    } else {
+      read_buffer_.resize(current_size);
+      if (result.status != common::SocketStatus::WOULD_BLOCK) {
+        open_ = false;
+      }
+      break;
+    }
+  }
+
+  size_t offset = 0;
+  while (true) {
+    auto [message, bytes_read] = common::deserialize_message(read_buffer_.data() + offset, read_buffer_.size() - offset);
+    if (!message) {
+      break;
+    }
+    offset += bytes_read;
+    on_message(*message);
+  }
+  read_buffer_.erase(read_buffer_.begin(), read_buffer_.begin() + offset);
+
+  return open_;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,791 @@
+#include "server/prefork.h"
+#include "common/affinity.h"
+#include "common/logger.h"
+#include "server/federation.h"
+#include "server/server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <new>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// Sessions the shared directory has room for.
+constexpr size_t PREFORK_DIRECTORY_CAPACITY = 64 * 1024;
+
+// A worker that exits sooner than this after starting is restarted only after this long, so a
+// worker that cannot start does not spin the supervisor.
+constexpr std::chrono::seconds MIN_WORKER_LIFETIME{1};
+
+size_t align_up(size_t value) { return (value + 63) & ~size_t{63}; }
+
+// Mailboxes start on page boundaries so that each can be placed on its reader's NUMA node.
+size_t align_to_page(size_t value) { return (value + 4095) & ~size_t{4095}; }
+
+uint64_t hash_name(const std::string &username) {
+  uint64_t hash = 14695981039346656037ULL; // FNV-1a
+  for (char c : username) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t hash_id(uint32_t user_id) {
+  uint64_t hash = user_id * 0x9E3779B97F4A7C15ULL;
+  return hash ^ (hash >> 32);
+}
+
+volatile sig_atomic_t stop_requested = 0;
+Server *worker_server = nullptr;
+
+void handle_supervisor_signal(int) { stop_requested = 1; }
+
+void handle_worker_signal(int) {
+  if (worker_server) {
+    worker_server->stop();
+  }
+}
+
+void install_handler(void (*handler)(int)) {
+  struct sigaction action {};
+  action.sa_handler = handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0; // No SA_RESTART: waitpid and epoll_wait return so the flag is seen
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+}
+
+} // namespace
+
+/**
+ * @brief Initializes the mutex as process-shared and robust.
+ */
+void SharedMutex::init() {
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&mutex_, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+}
+
+/**
+ * @brief Locks the mutex, taking it over if its owner died.
+ * @return False if the owner died while holding it, true otherwise.
+ */
+bool SharedMutex::lock() {
+  if (pthread_mutex_lock(&mutex_) == EOWNERDEAD) {
+    pthread_mutex_consistent(&mutex_);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Unlocks the mutex.
+ */
+void SharedMutex::unlock() { pthread_mutex_unlock(&mutex_); }
+
+/**
+ * @brief Gets the shared memory a directory of the given capacity needs.
+ */
+size_t SharedDirectory::bytes_for(size_t capacity) {
+  size_t table_size = 1;
+  while (table_size < capacity * 2) {
+    table_size <<= 1;
+  }
+  return align_up(sizeof(SharedDirectory)) + align_up(table_size * sizeof(NameSlot)) + table_size * sizeof(IdSlot);
+}
+
+/**
+ * @brief Constructs an empty directory in shared memory.
+ * @param memory Zeroed memory of bytes_for(capacity) bytes.
+ * @param capacity The number of sessions it holds.
+ * @return The directory.
+ */
+SharedDirectory *SharedDirectory::create(void *memory, size_t capacity) {
+  auto *directory = new (memory) SharedDirectory();
+  directory->mutex_.init();
+  directory->capacity_ = capacity;
+  directory->table_size_ = 1;
+  while (directory->table_size_ < capacity * 2) {
+    directory->table_size_ <<= 1;
+  }
+  directory->used_ = 0;
+  directory->deleted_ = 0;
+  return directory;
+}
+
+/**
+ * @brief Records a session, unless its username is taken.
+ * @param user_id The user ID.
+ * @param username The username.
+ * @param worker The worker the session is on.
+ * @param slot The session's FD in that worker.
+ * @return True if the session was recorded, false if the username is taken or the directory is full.
+ */
+bool SharedDirectory::claim(uint32_t user_id, const std::string &username, uint32_t worker, int32_t slot) {
+  if (username.size() > PREFORK_MAX_USERNAME) {
+    return false;
+  }
+  lock();
+  size_t name_position = find_name(username);
+  if (names()[name_position].state == USED || used_ >= capacity_) {
+    mutex_.unlock();
+    return false;
+  }
+  // deleted_ counts tombstones made since the last rebuild, reused or not, which bounds the
+  // non-empty slots of both tables and so keeps an empty slot in each to end probes at.
+  if (used_ + deleted_ + 1 > table_size_ * 3 / 4) {
+    rebuild();
+    name_position = find_name(username);
+  }
+
+  NameSlot &name = names()[name_position];
+  name.user_id = user_id;
+  name.worker = worker;
+  name.slot = slot;
+  std::memcpy(name.username, username.c_str(), username.size() + 1);
+  name.state = USED;
+
+  IdSlot &id = ids()[find_id(user_id)];
+  id.user_id = user_id;
+  id.position = static_cast<uint32_t>(name_position);
+  id.state = USED;
+  ++used_;
+  mutex_.unlock();
+  return true;
+}
+
+/**
+ * @brief Removes a session.
+ * @param user_id The user ID.
+ */
+void SharedDirectory::release(uint32_t user_id) {
+  lock();
+  const size_t id_position = find_id(user_id);
+  if (ids()[id_position].state == USED) {
+    erase(id_position);
+  }
+  mutex_.unlock();
+}
+
+/**
+ * @brief Looks up where a user's session is.
+ * @param user_id The user ID.
+ * @return The worker and slot, or nullopt if the user is not online.
+ */
+std::optional<SharedDirectory::Location> SharedDirectory::find(uint32_t user_id) {
+  lock();
+  std::optional<Location> location;
+  const IdSlot &id = ids()[find_id(user_id)];
+  if (id.state == USED) {
+    const NameSlot &name = names()[id.position];
+    location = Location{name.worker, name.slot};
+  }
+  mutex_.unlock();
+  return location;
+}
+
+/**
+ * @brief Checks whether a session with a username exists on any worker.
+ * @param username The username.
+ * @return True if the name is taken.
+ */
+bool SharedDirectory::is_username_taken(const std::string &username) {
+  lock();
+  const bool taken = names()[find_name(username)].state == USED;
+  mutex_.unlock();
+  return taken;
+}
+
+/**
+ * @brief Lists all sessions.
+ * @return The sessions.
+ */
+std::vector<SharedDirectory::Entry> SharedDirectory::entries() {
+  std::vector<Entry> result;
+  lock();
+  for (size_t i = 0; i < table_size_; ++i) {
+    const NameSlot &name = names()[i];
+    if (name.state == USED) {
+      result.push_back(Entry{name.user_id, name.worker, name.username});
+    }
+  }
+  mutex_.unlock();
+  return result;
+}
+
+/**
+ * @brief Removes the sessions of a worker that died.
+ * @param worker The worker.
+ * @return The removed sessions.
+ */
+std::vector<SharedDirectory::Entry> SharedDirectory::purge_worker(uint32_t worker) {
+  std::vector<Entry> purged;
+  lock();
+  for (size_t i = 0; i < table_size_; ++i) {
+    const NameSlot &name = names()[i];
+    if (name.state == USED && name.worker == worker) {
+      purged.push_back(Entry{name.user_id, name.worker, name.username});
+      erase(find_id(name.user_id));
+    }
+  }
+  mutex_.unlock();
+  return purged;
+}
+
+SharedDirectory::NameSlot *SharedDirectory::names() {
+  return reinterpret_cast<NameSlot *>(reinterpret_cast<char *>(this) + align_up(sizeof(SharedDirectory)));
+}
+
+SharedDirectory::IdSlot *SharedDirectory::ids() {
+  return reinterpret_cast<IdSlot *>(reinterpret_cast<char *>(names()) + align_up(table_size_ * sizeof(NameSlot)));
+}
+
+/**
+ * @brief Locks the directory. If a worker died halfway through an update, the indexes are
+ * rebuilt from the name table, which is written before them.
+ */
+void SharedDirectory::lock() {
+  if (!mutex_.lock()) {
+    LOG_WARNING(PREFORK_COMPONENT, "A worker died while updating the session directory, rebuilding it");
+    rebuild();
+  }
+}
+
+/**
+ * @brief Finds a username's slot in the name table: the slot holding it, or else where it goes.
+ */
+size_t SharedDirectory::find_name(const std::string &username) {
+  const size_t mask = table_size_ - 1;
+  size_t free_position = table_size_;
+  for (size_t position = hash_name(username) & mask;; position = (position + 1) & mask) {
+    const NameSlot &slot = names()[position];
+    if (slot.state == EMPTY) {
+      return free_position < table_size_ ? free_position : position;
+    }
+    if (slot.state == DELETED) {
+      free_position = std::min(free_position, position);
+    } else if (username == slot.username) {
+      return position;
+    }
+  }
+}
+
+/**
+ * @brief Finds a user ID's slot in the ID table: the slot holding it, or else where it goes.
+ */
+size_t SharedDirectory::find_id(uint32_t user_id) {
+  const size_t mask = table_size_ - 1;
+  size_t free_position = table_size_;
+  for (size_t position = hash_id(user_id) & mask;; position = (position + 1) & mask) {
+    const IdSlot &slot = ids()[position];
+    if (slot.state == EMPTY) {
+      return free_position < table_size_ ? free_position : position;
+    }
+    if (slot.state == DELETED) {
+      free_position = std::min(free_position, position);
+    } else if (slot.user_id == user_id) {
+      return position;
+    }
+  }
+}
+
+/**
+ * @brief Removes the session at a position of the ID table, leaving tombstones.
+ */
+void SharedDirectory::erase(size_t id_position) {
+  IdSlot &id = ids()[id_position];
+  names()[id.position].state = DELETED;
+  id.state = DELETED;
+  --used_;
+  ++deleted_;
+}
+
+/**
+ * @brief Reinserts all sessions, dropping tombstones and rebuilding the ID index.
+ */
+void SharedDirectory::rebuild() {
+  std::vector<NameSlot> sessions;
+  for (size_t i = 0; i < table_size_; ++i) {
+    if (names()[i].state == USED) {
+      sessions.push_back(names()[i]);
+    }
+  }
+  std::memset(static_cast<void *>(names()), 0, table_size_ * sizeof(NameSlot));
+  std::memset(static_cast<void *>(ids()), 0, table_size_ * sizeof(IdSlot));
+  used_ = 0;
+  deleted_ = 0;
+  for (const auto &session : sessions) {
+    const size_t name_position = find_name(session.username);
+    names()[name_position] = session;
+    IdSlot &id = ids()[find_id(session.user_id)];
+    id.user_id = session.user_id;
+    id.position = static_cast<uint32_t>(name_position);
+    id.state = USED;
+    ++used_;
+  }
+}
+
+/**
+ * @brief Gets the shared memory the mailboxes of the given number of workers need.
+ */
+size_t SharedMailboxes::bytes_for(size_t workers) {
+  return align_to_page(sizeof(SharedMailboxes)) + workers * align_to_page(sizeof(Mailbox));
+}
+
+/**
+ * @brief Constructs empty mailboxes in shared memory, each with its eventfd.
+ * @param memory Zeroed memory of bytes_for(workers) bytes.
+ * @param workers The number of workers.
+ * @return The mailboxes, or nullptr if an eventfd could not be created.
+ */
+SharedMailboxes *SharedMailboxes::create(void *memory, size_t workers) {
+  auto *mailboxes = new (memory) SharedMailboxes();
+  mailboxes->workers_ = workers;
+  for (uint32_t worker = 0; worker < workers; ++worker) {
+    Mailbox &box = mailboxes->mailbox(worker);
+    box.mutex.init();
+    box.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (box.event_fd < 0) {
+      LOG_ERROR(PREFORK_COMPONENT, "Failed to create eventfd: {}", std::strerror(errno));
+      return nullptr;
+    }
+  }
+  return mailboxes;
+}
+
+/**
+ * @brief Gets the eventfd signaled when a worker's mailbox receives events.
+ */
+int SharedMailboxes::event_fd(uint32_t worker) const {
+  return const_cast<SharedMailboxes *>(this)->mailbox(worker).event_fd;
+}
+
+/**
+ * @brief Posts an event to a worker's mailbox.
+ * @param worker The worker.
+ * @param message The event.
+ * @param slot The receiver's FD in that worker, or -1.
+ * @return False if the mailbox is full and the event was dropped, true otherwise.
+ */
+bool SharedMailboxes::post(uint32_t worker, const common::Message &message, int32_t slot) {
+  const auto bytes = common::serialize_message(message);
+  const size_t frame_size = sizeof(slot) + bytes.size();
+  Mailbox &box = mailbox(worker);
+  lock(box);
+  if (box.tail - box.head + frame_size > PREFORK_MAILBOX_BYTES) {
+    box.mutex.unlock();
+    return false;
+  }
+  const bool was_empty = box.head == box.tail;
+  auto append = [&box](const char *data, size_t size) {
+    const size_t offset = box.tail % PREFORK_MAILBOX_BYTES;
+    const size_t first = std::min(size, PREFORK_MAILBOX_BYTES - offset);
+    std::memcpy(box.data + offset, data, first);
+    std::memcpy(box.data, data + first, size - first);
+    box.tail += size;
+  };
+  append(reinterpret_cast<const char *>(&slot), sizeof(slot));
+  append(bytes.data(), bytes.size());
+  box.mutex.unlock();
+
+  // The worker empties its mailbox whenever woken, so only the first event needs to wake it.
+  if (was_empty) {
+    const uint64_t one = 1;
+    if (write(box.event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+      LOG_ERROR(PREFORK_COMPONENT, "Failed to wake worker {}: {}", worker, std::strerror(errno));
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Takes all events out of a worker's mailbox.
+ * @param worker The worker.
+ * @param on_message Called with each event and its slot.
+ */
+void SharedMailboxes::drain(uint32_t worker, const std::function<void(const common::Message &, int32_t)> &on_message) {
+  Mailbox &box = mailbox(worker);
+  uint64_t wakeups;
+  (void)!read(box.event_fd, &wakeups, sizeof(wakeups));
+
+  std::vector<char> bytes;
+  lock(box);
+  bytes.resize(box.tail - box.head);
+  const size_t offset = box.head % PREFORK_MAILBOX_BYTES;
+  const size_t first = std::min(bytes.size(), PREFORK_MAILBOX_BYTES - offset);
+  std::memcpy(bytes.data(), box.data + offset, first);
+  std::memcpy(bytes.data() + first, box.data, bytes.size() - first);
+  box.head = box.tail;
+  box.mutex.unlock();
+
+  size_t position = 0;
+  while (position + sizeof(int32_t) < bytes.size()) {
+    int32_t slot;
+    std::memcpy(&slot, bytes.data() + position, sizeof(slot));
+    auto [message, consumed] =
+        common::deserialize_message(bytes.data() + position + sizeof(slot), bytes.size() - position - sizeof(slot));
+    if (!message) {
+      break;
+    }
+    position += sizeof(slot) + consumed;
+    on_message(*message, slot);
+  }
+}
+
+/**
+ * @brief Empties a worker's mailbox, for the worker replacing one that died.
+ */
+void SharedMailboxes::reset(uint32_t worker) {
+  Mailbox &box = mailbox(worker);
+  lock(box);
+  box.head = box.tail;
+  box.mutex.unlock();
+}
+
+/**
+ * @brief Places a worker's mailbox on a NUMA node. Posters on other nodes write to it remotely,
+ * but its reader, which also takes the lock and copies everything out, stays local.
+ * @param worker The worker.
+ * @param node The node of the CPU the worker runs on.
+ * @return True on success, false otherwise.
+ */
+bool SharedMailboxes::bind_to_node(uint32_t worker, int node) {
+  return common::bind_memory_to_node(&mailbox(worker), align_to_page(sizeof(Mailbox)), node);
+}
+
+SharedMailboxes::Mailbox &SharedMailboxes::mailbox(uint32_t worker) {
+  char *first = reinterpret_cast<char *>(this) + align_to_page(sizeof(SharedMailboxes));
+  return *reinterpret_cast<Mailbox *>(first + worker * align_to_page(sizeof(Mailbox)));
+}
+
+/**
+ * @brief Locks a mailbox. If a worker died halfway through posting, the mailbox's contents are dropped.
+ */
+void SharedMailboxes::lock(Mailbox &box) {
+  if (!box.mutex.lock()) {
+    LOG_WARNING(PREFORK_COMPONENT, "A worker died while posting to a mailbox, dropping its contents");
+    box.head = box.tail;
+  }
+}
+
+/**
+ * @brief Maps the shared memory of a prefork server and sets up the directory and mailboxes in it.
+ * @param workers The number of workers.
+ * @param directory_capacity The number of sessions the directory holds.
+ * @return The shared state, or nullptr on failure.
+ */
+std::unique_ptr<PreforkShared> PreforkShared::create(size_t workers, size_t directory_capacity) {
+  auto shared = std::unique_ptr<PreforkShared>(new PreforkShared());
+  const size_t directory_bytes = align_to_page(SharedDirectory::bytes_for(directory_capacity));
+  const size_t mailbox_bytes = align_up(SharedMailboxes::bytes_for(workers));
+  shared->bytes_ = directory_bytes + mailbox_bytes + workers * sizeof(WorkerStats);
+  shared->memory_ = mmap(nullptr, shared->bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared->memory_ == MAP_FAILED) {
+    LOG_ERROR(PREFORK_COMPONENT, "Failed to map {} bytes of shared memory: {}", shared->bytes_, std::strerror(errno));
+    shared->memory_ = nullptr;
+    return nullptr;
+  }
+  shared->directory_ = SharedDirectory::create(shared->memory_, directory_capacity);
+  shared->mailboxes_ = SharedMailboxes::create(static_cast<char *>(shared->memory_) + directory_bytes, workers);
+  if (!shared->mailboxes_) {
+    return nullptr;
+  }
+  shared->stats_ = new (static_cast<char *>(shared->memory_) + directory_bytes + mailbox_bytes) WorkerStats[workers];
+  return shared;
+}
+
+/**
+ * @brief Destructor for PreforkShared. Unmaps this process's view of the shared memory.
+ */
+PreforkShared::~PreforkShared() {
+  if (memory_) {
+    munmap(memory_, bytes_);
+  }
+}
+
+/**
+ * @brief Constructs a worker's bus and starts watching its mailbox.
+ * @param epoll_manager The worker's reactor.
+ * @param shared The shared state, mapped before the worker was forked.
+ * @param worker The worker's index.
+ * @param metrics The worker's metrics.
+ * @param deliver Called for each event from another worker.
+ */
+PreforkBus::PreforkBus(EpollManager &epoll_manager, PreforkShared &shared, uint32_t worker, common::Metrics &metrics,
+                       DeliverCallback deliver)
+    : epoll_manager_(epoll_manager), shared_(shared), directory_(shared.directory()), mailboxes_(shared.mailboxes()),
+      worker_(worker), metrics_(metrics), deliver_(std::move(deliver)), event_fd_(mailboxes_.event_fd(worker)) {
+  epoll_manager_.add_fd(event_fd_, EPOLLIN | EPOLLET);
+  // Events posted before a restart were meant for the previous worker's sessions.
+  mailboxes_.reset(worker_);
+}
+
+/**
+ * @brief Destructor for PreforkBus. Stops watching the mailbox.
+ */
+PreforkBus::~PreforkBus() { epoll_manager_.remove_fd(event_fd_); }
+
+/**
+ * @brief Delivers the events in this worker's mailbox.
+ */
+void PreforkBus::handle_event() {
+  size_t received = 0;
+  mailboxes_.drain(worker_, [this, &received](const common::Message &message, int32_t slot) {
+    ++received;
+    deliver_(message, slot);
+  });
+  metrics_.increment_counter("prefork_events_received", received);
+}
+
+/**
+ * @brief Publishes a joining session in the shared directory.
+ * @param user_id The user ID.
+ * @param username The username.
+ * @param slot The session's FD.
+ * @return False if another worker admitted the name first, true otherwise.
+ */
+bool PreforkBus::claim(uint32_t user_id, const std::string &username, int32_t slot) {
+  return directory_.claim(user_id, username, worker_, slot);
+}
+
+/**
+ * @brief Removes a leaving session from the shared directory.
+ * @param user_id The user ID.
+ */
+void PreforkBus::release(uint32_t user_id) { directory_.release(user_id); }
+
+/**
+ * @brief Checks whether a username is online on any worker.
+ */
+bool PreforkBus::is_username_online(const std::string &username) { return directory_.is_username_taken(username); }
+
+/**
+ * @brief Lists the sessions of the other workers.
+ */
+std::vector<WorkerSession> PreforkBus::get_remote_users() {
+  auto users = directory_.entries();
+  users.erase(std::remove_if(users.begin(), users.end(),
+                             [this](const SharedDirectory::Entry &entry) { return entry.worker == worker_; }),
+              users.end());
+  return users;
+}
+
+/**
+ * @brief Sends a local event (join, leave, broadcast) to every other worker.
+ * @param event The event.
+ */
+void PreforkBus::forward(const common::Message &event) {
+  for (uint32_t worker = 0; worker < mailboxes_.workers(); ++worker) {
+    if (worker != worker_ && !mailboxes_.post(worker, event, -1)) {
+      metrics_.increment_counter("prefork_mailbox_full");
+    }
+  }
+}
+
+/**
+ * @brief Sends a private message to the worker with the receiver's session, or reports an
+ * offline receiver to the sender.
+ * @param message The S2C_PRIVATE.
+ */
+void PreforkBus::route_private(const common::Message &message) {
+  auto location = directory_.find(message.header.receiver_id);
+  if (location && location->worker != worker_ && mailboxes_.post(location->worker, message, location->slot)) {
+    return;
+  }
+  if (location && location->worker != worker_) {
+    metrics_.increment_counter("prefork_mailbox_full");
+  }
+  deliver_(common::Message(common::MessageType::S2C_ERROR, common::SERVER_ID, message.header.sender_id,
+                           "Receiver not found or not connected."),
+           -1);
+}
+
+/**
+ * @brief Places this worker's mailbox on its NUMA node.
+ * @param node The node of the CPU the worker is pinned to.
+ */
+void PreforkBus::place_mailbox(int node) {
+  if (mailboxes_.bind_to_node(worker_, node)) {
+    metrics_.set_gauge("prefork_mailbox_node", node);
+  }
+}
+
+/**
+ * @brief Counts a connection this worker accepted, and whether it arrived on another CPU than the
+ * one the worker runs on.
+ * @param fd The connection's FD.
+ */
+void PreforkBus::note_connection_opened(int fd) { count_connection(shared_.worker_stats(worker_), fd, metrics_); }
+
+/**
+ * @brief Counts a connection of this worker that closed.
+ */
+void PreforkBus::note_connection_closed() { --shared_.worker_stats(worker_).connected; }
+
+/**
+ * @brief Publishes the connection counts of all workers.
+ */
+void PreforkBus::report_balance() { publish_worker_balance(metrics_, &shared_.worker_stats(0), mailboxes_.workers()); }
+
+namespace {
+
+/**
+ * @brief Forks a worker running a server on the shared port.
+ * @param listeners One listener per worker when connections are steered by CPU, else empty.
+ * @return The worker's PID, or -1 on failure.
+ */
+pid_t spawn_worker(int port, const ServerConfig &config, PreforkShared &shared, uint32_t worker,
+                   std::vector<std::unique_ptr<common::IListeningSocket>> &listeners) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    if (pid < 0) {
+      LOG_ERROR(PREFORK_COMPONENT, "Failed to fork worker {}: {}", worker, std::strerror(errno));
+    }
+    return pid;
+  }
+
+  prctl(PR_SET_PDEATHSIG, SIGTERM); // Do not outlive the supervisor
+  ServerConfig worker_config = config;
+  worker_config.reuse_port = true;
+  if (!worker_config.metrics_file.empty()) {
+    worker_config.metrics_file += "." + std::to_string(worker);
+  }
+  std::unique_ptr<common::IListeningSocket> listener;
+  if (!listeners.empty()) {
+    worker_config.reactor_cpu = static_cast<int>(worker);
+    listener = std::move(listeners[worker]);
+    listeners.clear(); // This process's copies of the other workers' listeners
+  } else if (config.reactor_cpu >= 0) {
+    worker_config.reactor_cpu = config.reactor_cpu + static_cast<int>(worker); // One CPU each, from the given one
+  }
+
+  Server server(port, worker_config);
+  server.set_prefork(&shared, worker);
+  if (listener) {
+    server.adopt_listener(std::move(listener));
+  }
+  worker_server = &server;
+  install_handler(handle_worker_signal);
+  server.run();
+  worker_server = nullptr;
+  _exit(0);
+}
+
+/**
+ * @brief Announces the sessions of a dead worker as gone to the other workers.
+ */
+void announce_departures(PreforkShared &shared, uint32_t dead_worker,
+                         const std::vector<SharedDirectory::Entry> &sessions) {
+  for (const auto &session : sessions) {
+    common::Message user_left(common::MessageType::S2C_USER_LEFT, session.user_id, common::BROADCAST_ID,
+                              session.username);
+    for (uint32_t worker = 0; worker < shared.mailboxes().workers(); ++worker) {
+      if (worker != dead_worker) {
+        shared.mailboxes().post(worker, user_left, -1);
+      }
+    }
+  }
+}
+
+} // namespace
+
+/**
+ * @brief Runs a prefork server: forks single-threaded-reactor workers that share the client port
+ * with SO_REUSEPORT and each other's sessions through shared memory, restarts workers that die,
+ * and stops them all on SIGINT or SIGTERM. A crashing worker only takes its own connections down.
+ * With config.cpu_steering, worker i is pinned to CPU i and accepts the connections that arrive on it.
+ *
+ * @param port The client port.
+ * @param config The server settings, applied to every worker.
+ * @param workers The number of workers (1-MAX_NODE_ID).
+ * @return The process exit code.
+ */
+int run_prefork(int port, const ServerConfig &config, size_t workers) {
+  if (!check_worker_config(config, workers, "Prefork")) {
+    return 1;
+  }
+
+  auto shared = PreforkShared::create(workers, PREFORK_DIRECTORY_CAPACITY);
+  if (!shared) {
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<common::IListeningSocket>> listeners;
+  if (config.cpu_steering) {
+    // The supervisor keeps these open, so connections steered to a restarting worker wait in its backlog.
+    listeners = bind_steered_listeners(port, workers);
+    if (listeners.empty()) {
+      return 1;
+    }
+  }
+
+  install_handler(handle_supervisor_signal);
+  std::vector<pid_t> pids(workers, -1);
+  std::vector<std::chrono::steady_clock::time_point> started(workers);
+  for (uint32_t worker = 0; worker < workers; ++worker) {
+    pids[worker] = spawn_worker(port, config, *shared, worker, listeners);
+    started[worker] = std::chrono::steady_clock::now();
+  }
+  LOG_INFO(PREFORK_COMPONENT, "Started {} workers on port {}", workers, port);
+
+  while (!stop_requested) {
+    int status = 0;
+    const pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    auto it = std::find(pids.begin(), pids.end(), pid);
+    if (it == pids.end()) {
+      continue;
+    }
+
+    const auto worker = static_cast<uint32_t>(it - pids.begin());
+    auto sessions = shared->directory().purge_worker(worker);
+    LOG_WARNING(PREFORK_COMPONENT, "Worker {} (PID {}) exited with status {}, {} sessions lost", worker, pid, status,
+                sessions.size());
+    announce_departures(*shared, worker, sessions);
+
+    if (std::chrono::steady_clock::now() - started[worker] < MIN_WORKER_LIFETIME) {
+      std::this_thread::sleep_for(MIN_WORKER_LIFETIME);
+    }
+    if (!stop_requested) {
+      pids[worker] = spawn_worker(port, config, *shared, worker, listeners);
+      started[worker] = std::chrono::steady_clock::now();
+    }
+  }
+
+  LOG_INFO(PREFORK_COMPONENT, "Stopping workers");
+  for (pid_t pid : pids) {
+    if (pid > 0) {
+      kill(pid, SIGTERM);
+    }
+  }
+  for (pid_t pid : pids) {
+    if (pid > 0) {
+      waitpid(pid, nullptr, 0);
+    }
+  }
+  return 0;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,252 @@
+#include "server/presence_table.h"
+#include <cstdlib>
+#include <sstream>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// First character of a delta's header line.
+constexpr char DELTA_CHANGES = 'D';
+constexpr char DELTA_FULL = 'F';
+
+// First line of a digest.
+constexpr char DIGEST_QUERY = 'Q';
+constexpr char DIGEST_REPLY = 'R';
+
+const std::unordered_map<uint32_t, std::string> NO_USERS;
+
+} // namespace
+
+/**
+ * @brief Constructs a table that knows only the local node, with no users yet.
+ * @param local_node_id This node's ID.
+ * @param initial_version The local presence version before the first change.
+ */
+PresenceTable::PresenceTable(uint32_t local_node_id, uint64_t initial_version) : local_node_id_(local_node_id) {
+  NodePresence &local = nodes_[local_node_id_];
+  local.version = initial_version;
+  local.log_base = initial_version;
+}
+
+/**
+ * @brief Records a user joining this node.
+ * @param user_id The user ID.
+ * @param username The username.
+ */
+void PresenceTable::local_join(uint32_t user_id, const std::string &username) {
+  NodePresence &local = nodes_[local_node_id_];
+  record(local, Change{local.version + 1, user_id, true, username});
+}
+
+/**
+ * @brief Records a user leaving this node.
+ * @param user_id The user ID.
+ */
+void PresenceTable::local_leave(uint32_t user_id) {
+  NodePresence &local = nodes_[local_node_id_];
+  record(local, Change{local.version + 1, user_id, false, ""});
+}
+
+/**
+ * @brief Builds a digest of the versions known for every node.
+ * @param reply True when answering a digest, so the receiver does not answer again.
+ * @return An S2S_PRESENCE_DIGEST message. Payload: 'Q' or 'R', then one "node version" line per node.
+ */
+common::Message PresenceTable::make_digest(bool reply) const {
+  std::string payload(1, reply ? DIGEST_REPLY : DIGEST_QUERY);
+  payload += '\n';
+  for (const auto &[node_id, presence] : nodes_) {
+    payload += std::to_string(node_id) + ' ' + std::to_string(presence.version) + '\n';
+  }
+  return common::Message(common::MessageType::S2S_PRESENCE_DIGEST, common::SERVER_ID, common::SERVER_ID, payload);
+}
+
+/**
+ * @brief Compares a peer's digest with this table.
+ * @param digest The peer's S2S_PRESENCE_DIGEST.
+ * @param peer_is_ahead Set to true if the peer knows a newer version of some node and the digest
+ * was not itself a reply, i.e. this node should send its own digest back.
+ * @return One S2S_PRESENCE_DELTA per node the peer is behind on.
+ */
+std::vector<common::Message> PresenceTable::answer_digest(const common::Message &digest, bool &peer_is_ahead) const {
+  std::unordered_map<uint32_t, uint64_t> peer_versions;
+  std::istringstream lines(digest.payload);
+  std::string kind;
+  std::getline(lines, kind);
+  uint32_t node_id;
+  uint64_t version;
+  while (lines >> node_id >> version) {
+    peer_versions[node_id] = version;
+  }
+
+  peer_is_ahead = false;
+  if (kind.size() == 1 && kind[0] == DIGEST_QUERY) {
+    for (const auto &[peer_node, peer_version] : peer_versions) {
+      if (peer_version > version_of(peer_node) && peer_node != local_node_id_) {
+        peer_is_ahead = true;
+      }
+    }
+  }
+
+  std::vector<common::Message> deltas;
+  for (const auto &[node_id, presence] : nodes_) {
+    auto it = peer_versions.find(node_id);
+    const uint64_t since = it == peer_versions.end() ? 0 : it->second;
+    if (presence.version > since) {
+      deltas.push_back(make_delta(node_id, presence, since));
+    }
+  }
+  return deltas;
+}
+
+/**
+ * @brief Applies a delta received from a peer. Deltas about this node, stale deltas and deltas
+ * that do not start at the known version are ignored; a later round of gossip repairs the gap.
+ * @param delta The S2S_PRESENCE_DELTA.
+ * @return The S2C_USER_JOINED and S2C_USER_LEFT events the delta amounts to.
+ */
+std::vector<common::Message> PresenceTable::apply_delta(const common::Message &delta) {
+  std::vector<common::Message> events;
+  const uint32_t node_id = delta.header.sender_id;
+  if (node_id == local_node_id_) {
+    return events;
+  }
+
+  std::istringstream lines(delta.payload);
+  char kind = 0;
+  uint64_t base = 0;
+  uint64_t version = 0;
+  std::string line;
+  if (!(lines >> kind >> base >> version) || !std::getline(lines, line)) {
+    return events;
+  }
+  NodePresence &presence = nodes_[node_id];
+  if (version <= presence.version || (kind == DELTA_CHANGES && base != presence.version)) {
+    return events;
+  }
+
+  if (kind == DELTA_FULL) {
+    std::unordered_map<uint32_t, std::string> users;
+    while (std::getline(lines, line)) {
+      const size_t space = line.find(' ');
+      if (line.size() > 1 && line[0] == '+' && space != std::string::npos) {
+        users[static_cast<uint32_t>(std::strtoul(line.c_str() + 1, nullptr, 10))] = line.substr(space + 1);
+      }
+    }
+    for (const auto &[user_id, username] : presence.users) {
+      if (users.count(user_id) == 0) {
+        events.emplace_back(common::MessageType::S2C_USER_LEFT, user_id, common::BROADCAST_ID, username);
+      }
+    }
+    for (const auto &[user_id, username] : users) {
+      if (presence.users.count(user_id) == 0) {
+        events.emplace_back(common::MessageType::S2C_USER_JOINED, user_id, common::BROADCAST_ID, username);
+      }
+    }
+    presence.users = std::move(users);
+    presence.log.clear();
+    presence.version = version;
+    presence.log_base = version;
+    return events;
+  }
+
+  uint64_t next = base;
+  while (std::getline(lines, line) && line.size() > 1) {
+    const uint32_t user_id = static_cast<uint32_t>(std::strtoul(line.c_str() + 1, nullptr, 10));
+    const size_t space = line.find(' ');
+    Change change{++next, user_id, line[0] == '+', space == std::string::npos ? "" : line.substr(space + 1)};
+    if (change.joined) {
+      events.emplace_back(common::MessageType::S2C_USER_JOINED, user_id, common::BROADCAST_ID, change.username);
+    } else if (presence.users.count(user_id) > 0) {
+      events.emplace_back(common::MessageType::S2C_USER_LEFT, user_id, common::BROADCAST_ID, presence.users[user_id]);
+    }
+    record(presence, std::move(change));
+  }
+  return events;
+}
+
+/**
+ * @brief Forgets a node that left the cluster.
+ * @param node_id The node ID.
+ * @return An S2C_USER_LEFT event for each of the node's users.
+ */
+std::vector<common::Message> PresenceTable::drop_node(uint32_t node_id) {
+  std::vector<common::Message> events;
+  auto it = nodes_.find(node_id);
+  if (it == nodes_.end() || node_id == local_node_id_) {
+    return events;
+  }
+  for (const auto &[user_id, username] : it->second.users) {
+    events.emplace_back(common::MessageType::S2C_USER_LEFT, user_id, common::BROADCAST_ID, username);
+  }
+  nodes_.erase(it);
+  return events;
+}
+
+/**
+ * @brief Gets the presence version known for a node.
+ * @param node_id The node ID.
+ * @return The version, or 0 if nothing is known about the node.
+ */
+uint64_t PresenceTable::version_of(uint32_t node_id) const {
+  auto it = nodes_.find(node_id);
+  return it == nodes_.end() ? 0 : it->second.version;
+}
+
+/**
+ * @brief Gets the users known to be online on a node.
+ * @param node_id The node ID.
+ * @return User ID to username.
+ */
+const std::unordered_map<uint32_t, std::string> &PresenceTable::users_of(uint32_t node_id) const {
+  auto it = nodes_.find(node_id);
+  return it == nodes_.end() ? NO_USERS : it->second.users;
+}
+
+/**
+ * @brief Applies a change to a node's presence and logs it, trimming the log to PRESENCE_LOG_LENGTH.
+ */
+void PresenceTable::record(NodePresence &presence, Change change) {
+  if (change.joined) {
+    presence.users[change.user_id] = change.username;
+  } else {
+    presence.users.erase(change.user_id);
+  }
+  presence.version = change.version;
+  presence.log.push_back(std::move(change));
+  if (presence.log.size() > PRESENCE_LOG_LENGTH) {
+    presence.log_base = presence.log.front().version;
+    presence.log.pop_front();
+  }
+}
+
+/**
+ * @brief Builds the delta bringing a peer from a version of a node's presence to the current one.
+ * @return An S2S_PRESENCE_DELTA. Sender ID: the node. Payload: a "kind base version" line, then
+ * "+id name" or "-id" lines; kind 'D' lists the changes since base, kind 'F' all current users.
+ */
+common::Message PresenceTable::make_delta(uint32_t node_id, const NodePresence &presence, uint64_t since) const {
+  const bool full = since < presence.log_base;
+  std::string payload = std::string(1, full ? DELTA_FULL : DELTA_CHANGES) + ' ' + std::to_string(since) + ' ' +
+                        std::to_string(presence.version) + '\n';
+  if (full) {
+    for (const auto &[user_id, username] : presence.users) {
+      payload += '+' + std::to_string(user_id) + ' ' + username + '\n';
+    }
+  } else {
+    for (const auto &change : presence.log) {
+      if (change.version <= since) {
+        continue;
+      }
+      payload += change.joined ? '+' + std::to_string(change.user_id) + ' ' + change.username
+                               : '-' + std::to_string(change.user_id);
+      payload += '\n';
+    }
+  }
+  return common::Message(common::MessageType::S2S_PRESENCE_DELTA, node_id, common::SERVER_ID, payload);
+}
+
+} // namespace server
+} // namespace chat_app
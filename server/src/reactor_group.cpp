@@ -0,0 +1,351 @@
+#include "server/reactor_group.h"
+#include "common/logger.h"
+#include "server/server.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <pthread.h>
+#include <thread>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructor for ReactorGroup.
+ * @param reactors The number of reactors.
+ * @param mailbox_capacity The deliveries each mailbox holds.
+ */
+ReactorGroup::ReactorGroup(size_t reactors, size_t mailbox_capacity)
+    : reactors_(reactors), stats_(new WorkerStats[reactors]), directory_(reactors) {
+  mailboxes_.reserve(reactors * reactors);
+  for (size_t i = 0; i < reactors * reactors; ++i) {
+    // A reactor does not post to itself.
+    const bool self = i / reactors == i % reactors;
+    mailboxes_.push_back(std::make_unique<common::SpscQueue<ReactorDelivery>>(self ? 0 : mailbox_capacity));
+  }
+  for (size_t reactor = 0; reactor < reactors; ++reactor) {
+    signals_.push_back(std::make_unique<common::WakeupSignal>());
+  }
+}
+
+/**
+ * @brief Checks that every reactor's wakeup was created.
+ */
+bool ReactorGroup::is_valid() const {
+  for (const auto &signal : signals_) {
+    if (!signal->is_valid()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Pops up to max_count deliveries from the mailboxes into this reactor, taking each
+ * mailbox's in order.
+ */
+size_t ReactorBus::Inbox::pop_batch(ReactorDelivery *out, size_t max_count) {
+  size_t popped = 0;
+  for (uint32_t from = 0; from < group_.reactors() && popped < max_count; ++from) {
+    if (from != reactor_) {
+      popped += group_.mailbox(from, reactor_).pop_batch(out + popped, max_count - popped);
+    }
+  }
+  return popped;
+}
+
+/**
+ * @brief Checks whether every mailbox into this reactor is empty.
+ */
+bool ReactorBus::Inbox::empty() const {
+  for (uint32_t from = 0; from < group_.reactors(); ++from) {
+    if (from != reactor_ && !group_.mailbox(from, reactor_).empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Constructor for ReactorBus. Starts watching the reactor's wakeup.
+ * @param epoll_manager The reactor's epoll manager.
+ * @param group The group.
+ * @param reactor This reactor's index.
+ * @param metrics The reactor's metrics.
+ * @param deliver Hands a private message or an error to a local session.
+ * @param broadcast Hands a run of broadcasts to every local session.
+ */
+ReactorBus::ReactorBus(EpollManager &epoll_manager, ReactorGroup &group, uint32_t reactor, common::Metrics &metrics,
+                       FrameCallback deliver, BroadcastCallback broadcast)
+    : epoll_manager_(epoll_manager), group_(group), reactor_(reactor), metrics_(metrics), deliver_(std::move(deliver)),
+      broadcast_(std::move(broadcast)), inbox_(group, reactor), backlog_(group.reactors()) {
+  epoll_manager_.add_fd(group_.signal(reactor_).get_fd(), EPOLLIN | EPOLLET);
+}
+
+/**
+ * @brief Destructor for ReactorBus. Stops watching the wakeup.
+ */
+ReactorBus::~ReactorBus() { epoll_manager_.remove_fd(group_.signal(reactor_).get_fd()); }
+
+/**
+ * @brief Delivers what the other reactors posted while this one was waiting.
+ */
+void ReactorBus::handle_event() { drain_inbox(); }
+
+/**
+ * @brief Called once per loop iteration: retries posts that found a mailbox full, delivers what
+ * arrived meanwhile, and lets the directory free what this reactor has read from it.
+ */
+void ReactorBus::poll() {
+  group_.directory().quiesce(reactor_);
+  flush_backlog();
+  if (!inbox_.empty()) {
+    drain_inbox();
+  }
+}
+
+/**
+ * @brief Publishes a joining session in the group's directory.
+ * @return False if another reactor admitted the name first, true otherwise.
+ */
+bool ReactorBus::claim(uint32_t user_id, const std::string &username, int32_t slot) {
+  return group_.directory().claim(user_id, username, reactor_, slot);
+}
+
+/**
+ * @brief Removes a leaving session from the group's directory.
+ */
+void ReactorBus::release(uint32_t user_id) { group_.directory().release(user_id); }
+
+/**
+ * @brief Checks whether a username is online on any reactor.
+ */
+bool ReactorBus::is_username_online(const std::string &username) {
+  return group_.directory().is_username_taken(username);
+}
+
+/**
+ * @brief Lists the sessions of the other reactors.
+ */
+std::vector<WorkerSession> ReactorBus::get_remote_users() {
+  auto users = group_.directory().sessions();
+  users.erase(std::remove_if(users.begin(), users.end(),
+                             [this](const WorkerSession &session) { return session.worker == reactor_; }),
+              users.end());
+  return users;
+}
+
+/**
+ * @brief Sends a local event (join, leave, broadcast) to every other reactor, serialized once.
+ * @param event The event.
+ */
+void ReactorBus::forward(const common::Message &event) {
+  auto frame = std::make_shared<const std::vector<char>>(common::serialize_message(event));
+  for (uint32_t reactor = 0; reactor < group_.reactors(); ++reactor) {
+    if (reactor != reactor_) {
+      post(reactor, ReactorDelivery{frame, common::BROADCAST_ID, event.header.sender_id, -1});
+    }
+  }
+}
+
+/**
+ * @brief Sends a private message to the reactor with the receiver's session, or reports an
+ * offline receiver to the sender.
+ * @param message The S2C_PRIVATE.
+ */
+void ReactorBus::route_private(const common::Message &message) {
+  auto location = group_.directory().find(message.header.receiver_id);
+  if (location && location->session.worker != reactor_) {
+    post(location->session.worker,
+         ReactorDelivery{std::make_shared<const std::vector<char>>(common::serialize_message(message)),
+                         message.header.receiver_id, 0, location->slot});
+    return;
+  }
+  common::Message error_message(common::MessageType::S2C_ERROR, common::SERVER_ID, message.header.sender_id,
+                                "Receiver not found or not connected.");
+  deliver_(common::serialize_message(error_message), message.header.sender_id, -1);
+}
+
+/**
+ * @brief The queues are written by both of their ends and the reactors allocate nothing in them
+ * after the start, so they stay where the group was built.
+ */
+void ReactorBus::place_mailbox(int) {}
+
+/**
+ * @brief Counts a connection this reactor accepted.
+ * @param fd The connection's FD.
+ */
+void ReactorBus::note_connection_opened(int fd) { count_connection(group_.worker_stats(reactor_), fd, metrics_); }
+
+/**
+ * @brief Counts a connection of this reactor that closed.
+ */
+void ReactorBus::note_connection_closed() { --group_.worker_stats(reactor_).connected; }
+
+/**
+ * @brief Publishes the connection counts of all reactors, and the directory shards waiting for a
+ * reactor to pass a loop iteration before they can be freed.
+ */
+void ReactorBus::report_balance() {
+  publish_worker_balance(metrics_, &group_.worker_stats(0), group_.reactors());
+  metrics_.set_gauge("session_directory_retired_shards", static_cast<int64_t>(group_.directory().retired_shards()));
+}
+
+/**
+ * @brief Posts a delivery to a reactor and wakes it. When its mailbox is full, or earlier
+ * deliveries to it are still waiting, the delivery waits in the backlog to keep the order.
+ */
+void ReactorBus::post(uint32_t reactor, ReactorDelivery delivery) {
+  metrics_.increment_counter("reactor_frames_sent");
+  auto &backlog = backlog_[reactor];
+  if (backlog.empty() && group_.mailbox(reactor_, reactor).push_batch(&delivery, 1) == 1) {
+    group_.signal(reactor).notify();
+    return;
+  }
+  if (backlog.empty()) {
+    metrics_.increment_counter("reactor_mailbox_full");
+  }
+  backlog.push_back(std::move(delivery)); // push_batch leaves a rejected delivery intact
+}
+
+/**
+ * @brief Moves as much of each backlog as fits into its mailbox.
+ */
+void ReactorBus::flush_backlog() {
+  for (uint32_t reactor = 0; reactor < group_.reactors(); ++reactor) {
+    auto &backlog = backlog_[reactor];
+    size_t pushed = 0;
+    while (!backlog.empty() && group_.mailbox(reactor_, reactor).push_batch(&backlog.front(), 1) == 1) {
+      backlog.pop_front();
+      ++pushed;
+    }
+    if (pushed > 0) {
+      group_.signal(reactor).notify();
+    }
+  }
+}
+
+/**
+ * @brief Takes everything out of the inbox, then delivers it.
+ */
+void ReactorBus::drain_inbox() {
+  received_.clear();
+  group_.signal(reactor_).drain(inbox_,
+                                [this](ReactorDelivery &&delivery) { received_.push_back(std::move(delivery)); });
+  metrics_.increment_counter("reactor_frames_received", received_.size());
+  deliver_received();
+}
+
+/**
+ * @brief Delivers the received deliveries in order. Consecutive broadcasts are handed over as one
+ * run, so each local session gets all of them in one write; a private message ends the run.
+ */
+void ReactorBus::deliver_received() {
+  broadcast_run_.clear();
+  for (const auto &delivery : received_) {
+    if (delivery.receiver_id == common::BROADCAST_ID) {
+      broadcast_run_.push_back(BroadcastFrame{delivery.frame.get(), delivery.exclude_sender_id});
+      continue;
+    }
+    if (!broadcast_run_.empty()) {
+      broadcast_(broadcast_run_);
+      broadcast_run_.clear();
+    }
+    deliver_(*delivery.frame, delivery.receiver_id, delivery.slot);
+  }
+  if (!broadcast_run_.empty()) {
+    broadcast_(broadcast_run_);
+  }
+  received_.clear();
+}
+
+/**
+ * @brief Runs a server as a group of reactor threads in this process. Each reactor has its own
+ * epoll loop, clients and SO_REUSEPORT listener; they share sessions through the group's directory
+ * and events through its mailboxes. Stops on SIGINT or SIGTERM, or when a reactor stops on its own
+ * (e.g. it could not bind its port): the others would keep posting to its mailbox and waiting for it
+ * to quiesce. With config.cpu_steering, reactor i is pinned to CPU i and accepts the connections that
+ * arrive on it.
+ *
+ * @param port The client port.
+ * @param config The server settings, applied to every reactor.
+ * @param reactors The number of reactors (1-MAX_NODE_ID).
+ * @return The process exit code: 0 after a stop signal, 1 if the reactors could not start or one failed.
+ */
+int run_reactors(int port, const ServerConfig &config, size_t reactors) {
+  if (!check_worker_config(config, reactors, "Reactor")) {
+    return 1;
+  }
+  ReactorGroup group(reactors);
+  if (!group.is_valid()) {
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<common::IListeningSocket>> listeners;
+  if (config.cpu_steering) {
+    listeners = bind_steered_listeners(port, reactors);
+    if (listeners.empty()) {
+      return 1;
+    }
+  }
+
+  std::vector<std::unique_ptr<Server>> servers;
+  for (uint32_t reactor = 0; reactor < reactors; ++reactor) {
+    ServerConfig reactor_config = config;
+    reactor_config.reuse_port = true;
+    if (!reactor_config.metrics_file.empty()) {
+      reactor_config.metrics_file += "." + std::to_string(reactor);
+    }
+    if (!listeners.empty()) {
+      reactor_config.reactor_cpu = static_cast<int>(reactor);
+    } else if (config.reactor_cpu >= 0) {
+      reactor_config.reactor_cpu = config.reactor_cpu + static_cast<int>(reactor); // One CPU each, from the given one
+    }
+    servers.push_back(std::make_unique<Server>(port, reactor_config));
+    servers.back()->set_reactor_group(&group, reactor);
+    if (!listeners.empty()) {
+      servers.back()->adopt_listener(std::move(listeners[reactor]));
+    }
+  }
+
+  // Blocked before the reactors start so that they inherit the mask and only this thread takes them.
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+  // A reactor whose run() returns before the group stops it wakes this thread with SIGTERM.
+  const pthread_t main_thread = pthread_self();
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> failed{false};
+  std::vector<std::thread> threads;
+  for (size_t reactor = 0; reactor < servers.size(); ++reactor) {
+    threads.emplace_back([&, reactor] {
+      servers[reactor]->run();
+      if (!stopping.load()) {
+        LOG_ERROR(REACTOR_GROUP_COMPONENT, "Reactor {} stopped unexpectedly", reactor);
+        failed.store(true);
+        pthread_kill(main_thread, SIGTERM);
+      }
+    });
+  }
+  LOG_INFO(REACTOR_GROUP_COMPONENT, "Started {} reactors on port {}", reactors, port);
+
+  int signal = 0;
+  sigwait(&stop_signals, &signal);
+  stopping.store(true);
+  LOG_INFO(REACTOR_GROUP_COMPONENT, "Stopping reactors");
+  for (auto &server : servers) {
+    server->stop();
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return failed.load() ? 1 : 0;
+}
+
+} // namespace server
+} // namespace chat_app
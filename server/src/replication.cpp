@@ -0,0 +1,378 @@
+#include "server/replication.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <chrono>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// How much of the recent log the primary keeps encoded in memory for shipping.
+constexpr size_t TAIL_BUFFER_BYTES = 8 * 1024 * 1024;
+// Shipping to a standby pauses while this much output is still queued on its socket.
+constexpr size_t MAX_PENDING_BYTES = 1024 * 1024;
+// Records read from disk per catch-up batch.
+constexpr size_t CATCH_UP_RECORDS = 1024;
+
+uint64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Parses the leading decimal sequence number of a replication payload.
+ */
+uint64_t parse_sequence(const std::string &payload) {
+  try {
+    return std::stoull(payload);
+  } catch (const std::exception &) {
+    return 0;
+  }
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a ReplicationSource shipping the given log.
+ * @param epoll_manager The reactor's epoll instance, used to watch standby connections.
+ * @param message_log The log being replicated.
+ * @param metrics Receives the replication lag gauges.
+ */
+ReplicationSource::ReplicationSource(EpollManager &epoll_manager, const MessageLog &message_log,
+                                     common::Metrics &metrics)
+    : epoll_manager_(epoll_manager), message_log_(message_log), metrics_(metrics) {}
+
+/**
+ * @brief Destructor for ReplicationSource. Closes all standby connections.
+ */
+ReplicationSource::~ReplicationSource() { close(); }
+
+/**
+ * @brief Starts listening for standby connections.
+ * @param port The replication port.
+ * @return True on success, false otherwise.
+ */
+bool ReplicationSource::start(int port) {
+  listener_ = common::PosixSocket::create_listener();
+  if (!listener_ || !listener_->bind_socket(port) || !listener_->listen_socket(16)) {
+    LOG_ERROR(REPLICATION_COMPONENT, "Failed to listen for standbys on port {}", port);
+    listener_.reset();
+    return false;
+  }
+
+  listener_->set_non_blocking(true);
+  epoll_manager_.add_fd(listener_->get_fd(), EPOLLIN | EPOLLET);
+  LOG_INFO(REPLICATION_COMPONENT, "Accepting standbys on port {}", port);
+  return true;
+}
+
+/**
+ * @brief Stops listening and disconnects all standbys.
+ */
+void ReplicationSource::close() {
+  while (!standbys_.empty()) {
+    drop_standby(standbys_.begin()->first);
+  }
+  if (listener_) {
+    epoll_manager_.remove_fd(listener_->get_fd());
+    listener_->close_socket();
+    listener_.reset();
+  }
+}
+
+/**
+ * @brief Checks whether a file descriptor belongs to replication.
+ * @param fd The file descriptor.
+ * @return True if it is the replication listener or a standby connection.
+ */
+bool ReplicationSource::owns_fd(int fd) const {
+  return (listener_ && listener_->get_fd() == fd) || standbys_.count(fd) > 0;
+}
+
+/**
+ * @brief Handles an epoll event on the replication listener or a standby connection.
+ * @param fd The file descriptor that became ready.
+ * @param events The epoll event mask.
+ */
+void ReplicationSource::handle_event(int fd, uint32_t events) {
+  if (listener_ && fd == listener_->get_fd()) {
+    accept_standbys();
+    return;
+  }
+
+  auto it = standbys_.find(fd);
+  if (it == standbys_.end()) {
+    return;
+  }
+
+  Standby &standby = it->second;
+  bool open = !(events & (EPOLLHUP | EPOLLERR));
+  if (open && (events & EPOLLIN)) {
+    open = standby.connection->receive(
+        [this, &standby](const common::Message &message) { handle_standby_message(standby, message); });
+  }
+  if (open && (events & EPOLLOUT)) {
+    open = standby.connection->flush();
+  }
+
+  if (!open) {
+    drop_standby(fd);
+    return;
+  }
+  ship_to(standby);
+}
+
+/**
+ * @brief Keeps a freshly appended record in the in-memory tail for shipping.
+ * @param record The appended record.
+ */
+void ReplicationSource::on_append(const LogRecord &record) {
+  if (!tail_.empty() && record.sequence != tail_.back().sequence + 1) {
+    // Not contiguous with what we hold; start over so tail_ stays indexable by sequence.
+    tail_.clear();
+    tail_bytes_ = 0;
+  }
+
+  tail_.push_back({record.sequence, record.timestamp_ms, encode_log_record(record)});
+  tail_bytes_ += tail_.back().encoded.size();
+
+  while (tail_bytes_ > TAIL_BUFFER_BYTES && tail_.size() > 1) {
+    tail_bytes_ -= tail_.front().encoded.size();
+    tail_.pop_front();
+  }
+}
+
+/**
+ * @brief Ships pending records to every standby. Called once per reactor loop iteration,
+ * so records appended while handling one batch of events travel together.
+ */
+void ReplicationSource::ship() {
+  for (auto &[fd, standby] : standbys_) {
+    ship_to(standby);
+  }
+}
+
+/**
+ * @brief Publishes the replication gauges: number of standbys and the worst lag among them.
+ */
+void ReplicationSource::update_metrics() {
+  uint64_t max_lag_records = 0;
+  uint64_t oldest_unacked = message_log_.last_sequence() + 1;
+  for (const auto &[fd, standby] : standbys_) {
+    max_lag_records = std::max(max_lag_records, message_log_.last_sequence() - standby.acked_sequence);
+    oldest_unacked = std::min(oldest_unacked, standby.acked_sequence + 1);
+  }
+
+  int64_t lag_ms = 0;
+  if (max_lag_records > 0 && !tail_.empty()) {
+    const uint64_t index = oldest_unacked >= tail_.front().sequence ? oldest_unacked - tail_.front().sequence : 0;
+    if (index < tail_.size()) {
+      lag_ms = static_cast<int64_t>(now_ms() - tail_[index].timestamp_ms);
+    }
+  }
+
+  metrics_.set_gauge("replication_standbys", static_cast<int64_t>(standbys_.size()));
+  metrics_.set_gauge("replication_lag_records", static_cast<int64_t>(max_lag_records));
+  metrics_.set_gauge("replication_lag_ms", std::max<int64_t>(lag_ms, 0));
+}
+
+/**
+ * @brief Accepts all pending standby connections.
+ */
+void ReplicationSource::accept_standbys() {
+  while (auto socket = listener_->accept_connection()) {
+    auto connection = std::make_unique<PeerConnection>(std::move(socket));
+    int fd = connection->get_fd();
+    epoll_manager_.add_fd(fd, EPOLLIN | EPOLLOUT | EPOLLET);
+    standbys_[fd].connection = std::move(connection);
+    LOG_INFO(REPLICATION_COMPONENT, "Standby connected: FD = {}", fd);
+  }
+}
+
+/**
+ * @brief Handles a control message from a standby.
+ * @param standby The standby that sent the message.
+ * @param message The message.
+ */
+void ReplicationSource::handle_standby_message(Standby &standby, const common::Message &message) {
+  switch (message.header.type) {
+  case common::MessageType::S2S_REPLICATION_HELLO: {
+    standby.ready = true;
+    standby.acked_sequence = parse_sequence(message.payload);
+    standby.sent_sequence = standby.acked_sequence;
+    LOG_INFO(REPLICATION_COMPONENT, "Standby on FD {} resumes after sequence {}", standby.connection->get_fd(),
+             standby.acked_sequence);
+    break;
+  }
+  case common::MessageType::S2S_REPLICATION_ACK: {
+    standby.acked_sequence = std::max(standby.acked_sequence, parse_sequence(message.payload));
+    break;
+  }
+  default:
+    LOG_WARNING(REPLICATION_COMPONENT, "Unexpected message type {} from standby",
+                static_cast<int>(message.header.type));
+  }
+}
+
+/**
+ * @brief Sends batches to one standby until it is caught up, its window is full or its socket is backed up.
+ * @param standby The standby to ship to.
+ */
+void ReplicationSource::ship_to(Standby &standby) {
+  const uint64_t last_sequence = message_log_.last_sequence();
+
+  while (standby.ready && standby.sent_sequence < last_sequence &&
+         standby.sent_sequence - standby.acked_sequence < REPLICATION_WINDOW_RECORDS &&
+         standby.connection->pending_bytes() < MAX_PENDING_BYTES) {
+    std::string payload = std::to_string(last_sequence) + "\n";
+    uint64_t next = standby.sent_sequence + 1;
+
+    if (!tail_.empty() && tail_.front().sequence <= next && next <= tail_.back().sequence) {
+      for (size_t i = next - tail_.front().sequence; i < tail_.size() && payload.size() < REPLICATION_BATCH_BYTES;
+           ++i) {
+        payload.append(tail_[i].encoded.begin(), tail_[i].encoded.end());
+        next = tail_[i].sequence + 1;
+      }
+    } else {
+      // The standby is behind the in-memory tail: catch it up from the segments on disk.
+      message_log_.replay(
+          standby.sent_sequence,
+          [&payload, &next](const LogRecord &record) {
+            auto encoded = encode_log_record(record);
+            payload.append(encoded.begin(), encoded.end());
+            next = record.sequence + 1;
+          },
+          CATCH_UP_RECORDS);
+    }
+
+    if (next == standby.sent_sequence + 1) {
+      LOG_ERROR(REPLICATION_COMPONENT, "Records after sequence {} are no longer available", standby.sent_sequence);
+      break;
+    }
+
+    common::Message batch(common::MessageType::S2S_REPLICATION_BATCH, common::SERVER_ID, common::SERVER_ID, payload);
+    if (!standby.connection->send_message(batch)) {
+      break;
+    }
+    standby.sent_sequence = next - 1;
+  }
+}
+
+/**
+ * @brief Disconnects a standby and stops watching its socket.
+ * @param fd The standby's file descriptor.
+ */
+void ReplicationSource::drop_standby(int fd) {
+  LOG_INFO(REPLICATION_COMPONENT, "Standby disconnected: FD = {}", fd);
+  epoll_manager_.remove_fd(fd);
+  standbys_.erase(fd);
+}
+
+/**
+ * @brief Constructs a ReplicationSink applying shipped records to the given state.
+ * @param epoll_manager The reactor's epoll instance.
+ * @param message_log The standby's own log, or nullptr when it runs without persistence.
+ * @param state The standby's state, used to tell which records are already applied.
+ * @param metrics Receives the replication lag gauges.
+ * @param apply Applies one shipped record to the standby's in-memory state.
+ */
+ReplicationSink::ReplicationSink(EpollManager &epoll_manager, MessageLog *message_log, const ServerState &state,
+                                 common::Metrics &metrics, std::function<void(const LogRecord &)> apply)
+    : epoll_manager_(epoll_manager), message_log_(message_log), state_(state), metrics_(metrics),
+      apply_(std::move(apply)) {}
+
+/**
+ * @brief Connects to the primary and asks for everything after the locally applied sequence.
+ * @param host The primary's address.
+ * @param port The primary's replication port.
+ * @return True on success, false otherwise.
+ */
+bool ReplicationSink::connect(const std::string &host, int port) {
+  auto socket = common::PosixSocket::create_connector(host, port);
+  if (!socket) {
+    LOG_ERROR(REPLICATION_COMPONENT, "Failed to connect to primary at {}:{}", host, port);
+    return false;
+  }
+
+  connection_ = std::make_unique<PeerConnection>(std::move(socket));
+  epoll_manager_.add_fd(connection_->get_fd(), EPOLLIN | EPOLLOUT | EPOLLET);
+
+  common::Message hello(common::MessageType::S2S_REPLICATION_HELLO, common::SERVER_ID, common::SERVER_ID,
+                        std::to_string(state_.last_sequence));
+  connection_->send_message(hello);
+  LOG_INFO(REPLICATION_COMPONENT, "Replicating from {}:{} after sequence {}", host, port, state_.last_sequence);
+  return true;
+}
+
+/**
+ * @brief Closes the connection to the primary.
+ */
+void ReplicationSink::close() {
+  if (connection_) {
+    epoll_manager_.remove_fd(connection_->get_fd());
+    connection_.reset();
+  }
+}
+
+/**
+ * @brief Handles an epoll event on the primary connection.
+ * @param events The epoll event mask.
+ * @return False if the primary is gone, true otherwise.
+ */
+bool ReplicationSink::handle_event(uint32_t events) {
+  bool open = connection_ && !(events & (EPOLLHUP | EPOLLERR));
+  if (open && (events & EPOLLIN)) {
+    open = connection_->receive([this](const common::Message &message) {
+      if (message.header.type == common::MessageType::S2S_REPLICATION_BATCH) {
+        handle_batch(message);
+      }
+    });
+  }
+  if (open && (events & EPOLLOUT)) {
+    open = connection_->flush();
+  }
+  return open;
+}
+
+/**
+ * @brief Appends and applies the records of one batch, then acknowledges them.
+ * @param message The S2S_REPLICATION_BATCH message.
+ */
+void ReplicationSink::handle_batch(const common::Message &message) {
+  const std::string &payload = message.payload;
+  size_t offset = payload.find('\n');
+  if (offset == std::string::npos) {
+    LOG_ERROR(REPLICATION_COMPONENT, "Malformed replication batch");
+    return;
+  }
+  const uint64_t primary_sequence = parse_sequence(payload);
+  ++offset;
+
+  uint64_t last_timestamp_ms = 0;
+  LogRecord record;
+  while (size_t consumed = decode_log_record(payload.data() + offset, payload.size() - offset, record)) {
+    offset += consumed;
+    if (record.sequence <= state_.last_sequence) {
+      continue;
+    }
+    if (message_log_ && !message_log_->append_record(record)) {
+      break;
+    }
+    apply_(record);
+    last_timestamp_ms = record.timestamp_ms;
+  }
+
+  common::Message ack(common::MessageType::S2S_REPLICATION_ACK, common::SERVER_ID, common::SERVER_ID,
+                      std::to_string(state_.last_sequence));
+  connection_->send_message(ack);
+
+  const uint64_t lag_records = primary_sequence > state_.last_sequence ? primary_sequence - state_.last_sequence : 0;
+  const int64_t lag_ms = lag_records > 0 && last_timestamp_ms > 0 ? static_cast<int64_t>(now_ms() - last_timestamp_ms) : 0;
+  metrics_.set_gauge("replication_applied_sequence", static_cast<int64_t>(state_.last_sequence));
+  metrics_.set_gauge("replication_lag_records", static_cast<int64_t>(lag_records));
+  metrics_.set_gauge("replication_lag_ms", std::max<int64_t>(lag_ms, 0));
+}
+
+} // namespace server
+} // namespace chat_app
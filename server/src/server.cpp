@@ -1,30 +1,96 @@
 #include "server/server.h"
+#include "common/affinity.h"
 #include "common/logger.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <map>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 namespace chat_app {
 namespace server {
 
-Server::Server(int port) : port_(port), epoll_manager_(1024) {}
+Server::Server(int port, ServerConfig config) : port_(port), config_(std::move(config)), epoll_manager_(1024) {}
+
+/**
+ * @brief Makes run() accept clients on an already bound and listening socket instead of binding the port.
+ * @param listener The listener.
+ */
+void Server::adopt_listener(std::unique_ptr<common::IListeningSocket> listener) { listener_ = std::move(listener); }
+
+/**
+ * @brief Makes this server a worker of a prefork server. Must be called before run().
+ * @param shared The memory shared with the other workers.
+ * @param worker This worker's index.
+ */
+void Server::set_prefork(PreforkShared *shared, uint32_t worker) {
+  prefork_shared_ = shared;
+  worker_index_ = worker;
+}
+
+/**
+ * @brief Makes this server a reactor of a reactor group. Must be called before run().
+ * @param group The group.
+ * @param reactor This reactor's index.
+ */
+void Server::set_reactor_group(ReactorGroup *group, uint32_t reactor) {
+  reactor_group_ = group;
+  worker_index_ = reactor;
+}
 
 void Server::run() {
-  listener_ = common::PosixSocket::create_listener();
-  if (!listener_) {
-    LOG_ERROR(SERVER_COMPONENT, "Failed to create listening socket on port {}", port_);
+  if (!restore_state()) {
+    LOG_ERROR(SERVER_COMPONENT, "Failed to restore server state from {}", config_.data_dir);
     return;
   }
-
-  if (!listener_->bind_socket(port_) || !listener_->listen_socket(1024)) {
-    LOG_ERROR(SERVER_COMPONENT, "Failed to bind or listen on port {}", port_);
+  if (!start_replication() || !start_federation() || !start_gateway()) {
     return;
   }
 
+  if (prefork_shared_) {
+    worker_bus_ = std::make_unique<PreforkBus>(
+        epoll_manager_, *prefork_shared_, worker_index_, metrics_,
+        [this](const common::Message &event, int32_t slot) { deliver_worker_event(event, slot); });
+  } else if (reactor_group_) {
+    worker_bus_ = std::make_unique<ReactorBus>(
+        epoll_manager_, *reactor_group_, worker_index_, metrics_,
+        [this](const std::vector<char> &frame, uint32_t receiver_id, int32_t slot) {
+          deliver_reactor_frame(frame, receiver_id, slot);
+        },
+        [this](const std::vector<BroadcastFrame> &frames) { client_manager_.broadcast_frames(frames); });
+  }
+
+  if (!listener_) {
+    listener_ = common::PosixSocket::create_listener(config_.reuse_port);
+    if (!listener_) {
+      LOG_ERROR(SERVER_COMPONENT, "Failed to create listening socket on port {}", port_);
+      return;
+    }
+    if (!listener_->bind_socket(port_) || !listener_->listen_socket(1024)) {
+      LOG_ERROR(SERVER_COMPONENT, "Failed to bind or listen on port {}", port_);
+      return;
+    }
+  }
+
   listener_->set_non_blocking(true);
   epoll_manager_.add_fd(listener_->get_fd(), EPOLLIN | EPOLLET);
 
+  if (!config_.unix_socket_path.empty()) {
+    unix_listener_ = common::PosixSocket::create_unix_listener(config_.unix_socket_path);
+    if (!unix_listener_ || !unix_listener_->bind_socket(0) || !unix_listener_->listen_socket(1024)) {
+      LOG_ERROR(SERVER_COMPONENT, "Failed to bind or listen on {}", config_.unix_socket_path);
+      return;
+    }
+    unix_listener_->set_non_blocking(true);
+    epoll_manager_.add_fd(unix_listener_->get_fd(), EPOLLIN | EPOLLET);
+    LOG_INFO(SERVER_COMPONENT, "Accepting local clients on {}", config_.unix_socket_path);
+  }
+
   server_event_fd_ = eventfd(0, EFD_NONBLOCK);
   if (server_event_fd_ == -1) {
     LOG_ERROR(SERVER_COMPONENT, "Failed to create eventfd: {}", std::strerror(errno));
@@ -32,11 +98,68 @@ void Server::run() {
   }
   epoll_manager_.add_fd(server_event_fd_, EPOLLIN | EPOLLET);
 
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ == -1) {
+    LOG_ERROR(SERVER_COMPONENT, "Failed to create timerfd: {}", std::strerror(errno));
+    return;
+  }
+  itimerspec interval{};
+  interval.it_interval.tv_sec = config_.housekeeping_interval_ms / 1000;
+  interval.it_interval.tv_nsec = (config_.housekeeping_interval_ms % 1000) * 1000000L;
+  interval.it_value = interval.it_interval;
+  timerfd_settime(timer_fd_, 0, &interval, nullptr);
+  epoll_manager_.add_fd(timer_fd_, EPOLLIN | EPOLLET);
+
+  if (!flows_.start()) {
+    return;
+  }
+  epoll_manager_.add_fd(flows_.get_timer_fd(), EPOLLIN | EPOLLET);
+
+  auth_pool_ = std::make_unique<AuthPool>(config_.auth_threads, config_.auth_queue_limit,
+                                          config_.auth_queue_per_client, config_.password_iterations);
+  auth_pool_->set_cpus(config_.auth_cpus);
+  if (!auth_pool_->start()) {
+    return;
+  }
+  epoll_manager_.add_fd(auth_pool_->get_event_fd(), EPOLLIN | EPOLLET);
+
+  if (config_.pipeline) {
+    pipeline_ = std::make_unique<ClientPipeline>(config_.decode_threads, config_.encode_threads);
+    pipeline_->set_cpus(config_.decode_cpus, config_.encode_cpus);
+    if (!pipeline_->start()) {
+      return;
+    }
+    epoll_manager_.add_fd(pipeline_->get_event_fd(), EPOLLIN | EPOLLET);
+  } else if (config_.broadcast_threads > 0) {
+    // Writes of a pipelined session are queued by the reactor thread only, so the two do not mix.
+    fan_out_pool_ = std::make_unique<FanOutPool>(config_.broadcast_threads);
+    fan_out_pool_->start();
+    client_manager_.set_fan_out(fan_out_pool_.get(), config_.broadcast_fan_out_threshold);
+  }
+
+  // Pinned after the auth workers, fan-out helpers and pipeline stages are started, so that they do not inherit
+  // the reactor's CPU.
+  if (config_.reactor_cpu >= 0 && common::pin_current_thread(config_.reactor_cpu)) {
+    common::prefer_local_memory();
+    reactor_node_ = common::node_of_cpu(config_.reactor_cpu);
+    if (worker_bus_ && reactor_node_ >= 0) {
+      worker_bus_->place_mailbox(reactor_node_);
+    }
+  }
+
   running_ = true;
   LOG_INFO(SERVER_COMPONENT, "Server started on port {}. Waiting for new connections ...", port_);
 
   while (running_) {
-    int num_events = epoll_manager_.wait(-1);
+    // Clients over their chat budget are read on in the next tick at once, and work that found a pipeline ring
+    // full is flushed again soon, rather than on the next event.
+    int timeout = -1;
+    if (!over_budget_clients_.empty()) {
+      timeout = 0;
+    } else if (pipeline_ && pipeline_->has_backlog()) {
+      timeout = 1;
+    }
+    int num_events = epoll_manager_.wait(timeout);
     if (num_events < 0) {
       if (errno == EINTR)
         continue;
@@ -44,20 +167,100 @@ void Server::run() {
       break;
     }
 
+    // A new tick: the chat budgets are refilled, and the clients that ran out of theirs in the last tick go on
+    // where they stopped.
+    for (int fd : budget_spent_clients_) {
+      if (auto session = client_manager_.get_client_by_fd(fd)) {
+        session->set_chat_budget(CLIENT_CHAT_BUDGET);
+      }
+    }
+    budget_spent_clients_.clear();
+    if (!over_budget_clients_.empty()) {
+      auto over_budget = std::move(over_budget_clients_);
+      over_budget_clients_.clear();
+      for (int fd : over_budget) {
+        if (federation_ && federation_->is_congested()) {
+          deferred_client_reads_.insert(fd);
+        } else {
+          handle_client_message(fd);
+        }
+      }
+    }
+
     for (int i = 0; i < num_events; ++i) {
       const auto &event = epoll_manager_.get_events()[i];
       if (event.data.fd == listener_->get_fd()) {
-        handle_new_connection();
+        handle_new_connection(*listener_);
+      } else if (unix_listener_ && event.data.fd == unix_listener_->get_fd()) {
+        handle_new_connection(*unix_listener_);
       } else if (event.data.fd == server_event_fd_) {
         running_ = false;
+      } else if (event.data.fd == timer_fd_) {
+        handle_housekeeping();
+      } else if (event.data.fd == flows_.get_timer_fd()) {
+        flows_.handle_timer();
+      } else if (event.data.fd == auth_pool_->get_event_fd()) {
+        handle_auth_results();
+      } else if (pipeline_ && event.data.fd == pipeline_->get_event_fd()) {
+        handle_pipeline_messages();
+      } else if (replication_source_ && replication_source_->owns_fd(event.data.fd)) {
+        replication_source_->handle_event(event.data.fd, event.events);
+      } else if (worker_bus_ && worker_bus_->owns_fd(event.data.fd)) {
+        worker_bus_->handle_event();
+      } else if (federation_ && federation_->owns_fd(event.data.fd)) {
+        federation_->handle_event(event.data.fd, event.events);
+      } else if (gateway_hub_ && gateway_hub_->owns_fd(event.data.fd)) {
+        gateway_hub_->handle_event(event.data.fd, event.events);
+      } else if (gateway_uplink_ && gateway_uplink_->owns_fd(event.data.fd)) {
+        gateway_uplink_->handle_event(event.data.fd, event.events);
+      } else if (replication_sink_ && replication_sink_->owns_fd(event.data.fd)) {
+        if (!replication_sink_->handle_event(event.events)) {
+          promote_to_primary();
+        }
       } else {
+        if (event.events & EPOLLOUT) {
+          flows_.writable(event.data.fd); // Only watched while a session coroutine waits to send
+        }
         if ((event.events & EPOLLHUP) || (event.events & EPOLLERR)) {
           handle_client_disconnection(event.data.fd);
+        } else if ((event.events & EPOLLIN) && federation_ && federation_->is_congested()) {
+          deferred_client_reads_.insert(event.data.fd); // Backpressure: leave the input in the socket
         } else if (event.events & EPOLLIN) {
           handle_client_message(event.data.fd);
         }
       }
     }
+
+    // Everything logged while handling this round of events is shipped as one batch.
+    if (replication_source_) {
+      replication_source_->ship();
+    }
+    if (federation_) {
+      federation_->flush();
+      if (!federation_->is_congested() && !deferred_client_reads_.empty()) {
+        auto deferred = std::move(deferred_client_reads_);
+        deferred_client_reads_.clear();
+        for (int fd : deferred) {
+          handle_client_message(fd);
+        }
+        federation_->flush();
+      }
+    }
+    if (gateway_hub_) {
+      gateway_hub_->flush();
+    }
+    if (gateway_uplink_) {
+      gateway_uplink_->flush();
+    }
+    if (worker_bus_) {
+      worker_bus_->poll();
+    }
+    // Everything read or written while handling this round of events goes to the pipeline stages in one batch.
+    if (pipeline_) {
+      pipeline_->flush();
+    }
+    // No handler holds a session past the end of the tick, so the ones that disconnected during it can go.
+    client_manager_.reclaim_retired();
   }
 
   shutdown();
@@ -68,33 +271,434 @@ void Server::stop() { running_.store(false); }
 void Server::shutdown() {
   LOG_INFO(SERVER_COMPONENT, "Shutting down server...");
   close(server_event_fd_);
+  close(timer_fd_);
+  auth_pool_.reset();
+  federation_.reset();
+  worker_bus_.reset();
   listener_->close_socket();
+  if (unix_listener_) {
+    unix_listener_->close_socket();
+  }
+  replication_source_.reset();
+  replication_sink_.reset();
 
   common::Message server_shutdown_message(common::MessageType::S2C_SERVER_SHUTDOWN, common::SERVER_ID,
                                           common::BROADCAST_ID, "Server is shutting down.");
-  client_manager_.broadcast_message(server_shutdown_message, common::SERVER_ID);
+  broadcast(server_shutdown_message, common::SERVER_ID);
+  if (gateway_hub_) {
+    gateway_hub_->flush();
+    gateway_hub_.reset();
+  }
+  gateway_uplink_.reset();
+  if (pipeline_) {
+    pipeline_->stop(); // Writes the shutdown notices first
+  }
+
+  // A final snapshot lets the next start skip replaying the log entirely.
+  if (message_log_) {
+    message_log_->flush();
+    snapshotter_->write_now(state_);
+  }
 
   LOG_INFO(SERVER_COMPONENT, "Server shutdown complete.");
 }
 
+/**
+ * @brief Loads the latest snapshot and replays the log tail written after it.
+ * Does nothing when persistence is disabled.
+ *
+ * @return True if the server state is ready, false otherwise.
+ */
+bool Server::restore_state() {
+  // In a cluster, the node ID in the top bits keeps user IDs registered on different nodes apart;
+  // prefork workers and reactors split the ID space the same way.
+  const uint32_t id_prefix = prefork_shared_ || reactor_group_ ? worker_index_ + 1 : config_.node_id;
+  const uint32_t first_user_id = (id_prefix << NODE_ID_SHIFT) + 1;
+  const uint32_t last_user_id = (id_prefix << NODE_ID_SHIFT) + MAX_LOCAL_USER_ID;
+  static_assert((MAX_NODE_ID << NODE_ID_SHIFT) + MAX_LOCAL_USER_ID < FIRST_PROVISIONAL_CLIENT_ID,
+                "Registered user IDs must stay below the provisional client IDs");
+  if (config_.data_dir.empty()) {
+    user_registry_ = std::make_unique<UserRegistry>();
+    return user_registry_->open(1024, first_user_id, last_user_id);
+  }
+
+  message_log_ = std::make_unique<MessageLog>(config_.data_dir);
+  snapshotter_ = std::make_unique<StateSnapshotter>(config_.data_dir);
+  user_registry_ = std::make_unique<UserRegistry>(config_.data_dir + "/users.registry");
+  if (!message_log_->open() || !user_registry_->open(1024, first_user_id, last_user_id)) {
+    return false;
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  if (auto snapshot = snapshotter_->load_latest()) {
+    state_ = std::move(*snapshot);
+  }
+  uint64_t snapshot_sequence = state_.last_sequence;
+  size_t replayed = message_log_->replay(snapshot_sequence, [this](const LogRecord &record) { apply_record(record); });
+  last_snapshot_time_ = std::chrono::steady_clock::now();
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(last_snapshot_time_ - start_time).count();
+  LOG_INFO(SERVER_COMPONENT, "Restored state at sequence {} ({} records replayed after snapshot {}, {} users) in {} ms",
+           state_.last_sequence, replayed, snapshot_sequence, user_registry_->size(), elapsed);
+  return true;
+}
+
+/**
+ * @brief Sets up log shipping: connects to the primary when running as a standby, and
+ * accepts standbys when a replication port is configured.
+ *
+ * @return True on success, false otherwise.
+ */
+bool Server::start_replication() {
+  if (!config_.replicate_from.empty()) {
+    size_t colon = config_.replicate_from.rfind(':');
+    int port = colon == std::string::npos ? 0 : std::atoi(config_.replicate_from.c_str() + colon + 1);
+    replication_sink_ = std::make_unique<ReplicationSink>(epoll_manager_, message_log_.get(), state_, metrics_,
+                                                          [this](const LogRecord &record) { apply_record(record); });
+    if (port <= 0 || !replication_sink_->connect(config_.replicate_from.substr(0, colon), port)) {
+      LOG_ERROR(SERVER_COMPONENT, "Cannot replicate from '{}'", config_.replicate_from);
+      return false;
+    }
+    standby_ = true;
+    metrics_.set_gauge("server_standby", 1);
+  }
+
+  if (config_.replication_port > 0) {
+    if (!message_log_) {
+      LOG_ERROR(SERVER_COMPONENT, "Replication requires a data directory");
+      return false;
+    }
+    replication_source_ = std::make_unique<ReplicationSource>(epoll_manager_, *message_log_, metrics_);
+    if (!replication_source_->start(config_.replication_port)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Joins the cluster when a node ID is configured: starts accepting and dialing peer links.
+ *
+ * @return True if the server can start, false otherwise.
+ */
+bool Server::start_federation() {
+  if (config_.node_id == 0) {
+    return true;
+  }
+  if (config_.node_id > MAX_NODE_ID) {
+    LOG_ERROR(SERVER_COMPONENT, "Node ID must be between 1 and {}", MAX_NODE_ID);
+    return false;
+  }
+
+  federation_ = std::make_unique<Federation>(
+      epoll_manager_, config_.node_id, metrics_,
+      [this](const common::Message &event) { deliver_cluster_event(event); });
+  return federation_->start(config_.cluster_port, config_.peers, config_.relay_fanout, config_.cluster_shm_path);
+}
+
+/**
+ * @brief Hands an event received from another node to the local clients it is addressed to.
+ * @param event The event: a broadcast, a presence change, or a private message or error for one local user.
+ */
+void Server::deliver_cluster_event(const common::Message &event) {
+  if (event.header.receiver_id == common::BROADCAST_ID) {
+    broadcast(event, event.header.sender_id);
+    return;
+  }
+  auto receiver_session = client_manager_.get_client_by_id(event.header.receiver_id);
+  if (receiver_session) {
+    send_message(*receiver_session, event);
+  }
+}
+
+/**
+ * @brief Hands an event from another prefork worker to the local clients it is addressed to.
+ * @param event The event.
+ * @param slot The receiver's FD in this worker, or -1 to look the receiver up by ID.
+ */
+void Server::deliver_worker_event(const common::Message &event, int32_t slot) {
+  if (slot >= 0) {
+    auto receiver_session = client_manager_.get_client_by_fd(slot);
+    if (receiver_session && receiver_session->get_id() == event.header.receiver_id) {
+      send_message(*receiver_session, event);
+      return;
+    }
+  }
+  deliver_cluster_event(event);
+}
+
+/**
+ * @brief Hands a private message or an error from another reactor to the local client it is addressed to.
+ * @param frame The serialized message.
+ * @param receiver_id The receiver's ID.
+ * @param slot The receiver's FD in this reactor, or -1 to look the receiver up by ID.
+ */
+void Server::deliver_reactor_frame(const std::vector<char> &frame, uint32_t receiver_id, int32_t slot) {
+  auto receiver_session = slot >= 0 ? client_manager_.get_client_by_fd(slot) : nullptr;
+  if (!receiver_session || receiver_session->get_id() != receiver_id) {
+    receiver_session = client_manager_.get_client_by_id(receiver_id);
+  }
+  if (receiver_session) {
+    receiver_session->send(frame);
+  }
+}
+
+/**
+ * @brief Sets up the gateway tier: accepts gateways when a gateway port is configured, and
+ * connects to the routing servers when running as a gateway.
+ *
+ * @return True on success, false otherwise.
+ */
+bool Server::start_gateway() {
+  if (config_.gateway_port > 0 || !config_.gateway_shm_path.empty()) {
+    gateway_hub_ = std::make_unique<GatewayHub>(
+        epoll_manager_, metrics_,
+        [this](std::unique_ptr<common::IStreamSocket> socket, const std::string &client_address) {
+          ClientSession *session = client_manager_.add_client(std::move(socket));
+          if (session) {
+            session->set_remote_address(client_address);
+          }
+          return session;
+        },
+        [this](int fd, const common::Message &message) {
+          if (auto session = client_manager_.get_client_by_fd(fd)) {
+            process_message(*session, message);
+          }
+        },
+        [this](int fd) { handle_client_disconnection(fd); });
+    if (!gateway_hub_->start(config_.gateway_port, config_.gateway_shm_path)) {
+      return false;
+    }
+  }
+
+  if (!config_.upstreams.empty()) {
+    gateway_uplink_ = std::make_unique<GatewayUplink>(
+        epoll_manager_, metrics_, [this](const common::Message &envelope) { deliver_from_upstream(envelope); },
+        [this](const std::vector<int> &fds) {
+          for (int fd : fds) {
+            handle_client_disconnection(fd);
+          }
+        });
+    return gateway_uplink_->start(config_.upstreams);
+  }
+  return true;
+}
+
+/**
+ * @brief Gateway only: hands a delivery from the routing server to the client it is addressed to,
+ * or to every client for a broadcast. A join confirmation binds the session to its user ID; a
+ * refused join closes it.
+ * @param envelope The S2S_GATEWAY_DELIVER.
+ */
+void Server::deliver_from_upstream(const common::Message &envelope) {
+  auto [message, consumed] = common::deserialize_message(envelope.payload.data(), envelope.payload.size());
+  if (!message) {
+    return;
+  }
+  if (envelope.header.receiver_id == common::BROADCAST_ID) {
+    client_manager_.broadcast_message(*message, envelope.header.sender_id);
+    return;
+  }
+
+  auto session = client_manager_.get_client_by_fd(static_cast<int>(envelope.header.receiver_id));
+  if (!session) {
+    return;
+  }
+  if (message->header.type == common::MessageType::S2C_JOIN_SUCCESS) {
+    client_manager_.assign_id(*session, message->header.receiver_id);
+    session->set_authenticated(true);
+  }
+  session->send(std::vector<char>(envelope.payload.begin(), envelope.payload.end()));
+  if (message->header.type == common::MessageType::S2C_JOIN_FAILURE) {
+    handle_client_disconnection(session->get_fd()); // As the routing server does for its own clients
+  }
+}
+
+/**
+ * @brief Broadcasts a message to the local clients, and to the gateways for the clients they relay.
+ * @param message The message.
+ * @param exclude_sender_id The ID of the client that should not receive the message.
+ */
+void Server::broadcast(const common::Message &message, uint32_t exclude_sender_id) {
+  client_manager_.broadcast_message(message, exclude_sender_id);
+  if (gateway_hub_) {
+    gateway_hub_->broadcast(message, exclude_sender_id);
+  }
+}
+
+/**
+ * @brief Takes over from a lost primary. The replicated state is already applied, so this
+ * only stops replicating and starts admitting clients, with user IDs continuing where the primary left off.
+ */
+void Server::promote_to_primary() {
+  replication_sink_->close();
+  replication_sink_.reset();
+  standby_ = false;
+  metrics_.set_gauge("server_standby", 0);
+  LOG_WARNING(SERVER_COMPONENT, "Primary lost; taking over at sequence {}", state_.last_sequence);
+}
+
+/**
+ * @brief Applies a record that was logged earlier (log replay) or elsewhere (replication).
+ *
+ * @param record The record to apply.
+ */
+void Server::apply_record(const LogRecord &record) {
+  state_.apply(record);
+  if (record.message.header.type == common::MessageType::S2C_USER_JOINED) {
+    user_registry_->insert(record.message.payload, record.message.header.sender_id);
+  }
+}
+
+/**
+ * @brief Appends an accepted event to the message log and applies it to the durable state.
+ *
+ * @param message The event, in the form it was delivered to clients.
+ * @return False if the log could not store the event, true otherwise (also when there is no log).
+ */
+bool Server::record_event(const common::Message &message) {
+  if (!message_log_) {
+    return true;
+  }
+
+  LogRecord record;
+  record.sequence = message_log_->last_sequence() + 1;
+  record.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+  record.message = message;
+  if (!message_log_->append_record(record)) {
+    return false;
+  }
+  state_.apply(record);
+
+  if (replication_source_) {
+    replication_source_->on_append(record);
+  }
+  return true;
+}
+
+/**
+ * @brief Writes the current metrics to the configured metrics file, replacing it atomically.
+ */
+void Server::write_metrics_file() {
+  metrics_.set_gauge("clients_connected", static_cast<int64_t>(client_manager_.get_all_clients().size()));
+  metrics_.set_gauge("registered_users", static_cast<int64_t>(user_registry_->size()));
+  metrics_.set_gauge("auth_queue_depth", static_cast<int64_t>(auth_pool_->queued()));
+  if (message_log_) {
+    metrics_.set_gauge("log_last_sequence", static_cast<int64_t>(message_log_->last_sequence()));
+  }
+  if (replication_source_) {
+    replication_source_->update_metrics();
+  }
+
+  if (config_.metrics_file.empty()) {
+    return;
+  }
+  const std::string temp_path = config_.metrics_file + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::trunc);
+    out << metrics_.render();
+  }
+  std::rename(temp_path.c_str(), config_.metrics_file.c_str());
+}
+
+/**
+ * @brief Runs periodic maintenance: flushes the log and schedules state snapshots.
+ */
+void Server::handle_housekeeping() {
+  uint64_t expirations;
+  while (read(timer_fd_, &expirations, sizeof(expirations)) > 0) {
+  }
+
+  if (federation_) {
+    federation_->maintain();
+  }
+  if (gateway_uplink_) {
+    gateway_uplink_->maintain();
+  }
+  if (worker_bus_) {
+    worker_bus_->report_balance();
+  }
+  if (reactor_node_ >= 0) {
+    report_numa_placement();
+  }
+  if (fan_out_pool_) {
+    metrics_.set_gauge("broadcast_fan_out_jobs", static_cast<int64_t>(fan_out_pool_->jobs()));
+  }
+  if (pipeline_) {
+    pipeline_->report(metrics_);
+  }
+  write_metrics_file();
+  if (!message_log_) {
+    return;
+  }
+
+  message_log_->flush();
+  user_registry_->flush();
+  snapshotter_->poll();
+
+  auto now = std::chrono::steady_clock::now();
+  bool due = now - last_snapshot_time_ >= std::chrono::milliseconds(config_.snapshot_interval_ms);
+  if (due && state_.last_sequence != snapshotter_->last_snapshot_sequence() && snapshotter_->begin(state_)) {
+    last_snapshot_time_ = now;
+  }
+}
+
+/**
+ * @brief Publishes which NUMA nodes the memory of a sample of the client sessions is on, per node
+ * and as the count not on the reactor's node. Sessions are allocated by the reactor, so with the
+ * reactor pinned they should all be local.
+ */
+void Server::report_numa_placement() {
+  constexpr size_t SAMPLE_SIZE = 64;
+  std::map<int, int64_t> per_node;
+  int64_t remote = 0;
+  size_t sampled = 0;
+  for (const auto *session : client_manager_.get_all_clients()) {
+    if (sampled++ == SAMPLE_SIZE) {
+      break;
+    }
+    const int node = common::node_of_address(session);
+    ++per_node[node];
+    remote += node != reactor_node_ ? 1 : 0;
+  }
+  metrics_.set_gauge("numa_reactor_node", reactor_node_);
+  metrics_.set_gauge("numa_sampled_sessions_remote", remote);
+  for (const auto &[node, sessions] : per_node) {
+    if (node >= 0) {
+      metrics_.set_gauge("numa_node_" + std::to_string(node) + "_sampled_sessions", sessions);
+    }
+  }
+}
+
 /**
  * @brief Handles a new incoming connection.
  * Accepts the connection, sets it to non-blocking mode, and registers it with epoll.
+ *
+ * @param listener The TCP or Unix domain listener that became ready.
  */
-void Server::handle_new_connection() {
-  while (auto client_socket = listener_->accept_connection()) {
+void Server::handle_new_connection(common::IListeningSocket &listener) {
+  while (auto client_socket = listener.accept_connection()) {
     client_socket->set_non_blocking(true);
     int fd = client_socket->get_fd();
     LOG_INFO(SERVER_COMPONENT, "New connection accepted: FD = {}", fd);
+    if (pipeline_) {
+      client_socket = pipeline_->attach(std::move(client_socket));
+    }
 
     auto session = client_manager_.add_client(std::move(client_socket));
     epoll_manager_.add_fd(fd, EPOLLIN | EPOLLET);
+    if (worker_bus_) {
+      worker_bus_->note_connection_opened(fd);
+    }
   }
 }
 
 /**
  * @brief Handles incoming messages from a client.
- * Reads the message, deserializes it, and processes it.
+ * Reads the message, deserializes it, and processes it. A client that has chat left over from an earlier
+ * tick gets that processed first, and is only read again once it is through it.
  *
  * @param fd The file descriptor of the client.
  */
@@ -104,6 +708,14 @@ void Server::handle_client_message(int fd) {
     LOG_WARNING(SERVER_COMPONENT, "Received message from unknown client with FD = {}", fd);
     return;
   }
+  if (pipeline_) {
+    pipeline_->read(fd); // The decode stage reads and deserializes; handle_pipeline_messages() routes
+    return;
+  }
+
+  if (!process_client_messages(*session) || session->is_closed()) {
+    return; // The socket stays unread until the client is through its backlog
+  }
 
   auto &read_buffer = session->get_read_buffer();
   size_t initial_buffer_size = 4096;
@@ -112,7 +724,7 @@ void Server::handle_client_message(int fd) {
     size_t current_size = read_buffer.size();
     read_buffer.resize(current_size + initial_buffer_size);
 
-    auto result = session->get_socket()->raw_receive(read_buffer.data() + current_size, initial_buffer_size);
+    auto result = session->receive(read_buffer.data() + current_size, initial_buffer_size);
 
     if (result.status == common::SocketStatus::OK) {
       read_buffer.resize(current_size + result.bytes_transferred);
@@ -128,22 +740,69 @@ void Server::handle_client_message(int fd) {
     }
   }
 
-  // Deserialize the message
+  process_client_messages(*session);
+}
+
+/**
+ * @brief Deserializes and processes the complete messages in a client's read buffer, while the session has chat
+ * budget left for this tick. The client's messages keep their order: a control message behind chat over the
+ * budget waits with it.
+ *
+ * @param session The client session.
+ * @return False if messages were left over; the client is then read on in the next loop tick.
+ */
+bool Server::process_client_messages(ClientSession &session) {
+  auto &read_buffer = session.get_read_buffer();
+  size_t consumed = 0;
+  bool within_budget = true;
+
   while (true) {
-    auto [message, bytes_read] = common::deserialize_message(read_buffer);
+    auto [message, bytes_read] =
+        common::deserialize_message(read_buffer.data() + consumed, read_buffer.size() - consumed);
     if (!message) {
       // Not enough data to deserialize
       break;
     }
+    if (common::is_chat_message(message->header.type)) {
+      const size_t chat_budget = session.get_chat_budget();
+      if (chat_budget == 0) {
+        over_budget_clients_.insert(session.get_fd());
+        within_budget = false;
+        break;
+      }
+      if (chat_budget == CLIENT_CHAT_BUDGET) {
+        budget_spent_clients_.insert(session.get_fd());
+      }
+      session.set_chat_budget(chat_budget - 1);
+    }
 
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + bytes_read);
-    process_message(*session, *message);
+    consumed += bytes_read;
+    process_message(session, *message);
+    if (session.is_closed()) {
+      return true; // Whatever the client sent after leaving or being refused is dropped with it
+    }
   }
+  read_buffer.erase(read_buffer.begin(), read_buffer.begin() + consumed);
+  return within_budget;
+}
+
+/**
+ * @brief Routes the messages the pipeline's decode stage has read, and disconnects the clients whose
+ * connections it found closed.
+ */
+void Server::handle_pipeline_messages() {
+  pipeline_->route(
+      [this](int fd, const common::Message &message) {
+        if (auto session = client_manager_.get_client_by_fd(fd)) {
+          process_message(*session, message);
+        }
+      },
+      [this](int fd) { handle_client_disconnection(fd); });
 }
 
 /**
  * @brief Handles client disconnection.
- * Removes the client from the manager and unregisters it from epoll.
+ * Removes the client from the manager, which destroys it at the end of the loop tick, and unregisters it from epoll.
  * If the client was authenticated, it broadcasts a user left message.
  *
  * @param fd The file descriptor of the client.
@@ -154,15 +813,37 @@ void Server::handle_client_disconnection(int fd) {
     return;
 
   LOG_INFO(SERVER_COMPONENT, "Client disconnected: ID = {}, FD = {}", session->get_id(), fd);
+  flows_.close(fd);
 
-  if (session->is_authenticated()) {
+  if (gateway_uplink_) {
+    gateway_uplink_->close_channel(fd); // The routing server announces the departure
+  } else if (session->is_authenticated()) {
     common::Message user_left_message(common::MessageType::S2C_USER_LEFT, session->get_id(), common::BROADCAST_ID,
                                       session->get_username());
-    client_manager_.broadcast_message(user_left_message, session->get_id());
+    broadcast(user_left_message, session->get_id());
+    record_event(user_left_message);
+    if (federation_) {
+      federation_->forward(user_left_message);
+    }
+    if (worker_bus_) {
+      worker_bus_->release(session->get_id());
+      worker_bus_->forward(user_left_message);
+    }
   }
 
-  epoll_manager_.remove_fd(fd);
+  if (fd >= 0) { // Sessions relayed by a gateway have virtual FDs
+    epoll_manager_.remove_fd(fd);
+  }
+  if (pipeline_) {
+    pipeline_->detach(fd);
+  }
+  if (worker_bus_) {
+    worker_bus_->note_connection_closed();
+  }
   client_manager_.remove_client(fd);
+  deferred_client_reads_.erase(fd);
+  over_budget_clients_.erase(fd);
+  budget_spent_clients_.erase(fd);
 }
 
 /**
@@ -173,6 +854,19 @@ void Server::handle_client_disconnection(int fd) {
  * @param message The deserialized message.
  */
 void Server::process_message(ClientSession &session, const common::Message &message) {
+  // A session coroutine that claimed the session's input receives the message instead.
+  if (flows_.deliver(session.get_fd(), message)) {
+    return;
+  }
+
+  // A gateway only terminates connections; the routing server handles every request.
+  if (gateway_uplink_) {
+    if (!gateway_uplink_->forward(session.get_fd(), message) || message.header.type == common::MessageType::C2S_LEAVE) {
+      handle_client_disconnection(session.get_fd());
+    }
+    return;
+  }
+
   switch (message.header.type) {
   case common::MessageType::C2S_JOIN: {
     process_join_message(session, message);
@@ -201,43 +895,182 @@ void Server::process_message(ClientSession &session, const common::Message &mess
 
 /**
  * @brief Processes a join message from a client.
+ * Joins that involve a password are handed to the auth workers and finish in handle_auth_results().
+ * A cluster node refuses them: password hashes are kept per node, so another node could hand out a
+ * protected name again under a different password and user ID.
  *
  * @param session The client session that sent the join message.
- * @param message The join message containing the username.
+ * @param message The join message containing the username, optionally followed by '\n' and a password.
  */
 void Server::process_join_message(ClientSession &session, const common::Message &message) {
-  if (!session.is_authenticated()) {
-    std::string username(message.payload.begin(), message.payload.end());
-    if (client_manager_.is_username_taken(username)) {
-      common::Message user_already_exists_message(common::MessageType::S2C_JOIN_FAILURE, common::SERVER_ID,
-                                                  session.get_id(), "Username already exists");
-      session.get_socket()->send_data(common::serialize_message(user_already_exists_message));
+  if (session.is_authenticated() || session.is_auth_pending()) {
+    return;
+  }
 
-      LOG_WARNING(SERVER_COMPONENT, "Client with FD {} tried to join with an existing username: {}", session.get_fd(),
-                  username);
+  const size_t separator = message.payload.find('\n');
+  std::string username = message.payload.substr(0, separator);
+  std::string password = separator == std::string::npos ? "" : message.payload.substr(separator + 1);
 
-      // Force disconnect
-      handle_client_disconnection(session.get_fd());
-    } else {
-      session.set_username(username);
-      session.set_authenticated(true);
-      client_manager_.add_username(username);
+  if (standby_) {
+    reject_join(session, "Server is in standby mode");
+  } else if (is_username_online(username)) {
+    LOG_WARNING(SERVER_COMPONENT, "Client with FD {} tried to join with an existing username: {}", session.get_fd(),
+                username);
+    reject_join(session, "Username already exists");
+  } else if (username.empty() || username.size() > MAX_REGISTERED_USERNAME) {
+    reject_join(session, "Invalid username");
+  } else if (federation_ && (!password.empty() || state_.password_hashes.count(username) > 0)) {
+    reject_join(session, "Passwords are not supported in cluster mode");
+  } else {
+    auto stored = state_.password_hashes.find(username);
+    if (stored == state_.password_hashes.end() && password.empty()) {
+      // Nothing to hash or check, so there is no reason to leave the reactor thread.
+      complete_join(session, username, std::nullopt);
+      return;
+    }
+
+    AuthRequest request;
+    request.fd = session.get_fd();
+    request.session_id = session.get_id();
+    request.client_key = session.get_remote_address().empty() ? common::PosixSocket::peer_address(session.get_fd())
+                                                              : session.get_remote_address();
+    request.username = std::move(username);
+    request.password = std::move(password);
+    if (stored != state_.password_hashes.end()) {
+      request.stored_hash = stored->second;
+    }
+
+    if (!auth_pool_->submit(std::move(request))) {
+      metrics_.increment_counter("auth_rejected_busy");
+      reject_join(session, "Server is busy, try again later");
+      return;
+    }
+    session.set_auth_pending(true);
+  }
+}
+
+/**
+ * @brief Finishes the joins whose passwords the auth workers have checked.
+ */
+void Server::handle_auth_results() {
+  for (auto &result : auth_pool_->take_results()) {
+    ClientSession *session = client_manager_.get_client_by_fd(result.fd);
+    if (!session || session->get_id() != result.session_id) {
+      continue; // The client left while its join was being checked
+    }
+    session->set_auth_pending(false);
 
-      // Send a success message back to the client
-      common::Message user_joined_message(common::MessageType::S2C_JOIN_SUCCESS, common::SERVER_ID, session.get_id(),
-                                          "Welcome to the chat, " + username + "!");
-      session.get_socket()->send_data(common::serialize_message(user_joined_message));
+    if (!result.accepted) {
+      metrics_.increment_counter("auth_failures");
+      LOG_WARNING(SERVER_COMPONENT, "Client with FD {} failed to authenticate as {}", result.fd, result.username);
+      reject_join(*session, "Authentication failed");
+    } else if (is_username_online(result.username)) {
+      reject_join(*session, "Username already exists");
+    } else if (result.new_hash && state_.password_hashes.count(result.username) > 0) {
+      // Someone else registered a password for the name while this join was queued.
+      reject_join(*session, "Authentication failed");
+    } else {
+      complete_join(*session, result.username, result.new_hash);
+    }
+  }
+}
 
-      // Broadcast the user joined message to all other clients
-      common::Message notify_user_joined_message(common::MessageType::S2C_USER_JOINED, session.get_id(),
-                                                 common::BROADCAST_ID, username);
-      client_manager_.broadcast_message(notify_user_joined_message, session.get_id());
+/**
+ * @brief Admits an authenticated client: binds it to its registered user ID and announces it.
+ *
+ * @param session The joining client session.
+ * @param username The username it joins with.
+ * @param new_hash The password hash to register for the name, if this join set one.
+ */
+void Server::complete_join(ClientSession &session, const std::string &username,
+                           const std::optional<common::PasswordHash> &new_hash) {
+  auto user_id = user_registry_->register_user(username);
+  if (!user_id) {
+    reject_join(session, "Server cannot register more users"); // The name was checked; the IDs or the table ran out
+    return;
+  }
 
-      LOG_INFO(SERVER_COMPONENT, "Client with FD {} joined with username: {}", session.get_fd(), username);
+  if (new_hash) {
+    // A password only takes effect once it is in the log, or it would be forgotten on restart.
+    if (!record_event(common::Message(common::MessageType::S2S_USER_CREDENTIAL, common::SERVER_ID, *user_id,
+                                      username + "\n" + new_hash->encode()))) {
+      reject_join(session, "Server cannot store the password");
+      return;
     }
+    state_.password_hashes[username] = *new_hash;
+  }
+
+  // Another worker may have admitted the same name since is_username_online() was checked.
+  if (worker_bus_ && !worker_bus_->claim(*user_id, username, session.get_fd())) {
+    reject_join(session, "Username already exists");
+    return;
+  }
+
+  // Returning users get back the ID they were first registered with.
+  client_manager_.assign_id(session, *user_id);
+  session.set_username(username);
+  session.set_authenticated(true);
+  client_manager_.add_username(username);
+
+  // Send a success message back to the client
+  common::Message user_joined_message(common::MessageType::S2C_JOIN_SUCCESS, common::SERVER_ID, session.get_id(),
+                                      "Welcome to the chat, " + username + "!");
+  send_message(session, user_joined_message);
+
+  // Broadcast the user joined message to all other clients
+  common::Message notify_user_joined_message(common::MessageType::S2C_USER_JOINED, session.get_id(),
+                                             common::BROADCAST_ID, username);
+  broadcast(notify_user_joined_message, session.get_id());
+  record_event(notify_user_joined_message);
+  if (federation_) {
+    federation_->forward(notify_user_joined_message);
+  }
+  if (worker_bus_) {
+    worker_bus_->forward(notify_user_joined_message);
+  }
+
+  LOG_INFO(SERVER_COMPONENT, "Client with FD {} joined with username: {}", session.get_fd(), username);
+}
+
+/**
+ * @brief Sends a join failure to the client and disconnects it.
+ *
+ * @param session The client session.
+ * @param reason The reason shown to the client.
+ */
+void Server::reject_join(ClientSession &session, const std::string &reason) {
+  common::Message join_failure_message(common::MessageType::S2C_JOIN_FAILURE, common::SERVER_ID, session.get_id(),
+                                       reason);
+  send_message(session, join_failure_message);
+
+  // Force disconnect
+  handle_client_disconnection(session.get_fd());
+}
+
+/**
+ * @brief Sends a message to one client. In pipeline mode, it is serialized and written by the encode stage.
+ *
+ * @param session The client session.
+ * @param message The message.
+ */
+void Server::send_message(ClientSession &session, const common::Message &message) {
+  if (!pipeline_ || !pipeline_->send(session.get_fd(), message)) {
+    session.send(common::serialize_message(message));
   }
 }
 
+/**
+ * @brief Checks whether a username is in use on this node or, in a cluster, prefork or multi-reactor
+ * server, on any other node or worker.
+ *
+ * @param username The username.
+ * @return True if a connected user has this name.
+ */
+bool Server::is_username_online(const std::string &username) const {
+  return client_manager_.is_username_taken(username) || (federation_ && federation_->is_username_online(username)) ||
+         (worker_bus_ && worker_bus_->is_username_online(username));
+}
+
 /**
  * @brief Processes a request for the list of users currently connected to the server.
  *
@@ -251,6 +1084,16 @@ void Server::process_user_joined_list(ClientSession &session) {
       user_list.push_back(client->get_username() + ":" + std::to_string(client->get_id()));
     }
   }
+  if (federation_) {
+    for (const auto &[user_id, user] : federation_->get_remote_users()) {
+      user_list.push_back(user.username + ":" + std::to_string(user_id));
+    }
+  }
+  if (worker_bus_) {
+    for (const auto &user : worker_bus_->get_remote_users()) {
+      user_list.push_back(user.username + ":" + std::to_string(user.user_id));
+    }
+  }
 
   if (!user_list.empty()) {
     std::string user_list_str;
@@ -261,7 +1104,7 @@ void Server::process_user_joined_list(ClientSession &session) {
 
     common::Message user_list_message(common::MessageType::S2C_USER_JOINED_LIST, common::SERVER_ID, session.get_id(),
                                       user_list_str);
-    session.get_socket()->send_data(common::serialize_message(user_list_message));
+    send_message(session, user_list_message);
   }
 }
 
@@ -275,7 +1118,14 @@ void Server::process_broadcast_message(ClientSession &session, const common::Mes
   if (session.is_authenticated()) {
     common::Message broadcast_message(common::MessageType::S2C_BROADCAST, session.get_id(), common::BROADCAST_ID,
                                       message.payload);
-    client_manager_.broadcast_message(broadcast_message, session.get_id());
+    broadcast(broadcast_message, session.get_id());
+    record_event(broadcast_message);
+    if (federation_) {
+      federation_->forward(broadcast_message);
+    }
+    if (worker_bus_) {
+      worker_bus_->forward(broadcast_message);
+    }
   }
 }
 
@@ -287,14 +1137,24 @@ void Server::process_broadcast_message(ClientSession &session, const common::Mes
  */
 void Server::process_private_message(ClientSession &session, const common::Message &message) {
   auto receiver_session = client_manager_.get_client_by_id(message.header.receiver_id);
-  if (session.is_authenticated() && receiver_session) {
+  if (session.is_authenticated() && !receiver_session && (federation_ || worker_bus_)) {
+    common::Message private_message(common::MessageType::S2C_PRIVATE, session.get_id(), message.header.receiver_id,
+                                    message.payload);
+    if (federation_) {
+      federation_->route_private(private_message);
+    } else {
+      worker_bus_->route_private(private_message);
+    }
+    record_event(private_message);
+  } else if (session.is_authenticated() && receiver_session) {
     common::Message private_message(common::MessageType::S2C_PRIVATE, session.get_id(), message.header.receiver_id,
                                     message.payload);
-    receiver_session->get_socket()->send_data(common::serialize_message(private_message));
+    send_message(*receiver_session, private_message);
+    record_event(private_message);
   } else if (!receiver_session) {
     common::Message error_message(common::MessageType::S2C_ERROR, common::SERVER_ID, session.get_id(),
                                   "Receiver not found or not connected.");
-    session.get_socket()->send_data(common::serialize_message(error_message));
+    send_message(session, error_message);
   }
 }
 
@@ -0,0 +1,159 @@
+#include "server/session_directory.h"
+#include <algorithm>
+#include <functional>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructor for SessionDirectory.
+ * @param readers The number of reader threads, each of which must call quiesce() with its index.
+ */
+SessionDirectory::SessionDirectory(size_t readers) : readers_(new Reader[readers]), reader_count_(readers) {
+  for (size_t shard = 0; shard < SESSION_DIRECTORY_SHARDS; ++shard) {
+    ids_[shard].store(new IdShard(), std::memory_order_relaxed);
+    names_[shard].store(new NameShard(), std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Destructor for SessionDirectory. No reader may still be running.
+ */
+SessionDirectory::~SessionDirectory() {
+  for (size_t shard = 0; shard < SESSION_DIRECTORY_SHARDS; ++shard) {
+    delete ids_[shard].load(std::memory_order_relaxed);
+    delete names_[shard].load(std::memory_order_relaxed);
+  }
+}
+
+size_t SessionDirectory::name_shard(const std::string &username) {
+  return std::hash<std::string>()(username) % SESSION_DIRECTORY_SHARDS;
+}
+
+/**
+ * @brief Publishes a joining session.
+ * @param user_id The user ID.
+ * @param username The username.
+ * @param worker The worker the session is on.
+ * @param slot The session's FD.
+ * @return False if the name is already online, true otherwise.
+ */
+bool SessionDirectory::claim(uint32_t user_id, const std::string &username, uint32_t worker, int32_t slot) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  const size_t name_index = name_shard(username);
+  const NameShard *names = names_[name_index].load(std::memory_order_relaxed);
+  if (names->count(username) > 0) {
+    return false;
+  }
+
+  const size_t id_index = id_shard(user_id);
+  auto new_ids = std::make_unique<IdShard>(*ids_[id_index].load(std::memory_order_relaxed));
+  auto new_names = std::make_unique<NameShard>(*names);
+  (*new_ids)[user_id] = Entry{WorkerSession{user_id, worker, username}, slot};
+  (*new_names)[username] = user_id;
+  publish(id_index, std::move(new_ids), name_index, std::move(new_names));
+  return true;
+}
+
+/**
+ * @brief Removes a leaving session.
+ * @param user_id The user ID.
+ */
+void SessionDirectory::release(uint32_t user_id) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  const size_t id_index = id_shard(user_id);
+  const IdShard *ids = ids_[id_index].load(std::memory_order_relaxed);
+  auto it = ids->find(user_id);
+  if (it == ids->end()) {
+    return;
+  }
+
+  const size_t name_index = name_shard(it->second.session.username);
+  auto new_names = std::make_unique<NameShard>(*names_[name_index].load(std::memory_order_relaxed));
+  new_names->erase(it->second.session.username);
+  auto new_ids = std::make_unique<IdShard>(*ids);
+  new_ids->erase(user_id);
+  publish(id_index, std::move(new_ids), name_index, std::move(new_names));
+}
+
+/**
+ * @brief Finds a session by user ID.
+ * @param user_id The user ID.
+ * @return The session, or std::nullopt if the user is not online.
+ */
+std::optional<SessionDirectory::Entry> SessionDirectory::find(uint32_t user_id) const {
+  const IdShard *ids = ids_[id_shard(user_id)].load(std::memory_order_acquire);
+  auto it = ids->find(user_id);
+  if (it == ids->end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+/**
+ * @brief Checks whether a username is online.
+ */
+bool SessionDirectory::is_username_taken(const std::string &username) const {
+  return names_[name_shard(username)].load(std::memory_order_acquire)->count(username) > 0;
+}
+
+/**
+ * @brief Lists all sessions. Each shard is read as one snapshot; the list as a whole is not.
+ */
+std::vector<WorkerSession> SessionDirectory::sessions() const {
+  std::vector<WorkerSession> sessions;
+  for (const auto &shard : ids_) {
+    for (const auto &[user_id, entry] : *shard.load(std::memory_order_acquire)) {
+      sessions.push_back(entry.session);
+    }
+  }
+  return sessions;
+}
+
+/**
+ * @brief Declares that a reader holds nothing it read from the directory, which lets the shards
+ * retired so far be freed once the other readers have declared the same.
+ * @param reader The reader's index.
+ */
+void SessionDirectory::quiesce(size_t reader) {
+  // Acquire: lookups after this see every shard published before the epoch it reads.
+  readers_[reader].epoch.store(epoch_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+/**
+ * @brief Gets the number of shards retired but not yet freed.
+ */
+size_t SessionDirectory::retired_shards() const {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  return retired_.size() * 2;
+}
+
+/**
+ * @brief Replaces a shard of each table with its modified copy, then frees what the readers are done with.
+ */
+void SessionDirectory::publish(size_t id_index, std::unique_ptr<IdShard> ids, size_t name_index,
+                               std::unique_ptr<NameShard> names) {
+  Retired retired;
+  retired.ids.reset(ids_[id_index].exchange(ids.release(), std::memory_order_release));
+  retired.names.reset(names_[name_index].exchange(names.release(), std::memory_order_release));
+  // A reader that quiesces in this epoch or later no longer sees the old shards.
+  retired.epoch = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+  retired_.push_back(std::move(retired));
+  reclaim();
+}
+
+/**
+ * @brief Frees the retired shards every reader has quiesced since.
+ */
+void SessionDirectory::reclaim() {
+  uint64_t oldest = UINT64_MAX;
+  for (size_t reader = 0; reader < reader_count_; ++reader) {
+    oldest = std::min(oldest, readers_[reader].epoch.load(std::memory_order_acquire));
+  }
+  retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                [oldest](const Retired &retired) { return retired.epoch <= oldest; }),
+                 retired_.end());
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,299 @@
+#include "server/session_flows.h"
+#include "common/logger.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+// Frames are pooled in size classes of this many bytes; larger ones come from the heap every time.
+constexpr size_t FRAME_SIZE_CLASS = 128;
+constexpr size_t FRAME_SIZE_CLASSES = 16;
+
+struct FreeFrame {
+  FreeFrame *next;
+};
+
+// This thread's free lists, emptied when the thread exits.
+struct FramePoolState {
+  ~FramePoolState() {
+    for (auto *&head : free_lists) {
+      while (head) {
+        FreeFrame *next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+  }
+
+  FreeFrame *free_lists[FRAME_SIZE_CLASSES] = {};
+  uint64_t allocated{0};
+  uint64_t reused{0};
+};
+
+thread_local FramePoolState frame_pool;
+
+size_t size_class(size_t size) { return (size + FRAME_SIZE_CLASS - 1) / FRAME_SIZE_CLASS - 1; }
+
+} // namespace
+
+/**
+ * @brief Gets memory for a coroutine frame, from this thread's free list for its size if possible.
+ * @param size The frame's size.
+ */
+void *CoroutineFramePool::allocate(size_t size) {
+  const size_t index = size_class(size);
+  if (index >= FRAME_SIZE_CLASSES) {
+    ++frame_pool.allocated;
+    return ::operator new(size);
+  }
+  if (FreeFrame *frame = frame_pool.free_lists[index]) {
+    frame_pool.free_lists[index] = frame->next;
+    ++frame_pool.reused;
+    return frame;
+  }
+  ++frame_pool.allocated;
+  return ::operator new((index + 1) * FRAME_SIZE_CLASS);
+}
+
+/**
+ * @brief Returns a finished coroutine's frame to this thread's free list for its size.
+ * @param frame The frame.
+ * @param size The frame's size, as passed to allocate().
+ */
+void CoroutineFramePool::release(void *frame, size_t size) {
+  const size_t index = size_class(size);
+  if (index >= FRAME_SIZE_CLASSES) {
+    ::operator delete(frame);
+    return;
+  }
+  auto *free_frame = static_cast<FreeFrame *>(frame);
+  free_frame->next = frame_pool.free_lists[index];
+  frame_pool.free_lists[index] = free_frame;
+}
+
+uint64_t CoroutineFramePool::allocated() { return frame_pool.allocated; }
+
+uint64_t CoroutineFramePool::reused() { return frame_pool.reused; }
+
+/**
+ * @brief Constructs a SessionFlows. The timer is created by start().
+ * @param epoll_manager The reactor's epoll instance; sends that have to wait watch their socket for EPOLLOUT
+ * through it.
+ * @param tick Resolution of sleep_for().
+ */
+SessionFlows::SessionFlows(EpollManager &epoll_manager, std::chrono::milliseconds tick)
+    : epoll_manager_(epoll_manager), wheel_(tick, SESSION_FLOW_TIMER_SLOTS) {}
+
+/**
+ * @brief Destructor for SessionFlows. Destroys the coroutines that are still waiting.
+ */
+SessionFlows::~SessionFlows() {
+  auto suspended = std::move(suspended_);
+  suspended_.clear();
+  writers_.clear();
+  for (void *frame : suspended) {
+    std::coroutine_handle<>::from_address(frame).destroy();
+  }
+  if (timer_fd_ != -1) {
+    ::close(timer_fd_);
+  }
+}
+
+/**
+ * @brief Creates the timer that drives sleep_for(). The caller watches get_timer_fd() for EPOLLIN.
+ * @return False if the timerfd could not be created.
+ */
+bool SessionFlows::start() {
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ == -1) {
+    LOG_ERROR(SESSION_FLOWS_COMPONENT, "Failed to create timerfd: {}", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Hands a session's message to the coroutine that claimed the session's input, if any.
+ * @param fd The session's FD.
+ * @param message The message.
+ * @return True if a coroutine took the message; false if the server should process it.
+ */
+bool SessionFlows::deliver(int fd, const common::Message &message) {
+  auto it = inputs_.find(fd);
+  if (it == inputs_.end()) {
+    return false;
+  }
+  it->second.messages.push_back(message);
+  if (auto reader = std::exchange(it->second.reader, nullptr)) {
+    resume(reader);
+  }
+  return true;
+}
+
+/**
+ * @brief Continues the send waiting for a socket that can take more.
+ * @param fd The socket's FD.
+ */
+void SessionFlows::writable(int fd) {
+  auto it = writers_.find(fd);
+  if (it == writers_.end()) {
+    return;
+  }
+  SendAwaiter &send = *it->second;
+  if (write(send)) {
+    writers_.erase(it);
+    epoll_manager_.modify_fd(fd, EPOLLIN | EPOLLET);
+    resume(send.handle_);
+  }
+}
+
+/**
+ * @brief Wakes the coroutines waiting on a session that disconnected: recv_frame() gives nothing and
+ * send_frame() gives false. Called before the session is removed.
+ * @param fd The session's FD.
+ */
+void SessionFlows::close(int fd) {
+  auto writer = writers_.find(fd);
+  if (writer != writers_.end()) {
+    SendAwaiter &send = *writer->second;
+    writers_.erase(writer);
+    send.ok_ = false;
+    resume(send.handle_);
+  }
+  auto input = inputs_.find(fd);
+  if (input != inputs_.end()) {
+    input->second.closed = true;
+    if (auto reader = std::exchange(input->second.reader, nullptr)) {
+      resume(reader);
+    }
+  }
+}
+
+/**
+ * @brief Resumes the coroutines whose sleep is over. Called when the timer FD is readable.
+ */
+void SessionFlows::handle_timer() {
+  uint64_t expirations = 0;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+    return;
+  }
+  wheel_.advance(expirations);
+  if (wheel_.pending() == 0) {
+    arm_timer(false);
+  }
+}
+
+/**
+ * @brief Makes an awaitable that writes a message to a session.
+ * @param session The session; it stays valid while the send waits, as disconnecting it wakes the send first.
+ * @param message The message.
+ */
+SessionFlows::SendAwaiter SessionFlows::send_frame(ClientSession &session, const common::Message &message) {
+  return SendAwaiter(*this, session, common::serialize_message(message));
+}
+
+/**
+ * @brief Makes an awaitable that waits for a delay on the timer wheel.
+ * @param delay The delay.
+ */
+SessionFlows::SleepAwaiter SessionFlows::sleep_for(std::chrono::milliseconds delay) {
+  return SleepAwaiter(*this, delay);
+}
+
+void SessionFlows::resume(std::coroutine_handle<> handle) {
+  suspended_.erase(handle.address());
+  handle.resume();
+}
+
+/**
+ * @brief Writes as much of a send as the socket takes.
+ * @return True if the send is over: all written, or the session gone.
+ */
+bool SessionFlows::write(SendAwaiter &send) {
+  while (send.sent_ < send.bytes_.size()) {
+    auto result = send.sent_ == 0
+                      ? send.session_.send(send.bytes_)
+                      : send.session_.send(std::vector<char>(send.bytes_.begin() + send.sent_, send.bytes_.end()));
+    if (result.status == common::SocketStatus::WOULD_BLOCK) {
+      return false;
+    }
+    if (result.status != common::SocketStatus::OK) {
+      send.ok_ = false;
+      return true;
+    }
+    send.sent_ += result.bytes_transferred;
+  }
+  return true;
+}
+
+/**
+ * @brief Starts or stops the periodic tick of the timer wheel, which only runs while timers are pending.
+ */
+void SessionFlows::arm_timer(bool armed) {
+  if (armed == timer_armed_ || timer_fd_ == -1) {
+    return;
+  }
+  itimerspec interval{};
+  if (armed) {
+    const auto tick = wheel_.tick();
+    interval.it_interval.tv_sec = tick.count() / 1000;
+    interval.it_interval.tv_nsec = (tick.count() % 1000) * 1000000L;
+    interval.it_value = interval.it_interval;
+  }
+  timerfd_settime(timer_fd_, 0, &interval, nullptr);
+  timer_armed_ = armed;
+}
+
+bool SessionFlows::RecvAwaiter::await_ready() const {
+  auto it = flows_.inputs_.find(fd_);
+  return it == flows_.inputs_.end() || !it->second.messages.empty() || it->second.closed;
+}
+
+void SessionFlows::RecvAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  flows_.inputs_[fd_].reader = handle;
+  flows_.suspend(handle);
+}
+
+std::optional<common::Message> SessionFlows::RecvAwaiter::await_resume() {
+  auto it = flows_.inputs_.find(fd_);
+  if (it == flows_.inputs_.end() || it->second.messages.empty()) {
+    return std::nullopt;
+  }
+  common::Message message = std::move(it->second.messages.front());
+  it->second.messages.pop_front();
+  return message;
+}
+
+void SessionFlows::SendAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  flows_.writers_[session_.get_fd()] = this;
+  flows_.suspend(handle);
+  flows_.epoll_manager_.modify_fd(session_.get_fd(), EPOLLIN | EPOLLOUT | EPOLLET);
+}
+
+void SessionFlows::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  flows_.suspend(handle);
+  flows_.wheel_.schedule(delay_, [flows = &flows_, handle]() { flows->resume(handle); });
+  flows_.arm_timer(true);
+}
+
+/**
+ * @brief Claims a session's input.
+ * @param flows The flows of the session's reactor.
+ * @param fd The session's FD.
+ */
+SessionInput::SessionInput(SessionFlows &flows, int fd) : flows_(flows), fd_(fd) { flows_.inputs_[fd_]; }
+
+/**
+ * @brief Hands the session's input back to the server. Messages not received are dropped.
+ */
+SessionInput::~SessionInput() { flows_.inputs_.erase(fd_); }
+
+} // namespace server
+} // namespace chat_app
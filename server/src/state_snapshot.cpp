@@ -0,0 +1,343 @@
+#include "server/state_snapshot.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'N', 'P', '3'};
+constexpr const char *SNAPSHOT_FILE_NAME = "state.snapshot";
+
+/**
+ * @brief Fixed-size output buffer over a file descriptor.
+ *
+ * Used by the forked snapshot child, which must not allocate: another thread of the parent may
+ * have held the allocator lock at the time of the fork.
+ */
+class FdWriter {
+public:
+  explicit FdWriter(int fd) : fd_(fd) {}
+
+  void put(const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0 && ok_) {
+      size_t chunk = std::min(size, sizeof(buffer_) - used_);
+      std::memcpy(buffer_ + used_, bytes, chunk);
+      used_ += chunk;
+      bytes += chunk;
+      size -= chunk;
+      if (used_ == sizeof(buffer_)) {
+        drain();
+      }
+    }
+  }
+
+  void put_u32(uint32_t value) {
+    uint32_t net = htobe32(value);
+    put(&net, sizeof(net));
+  }
+
+  void put_u64(uint64_t value) {
+    uint64_t net = htobe64(value);
+    put(&net, sizeof(net));
+  }
+
+  bool finish() {
+    drain();
+    return ok_;
+  }
+
+private:
+  void drain() {
+    size_t written = 0;
+    while (ok_ && written < used_) {
+      ssize_t n = ::write(fd_, buffer_ + written, used_ - written);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        ok_ = false;
+        break;
+      }
+      written += static_cast<size_t>(n);
+    }
+    used_ = 0;
+  }
+
+  int fd_;
+  bool ok_{true};
+  size_t used_{0};
+  char buffer_[64 * 1024];
+};
+
+/**
+ * @brief Bounds-checked reader over a memory-mapped snapshot.
+ */
+class MappedReader {
+public:
+  MappedReader(const char *data, size_t size) : data_(data), size_(size) {}
+
+  bool get(void *out, size_t size) {
+    if (offset_ + size > size_) {
+      return false;
+    }
+    std::memcpy(out, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  bool get_u32(uint32_t &value) {
+    uint32_t net;
+    if (!get(&net, sizeof(net)))
+      return false;
+    value = be32toh(net);
+    return true;
+  }
+
+  bool get_u64(uint64_t &value) {
+    uint64_t net;
+    if (!get(&net, sizeof(net)))
+      return false;
+    value = be64toh(net);
+    return true;
+  }
+
+private:
+  const char *data_;
+  size_t size_;
+  size_t offset_{0};
+};
+
+} // namespace
+
+/**
+ * @brief Applies one log record to the state.
+ * Used both for live traffic and for replaying the log tail after loading a snapshot.
+ *
+ * @param record The record to apply.
+ */
+void ServerState::apply(const LogRecord &record) {
+  last_sequence = std::max(last_sequence, record.sequence);
+
+  if (record.message.header.type == common::MessageType::S2S_USER_CREDENTIAL) {
+    const std::string &payload = record.message.payload;
+    size_t separator = payload.find('\n');
+    auto hash = separator == std::string::npos ? std::nullopt : common::PasswordHash::decode(payload.substr(separator + 1));
+    if (hash) {
+      password_hashes[payload.substr(0, separator)] = *hash;
+    }
+  }
+}
+
+/**
+ * @brief Constructs a StateSnapshotter that keeps its snapshot in the given directory.
+ * @param directory The data directory of the server.
+ */
+StateSnapshotter::StateSnapshotter(const std::string &directory)
+    : directory_(directory), snapshot_path_((std::filesystem::path(directory) / SNAPSHOT_FILE_NAME).string()),
+      temp_path_(snapshot_path_ + ".tmp") {}
+
+/**
+ * @brief Destructor for StateSnapshotter. Waits for a snapshot that is still being written.
+ */
+StateSnapshotter::~StateSnapshotter() { wait(); }
+
+/**
+ * @brief Starts writing a snapshot in a forked child process.
+ *
+ * The child sees the parent's memory as of the fork, so the snapshot is consistent without
+ * pausing the reactor for the duration of the write.
+ * @param state The state to snapshot.
+ * @return True if the child was started, false if a snapshot is already in progress or fork failed.
+ */
+bool StateSnapshotter::begin(const ServerState &state) {
+  if (in_progress()) {
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    LOG_ERROR(STATE_SNAPSHOT_COMPONENT, "Failed to fork snapshot writer: {}", std::strerror(errno));
+    return false;
+  }
+
+  if (pid == 0) {
+    // Child: only async-signal-safe calls from here on, no logging and no allocation.
+    _exit(write_file(state) ? 0 : 1);
+  }
+
+  child_pid_ = pid;
+  pending_sequence_ = state.last_sequence;
+  LOG_DEBUG(STATE_SNAPSHOT_COMPONENT, "Snapshot of sequence {} started in child {}", pending_sequence_, pid);
+  return true;
+}
+
+/**
+ * @brief Reaps the snapshot child if it has finished, without blocking.
+ * @return True if a snapshot completed successfully during this call.
+ */
+bool StateSnapshotter::poll() {
+  if (!in_progress()) {
+    return false;
+  }
+
+  int status = 0;
+  pid_t result = waitpid(child_pid_, &status, WNOHANG);
+  if (result == 0) {
+    return false;
+  }
+  child_pid_ = -1;
+
+  if (result < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    LOG_ERROR(STATE_SNAPSHOT_COMPONENT, "Snapshot of sequence {} failed", pending_sequence_);
+    return false;
+  }
+
+  last_snapshot_sequence_ = pending_sequence_;
+  LOG_INFO(STATE_SNAPSHOT_COMPONENT, "Snapshot written at sequence {}", last_snapshot_sequence_);
+  return true;
+}
+
+/**
+ * @brief Blocks until an in-progress snapshot has finished.
+ */
+void StateSnapshotter::wait() {
+  while (in_progress()) {
+    int status = 0;
+    pid_t result = waitpid(child_pid_, &status, 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    child_pid_ = -1;
+    if (result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+      last_snapshot_sequence_ = pending_sequence_;
+    }
+  }
+}
+
+/**
+ * @brief Writes a snapshot synchronously, e.g. during a clean shutdown.
+ * @param state The state to snapshot.
+ * @return True on success, false otherwise.
+ */
+bool StateSnapshotter::write_now(const ServerState &state) {
+  wait();
+  if (!write_file(state)) {
+    LOG_ERROR(STATE_SNAPSHOT_COMPONENT, "Failed to write snapshot to {}", snapshot_path_);
+    return false;
+  }
+  last_snapshot_sequence_ = state.last_sequence;
+  return true;
+}
+
+/**
+ * @brief Loads the latest snapshot by memory-mapping it.
+ * @return The restored state, or std::nullopt if there is no valid snapshot.
+ */
+std::optional<ServerState> StateSnapshotter::load_latest() const {
+  int fd = ::open(snapshot_path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  struct stat st {};
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    LOG_ERROR(STATE_SNAPSHOT_COMPONENT, "Failed to map snapshot {}: {}", snapshot_path_, std::strerror(errno));
+    return std::nullopt;
+  }
+  madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+  MappedReader reader(static_cast<const char *>(mapped), st.st_size);
+  ServerState state;
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  uint64_t hash_count = 0;
+  bool ok = reader.get(magic, sizeof(magic)) && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0 &&
+            reader.get_u64(state.last_sequence) && reader.get_u64(hash_count);
+  for (uint64_t i = 0; ok && i < hash_count; ++i) {
+    uint32_t name_size = 0;
+    common::PasswordHash hash;
+    ok = reader.get_u32(name_size) && name_size <= st.st_size;
+    std::string name(ok ? name_size : 0, '\0');
+    ok = ok && reader.get(name.data(), name_size) && reader.get_u32(hash.iterations) &&
+         reader.get(hash.salt.data(), hash.salt.size()) && reader.get(hash.hash.data(), hash.hash.size());
+    if (ok) {
+      state.password_hashes.emplace(std::move(name), hash);
+    }
+  }
+
+  munmap(mapped, st.st_size);
+  if (!ok) {
+    LOG_ERROR(STATE_SNAPSHOT_COMPONENT, "Snapshot {} is corrupted, ignoring it", snapshot_path_);
+    return std::nullopt;
+  }
+  return state;
+}
+
+/**
+ * @brief Gets the path of the latest snapshot file.
+ * @return The snapshot path.
+ */
+std::string StateSnapshotter::get_snapshot_path() const { return snapshot_path_; }
+
+/**
+ * @brief Serializes the state to a file descriptor without allocating.
+ * @param fd The destination file descriptor.
+ * @param state The state to serialize.
+ * @return True on success, false otherwise.
+ */
+bool StateSnapshotter::write_to_fd(int fd, const ServerState &state) {
+  FdWriter writer(fd);
+  writer.put(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  writer.put_u64(state.last_sequence);
+  writer.put_u64(state.password_hashes.size());
+  for (const auto &[name, hash] : state.password_hashes) {
+    writer.put_u32(static_cast<uint32_t>(name.size()));
+    writer.put(name.data(), name.size());
+    writer.put_u32(hash.iterations);
+    writer.put(hash.salt.data(), hash.salt.size());
+    writer.put(hash.hash.data(), hash.hash.size());
+  }
+  return writer.finish();
+}
+
+/**
+ * @brief Writes the snapshot to a temporary file and atomically renames it over the previous one.
+ * Safe to call from the forked child: it uses only system calls and pre-built paths.
+ *
+ * @param state The state to write.
+ * @return True on success, false otherwise.
+ */
+bool StateSnapshotter::write_file(const ServerState &state) const {
+  int fd = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = write_to_fd(fd, state) && fsync(fd) == 0;
+  ::close(fd);
+  if (!ok || ::rename(temp_path_.c_str(), snapshot_path_.c_str()) != 0) {
+    ::unlink(temp_path_.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace server
+} // namespace chat_app
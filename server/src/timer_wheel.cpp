@@ -0,0 +1,76 @@
+#include "server/timer_wheel.h"
+#include <algorithm>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructs a TimerWheel.
+ * @param tick The wheel's resolution.
+ * @param slots Slots of the wheel; timers up to slots ticks away fire without waiting for a full turn.
+ */
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slots)
+    : tick_(std::max(tick, std::chrono::milliseconds(1))), slots_(std::max<size_t>(slots, 1)) {}
+
+/**
+ * @brief Schedules a callback.
+ * @param delay The time until it fires, rounded up to whole ticks; it fires on the next tick at the earliest.
+ * @param callback The callback, run from advance().
+ * @return The timer's ID, for cancel().
+ */
+uint64_t TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+  const uint64_t ticks = std::max<uint64_t>(1, (delay.count() + tick_.count() - 1) / tick_.count());
+  const size_t slot = (current_ + ticks) % slots_.size();
+  const uint64_t id = next_id_++;
+  auto position = slots_[slot].insert(slots_[slot].end(), Timer{id, (ticks - 1) / slots_.size(), std::move(callback)});
+  timers_.emplace(id, std::make_pair(slot, position));
+  return id;
+}
+
+/**
+ * @brief Cancels a timer that has not fired yet.
+ * @param id The timer's ID.
+ * @return False if the timer has fired or was cancelled already.
+ */
+bool TimerWheel::cancel(uint64_t id) {
+  auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return false;
+  }
+  slots_[it->second.first].erase(it->second.second);
+  timers_.erase(it);
+  return true;
+}
+
+/**
+ * @brief Moves the wheel on and runs the callbacks of the timers that are due, in the order they
+ * fall due. Callbacks may schedule and cancel timers.
+ * @param ticks The number of ticks that have passed.
+ * @return The number of callbacks run.
+ */
+size_t TimerWheel::advance(uint64_t ticks) {
+  size_t fired = 0;
+  for (uint64_t i = 0; i < ticks && !timers_.empty(); ++i) {
+    current_ = (current_ + 1) % slots_.size();
+    std::vector<Callback> due;
+    Slot &slot = slots_[current_];
+    for (auto it = slot.begin(); it != slot.end();) {
+      if (it->turns > 0) {
+        --it->turns;
+        ++it;
+        continue;
+      }
+      due.push_back(std::move(it->callback));
+      timers_.erase(it->id);
+      it = slot.erase(it);
+    }
+    for (auto &callback : due) {
+      callback();
+    }
+    fired += due.size();
+  }
+  return fired;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,99 @@
+#include "server/user_directory.h"
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Constructs an empty directory.
+ * @param cache_capacity Lookup answers kept; the least recently used is evicted first.
+ */
+UserDirectory::UserDirectory(size_t cache_capacity) : cache_capacity_(cache_capacity) {}
+
+/**
+ * @brief Records where a user homed at this node is connected.
+ * @param user_id The user ID.
+ * @param node_id The node the user is connected to.
+ */
+void UserDirectory::set_home(uint32_t user_id, uint32_t node_id) { homes_[user_id] = node_id; }
+
+/**
+ * @brief Removes a home entry, unless the user has meanwhile been registered by another node.
+ * @param user_id The user ID.
+ * @param node_id The node reporting that the user left.
+ */
+void UserDirectory::remove_home(uint32_t user_id, uint32_t node_id) {
+  auto it = homes_.find(user_id);
+  if (it != homes_.end() && it->second == node_id) {
+    homes_.erase(it);
+  }
+}
+
+/**
+ * @brief Looks up a user homed at this node.
+ * @param user_id The user ID.
+ * @return The node the user is connected to, or std::nullopt if the user is offline.
+ */
+std::optional<uint32_t> UserDirectory::find_home(uint32_t user_id) const {
+  auto it = homes_.find(user_id);
+  return it == homes_.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+}
+
+/**
+ * @brief Remembers the answer to a lookup.
+ * @param user_id The user ID.
+ * @param node_id The node the user is connected to.
+ */
+void UserDirectory::cache(uint32_t user_id, uint32_t node_id) {
+  forget(user_id);
+  lru_.emplace_front(user_id, node_id);
+  cache_[user_id] = lru_.begin();
+  if (cache_.size() > cache_capacity_) {
+    cache_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+/**
+ * @brief Looks up a remembered answer and marks it as recently used.
+ * @param user_id The user ID.
+ * @return The node the user was connected to, or std::nullopt if not cached.
+ */
+std::optional<uint32_t> UserDirectory::find_cached(uint32_t user_id) {
+  auto it = cache_.find(user_id);
+  if (it == cache_.end()) {
+    return std::nullopt;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->second;
+}
+
+/**
+ * @brief Drops a remembered answer, e.g. because the user left.
+ * @param user_id The user ID.
+ */
+void UserDirectory::forget(uint32_t user_id) {
+  auto it = cache_.find(user_id);
+  if (it != cache_.end()) {
+    lru_.erase(it->second);
+    cache_.erase(it);
+  }
+}
+
+/**
+ * @brief Drops everything pointing at a node that left the cluster.
+ * @param node_id The node ID.
+ */
+void UserDirectory::forget_node(uint32_t node_id) {
+  drop_homes_if([this, node_id](uint32_t user_id) { return homes_.at(user_id) == node_id; });
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    if (it->second == node_id) {
+      cache_.erase(it->first);
+      it = lru_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+} // namespace server
+} // namespace chat_app
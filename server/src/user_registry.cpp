@@ -0,0 +1,372 @@
+#include "server/user_registry.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+namespace {
+
+constexpr char REGISTRY_MAGIC[8] = {'C', 'H', 'A', 'T', 'R', 'E', 'G', '1'};
+
+size_t round_up_to_power_of_two(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace
+
+/**
+ * @brief The first cache line of the registry file. The file is mapped as-is, so it is only
+ * portable between hosts of the same byte order.
+ */
+struct alignas(64) UserRegistry::Header {
+  char magic[8];
+  uint64_t capacity;
+  std::atomic<uint64_t> count;
+  std::atomic<uint32_t> next_user_id;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Slots must be plain memory");
+
+/**
+ * @brief Constructs a UserRegistry backed by the given file.
+ * @param path The registry file. An empty path keeps the registry in memory only.
+ */
+UserRegistry::UserRegistry(const std::string &path) : path_(path) {}
+
+/**
+ * @brief Destructor for UserRegistry. Unmaps the table.
+ */
+UserRegistry::~UserRegistry() { close(); }
+
+/**
+ * @brief Opens the registry file, creating an empty table if it does not exist yet.
+ * @param initial_capacity Number of slots of a newly created table (rounded up to a power of two).
+ * @param first_user_id The ID a newly created table hands out first.
+ * @param last_user_id The highest ID register_user() hands out; registering fails once it is used.
+ * @return True on success, false otherwise.
+ */
+bool UserRegistry::open(size_t initial_capacity, uint32_t first_user_id, uint32_t last_user_id) {
+  last_user_id_ = last_user_id;
+  if (!path_.empty() && access(path_.c_str(), F_OK) == 0) {
+    if (!map_table(0, false)) {
+      return false;
+    }
+    LOG_INFO(USER_REGISTRY_COMPONENT, "Opened registry {} with {} users ({} slots)", path_, size(), capacity());
+    return true;
+  }
+  if (!map_table(round_up_to_power_of_two(std::max<size_t>(initial_capacity, 16)), true)) {
+    return false;
+  }
+  header_->next_user_id.store(first_user_id);
+  return true;
+}
+
+/**
+ * @brief Unmaps the table. Dirty pages are written back by the kernel.
+ */
+void UserRegistry::close() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+    header_ = nullptr;
+    slots_ = nullptr;
+  }
+}
+
+/**
+ * @brief Schedules the dirty pages of the table for write-back.
+ * @return True on success, false otherwise.
+ */
+bool UserRegistry::flush() {
+  if (path_.empty() || !mapping_) {
+    return true;
+  }
+  return msync(mapping_, mapping_size_, MS_ASYNC) == 0;
+}
+
+/**
+ * @brief Looks up the user ID registered for a username.
+ * @param username The username.
+ * @return The user ID, or std::nullopt if the name is not registered.
+ */
+std::optional<uint32_t> UserRegistry::find(const std::string &username) const {
+  Slot *slot = find_slot(username, hash(username));
+  if (!slot) {
+    return std::nullopt;
+  }
+  return slot->user_id;
+}
+
+/**
+ * @brief Returns the user ID of a username, registering it with a new ID if needed.
+ * @param username The username.
+ * @return The user ID, or std::nullopt if the name cannot be registered, e.g. because the IDs ran out.
+ */
+std::optional<uint32_t> UserRegistry::register_user(const std::string &username) {
+  if (username.empty() || username.size() > MAX_REGISTERED_USERNAME) {
+    return std::nullopt;
+  }
+
+  const uint64_t tag = hash(username);
+  if (Slot *slot = find_slot(username, tag)) {
+    return slot->user_id;
+  }
+
+  if ((size() + 1) * 2 > capacity() && !grow()) {
+    return std::nullopt;
+  }
+
+  // Reserve the ID before publishing the slot: a crash in between only wastes an ID. The counter never
+  // passes last_user_id_, whose successor belongs to another node's or worker's range.
+  uint32_t user_id = header_->next_user_id.load();
+  do {
+    if (user_id > last_user_id_) {
+      LOG_ERROR(USER_REGISTRY_COMPONENT, "No user IDs left to register '{}' (last is {})", username, last_user_id_);
+      return std::nullopt;
+    }
+  } while (!header_->next_user_id.compare_exchange_weak(user_id, user_id + 1));
+  write_slot(username, tag, user_id);
+  return user_id;
+}
+
+/**
+ * @brief Registers a username with a known user ID, e.g. when replaying or replicating the log.
+ * @param username The username.
+ * @param user_id The user ID it was registered with.
+ * @return True if the entry is present afterwards, false if the name is bound to another ID or on error.
+ */
+bool UserRegistry::insert(const std::string &username, uint32_t user_id) {
+  if (username.empty() || username.size() > MAX_REGISTERED_USERNAME) {
+    return false;
+  }
+
+  const uint64_t tag = hash(username);
+  if (Slot *slot = find_slot(username, tag)) {
+    if (slot->user_id != user_id) {
+      LOG_WARNING(USER_REGISTRY_COMPONENT, "'{}' is registered as {}, not {}", username, slot->user_id, user_id);
+      return false;
+    }
+    return true;
+  }
+
+  if ((size() + 1) * 2 > capacity() && !grow()) {
+    return false;
+  }
+
+  uint32_t next = header_->next_user_id.load();
+  while (next <= user_id && !header_->next_user_id.compare_exchange_weak(next, user_id + 1)) {
+  }
+  write_slot(username, tag, user_id);
+  return true;
+}
+
+/**
+ * @brief Gets the number of registered usernames.
+ */
+size_t UserRegistry::size() const { return header_ ? header_->count.load() : 0; }
+
+/**
+ * @brief Gets the number of slots of the table.
+ */
+size_t UserRegistry::capacity() const { return header_ ? header_->capacity : 0; }
+
+/**
+ * @brief Gets the user ID the next registration will receive.
+ */
+uint32_t UserRegistry::next_user_id() const { return header_ ? header_->next_user_id.load() : 1; }
+
+/**
+ * @brief 64-bit FNV-1a with a final avalanche step, so the low bits used for the slot index are well mixed.
+ * The hash is persisted in the slot tags and therefore must never change.
+ */
+uint64_t UserRegistry::hash(const std::string &username) {
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : username) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h != 0 ? h : 1; // 0 marks an empty slot
+}
+
+/**
+ * @brief Maps the registry into memory.
+ * @param capacity Number of slots when creating a table; ignored when mapping an existing file.
+ * @param create True to create a new, empty table (replacing any existing file).
+ * @return True on success, false otherwise.
+ */
+bool UserRegistry::map_table(size_t capacity, bool create) {
+  close();
+
+  if (path_.empty()) {
+    mapping_size_ = sizeof(Header) + capacity * sizeof(Slot);
+    mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      LOG_ERROR(USER_REGISTRY_COMPONENT, "Failed to open registry {}: {}", path_, std::strerror(errno));
+      return false;
+    }
+
+    struct stat st {};
+    fstat(fd, &st);
+    if (create) {
+      mapping_size_ = sizeof(Header) + capacity * sizeof(Slot);
+      if (ftruncate(fd, 0) != 0 || ftruncate(fd, mapping_size_) != 0) {
+        LOG_ERROR(USER_REGISTRY_COMPONENT, "Failed to size registry {}: {}", path_, std::strerror(errno));
+        ::close(fd);
+        return false;
+      }
+    } else {
+      mapping_size_ = st.st_size;
+    }
+
+    mapping_ = mapping_size_ >= sizeof(Header)
+                   ? mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                   : MAP_FAILED;
+    ::close(fd);
+  }
+
+  if (mapping_ == MAP_FAILED) {
+    LOG_ERROR(USER_REGISTRY_COMPONENT, "Failed to map registry {}: {}", path_, std::strerror(errno));
+    mapping_ = nullptr;
+    return false;
+  }
+
+  header_ = static_cast<Header *>(mapping_);
+  slots_ = reinterpret_cast<Slot *>(static_cast<char *>(mapping_) + sizeof(Header));
+
+  if (create) {
+    // The mapping is zero-filled, which already marks every slot as empty.
+    std::memcpy(header_->magic, REGISTRY_MAGIC, sizeof(REGISTRY_MAGIC));
+    header_->capacity = capacity;
+    header_->count.store(0);
+    header_->next_user_id.store(1);
+  } else if (std::memcmp(header_->magic, REGISTRY_MAGIC, sizeof(REGISTRY_MAGIC)) != 0 ||
+             mapping_size_ != sizeof(Header) + header_->capacity * sizeof(Slot)) {
+    LOG_ERROR(USER_REGISTRY_COMPONENT, "Registry {} is corrupted", path_);
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Doubles the table. The new table is built in a temporary file and renamed over the old
+ * one, so a crash while growing leaves the old table intact.
+ * @return True on success, false otherwise.
+ */
+bool UserRegistry::grow() {
+  const size_t old_capacity = capacity();
+  const size_t new_capacity = old_capacity * 2;
+  void *old_mapping = mapping_;
+  const size_t old_mapping_size = mapping_size_;
+  Slot *old_slots = slots_;
+  const uint32_t next_user_id = header_->next_user_id.load();
+
+  // Detach the old mapping so map_table() does not unmap it while we still copy from it.
+  mapping_ = nullptr;
+  const std::string final_path = path_;
+  if (!path_.empty()) {
+    path_ = final_path + ".tmp";
+  }
+
+  bool ok = map_table(new_capacity, true);
+  if (ok) {
+    // write_slot() counts the copied names, so the new table's count is that of the names actually
+    // there, even if a crash left the old count one short.
+    for (size_t i = 0; i < old_capacity; ++i) {
+      const Slot &slot = old_slots[i];
+      const uint64_t tag = slot.tag.load(std::memory_order_acquire);
+      if (tag != 0) {
+        write_slot(std::string(slot.name, slot.name_size), tag, slot.user_id);
+      }
+    }
+    header_->next_user_id.store(next_user_id);
+  }
+
+  if (ok && !final_path.empty()) {
+    ok = msync(mapping_, mapping_size_, MS_SYNC) == 0 && std::rename(path_.c_str(), final_path.c_str()) == 0;
+  }
+  path_ = final_path;
+
+  if (!ok) {
+    LOG_ERROR(USER_REGISTRY_COMPONENT, "Failed to grow registry to {} slots", new_capacity);
+    close();
+    mapping_ = old_mapping;
+    mapping_size_ = old_mapping_size;
+    header_ = static_cast<Header *>(mapping_);
+    slots_ = old_slots;
+    return false;
+  }
+
+  munmap(old_mapping, old_mapping_size);
+  LOG_INFO(USER_REGISTRY_COMPONENT, "Registry grown to {} slots", new_capacity);
+  return true;
+}
+
+/**
+ * @brief Probes for the slot holding a username.
+ * @param username The username.
+ * @param tag The username's hash.
+ * @return The slot, or nullptr if the name is not registered.
+ */
+UserRegistry::Slot *UserRegistry::find_slot(const std::string &username, uint64_t tag) const {
+  if (!slots_) {
+    return nullptr;
+  }
+
+  const size_t mask = capacity() - 1;
+  for (size_t index = tag & mask;; index = (index + 1) & mask) {
+    Slot &slot = slots_[index];
+    const uint64_t slot_tag = slot.tag.load(std::memory_order_acquire);
+    if (slot_tag == 0) {
+      return nullptr;
+    }
+    if (slot_tag == tag && slot.name_size == username.size() &&
+        std::memcmp(slot.name, username.data(), username.size()) == 0) {
+      return &slot;
+    }
+  }
+}
+
+/**
+ * @brief Writes an entry into the first free slot of its probe sequence.
+ * The tag is stored last, with release ordering, which is what makes the entry visible.
+ *
+ * @param username The username.
+ * @param tag The username's hash.
+ * @param user_id The user ID.
+ */
+void UserRegistry::write_slot(const std::string &username, uint64_t tag, uint32_t user_id) {
+  const size_t mask = capacity() - 1;
+  size_t index = tag & mask;
+  while (slots_[index].tag.load(std::memory_order_relaxed) != 0) {
+    index = (index + 1) & mask;
+  }
+
+  Slot &slot = slots_[index];
+  slot.user_id = user_id;
+  slot.name_size = static_cast<uint8_t>(username.size());
+  std::memcpy(slot.name, username.data(), username.size());
+  slot.tag.store(tag, std::memory_order_release);
+  header_->count.fetch_add(1);
+}
+
+} // namespace server
+} // namespace chat_app
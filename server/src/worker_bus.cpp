@@ -0,0 +1,135 @@
+#include "server/worker_bus.h"
+#include "common/logger.h"
+#include "common/socket.h"
+#include "server/federation.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <linux/filter.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace chat_app {
+namespace server {
+
+/**
+ * @brief Counts a connection a worker accepted, and whether it arrived on another CPU than the
+ * one the worker runs on.
+ * @param stats The worker's counts.
+ * @param fd The connection's FD.
+ * @param metrics The worker's metrics.
+ */
+void count_connection(WorkerStats &stats, int fd, common::Metrics &metrics) {
+  ++stats.accepted;
+  ++stats.connected;
+  int incoming_cpu = -1;
+  socklen_t length = sizeof(incoming_cpu);
+  if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, &length) == 0 && incoming_cpu >= 0 &&
+      incoming_cpu != sched_getcpu()) {
+    ++stats.off_cpu;
+    metrics.increment_counter("connections_off_cpu");
+  }
+}
+
+/**
+ * @brief Publishes the connection counts of all workers as gauges, with the spread between the
+ * busiest and the idlest worker as a percentage of the busiest.
+ * @param metrics The publishing worker's metrics.
+ * @param stats The counts of all workers.
+ * @param workers The number of workers.
+ */
+void publish_worker_balance(common::Metrics &metrics, const WorkerStats *stats, size_t workers) {
+  int64_t most = 0;
+  int64_t least = INT64_MAX;
+  for (size_t worker = 0; worker < workers; ++worker) {
+    const int64_t connected = stats[worker].connected.load();
+    const std::string prefix = "worker_" + std::to_string(worker);
+    metrics.set_gauge(prefix + "_connections", connected);
+    metrics.set_gauge(prefix + "_accepted", static_cast<int64_t>(stats[worker].accepted.load()));
+    metrics.set_gauge(prefix + "_off_cpu", static_cast<int64_t>(stats[worker].off_cpu.load()));
+    most = std::max(most, connected);
+    least = std::min(least, connected);
+  }
+  metrics.set_gauge("worker_connection_skew_percent", most > 0 ? (most - least) * 100 / most : 0);
+}
+
+/**
+ * @brief Checks that a server can be split into workers: each worker would own clustering,
+ * persistence, replication, gateways and the Unix domain socket on its own, and they need one
+ * owner per server. Steering connections by CPU needs a CPU per worker.
+ * @param config The server settings.
+ * @param workers The number of workers.
+ * @param mode The name of the mode, for the log.
+ * @return True if the settings allow it, false otherwise.
+ */
+bool check_worker_config(const ServerConfig &config, size_t workers, const char *mode) {
+  if (workers == 0 || workers > MAX_NODE_ID) {
+    LOG_ERROR(WORKER_BUS_COMPONENT, "{} worker count must be between 1 and {}", mode, MAX_NODE_ID);
+    return false;
+  }
+  if (config.node_id != 0 || !config.data_dir.empty() || config.replication_port != 0 ||
+      !config.replicate_from.empty() || config.gateway_port != 0 || !config.gateway_shm_path.empty() ||
+      !config.upstreams.empty() || !config.unix_socket_path.empty()) {
+    LOG_ERROR(WORKER_BUS_COMPONENT,
+              "{} mode does not support clustering, persistence, replication, gateways or Unix domain sockets", mode);
+    return false;
+  }
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (config.cpu_steering && static_cast<long>(workers) > cpus) {
+    LOG_ERROR(WORKER_BUS_COMPONENT, "CPU steering needs at most one worker per CPU ({} CPUs)", cpus);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Attaches a reuseport program to a listener's SO_REUSEPORT group that hands each
+ * connection to the listener with the index of the CPU it arrived on, modulo the group size.
+ * Listeners are indexed in the order they joined the group.
+ *
+ * @param listener_fd A bound listener of the group.
+ * @param group_size The number of listeners in the group.
+ * @return True on success, false otherwise.
+ */
+bool attach_cpu_steering(int listener_fd, size_t group_size) {
+  sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(group_size)},
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  sock_fprog program{};
+  program.len = sizeof(code) / sizeof(code[0]);
+  program.filter = code;
+  if (setsockopt(listener_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0) {
+    LOG_ERROR(WORKER_BUS_COMPONENT, "Failed to attach the CPU steering program: {}", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Binds one listener per worker to the port, in worker order, and steers connections
+ * between them by CPU. Worker i takes listener i and is pinned to CPU i.
+ *
+ * @return The listeners, or an empty vector on failure.
+ */
+std::vector<std::unique_ptr<common::IListeningSocket>> bind_steered_listeners(int port, size_t workers) {
+  std::vector<std::unique_ptr<common::IListeningSocket>> listeners;
+  for (size_t worker = 0; worker < workers; ++worker) {
+    auto listener = common::PosixSocket::create_listener(true);
+    if (!listener || !listener->bind_socket(port) || !listener->listen_socket(1024)) {
+      LOG_ERROR(WORKER_BUS_COMPONENT, "Failed to bind or listen on port {}", port);
+      return {};
+    }
+    listeners.push_back(std::move(listener));
+  }
+  if (!attach_cpu_steering(listeners.front()->get_fd(), workers)) {
+    return {};
+  }
+  return listeners;
+}
+
+} // namespace server
+} // namespace chat_app
@@ -0,0 +1,63 @@
+#include "common/affinity.h"
+#include "gtest/gtest.h"
+#include <sched.h>
+#include <sys/mman.h>
+#include <thread>
+
+using namespace chat_app::common;
+
+TEST(AffinityTest, ParsesCpuLists) {
+  EXPECT_EQ(parse_cpu_list("3"), std::vector<int>({3}));
+  EXPECT_EQ(parse_cpu_list("0-2,8"), std::vector<int>({0, 1, 2, 8}));
+  EXPECT_TRUE(parse_cpu_list("").empty());
+  EXPECT_TRUE(parse_cpu_list("2-1").empty());
+  EXPECT_TRUE(parse_cpu_list("1,x").empty());
+  EXPECT_TRUE(parse_cpu_list("-1").empty());
+  EXPECT_TRUE(parse_cpu_list("1-").empty());
+}
+
+TEST(AffinityTest, PinsTheCallingThreadOnly) {
+  cpu_set_t before;
+  sched_getaffinity(0, sizeof(before), &before);
+
+  int pinned_cpu = -1;
+  std::thread([&pinned_cpu]() {
+    if (pin_current_thread(0)) {
+      pinned_cpu = sched_getcpu();
+    }
+  }).join();
+  EXPECT_EQ(pinned_cpu, 0);
+
+  cpu_set_t after;
+  sched_getaffinity(0, sizeof(after), &after);
+  EXPECT_TRUE(CPU_EQUAL(&before, &after)) << "Other threads keep their affinity";
+}
+
+TEST(AffinityTest, PlacesMemoryOnTheNodeOfThePinnedThread) {
+  const int node = node_of_cpu(0);
+  if (node < 0) {
+    GTEST_SKIP() << "No NUMA topology exposed";
+  }
+
+  int placed_on = -2;
+  std::thread([&placed_on]() {
+    pin_current_thread(0);
+    prefer_local_memory();
+    std::vector<char> buffer(1 << 20, 1); // Touched, so placed
+    placed_on = node_of_address(buffer.data());
+  }).join();
+  if (placed_on == -1) {
+    GTEST_SKIP() << "Memory policy calls are not permitted here";
+  }
+  EXPECT_EQ(placed_on, node);
+
+  const size_t length = 1 << 20;
+  void *memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(memory, MAP_FAILED);
+  if (bind_memory_to_node(memory, length, node)) {
+    static_cast<char *>(memory)[0] = 1;
+    EXPECT_EQ(node_of_address(memory), node);
+  }
+  EXPECT_FALSE(bind_memory_to_node(memory, length, -1));
+  munmap(memory, length);
+}
@@ -0,0 +1,64 @@
+#include "common/compression.h"
+#include "gtest/gtest.h"
+#include <random>
+#include <string>
+
+using namespace chat_app::common;
+
+namespace {
+
+std::vector<char> round_trip(const std::string &input) {
+  auto compressed = lz_compress(input.data(), input.size());
+  std::vector<char> output;
+  EXPECT_TRUE(lz_decompress(compressed.data(), compressed.size(), output));
+  return output;
+}
+
+} // namespace
+
+TEST(CompressionTest, RoundTripsEdgeCases) {
+  for (const std::string &input : {std::string(), std::string("a"), std::string("abcd"), std::string(1000, 'x'),
+                                   std::string("abcabcabcabcabcabcabcabcabcabcabc")}) {
+    auto output = round_trip(input);
+    EXPECT_EQ(std::string(output.begin(), output.end()), input);
+  }
+}
+
+TEST(CompressionTest, ShrinksRepetitiveTraffic) {
+  std::string input;
+  for (int i = 0; i < 500; ++i) {
+    input += "\x12user" + std::to_string(i % 20) + ": hello everyone, how is it going?";
+  }
+
+  auto compressed = lz_compress(input.data(), input.size());
+  EXPECT_LT(compressed.size(), input.size() / 4);
+
+  std::vector<char> output;
+  ASSERT_TRUE(lz_decompress(compressed.data(), compressed.size(), output));
+  EXPECT_EQ(std::string(output.begin(), output.end()), input);
+}
+
+TEST(CompressionTest, RoundTripsRandomData) {
+  std::mt19937 rng(42);
+  for (size_t size : {17u, 4096u, 200000u}) {
+    std::string input(size, '\0');
+    for (auto &c : input) {
+      c = static_cast<char>(rng() % 4); // Small alphabet: many short, overlapping matches
+    }
+    auto output = round_trip(input);
+    EXPECT_EQ(std::string(output.begin(), output.end()), input);
+  }
+}
+
+TEST(CompressionTest, RejectsMalformedInput) {
+  std::vector<char> output;
+  EXPECT_FALSE(lz_decompress("", 0, output));
+
+  auto compressed = lz_compress("hello hello hello hello", 23);
+  compressed[0] = 0x7f; // Absurd uncompressed size
+  EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size(), output));
+
+  compressed = lz_compress("hello hello hello hello", 23);
+  compressed.pop_back();
+  EXPECT_FALSE(lz_decompress(compressed.data(), compressed.size(), output));
+}
@@ -0,0 +1,246 @@
+#include "common/concurrent_queue.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chat_app::common;
+
+TEST(SpscQueueTest, KeepsOrderAndRefusesWhenFull) {
+  SpscQueue<std::string> queue(3);
+  EXPECT_EQ(queue.capacity(), 4u);
+  EXPECT_TRUE(queue.empty());
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.try_push(std::to_string(i)));
+  }
+  EXPECT_FALSE(queue.try_push("full"));
+
+  EXPECT_EQ(queue.try_pop(), "0");
+  std::string batch[] = {"4", "5"};
+  EXPECT_EQ(queue.push_batch(batch, 2), 1u) << "Only one slot was free";
+
+  std::string out[8];
+  ASSERT_EQ(queue.pop_batch(out, 8), 4u);
+  EXPECT_EQ(out[0], "1");
+  EXPECT_EQ(out[3], "4");
+  EXPECT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(SpscQueueTest, HandsOverEveryElementInOrderUnderContention) {
+  constexpr uint64_t COUNT = 500000;
+  SpscQueue<uint64_t> queue(1024);
+
+  std::thread producer([&queue]() {
+    uint64_t next = 0;
+    uint64_t batch[16];
+    while (next < COUNT) {
+      if (next % 3 == 0) {
+        if (queue.try_push(next)) {
+          ++next;
+        } else {
+          std::this_thread::yield();
+        }
+        continue;
+      }
+      const size_t size = std::min<uint64_t>(16, COUNT - next);
+      for (size_t i = 0; i < size; ++i) {
+        batch[i] = next + i;
+      }
+      const size_t pushed = queue.push_batch(batch, size);
+      next += pushed;
+      if (pushed == 0) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint64_t expected = 0;
+  uint64_t out[32];
+  while (expected < COUNT) {
+    const size_t popped = queue.pop_batch(out, 32);
+    for (size_t i = 0; i < popped; ++i) {
+      ASSERT_EQ(out[i], expected++);
+    }
+    if (popped == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTest, KeepsOrderAndRefusesWhenFull) {
+  MpscQueue<int> queue(4);
+  int batch[] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(queue.push_batch(batch, 6), 4u) << "A batch takes what fits";
+  EXPECT_FALSE(queue.try_push(7));
+
+  EXPECT_EQ(queue.try_pop(), 1);
+  EXPECT_EQ(queue.push_batch(batch + 4, 2), 1u);
+
+  int out[8];
+  ASSERT_EQ(queue.pop_batch(out, 8), 4u);
+  EXPECT_EQ(out[0], 2);
+  EXPECT_EQ(out[3], 5);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTest, HandsOverEveryElementOfEveryProducerUnderContention) {
+  constexpr uint64_t PRODUCERS = 4;
+  constexpr uint64_t PER_PRODUCER = 100000;
+  MpscQueue<uint64_t> queue(256);
+
+  std::vector<std::thread> producers;
+  for (uint64_t producer = 0; producer < PRODUCERS; ++producer) {
+    producers.emplace_back([&queue, producer]() {
+      uint64_t next = 0;
+      uint64_t batch[8];
+      while (next < PER_PRODUCER) {
+        // Alternate single pushes and batches so that both race with each other.
+        const size_t size = next % 2 == 0 ? 1 : std::min<uint64_t>(8, PER_PRODUCER - next);
+        for (size_t i = 0; i < size; ++i) {
+          batch[i] = (producer << 32) | (next + i);
+        }
+        const size_t pushed = queue.push_batch(batch, size);
+        next += pushed;
+        if (pushed == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<uint64_t> next_expected(PRODUCERS, 0);
+  uint64_t received = 0;
+  uint64_t out[64];
+  while (received < PRODUCERS * PER_PRODUCER) {
+    const size_t popped = queue.pop_batch(out, 64);
+    for (size_t i = 0; i < popped; ++i) {
+      const uint64_t producer = out[i] >> 32;
+      ASSERT_LT(producer, PRODUCERS);
+      ASSERT_EQ(out[i] & 0xFFFFFFFF, next_expected[producer]++) << "Each producer's elements stay in order";
+    }
+    received += popped;
+    if (popped == 0) {
+      std::this_thread::yield();
+    }
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(WakeupSignalTest, SignalsOnlyWhenTheQueueBecomesNonEmpty) {
+  MpscQueue<int> queue(16);
+  WakeupSignal signal;
+  ASSERT_TRUE(signal.is_valid());
+
+  for (int i = 0; i < 3; ++i) {
+    queue.try_push(i);
+    signal.notify();
+  }
+  EXPECT_EQ(signal.signals_sent(), 1u);
+  pollfd pfd{signal.get_fd(), POLLIN, 0};
+  EXPECT_EQ(poll(&pfd, 1, 0), 1);
+
+  std::vector<int> drained;
+  EXPECT_EQ(signal.drain(queue, [&drained](int value) { drained.push_back(value); }), 3u);
+  EXPECT_EQ(drained, std::vector<int>({0, 1, 2}));
+  EXPECT_EQ(poll(&pfd, 1, 0), 0) << "Drained and not signaled again";
+
+  queue.try_push(3);
+  signal.notify();
+  EXPECT_EQ(signal.signals_sent(), 2u);
+}
+
+TEST(WakeupSignalTest, NeverLosesAWakeupUnderContention) {
+  constexpr int PRODUCERS = 3;
+  constexpr int PER_PRODUCER = 100000;
+  MpscQueue<int> queue(512);
+  WakeupSignal signal;
+
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < PRODUCERS; ++producer) {
+    producers.emplace_back([&queue, &signal]() {
+      for (int i = 0; i < PER_PRODUCER; ++i) {
+        while (!queue.try_push(i)) {
+          std::this_thread::yield();
+        }
+        signal.notify();
+      }
+    });
+  }
+
+  // The consumer only looks at the queue when the eventfd fires, as a reactor would.
+  int received = 0;
+  pollfd pfd{signal.get_fd(), POLLIN, 0};
+  while (received < PRODUCERS * PER_PRODUCER) {
+    ASSERT_EQ(poll(&pfd, 1, 5000), 1) << "A push went unsignaled";
+    received += static_cast<int>(signal.drain(queue, [](int) {}));
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  EXPECT_LT(signal.signals_sent(), static_cast<uint64_t>(PRODUCERS * PER_PRODUCER));
+}
+
+TEST(ChaseLevDequeTest, OwnerTakesNewestAndThievesStealOldest) {
+  ChaseLevDeque<int> deque(2);
+  for (int i = 1; i <= 5; ++i) {
+    deque.push(i); // Grows past the initial capacity
+  }
+  EXPECT_EQ(deque.size(), 5u);
+  EXPECT_EQ(deque.take(), 5);
+  EXPECT_EQ(deque.steal(), 1);
+  EXPECT_EQ(deque.steal(), 2);
+  EXPECT_EQ(deque.take(), 4);
+  EXPECT_EQ(deque.take(), 3);
+  EXPECT_FALSE(deque.take().has_value());
+  EXPECT_FALSE(deque.steal().has_value());
+}
+
+TEST(ChaseLevDequeTest, HandsOutEveryElementOnceUnderContention) {
+  constexpr int ELEMENTS = 20000;
+  ChaseLevDeque<int> deque(16);
+  std::vector<std::atomic<int>> seen(ELEMENTS);
+  std::atomic<bool> done{false};
+
+  std::vector<std::thread> thieves;
+  for (int thief = 0; thief < 2; ++thief) {
+    thieves.emplace_back([&]() {
+      while (!done || deque.size() > 0) {
+        if (auto value = deque.steal()) {
+          ++seen[*value];
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int i = 0; i < ELEMENTS; ++i) {
+    deque.push(i);
+    if (i % 3 == 0) {
+      if (auto value = deque.take()) {
+        ++seen[*value];
+      }
+    }
+    if (i % 256 == 0) {
+      std::this_thread::yield();
+    }
+  }
+  while (auto value = deque.take()) {
+    ++seen[*value];
+  }
+  done = true;
+  for (auto &thief : thieves) {
+    thief.join();
+  }
+
+  for (int i = 0; i < ELEMENTS; ++i) {
+    ASSERT_EQ(seen[i].load(), 1) << "Element " << i;
+  }
+}
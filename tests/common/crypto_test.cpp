@@ -0,0 +1,65 @@
+#include "common/crypto.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <string>
+
+using namespace chat_app::common;
+
+namespace {
+
+std::string hex(const Sha256Digest &digest) {
+  std::string result;
+  char byte[3];
+  for (uint8_t b : digest) {
+    std::snprintf(byte, sizeof(byte), "%02x", b);
+    result += byte;
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(CryptoTest, Sha256KnownAnswers) {
+  EXPECT_EQ(hex(sha256("", 0)), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(hex(sha256("abc", 3)), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  const std::string two_blocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  EXPECT_EQ(hex(sha256(two_blocks.data(), two_blocks.size())),
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(CryptoTest, HmacSha256KnownAnswer) {
+  const std::string data = "what do ya want for nothing?";
+  EXPECT_EQ(hex(hmac_sha256("Jefe", data.data(), data.size())),
+            "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+}
+
+TEST(CryptoTest, Pbkdf2Sha256KnownAnswers) {
+  EXPECT_EQ(hex(pbkdf2_sha256("password", "salt", 4, 1)),
+            "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b");
+  EXPECT_EQ(hex(pbkdf2_sha256("password", "salt", 4, 4096)),
+            "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a");
+}
+
+TEST(CryptoTest, PasswordHashVerifiesAndRoundTrips) {
+  auto hash = PasswordHash::create("secret", 1000);
+  ASSERT_TRUE(hash.has_value());
+  EXPECT_TRUE(hash->verify("secret"));
+  EXPECT_FALSE(hash->verify("Secret"));
+
+  auto decoded = PasswordHash::decode(hash->encode());
+  ASSERT_TRUE(decoded.has_value());
+  EXPECT_EQ(decoded->iterations, 1000u);
+  EXPECT_TRUE(decoded->verify("secret"));
+
+  auto other = PasswordHash::create("secret", 1000);
+  ASSERT_TRUE(other.has_value());
+  EXPECT_NE(other->salt, hash->salt) << "Every hash should get its own salt";
+}
+
+TEST(CryptoTest, PasswordHashRejectsMalformedEncoding) {
+  EXPECT_FALSE(PasswordHash::decode("").has_value());
+  EXPECT_FALSE(PasswordHash::decode("1000$00$00").has_value());
+  EXPECT_FALSE(PasswordHash::decode("x$" + std::string(32, '0') + "$" + std::string(64, '0')).has_value());
+  EXPECT_TRUE(PasswordHash::decode("1$" + std::string(32, '0') + "$" + std::string(64, '0')).has_value());
+}
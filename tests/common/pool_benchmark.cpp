@@ -0,0 +1,151 @@
+// Compares the work-stealing pool with a pool behind one std::mutex-guarded std::deque under bursty
+// load: bursts of small tasks separated by idle gaps, as when a reactor offloads a batch of events.
+// Not run by ctest:
+//   ./pool_benchmark [bursts] [tasks per burst] [threads]
+#include "common/work_stealing_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace chat_app::common;
+
+namespace {
+
+class LockedPool {
+public:
+  explicit LockedPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back([this]() { worker_loop(); });
+    }
+  }
+
+  ~LockedPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto &thread : threads_) {
+      thread.join();
+    }
+  }
+
+  bool submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    wakeup_.notify_one();
+    return true;
+  }
+
+private:
+  void worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wakeup_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      auto task = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_{false};
+  std::vector<std::thread> threads_;
+};
+
+// A small CPU-bound task, about the cost of hashing a short frame.
+void spin(uint64_t &sink) {
+  uint64_t value = sink | 1;
+  for (int i = 0; i < 200; ++i) {
+    value ^= value << 13;
+    value ^= value >> 7;
+    value ^= value << 17;
+  }
+  sink = value;
+}
+
+struct Result {
+  double tasks_per_second;
+  double median_burst_us;
+  double worst_burst_us;
+};
+
+template <typename Pool> Result run(Pool &pool, int bursts, int per_burst) {
+  std::vector<double> latencies;
+  std::atomic<uint64_t> sink{0};
+  double busy_seconds = 0;
+
+  for (int burst = 0; burst < bursts; ++burst) {
+    std::atomic<int> remaining{per_burst};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < per_burst;) {
+      const bool queued = pool.submit([&remaining, &sink]() {
+        uint64_t value = sink.load(std::memory_order_relaxed);
+        spin(value);
+        sink.store(value, std::memory_order_relaxed);
+        remaining.fetch_sub(1, std::memory_order_release);
+      });
+      if (queued) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+      std::this_thread::yield();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    latencies.push_back(elapsed.count() * 1e6);
+    busy_seconds += elapsed.count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2)); // The workers go idle between bursts
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  return {static_cast<double>(bursts) * per_burst / busy_seconds, latencies[latencies.size() / 2], latencies.back()};
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int bursts = argc > 1 ? std::atoi(argv[1]) : 200;
+  const int per_burst = argc > 2 ? std::atoi(argv[2]) : 2000;
+  const size_t threads =
+      argc > 3 ? std::strtoul(argv[3], nullptr, 10) : std::max(2u, std::thread::hardware_concurrency());
+  std::printf("%d bursts of %d tasks on %zu threads\n", bursts, per_burst, threads);
+  std::printf("%-16s %14s %16s %16s\n", "", "Million tasks/s", "Median burst us", "Worst burst us");
+
+  auto row = [](const char *name, const Result &result) {
+    std::printf("%-16s %14.2f %16.0f %16.0f\n", name, result.tasks_per_second / 1e6, result.median_burst_us,
+                result.worst_burst_us);
+  };
+
+  {
+    WorkStealingPool pool(threads, 4096);
+    pool.start();
+    row("work stealing", run(pool, bursts, per_burst));
+    std::printf("%-16s %llu of %llu tasks stolen\n", "",
+                static_cast<unsigned long long>(pool.stolen()), static_cast<unsigned long long>(pool.executed()));
+  }
+  {
+    LockedPool pool(threads);
+    row("mutex + deque", run(pool, bursts, per_burst));
+  }
+  return 0;
+}
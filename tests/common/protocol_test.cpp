@@ -161,4 +161,15 @@ TEST(ProtocolTest, SerializeAndDeserializeMultipleMessages) {
     offset += HEADER_SIZE + expected_msg.header.payload_size;
   }
   EXPECT_EQ(offset, buffer.size());
-}
\ No newline at end of file
+}
+TEST(ProtocolTest, TellsChatFromControlMessages) {
+  EXPECT_TRUE(is_chat_message(MessageType::C2S_BROADCAST));
+  EXPECT_TRUE(is_chat_message(MessageType::C2S_PRIVATE));
+  EXPECT_TRUE(is_chat_message(MessageType::S2C_BROADCAST));
+  EXPECT_TRUE(is_chat_message(MessageType::S2C_PRIVATE));
+  EXPECT_FALSE(is_chat_message(MessageType::C2S_JOIN));
+  EXPECT_FALSE(is_chat_message(MessageType::C2S_LEAVE));
+  EXPECT_FALSE(is_chat_message(MessageType::S2C_JOIN_SUCCESS));
+  EXPECT_FALSE(is_chat_message(MessageType::S2C_USER_JOINED));
+  EXPECT_FALSE(is_chat_message(MessageType::S2C_ERROR));
+}
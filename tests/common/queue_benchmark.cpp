@@ -0,0 +1,99 @@
+// Compares the lock-free queues with a std::mutex-guarded std::deque. Not run by ctest:
+//   ./queue_benchmark [elements per producer]
+#include "common/concurrent_queue.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace chat_app::common;
+
+namespace {
+
+class LockedQueue {
+public:
+  using value_type = uint64_t;
+
+  size_t push_batch(uint64_t *values, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() + count > 4096) {
+      count = 4096 - std::min<size_t>(queue_.size(), 4096);
+    }
+    queue_.insert(queue_.end(), values, values + count);
+    return count;
+  }
+
+  size_t pop_batch(uint64_t *out, size_t max_count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t popped = std::min(max_count, queue_.size());
+    std::copy(queue_.begin(), queue_.begin() + popped, out);
+    queue_.erase(queue_.begin(), queue_.begin() + popped);
+    return popped;
+  }
+
+private:
+  std::mutex mutex_;
+  std::deque<uint64_t> queue_;
+};
+
+template <typename Queue> double run(Queue &queue, int producers, uint64_t per_producer, size_t batch) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < producers; ++producer) {
+    threads.emplace_back([&queue, per_producer, batch]() {
+      std::vector<uint64_t> values(batch);
+      for (uint64_t sent = 0; sent < per_producer;) {
+        const size_t size = std::min<uint64_t>(batch, per_producer - sent);
+        for (size_t i = 0; i < size; ++i) {
+          values[i] = sent + i;
+        }
+        const size_t pushed = queue.push_batch(values.data(), size);
+        sent += pushed;
+        if (pushed == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<uint64_t> out(64);
+  for (uint64_t received = 0; received < producers * per_producer;) {
+    const size_t popped = queue.pop_batch(out.data(), out.size());
+    received += popped;
+    if (popped == 0) {
+      std::this_thread::yield();
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return producers * per_producer / elapsed.count() / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const uint64_t per_producer = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+  std::printf("%-28s %10s %10s\n", "Million elements/s", "batch 1", "batch 32");
+
+  auto row = [per_producer](const char *name, auto make, int producers) {
+    double rates[2];
+    size_t batches[2] = {1, 32};
+    for (int i = 0; i < 2; ++i) {
+      auto queue = make();
+      rates[i] = run(*queue, producers, per_producer / producers, batches[i]);
+    }
+    std::printf("%-28s %10.1f %10.1f\n", name, rates[0], rates[1]);
+  };
+
+  row("SPSC, 1 producer", [] { return std::make_unique<SpscQueue<uint64_t>>(4096); }, 1);
+  row("mutex + deque, 1 producer", [] { return std::make_unique<LockedQueue>(); }, 1);
+  row("MPSC, 1 producer", [] { return std::make_unique<MpscQueue<uint64_t>>(4096); }, 1);
+  row("MPSC, 4 producers", [] { return std::make_unique<MpscQueue<uint64_t>>(4096); }, 4);
+  row("mutex + deque, 4 producers", [] { return std::make_unique<LockedQueue>(); }, 4);
+  return 0;
+}
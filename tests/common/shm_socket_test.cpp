@@ -0,0 +1,244 @@
+#include "common/shm_socket.h"
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <numeric>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::common;
+
+namespace {
+
+// Waits for an edge on a socket's FD, as the server's event loop does.
+bool wait_readable(int epoll_fd, int timeout_ms) {
+  epoll_event event{};
+  return epoll_wait(epoll_fd, &event, 1, timeout_ms) == 1;
+}
+
+int watch(int fd) {
+  int epoll_fd = epoll_create1(0);
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLET;
+  event.data.fd = fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  return epoll_fd;
+}
+
+} // namespace
+
+TEST(ShmSocketTest, TransfersDataBothWaysAcrossTheRingEnd) {
+  auto [first, second] = ShmSocket::create_pair(64);
+  ASSERT_TRUE(first && second);
+  first->set_non_blocking(true);
+  second->set_non_blocking(true);
+
+  std::vector<char> received;
+  for (int round = 0; round < 20; ++round) {
+    std::vector<char> data(37, static_cast<char>('a' + round));
+    auto sent = first->send_data(data);
+    ASSERT_EQ(sent.status, SocketStatus::OK);
+    ASSERT_EQ(sent.bytes_transferred, data.size());
+
+    char buffer[64];
+    auto result = second->raw_receive(buffer, sizeof(buffer));
+    ASSERT_EQ(result.status, SocketStatus::OK);
+    ASSERT_EQ(result.bytes_transferred, data.size());
+    EXPECT_EQ(std::vector<char>(buffer, buffer + result.bytes_transferred), data);
+  }
+
+  ASSERT_EQ(second->send_data({'o', 'k'}).bytes_transferred, 2u);
+  char buffer[8];
+  auto result = first->raw_receive(buffer, sizeof(buffer));
+  ASSERT_EQ(result.status, SocketStatus::OK);
+  EXPECT_EQ(std::string(buffer, result.bytes_transferred), "ok");
+  EXPECT_EQ(first->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::WOULD_BLOCK);
+}
+
+TEST(ShmSocketTest, WakesTheReaderAndTheBlockedWriter) {
+  auto [writer, reader] = ShmSocket::create_pair(64);
+  ASSERT_TRUE(writer && reader);
+  writer->set_non_blocking(true);
+  reader->set_non_blocking(true);
+  int reader_epoll = watch(reader->get_fd());
+  int writer_epoll = watch(writer->get_fd());
+
+  char buffer[128];
+  EXPECT_EQ(reader->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::WOULD_BLOCK);
+  ASSERT_EQ(writer->send_data(std::vector<char>(100, 'x')).bytes_transferred, 64u) << "Partial write to a full ring";
+  EXPECT_TRUE(wait_readable(reader_epoll, 1000)) << "A waiting reader is woken";
+  EXPECT_EQ(writer->send_data({'y'}).status, SocketStatus::WOULD_BLOCK);
+
+  ASSERT_EQ(reader->raw_receive(buffer, sizeof(buffer)).bytes_transferred, 64u);
+  EXPECT_TRUE(wait_readable(writer_epoll, 1000)) << "A writer waiting for room is woken";
+  EXPECT_EQ(writer->send_data({'y'}).bytes_transferred, 1u);
+
+  // Each new round of waiting gets a new edge.
+  EXPECT_EQ(reader->raw_receive(buffer, sizeof(buffer)).bytes_transferred, 1u);
+  EXPECT_EQ(reader->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::WOULD_BLOCK);
+  ASSERT_EQ(writer->send_data({'z'}).bytes_transferred, 1u);
+  EXPECT_TRUE(wait_readable(reader_epoll, 1000));
+
+  close(reader_epoll);
+  close(writer_epoll);
+}
+
+TEST(ShmSocketTest, PeerSeesCloseAfterTheRemainingData) {
+  auto [first, second] = ShmSocket::create_pair();
+  ASSERT_TRUE(first && second);
+  second->set_non_blocking(true);
+
+  ASSERT_EQ(first->send_data({'b', 'y', 'e'}).bytes_transferred, 3u);
+  first->close_socket();
+  EXPECT_FALSE(first->is_valid());
+
+  char buffer[8];
+  auto result = second->raw_receive(buffer, sizeof(buffer));
+  ASSERT_EQ(result.status, SocketStatus::OK);
+  EXPECT_EQ(std::string(buffer, result.bytes_transferred), "bye");
+  EXPECT_EQ(second->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::CLOSED);
+  EXPECT_EQ(second->send_data({'?'}).status, SocketStatus::CLOSED);
+}
+
+TEST(ShmSocketTest, StreamsBetweenThreadsThroughAListener) {
+  const std::string path = "/tmp/chat_shm_socket_test_" + std::to_string(getpid()) + ".sock";
+  ShmListener listener(path, 4096);
+  ASSERT_TRUE(listener.bind_socket(0));
+  ASSERT_TRUE(listener.listen_socket(4));
+
+  constexpr size_t total = 8 * 1024 * 1024;
+  std::thread sender([&path]() {
+    auto socket = ShmSocket::connect(path);
+    ASSERT_TRUE(socket);
+    std::vector<char> chunk(1000);
+    size_t sent = 0;
+    while (sent < total) {
+      const size_t count = std::min(chunk.size(), total - sent);
+      chunk.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        chunk[i] = static_cast<char>((sent + i) % 251);
+      }
+      auto result = socket->send_data(chunk); // Blocking: waits for room
+      ASSERT_EQ(result.status, SocketStatus::OK);
+      sent += result.bytes_transferred;
+    }
+  });
+
+  auto socket = listener.accept_connection();
+  ASSERT_TRUE(socket);
+  size_t received = 0;
+  bool in_order = true;
+  char buffer[1500];
+  while (received < total) {
+    auto result = socket->raw_receive(buffer, sizeof(buffer)); // Blocking: waits for data
+    ASSERT_EQ(result.status, SocketStatus::OK);
+    for (size_t i = 0; i < result.bytes_transferred; ++i) {
+      in_order = in_order && buffer[i] == static_cast<char>((received + i) % 251);
+    }
+    received += result.bytes_transferred;
+  }
+  sender.join();
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(socket->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::CLOSED);
+}
+
+TEST(ShmSocketTest, NoticesAPeerThatExitedWithoutClosing) {
+  const std::string path = "/tmp/chat_shm_socket_exit_test_" + std::to_string(getpid()) + ".sock";
+  ShmListener listener(path);
+  ASSERT_TRUE(listener.bind_socket(0));
+  ASSERT_TRUE(listener.listen_socket(4));
+
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    auto socket = ShmSocket::connect(path);
+    if (socket) {
+      socket->send_data({'h', 'i'});
+    }
+    _exit(socket ? 0 : 1);
+  }
+
+  auto socket = listener.accept_connection();
+  ASSERT_TRUE(socket);
+  int status = 0;
+  waitpid(child, &status, 0);
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  socket->set_non_blocking(true);
+  char buffer[8];
+  auto result = socket->raw_receive(buffer, sizeof(buffer));
+  ASSERT_EQ(result.status, SocketStatus::OK);
+  EXPECT_EQ(std::string(buffer, result.bytes_transferred), "hi");
+  EXPECT_EQ(socket->raw_receive(buffer, sizeof(buffer)).status, SocketStatus::CLOSED);
+}
+
+TEST(ShmSocketTest, ListenerReplacesAStalePathButNotALiveOne) {
+  const std::string path = "/tmp/chat_shm_stale_test_" + std::to_string(getpid()) + ".sock";
+  ShmListener live(path);
+  ASSERT_TRUE(live.bind_socket(0) && live.listen_socket(4));
+  {
+    ShmListener second(path);
+    EXPECT_FALSE(second.bind_socket(0)) << "Another listener owns the path";
+  }
+  EXPECT_EQ(access(path.c_str(), F_OK), 0) << "A listener that failed to bind leaves the path alone";
+
+  live.close_socket();
+
+  // A server that crashed leaves its socket file behind with nobody listening on it.
+  int crashed_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+  ASSERT_EQ(bind(crashed_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  close(crashed_fd);
+
+  ShmListener replacement(path);
+  EXPECT_TRUE(replacement.bind_socket(0)) << "A socket file nobody listens on is replaced";
+}
+
+TEST(ShmSocketTest, FinishesAnAsyncHandshakeOnceTheListenerAccepts) {
+  const std::string path = "/tmp/chat_shm_async_test_" + std::to_string(getpid()) + ".sock";
+  ShmListener listener(path);
+  ASSERT_TRUE(listener.bind_socket(0) && listener.listen_socket(4));
+
+  auto connecting = ShmSocket::connect_async(path);
+  ASSERT_TRUE(connecting);
+  connecting->set_non_blocking(true);
+  int epoll_fd = watch(connecting->get_fd());
+  EXPECT_EQ(connecting->complete_handshake(), SocketStatus::WOULD_BLOCK) << "Nothing was handed over yet";
+  EXPECT_EQ(connecting->send_data({'h', 'i'}).status, SocketStatus::WOULD_BLOCK);
+
+  auto accepted = listener.accept_connection();
+  ASSERT_TRUE(accepted);
+  ASSERT_TRUE(wait_readable(epoll_fd, 1000)) << "The handover wakes the event loop";
+  ASSERT_EQ(connecting->complete_handshake(), SocketStatus::OK);
+  ASSERT_EQ(connecting->send_data({'h', 'i'}).status, SocketStatus::OK);
+
+  accepted->set_non_blocking(true);
+  char buffer[8];
+  auto result = accepted->raw_receive(buffer, sizeof(buffer));
+  ASSERT_EQ(result.status, SocketStatus::OK);
+  EXPECT_EQ(std::string(buffer, result.bytes_transferred), "hi");
+
+  ASSERT_TRUE(accepted->send_data({'!'}).status == SocketStatus::OK);
+  ASSERT_TRUE(wait_readable(epoll_fd, 1000)) << "Data wakes the event loop once connected";
+  result = connecting->raw_receive(buffer, sizeof(buffer));
+  ASSERT_EQ(result.status, SocketStatus::OK);
+  EXPECT_EQ(std::string(buffer, result.bytes_transferred), "!");
+  close(epoll_fd);
+}
+
+TEST(ShmSocketTest, FailsAnAsyncHandshakeTheListenerDropped) {
+  const std::string path = "/tmp/chat_shm_dropped_test_" + std::to_string(getpid()) + ".sock";
+  auto listener = std::make_unique<ShmListener>(path);
+  ASSERT_TRUE(listener->bind_socket(0) && listener->listen_socket(4));
+
+  auto connecting = ShmSocket::connect_async(path);
+  ASSERT_TRUE(connecting);
+  listener.reset(); // Closes the pending connection without handing anything over
+  EXPECT_EQ(connecting->complete_handshake(), SocketStatus::ERROR);
+}
@@ -3,6 +3,9 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <cstring>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace chat_app::common;
 
@@ -148,4 +151,54 @@ TEST_F(SocketTest, DetectsClosedConnection) {
   SocketResult receive_result = accepted_socket->receive_data(receive_buffer);
   EXPECT_EQ(receive_result.status, SocketStatus::CLOSED) << "Expected receive on closed socket to return CLOSED";
   EXPECT_EQ(receive_result.bytes_transferred, 0) << "Expected no bytes to be transferred on closed socket";
-}
\ No newline at end of file
+}
+TEST(UnixSocketTest, SendAndReceiveDataOverAPath) {
+  const std::string path = "/tmp/chat_socket_test_" + std::to_string(getpid()) + ".sock";
+  auto listener = PosixSocket::create_unix_listener(path);
+  ASSERT_TRUE(listener && listener->bind_socket(0) && listener->listen_socket(5));
+
+  auto client = PosixSocket::create_unix_connector(path);
+  ASSERT_TRUE(client && client->is_valid());
+  auto server = listener->accept_connection();
+  ASSERT_TRUE(server && server->is_valid());
+
+  std::vector<char> data = {'p', 'i', 'n', 'g'};
+  auto sent = client->send_data(data);
+  ASSERT_EQ(sent.status, SocketStatus::OK);
+  ASSERT_EQ(sent.bytes_transferred, data.size());
+  std::vector<char> buffer(16);
+  auto received = server->receive_data(buffer);
+  ASSERT_EQ(received.status, SocketStatus::OK);
+  EXPECT_EQ(std::vector<char>(buffer.begin(), buffer.begin() + received.bytes_transferred), data);
+
+  listener->close_socket();
+  EXPECT_NE(access(path.c_str(), F_OK), 0) << "Closing the listener removes its path";
+}
+
+TEST(UnixSocketTest, ReplacesAStalePathButNotALiveOne) {
+  const std::string path = "/tmp/chat_socket_stale_test_" + std::to_string(getpid()) + ".sock";
+  auto live = PosixSocket::create_unix_listener(path);
+  ASSERT_TRUE(live && live->bind_socket(0) && live->listen_socket(5));
+  auto second = PosixSocket::create_unix_listener(path);
+  ASSERT_TRUE(second);
+  EXPECT_FALSE(second->bind_socket(0)) << "Another listener owns the path";
+
+  live->close_socket();
+
+  // A server that crashed leaves its socket file behind with nobody listening on it.
+  int crashed_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+  ASSERT_EQ(bind(crashed_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  close(crashed_fd);
+  ASSERT_EQ(access(path.c_str(), F_OK), 0);
+
+  auto replacement = PosixSocket::create_unix_listener(path);
+  ASSERT_TRUE(replacement);
+  EXPECT_TRUE(replacement->bind_socket(0)) << "A socket file nobody listens on is replaced";
+}
+
+TEST(UnixSocketTest, ConnectFailsWithoutListener) {
+  EXPECT_EQ(PosixSocket::create_unix_connector("/tmp/chat_socket_test_missing.sock"), nullptr);
+}
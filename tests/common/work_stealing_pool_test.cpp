@@ -0,0 +1,118 @@
+#include "common/work_stealing_pool.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chat_app::common;
+
+namespace {
+
+// Waits up to a few seconds for a condition set by other threads.
+template <typename Condition> bool wait_for(Condition condition) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+} // namespace
+
+TEST(WorkStealingPoolTest, RunsEverySubmittedTask) {
+  WorkStealingPool pool(4, 256);
+  pool.start();
+  std::atomic<int> ran{0};
+  int submitted = 0;
+  while (submitted < 10000) {
+    if (pool.submit([&ran]() { ++ran; })) {
+      ++submitted;
+    } else {
+      std::this_thread::yield(); // Every inbox full
+    }
+  }
+  ASSERT_TRUE(wait_for([&]() { return ran.load() == 10000; }));
+  EXPECT_EQ(pool.executed(), 10000u);
+}
+
+TEST(WorkStealingPoolTest, IdleWorkersStealTasksSpawnedByABusyOne) {
+  WorkStealingPool pool(3);
+  pool.start();
+  std::atomic<int> ran{0};
+  pool.submit([&]() {
+    for (int i = 0; i < 200; ++i) {
+      pool.submit([&ran]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        ++ran;
+      });
+    }
+  });
+  ASSERT_TRUE(wait_for([&]() { return ran.load() == 200; }));
+  EXPECT_GT(pool.stolen(), 0u);
+}
+
+TEST(WorkStealingPoolTest, RunsHigherPrioritiesFirst) {
+  WorkStealingPool pool(1);
+  pool.start();
+  std::atomic<bool> gate{false};
+  std::atomic<bool> blocked{false};
+  pool.submit([&]() {
+    blocked = true;
+    while (!gate) {
+      std::this_thread::yield();
+    }
+  });
+  ASSERT_TRUE(wait_for([&]() { return blocked.load(); }));
+
+  std::mutex mutex;
+  std::vector<char> order;
+  auto record = [&](char label) {
+    return [&mutex, &order, label]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(label);
+    };
+  };
+  for (int i = 0; i < 3; ++i) {
+    pool.submit(record('L'), WorkStealingPool::Priority::LOW);
+    pool.submit(record('N'), WorkStealingPool::Priority::NORMAL);
+    pool.submit(record('H'), WorkStealingPool::Priority::HIGH);
+  }
+  gate = true;
+  ASSERT_TRUE(wait_for([&]() { return pool.executed() == 10; }));
+  EXPECT_EQ(std::string(order.begin(), order.end()), "HHHNNNLLL");
+}
+
+TEST(WorkStealingPoolTest, PostsCompletionsToTheOwningThread) {
+  WorkStealingPool pool(2);
+  pool.start();
+  CompletionQueue completions;
+  ASSERT_TRUE(completions.is_valid());
+
+  std::vector<int> results;
+  std::thread::id completed_on;
+  for (int i = 1; i <= 3; ++i) {
+    ASSERT_TRUE(pool.submit(
+        WorkStealingPool::Priority::NORMAL, completions, [i]() { return i * i; },
+        [&](int result) {
+          results.push_back(result);
+          completed_on = std::this_thread::get_id();
+        }));
+  }
+
+  while (results.size() < 3) {
+    pollfd reactor{completions.get_fd(), POLLIN, 0};
+    ASSERT_EQ(poll(&reactor, 1, 5000), 1) << "The reactor is woken by the completion fd";
+    completions.run();
+  }
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(results, (std::vector<int>{1, 4, 9}));
+  EXPECT_EQ(completed_on, std::this_thread::get_id());
+}
@@ -0,0 +1,102 @@
+#include "server/auth_pool.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <poll.h>
+#include <thread>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+namespace {
+
+AuthRequest make_request(int fd, const std::string &client_key, const std::string &password,
+                         std::optional<PasswordHash> stored_hash = std::nullopt) {
+  AuthRequest request;
+  request.fd = fd;
+  request.session_id = static_cast<uint32_t>(fd);
+  request.client_key = client_key;
+  request.username = "user" + std::to_string(fd);
+  request.password = password;
+  request.stored_hash = stored_hash;
+  return request;
+}
+
+// Collects results until `count` have arrived or a timeout expires.
+std::vector<AuthResult> wait_for_results(AuthPool &pool, size_t count) {
+  std::vector<AuthResult> results;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (results.size() < count && std::chrono::steady_clock::now() < deadline) {
+    pollfd pfd{pool.get_event_fd(), POLLIN, 0};
+    poll(&pfd, 1, 100);
+    for (auto &result : pool.take_results()) {
+      results.push_back(std::move(result));
+    }
+  }
+  return results;
+}
+
+} // namespace
+
+TEST(AuthPoolTest, HashesNewPasswordsAndVerifiesStoredOnes) {
+  AuthPool pool(2, 16, 16, 1000);
+  ASSERT_TRUE(pool.start());
+
+  auto stored = PasswordHash::create("secret", 1000);
+  ASSERT_TRUE(stored.has_value());
+
+  ASSERT_TRUE(pool.submit(make_request(1, "10.0.0.1", "fresh")));
+  ASSERT_TRUE(pool.submit(make_request(2, "10.0.0.1", "secret", stored)));
+  ASSERT_TRUE(pool.submit(make_request(3, "10.0.0.1", "wrong", stored)));
+
+  auto results = wait_for_results(pool, 3);
+  ASSERT_EQ(results.size(), 3u);
+  for (const auto &result : results) {
+    EXPECT_EQ(result.session_id, static_cast<uint32_t>(result.fd));
+    if (result.fd == 1) {
+      EXPECT_TRUE(result.accepted);
+      ASSERT_TRUE(result.new_hash.has_value());
+      EXPECT_TRUE(result.new_hash->verify("fresh"));
+    } else {
+      EXPECT_EQ(result.accepted, result.fd == 2);
+      EXPECT_FALSE(result.new_hash.has_value());
+    }
+  }
+}
+
+TEST(AuthPoolTest, BoundsQueuePerClientAndInTotal) {
+  // A single slow worker keeps requests queued while we submit.
+  AuthPool pool(1, 4, 2, 100000);
+  ASSERT_TRUE(pool.start());
+
+  ASSERT_TRUE(pool.submit(make_request(1, "10.0.0.1", "a")));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20)); // let the worker pick it up
+
+  EXPECT_TRUE(pool.submit(make_request(2, "10.0.0.1", "a")));
+  EXPECT_TRUE(pool.submit(make_request(3, "10.0.0.1", "a")));
+  EXPECT_FALSE(pool.submit(make_request(4, "10.0.0.1", "a"))) << "Per-client limit should apply";
+  EXPECT_TRUE(pool.submit(make_request(5, "10.0.0.2", "a")));
+  EXPECT_TRUE(pool.submit(make_request(6, "10.0.0.3", "a")));
+  EXPECT_FALSE(pool.submit(make_request(7, "10.0.0.4", "a"))) << "Total limit should apply";
+  EXPECT_EQ(pool.queued(), 4u);
+}
+
+TEST(AuthPoolTest, ServesClientsRoundRobin) {
+  AuthPool pool(1, 64, 64, 20000);
+  ASSERT_TRUE(pool.start());
+
+  // Occupy the worker, then queue a burst from one address followed by a single request from another.
+  ASSERT_TRUE(pool.submit(make_request(100, "10.0.0.9", "a")));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  for (int fd = 1; fd <= 8; ++fd) {
+    ASSERT_TRUE(pool.submit(make_request(fd, "10.0.0.1", "a")));
+  }
+  ASSERT_TRUE(pool.submit(make_request(50, "10.0.0.2", "a")));
+
+  auto results = wait_for_results(pool, 10);
+  ASSERT_EQ(results.size(), 10u);
+  size_t position = 0;
+  while (position < results.size() && results[position].fd != 50) {
+    ++position;
+  }
+  EXPECT_LE(position, 3u) << "The lone client should not wait behind the whole burst";
+}
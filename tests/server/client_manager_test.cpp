@@ -12,6 +12,7 @@ class MockStreamSocket : public IStreamSocket {
 public:
   virtual ~MockStreamSocket() = default;
   MOCK_METHOD(SocketResult, send_data, (const std::vector<char> &), (override));
+  MOCK_METHOD(SocketResult, raw_send, (const char *, size_t), (override));
   MOCK_METHOD(SocketResult, receive_data, (std::vector<char> &), (override));
   MOCK_METHOD(SocketResult, raw_receive, (char *, size_t), (override));
   MOCK_METHOD(void, close_socket, (), (override));
@@ -52,6 +53,24 @@ TEST_F(ClientManagerTest, RemoveClient) {
       << "Client session ID still exists after removal";
 }
 
+TEST_F(ClientManagerTest, KeepsRemovedClientsUntilTheyAreReclaimed) {
+  auto mock_socket = std::make_unique<MockStreamSocket>();
+  EXPECT_CALL(*mock_socket, get_fd()).WillRepeatedly(Return(12));
+  ClientSession *session = client_manager_->add_client(std::move(mock_socket));
+  session->set_username("alice");
+  client_manager_->add_username("alice");
+
+  client_manager_->remove_client(12);
+  EXPECT_TRUE(session->is_closed()) << "The session is still readable by the handler that removed it";
+  EXPECT_EQ(session->get_username(), "alice");
+  EXPECT_EQ(client_manager_->get_client_by_fd(12), nullptr);
+  EXPECT_FALSE(client_manager_->is_username_taken("alice"));
+  EXPECT_EQ(client_manager_->retired_count(), 1u);
+
+  EXPECT_EQ(client_manager_->reclaim_retired(), 1u);
+  EXPECT_EQ(client_manager_->retired_count(), 0u);
+}
+
 TEST_F(ClientManagerTest, GetClientById) {
   auto mock_socket = std::make_unique<MockStreamSocket>();
   EXPECT_CALL(*mock_socket, get_fd()).WillRepeatedly(Return(15));
@@ -62,6 +81,24 @@ TEST_F(ClientManagerTest, GetClientById) {
   EXPECT_EQ(client_manager_->get_client_by_id(session->get_id()), session) << "Failed to retrieve client by ID";
 }
 
+TEST_F(ClientManagerTest, AssignId) {
+  auto mock_socket1 = std::make_unique<MockStreamSocket>();
+  EXPECT_CALL(*mock_socket1, get_fd()).WillRepeatedly(Return(11));
+  auto mock_socket2 = std::make_unique<MockStreamSocket>();
+  EXPECT_CALL(*mock_socket2, get_fd()).WillRepeatedly(Return(12));
+
+  ClientSession *session1 = client_manager_->add_client(std::move(mock_socket1));
+  ClientSession *session2 = client_manager_->add_client(std::move(mock_socket2));
+  const uint32_t provisional_id = session1->get_id();
+  EXPECT_GE(provisional_id, FIRST_PROVISIONAL_CLIENT_ID) << "New sessions should get a provisional ID";
+
+  EXPECT_TRUE(client_manager_->assign_id(*session1, 7));
+  EXPECT_EQ(session1->get_id(), 7) << "Session was not re-keyed";
+  EXPECT_EQ(client_manager_->get_client_by_id(7), session1) << "Failed to retrieve client by assigned ID";
+  EXPECT_EQ(client_manager_->get_client_by_id(provisional_id), nullptr) << "Provisional ID was not released";
+  EXPECT_FALSE(client_manager_->assign_id(*session2, 7)) << "An ID must not be shared by two sessions";
+}
+
 TEST_F(ClientManagerTest, GetAllClients) {
   auto mock_socket1 = std::make_unique<MockStreamSocket>();
   EXPECT_CALL(*mock_socket1, get_fd()).WillRepeatedly(Return(20));
@@ -109,4 +146,40 @@ TEST_F(ClientManagerTest, BroadcastMessage) {
 
   Message msg(MessageType::S2C_BROADCAST, session1->get_id(), BROADCAST_ID, "hi");
   client_manager_->broadcast_message(msg, session1->get_id());
-}
\ No newline at end of file
+}
+TEST_F(ClientManagerTest, BroadcastFansOutToLargeAudiencesInOrder) {
+  constexpr int CLIENTS = 3 * BROADCAST_FAN_OUT_CHUNK;
+  FanOutPool pool(2);
+  pool.start();
+  client_manager_->set_fan_out(&pool, CLIENTS);
+
+  std::vector<std::vector<std::string>> received(CLIENTS);
+  uint32_t sender_id = 0;
+  for (int i = 0; i < CLIENTS; ++i) {
+    auto mock_socket = std::make_unique<MockStreamSocket>();
+    EXPECT_CALL(*mock_socket, get_fd()).WillRepeatedly(Return(100 + i));
+    EXPECT_CALL(*mock_socket, send_data(_)).WillRepeatedly([&received, i](const std::vector<char> &data) {
+      auto [message, consumed] = deserialize_message(data);
+      received[i].push_back(message ? message->payload : "");
+      return SocketResult{SocketStatus::OK, data.size()};
+    });
+    ClientSession *session = client_manager_->add_client(std::move(mock_socket));
+    session->set_authenticated(true);
+    sender_id = session->get_id();
+  }
+
+  client_manager_->broadcast_message(Message(MessageType::S2C_BROADCAST, sender_id, BROADCAST_ID, "first"), sender_id);
+  client_manager_->broadcast_message(Message(MessageType::S2C_BROADCAST, sender_id, BROADCAST_ID, "second"), sender_id);
+  EXPECT_EQ(pool.jobs(), 2u) << "Both broadcasts are split between the helpers";
+
+  size_t excluded = 0;
+  for (const auto &messages : received) {
+    if (messages.empty()) {
+      ++excluded;
+      continue;
+    }
+    EXPECT_EQ(messages, (std::vector<std::string>{"first", "second"}));
+  }
+  EXPECT_EQ(excluded, 1u) << "Only the sender is left out";
+  client_manager_.reset(); // Before the mocks' captures go out of scope
+}
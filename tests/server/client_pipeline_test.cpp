@@ -0,0 +1,258 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/client_pipeline.h"
+#include "server/server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+namespace {
+
+// Routes whatever the decode stage has produced within the timeout.
+size_t route_for(ClientPipeline &pipeline, std::vector<Message> &messages, std::vector<int> &closed,
+                 std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+  size_t routed = 0;
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (std::chrono::steady_clock::now() < deadline) {
+    pollfd wakeup{pipeline.get_event_fd(), POLLIN, 0};
+    poll(&wakeup, 1, 10);
+    routed += pipeline.route([&](int, const Message &message) { messages.push_back(message); },
+                             [&](int fd) { closed.push_back(fd); });
+    if (routed > 0) {
+      return routed;
+    }
+  }
+  return routed;
+}
+
+// Reads and deserializes messages from the peer's end until count have arrived.
+std::vector<Message> read_messages(int fd, size_t count) {
+  std::vector<Message> messages;
+  std::vector<char> buffer;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (messages.size() < count && std::chrono::steady_clock::now() < deadline) {
+    char chunk[1024];
+    ssize_t received = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received > 0) {
+      buffer.insert(buffer.end(), chunk, chunk + received);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    while (true) {
+      auto [message, consumed] = deserialize_message(buffer);
+      if (!message) {
+        break;
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + consumed);
+      messages.push_back(*message);
+    }
+  }
+  return messages;
+}
+
+} // namespace
+
+class ClientPipelineTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+    fcntl(fds_[0], F_SETFL, fcntl(fds_[0], F_GETFL) | O_NONBLOCK);
+    ASSERT_TRUE(pipeline_.start());
+    socket_ = pipeline_.attach(std::make_unique<PosixSocket>(fds_[0]));
+  }
+
+  void TearDown() override {
+    if (fds_[1] >= 0) {
+      close(fds_[1]);
+    }
+  }
+
+  void send_from_peer(const std::vector<Message> &messages) {
+    std::vector<char> bytes;
+    for (const auto &message : messages) {
+      auto frame = serialize_message(message);
+      bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+    ASSERT_EQ(write(fds_[1], bytes.data(), bytes.size()), static_cast<ssize_t>(bytes.size()));
+  }
+
+  ClientPipeline pipeline_{2, 2};
+  int fds_[2] = {-1, -1};
+  std::unique_ptr<IStreamSocket> socket_;
+};
+
+TEST_F(ClientPipelineTest, DecodesMessagesInOrderAndWritesReplies) {
+  send_from_peer({Message(MessageType::C2S_JOIN, 0, 0, "alice"), Message(MessageType::C2S_BROADCAST, 0, 0, "one"),
+                  Message(MessageType::C2S_BROADCAST, 0, 0, "two")});
+  pipeline_.read(fds_[0]);
+  pipeline_.flush();
+
+  std::vector<Message> messages;
+  std::vector<int> closed;
+  while (messages.size() < 3 && route_for(pipeline_, messages, closed) > 0) {
+  }
+  ASSERT_EQ(messages.size(), 3u);
+  EXPECT_EQ(messages[0].payload, "alice");
+  EXPECT_EQ(messages[1].payload, "one");
+  EXPECT_EQ(messages[2].payload, "two");
+  EXPECT_TRUE(closed.empty());
+
+  // A serialized frame written to the session's socket and a message left to the encode stage.
+  socket_->send_data(serialize_message(Message(MessageType::S2C_JOIN_SUCCESS, SERVER_ID, 1, "welcome")));
+  EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_BROADCAST, 2, BROADCAST_ID, "hi")));
+  pipeline_.flush();
+
+  auto replies = read_messages(fds_[1], 2);
+  ASSERT_EQ(replies.size(), 2u);
+  EXPECT_EQ(replies[0].payload, "welcome");
+  EXPECT_EQ(replies[1].payload, "hi");
+}
+
+TEST_F(ClientPipelineTest, WritesControlRepliesAheadOfQueuedChat) {
+  for (int i = 0; i < 100; ++i) {
+    socket_->send_data(serialize_message(Message(MessageType::S2C_BROADCAST, 2, BROADCAST_ID, std::to_string(i))));
+  }
+  EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_ERROR, SERVER_ID, 1, "error")));
+  EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_USER_JOINED, SERVER_ID, 1, "carol")));
+  pipeline_.flush();
+
+  auto replies = read_messages(fds_[1], 102);
+  ASSERT_EQ(replies.size(), 102u);
+  EXPECT_EQ(replies[0].payload, "error");
+  EXPECT_EQ(replies[1].payload, "carol");
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(replies[i + 2].payload, std::to_string(i)) << "Chat keeps its order";
+  }
+}
+
+TEST_F(ClientPipelineTest, KeepsWhatTheSocketDoesNotTakeForLater) {
+  int size = 4096;
+  setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  const size_t count = 200;
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_BROADCAST, 2, BROADCAST_ID,
+                                                std::to_string(i) + std::string(4096, 'x'))));
+  }
+  pipeline_.flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // The encode thread fills the socket
+
+  auto replies = read_messages(fds_[1], count);
+  ASSERT_EQ(replies.size(), count);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(replies[i].payload, std::to_string(i) + std::string(4096, 'x'));
+  }
+}
+
+TEST_F(ClientPipelineTest, WritesControlRepliesAheadOfChatTheSocketDidNotTake) {
+  int size = 4096;
+  setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  const size_t count = 200;
+  const std::string filler(4096, 'x');
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_BROADCAST, 2, BROADCAST_ID, filler)));
+  }
+  pipeline_.flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // The chat fills the socket
+  EXPECT_TRUE(pipeline_.send(fds_[0], Message(MessageType::S2C_USER_JOINED, SERVER_ID, 1, "carol")));
+  pipeline_.flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto replies = read_messages(fds_[1], count + 1);
+  ASSERT_EQ(replies.size(), count + 1);
+  size_t position = 0;
+  while (position < replies.size() && replies[position].header.type != MessageType::S2C_USER_JOINED) {
+    ++position;
+  }
+  ASSERT_LT(position, replies.size());
+  EXPECT_LE(position * (HEADER_SIZE + filler.size()), PIPELINE_WRITE_CHUNK + 2 * (HEADER_SIZE + filler.size()))
+      << "Only the chat in flight goes ahead";
+}
+
+TEST_F(ClientPipelineTest, ReportsConnectionsThePeerClosed) {
+  send_from_peer({Message(MessageType::C2S_BROADCAST, 0, 0, "last words")});
+  close(fds_[1]);
+  fds_[1] = -1;
+  pipeline_.read(fds_[0]);
+  pipeline_.flush();
+
+  std::vector<Message> messages;
+  std::vector<int> closed;
+  while (closed.empty() && route_for(pipeline_, messages, closed) > 0) {
+  }
+  ASSERT_EQ(messages.size(), 1u) << "Messages sent before the close are still routed";
+  EXPECT_EQ(messages[0].payload, "last words");
+  EXPECT_EQ(closed, std::vector<int>{fds_[0]});
+}
+
+TEST_F(ClientPipelineTest, DropsMessagesOfDetachedConnections) {
+  send_from_peer({Message(MessageType::C2S_BROADCAST, 0, 0, "too late")});
+  pipeline_.read(fds_[0]);
+  pipeline_.flush();
+
+  pollfd wakeup{pipeline_.get_event_fd(), POLLIN, 0};
+  ASSERT_EQ(poll(&wakeup, 1, 2000), 1);
+  pipeline_.detach(fds_[0]);
+
+  std::vector<Message> messages;
+  std::vector<int> closed;
+  EXPECT_EQ(route_for(pipeline_, messages, closed), 1u);
+  EXPECT_TRUE(messages.empty());
+  EXPECT_TRUE(closed.empty());
+  EXPECT_FALSE(pipeline_.send(fds_[0], Message(MessageType::S2C_ERROR, SERVER_ID, 1, "gone")));
+}
+
+TEST(PipelineServerTest, ServesClientsThroughTheStages) {
+  ServerConfig config;
+  config.pipeline = true;
+  config.decode_threads = 2;
+  config.encode_threads = 2;
+  config.housekeeping_interval_ms = 50;
+  Server server(9956, config);
+  std::thread server_thread([&server]() { server.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  auto join = [](const std::string &username) {
+    auto socket = PosixSocket::create_connector("127.0.0.1", 9956);
+    EXPECT_TRUE(socket);
+    socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    return socket;
+  };
+  auto alice = join("alice");
+  auto alice_welcome = read_messages(alice->get_fd(), 1);
+  ASSERT_EQ(alice_welcome.size(), 1u);
+  EXPECT_EQ(alice_welcome[0].header.type, MessageType::S2C_JOIN_SUCCESS);
+  const uint32_t alice_id = alice_welcome[0].header.receiver_id;
+
+  auto bob = join("bob");
+  auto bob_welcome = read_messages(bob->get_fd(), 1);
+  ASSERT_EQ(bob_welcome.size(), 1u);
+  const uint32_t bob_id = bob_welcome[0].header.receiver_id;
+  auto joined = read_messages(alice->get_fd(), 1);
+  ASSERT_EQ(joined.size(), 1u);
+  EXPECT_EQ(joined[0].header.type, MessageType::S2C_USER_JOINED);
+
+  auto impostor = join("bob");
+  auto rejected = read_messages(impostor->get_fd(), 1);
+  ASSERT_EQ(rejected.size(), 1u);
+  EXPECT_EQ(rejected[0].header.type, MessageType::S2C_JOIN_FAILURE) << "Replies queued before a disconnect are written";
+
+  alice->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, alice_id, BROADCAST_ID, "hello")));
+  alice->send_data(serialize_message(Message(MessageType::C2S_PRIVATE, alice_id, bob_id, "psst")));
+  auto received = read_messages(bob->get_fd(), 2);
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].payload, "hello");
+  EXPECT_EQ(received[1].payload, "psst");
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100)); // A housekeeping tick
+  server.stop();
+  server_thread.join();
+  EXPECT_NE(server.get_metrics().render().find("pipeline_decode_queue_depth"), std::string::npos);
+}
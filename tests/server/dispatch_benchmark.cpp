@@ -0,0 +1,77 @@
+// Measures what calling a client's socket through the IStreamSocket interface costs per message
+// against the direct calls ClientSession makes to a PosixSocket. Not run by ctest:
+//   ./dispatch_benchmark [messages]
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/client_session.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::common;
+using namespace chat_app::server;
+
+namespace {
+
+// Drains the peer end of a socket pair so that the sender never blocks.
+class Drain {
+public:
+  explicit Drain(int fd) : fd_(fd), thread_([this]() {
+    char buffer[65536];
+    while (read(fd_, buffer, sizeof(buffer)) > 0) {
+    }
+  }) {}
+  ~Drain() {
+    shutdown(fd_, SHUT_RDWR);
+    thread_.join();
+    close(fd_);
+  }
+
+private:
+  int fd_;
+  std::thread thread_;
+};
+
+template <typename Send> double nanoseconds_per_message(uint64_t messages, Send &&send) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < messages; ++i) {
+    send();
+  }
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / messages;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const uint64_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  const auto frame = serialize_message(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "hello, everyone"));
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    std::perror("socketpair");
+    return 1;
+  }
+  Drain drain(fds[1]);
+  ClientSession session(1, std::make_unique<PosixSocket>(fds[0]));
+  IStreamSocket *interface_socket = session.get_socket();
+
+  std::printf("%zu-byte frames, %llu messages\n", frame.size(), static_cast<unsigned long long>(messages));
+  std::printf("%-34s %10s\n", "", "ns/message");
+  // Interleaved twice, so that warm-up and drift do not favour either.
+  for (int round = 0; round < 2; ++round) {
+    std::printf("%-34s %10.1f\n", "virtual IStreamSocket::send_data",
+                nanoseconds_per_message(messages, [&]() { interface_socket->send_data(frame); }));
+    std::printf("%-34s %10.1f\n", "direct ClientSession::send",
+                nanoseconds_per_message(messages, [&]() { session.send(frame); }));
+  }
+  std::printf("%-34s %10.1f\n", "serialize_message (no write)", nanoseconds_per_message(messages, [&]() {
+                auto serialized = serialize_message(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "hello"));
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+              }));
+  return 0;
+}
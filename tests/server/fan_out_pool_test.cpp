@@ -0,0 +1,56 @@
+#include "server/fan_out_pool.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace chat_app::server;
+
+TEST(FanOutPoolTest, RunsEveryIndexExactlyOnce) {
+  constexpr size_t COUNT = 10000;
+  FanOutPool pool(3);
+  pool.start();
+
+  for (int round = 0; round < 3; ++round) {
+    std::unique_ptr<std::atomic<int>[]> hits(new std::atomic<int>[COUNT]());
+    pool.run(COUNT, 64, [&hits](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        ++hits[i];
+      }
+    });
+    for (size_t i = 0; i < COUNT; ++i) {
+      ASSERT_EQ(hits[i].load(), 1) << "Index " << i << " in round " << round;
+    }
+  }
+  EXPECT_EQ(pool.jobs(), 3u);
+}
+
+TEST(FanOutPoolTest, SharesTheWorkWithTheHelpers) {
+  FanOutPool pool(2);
+  pool.start();
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  pool.run(64, 1, [&](size_t, size_t) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Long enough for the helpers to wake
+  });
+  EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(FanOutPoolTest, RunsSmallRangesOnTheCallingThread) {
+  FanOutPool pool(2);
+  pool.start();
+  std::thread::id runner;
+  pool.run(10, 64, [&runner](size_t begin, size_t end) {
+    EXPECT_EQ(begin, 0u);
+    EXPECT_EQ(end, 10u);
+    runner = std::this_thread::get_id();
+  });
+  EXPECT_EQ(runner, std::this_thread::get_id());
+  EXPECT_EQ(pool.jobs(), 0u);
+}
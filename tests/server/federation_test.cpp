@@ -0,0 +1,320 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/server.h"
+#include "test_server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+/**
+ * @brief Runs a two-node cluster, each node in its own thread, with both nodes dialing each other.
+ */
+class FederationTest : public ::testing::Test {
+protected:
+  using Node = TestServer;
+
+  void SetUp() override {
+    start_node(node_a_, node_a_port_, 1, cluster_a_port_, cluster_b_port_);
+    start_node(node_b_, node_b_port_, 2, cluster_b_port_, cluster_a_port_);
+    ASSERT_TRUE(node_a_.running() && node_b_.running()) << "A node failed to start";
+    ASSERT_TRUE(wait_for([this]() {
+      return node_a_->get_metrics().get_gauge("cluster_peers") == 1 &&
+             node_b_->get_metrics().get_gauge("cluster_peers") == 1;
+    }));
+  }
+
+  void TearDown() override {
+    stop_node(node_a_);
+    stop_node(node_b_);
+  }
+
+  void start_node(Node &node, int port, uint32_t node_id, int cluster_port, int peer_port) {
+    start_node(node, port, node_id, cluster_port, std::vector<int>{peer_port}, 0);
+  }
+
+  void start_node(Node &node, int port, uint32_t node_id, int cluster_port, const std::vector<int> &peer_ports,
+                  size_t relay_fanout) {
+    ServerConfig config;
+    config.node_id = node_id;
+    config.cluster_port = cluster_port;
+    for (int peer_port : peer_ports) {
+      config.peers.push_back("127.0.0.1:" + std::to_string(peer_port));
+    }
+    config.relay_fanout = relay_fanout;
+    start_node(node, port, config);
+  }
+
+  // Starts a node and waits until it has had time to bind its ports; check running() afterwards.
+  static void start_node(Node &node, int port, ServerConfig config) {
+    config.housekeeping_interval_ms = 50;
+    node.start(port, config);
+  }
+
+  static void stop_node(Node &node) { node.stop(); }
+
+  struct Client {
+    std::unique_ptr<IStreamSocket> socket;
+    std::vector<char> buffer;
+    uint32_t id{0};
+  };
+
+  // Connects and joins, returning a client whose id is set on success.
+  Client join(int port, const std::string &username) {
+    Client client;
+    client.socket = PosixSocket::create_connector("127.0.0.1", port);
+    if (!client.socket) {
+      return client;
+    }
+    client.socket->set_non_blocking(true);
+    client.socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    auto response = read_until(client, MessageType::S2C_JOIN_SUCCESS);
+    if (response) {
+      client.id = response->header.receiver_id;
+    }
+    return client;
+  }
+
+  // Reads messages until one of the given type arrives, with a timeout.
+  std::optional<Message> read_until(Client &client, MessageType type) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (std::chrono::steady_clock::now() < deadline) {
+      auto [message, consumed] = deserialize_message(client.buffer);
+      if (message) {
+        client.buffer.erase(client.buffer.begin(), client.buffer.begin() + consumed);
+        if (message->header.type == type) {
+          return message;
+        }
+        continue;
+      }
+
+      std::vector<char> chunk(1024);
+      auto result = client.socket->receive_data(chunk);
+      if (result.status == SocketStatus::OK) {
+        client.buffer.insert(client.buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+      } else if (result.status == SocketStatus::WOULD_BLOCK) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      } else {
+        return std::nullopt;
+      }
+    }
+    return std::nullopt;
+  }
+
+  bool wait_for(const std::function<bool()> &condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+  }
+
+  const int node_a_port_ = 9921;
+  const int node_b_port_ = 9922;
+  const int cluster_a_port_ = 9923;
+  const int cluster_b_port_ = 9924;
+  Node node_a_;
+  Node node_b_;
+};
+
+TEST_F(FederationTest, BroadcastsReachClientsOnOtherNodes) {
+  Client alice = join(node_a_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  EXPECT_EQ(alice.id >> NODE_ID_SHIFT, 1u) << "User IDs carry the registering node's ID";
+
+  Client bob = join(node_b_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  EXPECT_EQ(bob.id >> NODE_ID_SHIFT, 2u);
+
+  auto joined = read_until(alice, MessageType::S2C_USER_JOINED);
+  ASSERT_TRUE(joined.has_value());
+  EXPECT_EQ(joined->header.sender_id, bob.id);
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "hello from b")));
+  auto broadcast = read_until(alice, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(broadcast.has_value());
+  EXPECT_EQ(broadcast->header.sender_id, bob.id);
+  EXPECT_EQ(std::string(broadcast->payload.begin(), broadcast->payload.end()), "hello from b");
+}
+
+TEST_F(FederationTest, UserListAndNamesCoverTheCluster) {
+  Client alice = join(node_a_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  ASSERT_TRUE(wait_for([this]() { return node_b_->get_metrics().get_gauge("cluster_remote_users") == 1; }));
+
+  Client impostor = join(node_b_port_, "alice");
+  EXPECT_EQ(impostor.id, 0u) << "A name online on another node must be rejected";
+
+  Client bob = join(node_b_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_USER_JOINED_LIST, 0, 0, "")));
+  auto list = read_until(bob, MessageType::S2C_USER_JOINED_LIST);
+  ASSERT_TRUE(list.has_value());
+  const std::string users(list->payload.begin(), list->payload.end());
+  EXPECT_NE(users.find("alice:" + std::to_string(alice.id)), std::string::npos) << users;
+  EXPECT_EQ(users.find("bob:"), std::string::npos) << "The list leaves out the requesting user";
+}
+
+TEST_F(FederationTest, RefusesPasswordsInClusterMode) {
+  Client client;
+  client.socket = PosixSocket::create_connector("127.0.0.1", node_a_port_);
+  ASSERT_TRUE(client.socket);
+  client.socket->set_non_blocking(true);
+  client.socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice\nsecret")));
+  auto response = read_until(client, MessageType::S2C_JOIN_FAILURE);
+  ASSERT_TRUE(response.has_value());
+  EXPECT_EQ(response->payload, "Passwords are not supported in cluster mode");
+
+  Client alice = join(node_b_port_, "alice");
+  EXPECT_NE(alice.id, 0u) << "The name itself stays free";
+}
+
+TEST_F(FederationTest, UsersOfALostNodeLeave) {
+  Client alice = join(node_a_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(node_b_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  ASSERT_TRUE(read_until(alice, MessageType::S2C_USER_JOINED).has_value());
+
+  stop_node(node_b_);
+
+  auto left = read_until(alice, MessageType::S2C_USER_LEFT);
+  ASSERT_TRUE(left.has_value());
+  EXPECT_EQ(left->header.sender_id, bob.id);
+  EXPECT_TRUE(wait_for([this]() { return node_a_->get_metrics().get_gauge("cluster_peers") == 0; }));
+}
+
+TEST_F(FederationTest, PrivateMessagesAreRoutedToTheRecipientsNodeInOrder) {
+  Client alice = join(node_a_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(node_b_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  ASSERT_TRUE(read_until(alice, MessageType::S2C_USER_JOINED).has_value());
+
+  for (int i = 0; i < 5; ++i) {
+    alice.socket->send_data(
+        serialize_message(Message(MessageType::C2S_PRIVATE, 0, bob.id, "secret " + std::to_string(i))));
+  }
+  for (int i = 0; i < 5; ++i) {
+    auto message = read_until(bob, MessageType::S2C_PRIVATE);
+    ASSERT_TRUE(message.has_value());
+    EXPECT_EQ(message->header.sender_id, alice.id);
+    EXPECT_EQ(std::string(message->payload.begin(), message->payload.end()), "secret " + std::to_string(i));
+  }
+
+  const uint32_t offline_id = (2u << NODE_ID_SHIFT) + 1000;
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_PRIVATE, 0, offline_id, "anyone?")));
+  auto error = read_until(alice, MessageType::S2C_ERROR);
+  ASSERT_TRUE(error.has_value()) << "An offline recipient is reported to the sender";
+}
+
+/**
+ * @brief Runs a two-node cluster linked over shared memory, the second node dialing the first.
+ */
+class ShmFederationTest : public FederationTest {
+protected:
+  void SetUp() override {
+    const std::string path = "/tmp/chat_federation_shm_test_" + std::to_string(getpid()) + ".sock";
+    ServerConfig config_a;
+    config_a.node_id = 1;
+    config_a.cluster_shm_path = path;
+    start_node(node_a_, node_a_port_, config_a);
+    ServerConfig config_b;
+    config_b.node_id = 2;
+    config_b.peers.push_back("shm:" + path);
+    start_node(node_b_, node_b_port_, config_b);
+    ASSERT_TRUE(node_a_.running() && node_b_.running()) << "A node failed to start";
+    ASSERT_TRUE(wait_for([this]() {
+      return node_a_->get_metrics().get_gauge("cluster_peers") == 1 &&
+             node_b_->get_metrics().get_gauge("cluster_peers") == 1;
+    }));
+  }
+};
+
+TEST_F(ShmFederationTest, BroadcastsReachClientsOnOtherNodes) {
+  Client alice = join(node_a_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(node_b_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  ASSERT_TRUE(read_until(alice, MessageType::S2C_USER_JOINED).has_value());
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "hello from b")));
+  auto broadcast = read_until(alice, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(broadcast.has_value());
+  EXPECT_EQ(broadcast->header.sender_id, bob.id);
+  EXPECT_EQ(std::string(broadcast->payload.begin(), broadcast->payload.end()), "hello from b");
+}
+
+/**
+ * @brief Runs a four-node cluster relaying broadcasts with a fan-out of one, so each broadcast
+ * travels a chain through every node.
+ */
+class RelayTreeTest : public FederationTest {
+protected:
+  static constexpr size_t NODES = 4;
+
+  void SetUp() override {
+    for (size_t i = 0; i < NODES; ++i) {
+      std::vector<int> peer_ports;
+      for (size_t j = 0; j < NODES; ++j) {
+        if (j != i) {
+          peer_ports.push_back(cluster_port(j));
+        }
+      }
+      start_node(nodes_[i], client_port(i), static_cast<uint32_t>(i + 1), cluster_port(i), peer_ports, 1);
+      ASSERT_TRUE(nodes_[i].running()) << "Node " << i + 1 << " failed to start";
+    }
+    ASSERT_TRUE(wait_for([this]() {
+      for (const Node &node : nodes_) {
+        if (node->get_metrics().get_gauge("cluster_peers") != static_cast<int64_t>(NODES - 1)) {
+          return false;
+        }
+      }
+      return true;
+    }));
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < NODES; ++i) {
+      stop_node(nodes_[i]);
+    }
+  }
+
+  static int client_port(size_t index) { return 9941 + static_cast<int>(index); }
+  static int cluster_port(size_t index) { return 9945 + static_cast<int>(index); }
+
+  Node nodes_[NODES];
+};
+
+TEST_F(RelayTreeTest, BroadcastsAreRelayedInOrderDownTheTree) {
+  Client clients[NODES];
+  for (size_t i = 0; i < NODES; ++i) {
+    clients[i] = join(client_port(i), "user" + std::to_string(i));
+    ASSERT_NE(clients[i].id, 0u);
+  }
+
+  for (int i = 0; i < 20; ++i) {
+    clients[0].socket->send_data(
+        serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "wave " + std::to_string(i))));
+  }
+  for (size_t node = 1; node < NODES; ++node) {
+    for (int i = 0; i < 20; ++i) {
+      auto broadcast = read_until(clients[node], MessageType::S2C_BROADCAST);
+      ASSERT_TRUE(broadcast.has_value()) << "node " << node + 1 << ", broadcast " << i;
+      EXPECT_EQ(broadcast->header.sender_id, clients[0].id);
+      EXPECT_EQ(std::string(broadcast->payload.begin(), broadcast->payload.end()), "wave " + std::to_string(i));
+    }
+  }
+
+  // The origin sends one copy; every node but the last in the chain passes it on.
+  EXPECT_EQ(nodes_[0]->get_metrics().get_counter("relay_copies_sent"), 20u);
+  EXPECT_EQ(nodes_[1]->get_metrics().get_counter("relay_copies_sent"), 20u);
+  EXPECT_EQ(nodes_[2]->get_metrics().get_counter("relay_copies_sent"), 20u);
+  EXPECT_EQ(nodes_[3]->get_metrics().get_counter("relay_copies_sent"), 0u);
+}
@@ -0,0 +1,177 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/server.h"
+#include "test_server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <thread>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+/**
+ * @brief Runs a routing server and a gateway relaying to it over two links, each in its own thread.
+ */
+class GatewayTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ServerConfig core_config;
+    core_config.gateway_port = gateway_link_port_;
+    core_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(core_.start(core_port_, core_config)) << "The routing server failed to start";
+
+    ServerConfig gateway_config;
+    gateway_config.upstreams = {"127.0.0.1:" + std::to_string(gateway_link_port_),
+                                "127.0.0.1:" + std::to_string(gateway_link_port_)};
+    gateway_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(gateway_.start(gateway_port_, gateway_config)) << "The gateway failed to start";
+  }
+
+  void TearDown() override {
+    gateway_.stop();
+    core_.stop();
+  }
+
+  struct Client {
+    std::unique_ptr<IStreamSocket> socket;
+    std::vector<char> buffer;
+    uint32_t id{0};
+  };
+
+  // Connects and joins, returning a client whose id is set on success.
+  Client join(int port, const std::string &username) {
+    Client client;
+    client.socket = PosixSocket::create_connector("127.0.0.1", port);
+    if (!client.socket) {
+      return client;
+    }
+    client.socket->set_non_blocking(true);
+    client.socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    auto response = read_until(client, MessageType::S2C_JOIN_SUCCESS);
+    if (response) {
+      client.id = response->header.receiver_id;
+    }
+    return client;
+  }
+
+  // Reads messages until one of the given type arrives, with a timeout.
+  std::optional<Message> read_until(Client &client, MessageType type,
+                                    std::chrono::milliseconds timeout = std::chrono::seconds(3)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+      auto [message, consumed] = deserialize_message(client.buffer);
+      if (message) {
+        client.buffer.erase(client.buffer.begin(), client.buffer.begin() + consumed);
+        if (message->header.type == type) {
+          return message;
+        }
+        continue;
+      }
+
+      std::vector<char> chunk(1024);
+      auto result = client.socket->receive_data(chunk);
+      if (result.status == SocketStatus::OK) {
+        client.buffer.insert(client.buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+      } else if (result.status == SocketStatus::WOULD_BLOCK) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      } else {
+        return std::nullopt;
+      }
+    }
+    return std::nullopt;
+  }
+
+  const int core_port_ = 9931;
+  const int gateway_link_port_ = 9932;
+  const int gateway_port_ = 9933;
+  TestServer core_;
+  TestServer gateway_;
+};
+
+TEST_F(GatewayTest, RelaysSessionsAndFansOutAtTheGateway) {
+  EXPECT_EQ(core_->get_metrics().get_gauge("gateways"), 2) << "One gateway, two links";
+
+  Client alice = join(gateway_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client carol = join(gateway_port_, "carol");
+  ASSERT_NE(carol.id, 0u);
+  Client bob = join(core_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+  EXPECT_EQ(join(gateway_port_, "bob").id, 0u) << "Names are checked by the routing server";
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "hello all")));
+  for (Client *client : {&alice, &carol}) {
+    auto message = read_until(*client, MessageType::S2C_BROADCAST);
+    ASSERT_TRUE(message.has_value());
+    EXPECT_EQ(message->header.sender_id, bob.id);
+  }
+
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "from alice")));
+  auto message = read_until(carol, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(message.has_value());
+  EXPECT_EQ(std::string(message->payload.begin(), message->payload.end()), "from alice");
+  ASSERT_TRUE(read_until(bob, MessageType::S2C_BROADCAST).has_value());
+  EXPECT_FALSE(read_until(alice, MessageType::S2C_BROADCAST, std::chrono::milliseconds(200)).has_value())
+      << "The sender does not get its own broadcast back";
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_PRIVATE, 0, alice.id, "psst")));
+  message = read_until(alice, MessageType::S2C_PRIVATE);
+  ASSERT_TRUE(message.has_value());
+  EXPECT_EQ(message->header.sender_id, bob.id);
+
+  carol.socket.reset();
+  message = read_until(bob, MessageType::S2C_USER_LEFT);
+  ASSERT_TRUE(message.has_value());
+  EXPECT_EQ(message->header.sender_id, carol.id);
+}
+
+TEST_F(GatewayTest, SessionsEndWithTheirRoutingServer) {
+  Client alice = join(gateway_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+
+  core_.stop();
+  EXPECT_TRUE(read_until(alice, MessageType::S2C_SERVER_SHUTDOWN).has_value());
+}
+
+/**
+ * @brief Runs a routing server and a gateway relaying to it over the shared memory transport.
+ */
+class ShmGatewayTest : public GatewayTest {
+protected:
+  void SetUp() override {
+    const std::string path = "/tmp/chat_gateway_test_" + std::to_string(getpid()) + ".sock";
+    ServerConfig core_config;
+    core_config.gateway_shm_path = path;
+    core_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(core_.start(core_port_, core_config)) << "The routing server failed to start";
+
+    ServerConfig gateway_config;
+    gateway_config.upstreams = {"shm:" + path};
+    gateway_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(gateway_.start(gateway_port_, gateway_config)) << "The gateway failed to start";
+  }
+};
+
+TEST_F(ShmGatewayTest, RelaysSessionsOverSharedMemory) {
+  EXPECT_EQ(core_->get_metrics().get_gauge("gateways"), 1);
+
+  Client alice = join(gateway_port_, "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(core_port_, "bob");
+  ASSERT_NE(bob.id, 0u);
+
+  for (int i = 0; i < 100; ++i) {
+    bob.socket->send_data(
+        serialize_message(Message(MessageType::C2S_PRIVATE, 0, alice.id, "message " + std::to_string(i))));
+  }
+  for (int i = 0; i < 100; ++i) {
+    auto message = read_until(alice, MessageType::S2C_PRIVATE);
+    ASSERT_TRUE(message.has_value());
+    EXPECT_EQ(std::string(message->payload.begin(), message->payload.end()), "message " + std::to_string(i));
+  }
+
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "from alice")));
+  auto message = read_until(bob, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(message.has_value());
+  EXPECT_EQ(message->header.sender_id, alice.id);
+}
@@ -0,0 +1,66 @@
+#include "server/hash_ring.h"
+#include "gtest/gtest.h"
+#include <map>
+
+using namespace chat_app::server;
+
+TEST(HashRingTest, EmptyRingOwnsNothing) {
+  HashRing ring;
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(ring.node_for(42u), 0u);
+  EXPECT_EQ(ring.node_for(std::string("alice")), 0u);
+}
+
+TEST(HashRingTest, SpreadsKeysOverNodes) {
+  HashRing ring;
+  for (uint32_t node = 1; node <= 4; ++node) {
+    ring.add_node(node);
+  }
+  ring.add_node(2); // Adding twice is a no-op
+  EXPECT_EQ(ring.node_count(), 4u);
+
+  std::map<uint32_t, int> keys_per_node;
+  for (uint32_t user = 1; user <= 10000; ++user) {
+    ++keys_per_node[ring.node_for(user)];
+  }
+  ASSERT_EQ(keys_per_node.size(), 4u);
+  for (const auto &[node, keys] : keys_per_node) {
+    EXPECT_GT(keys, 1500) << "Node " << node << " owns too few keys";
+    EXPECT_LT(keys, 3500) << "Node " << node << " owns too many keys";
+  }
+  EXPECT_EQ(ring.node_for(std::string("alice")), ring.node_for(std::string("alice")));
+}
+
+TEST(HashRingTest, MembershipChangesMoveOnlyAffectedKeys) {
+  HashRing ring;
+  for (uint32_t node = 1; node <= 3; ++node) {
+    ring.add_node(node);
+  }
+  std::map<uint32_t, uint32_t> before;
+  for (uint32_t user = 1; user <= 10000; ++user) {
+    before[user] = ring.node_for(user);
+  }
+
+  ring.add_node(4);
+  int moved = 0;
+  for (const auto &[user, node] : before) {
+    const uint32_t now = ring.node_for(user);
+    if (now != node) {
+      EXPECT_EQ(now, 4u) << "A key may only move to the new node";
+      ++moved;
+    }
+  }
+  EXPECT_GT(moved, 1000);
+  EXPECT_LT(moved, 4000);
+
+  ring.remove_node(4);
+  ring.remove_node(2);
+  EXPECT_FALSE(ring.contains(2));
+  for (const auto &[user, node] : before) {
+    if (node != 2) {
+      EXPECT_EQ(ring.node_for(user), node) << "Keys of the remaining nodes must stay put";
+    } else {
+      EXPECT_NE(ring.node_for(user), 2u);
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#include "server/history_export.h"
+#include "server/message_log.h"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <stdlib.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+class HistoryExportTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/history_export_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    directory_ = dir_template;
+    output_path_ = directory_ + "/export.col";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  void append(MessageLog &log, uint64_t timestamp_ms, const Message &message) {
+    LogRecord record;
+    record.sequence = log.last_sequence() + 1;
+    record.timestamp_ms = timestamp_ms;
+    record.message = message;
+    ASSERT_TRUE(log.append_record(record));
+  }
+
+  std::string directory_;
+  std::string output_path_;
+};
+
+TEST_F(HistoryExportTest, ExportsChatEventsAsColumns) {
+  {
+    MessageLog log(directory_, 512);
+    ASSERT_TRUE(log.open());
+    append(log, 1000, Message(MessageType::S2C_USER_JOINED, 1, BROADCAST_ID, "alice"));
+    append(log, 1005, Message(MessageType::S2S_USER_CREDENTIAL, SERVER_ID, 1, "alice\nhash"));
+    append(log, 1010, Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "hello"));
+    append(log, 1008, Message(MessageType::S2C_PRIVATE, 2, 1, "psst"));
+    append(log, 1020, Message(MessageType::S2C_PRIVATE, 1, 2, "hi"));
+  }
+
+  auto stats = export_history(directory_, output_path_);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->rows, 4) << "Internal records must not be exported";
+  EXPECT_EQ(stats->last_sequence, 5);
+
+  auto history = read_history_export(output_path_);
+  ASSERT_TRUE(history.has_value());
+  EXPECT_EQ(history->sequences, (std::vector<uint64_t>{1, 3, 4, 5}));
+  EXPECT_EQ(history->timestamps_ms, (std::vector<uint64_t>{1000, 1010, 1008, 1020}));
+  EXPECT_EQ(history->sender_ids, (std::vector<uint32_t>{1, 1, 2, 1}));
+  EXPECT_EQ(history->lengths, (std::vector<uint32_t>{5, 5, 4, 2}));
+  EXPECT_EQ(history->types[1], MessageType::S2C_BROADCAST);
+
+  ASSERT_EQ(history->scopes.size(), 4u);
+  EXPECT_EQ(history->scope_dictionary[history->scopes[0]], "presence");
+  EXPECT_EQ(history->scope_dictionary[history->scopes[1]], "broadcast");
+  EXPECT_EQ(history->scope_dictionary[history->scopes[2]], "dm:1-2");
+  EXPECT_EQ(history->scopes[2], history->scopes[3]) << "Both directions of a conversation share a scope";
+  EXPECT_EQ(history->scope_dictionary.size(), 3u);
+}
+
+TEST_F(HistoryExportTest, FiltersBySequenceAndTime) {
+  {
+    MessageLog log(directory_, 4096);
+    ASSERT_TRUE(log.open());
+    for (uint64_t i = 1; i <= 100; ++i) {
+      append(log, 1000 * i, Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "message"));
+    }
+  }
+
+  ExportOptions options;
+  options.after_sequence = 40;
+  options.from_ms = 20000;
+  options.to_ms = 60000;
+  auto stats = export_history(directory_, output_path_, options);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->rows, 19); // Sequences 41..59
+
+  auto history = read_history_export(output_path_);
+  ASSERT_TRUE(history.has_value());
+  ASSERT_EQ(history->sequences.size(), 19u);
+  EXPECT_EQ(history->sequences.front(), 41);
+  EXPECT_EQ(history->sequences.back(), 59);
+}
+
+TEST_F(HistoryExportTest, SpansRowGroupsAndIgnoresTornTail) {
+  const size_t rows = EXPORT_ROW_GROUP_ROWS + 10;
+  {
+    MessageLog log(directory_);
+    ASSERT_TRUE(log.open());
+    for (size_t i = 1; i <= rows; ++i) {
+      append(log, 1000 + i, Message(MessageType::S2C_BROADCAST, static_cast<uint32_t>(i % 7), BROADCAST_ID, "x"));
+    }
+  }
+
+  // Simulate the live server in the middle of an append.
+  const auto segments = MessageLog::list_segments(directory_);
+  ASSERT_EQ(segments.size(), 1u);
+  std::filesystem::resize_file(segments[0], std::filesystem::file_size(segments[0]) - 3);
+
+  auto stats = export_history(directory_, output_path_);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->rows, rows - 1);
+
+  auto history = read_history_export(output_path_);
+  ASSERT_TRUE(history.has_value());
+  ASSERT_EQ(history->sequences.size(), rows - 1);
+  EXPECT_EQ(history->sequences[EXPORT_ROW_GROUP_ROWS], EXPORT_ROW_GROUP_ROWS + 1);
+  EXPECT_EQ(history->sender_ids[EXPORT_ROW_GROUP_ROWS], (EXPORT_ROW_GROUP_ROWS + 1) % 7);
+}
+
+TEST_F(HistoryExportTest, RejectsMissingInput) {
+  EXPECT_FALSE(export_history(directory_, output_path_).has_value());
+  EXPECT_FALSE(read_history_export(directory_ + "/missing.col").has_value());
+}
@@ -0,0 +1,129 @@
+#include "server/message_log.h"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <csignal>
+#include <fstream>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+class MessageLogTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/message_log_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    directory_ = dir_template;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  std::string directory_;
+};
+
+TEST_F(MessageLogTest, EncodeAndDecodeRecord) {
+  LogRecord record;
+  record.sequence = 42;
+  record.timestamp_ms = 1234567890123ULL;
+  record.message = Message(MessageType::S2C_BROADCAST, 7, BROADCAST_ID, "hello");
+
+  auto bytes = encode_log_record(record);
+  ASSERT_EQ(bytes.size(), LOG_RECORD_HEADER_SIZE + HEADER_SIZE + 5);
+
+  LogRecord decoded;
+  ASSERT_EQ(decode_log_record(bytes.data(), bytes.size(), decoded), bytes.size());
+  EXPECT_EQ(decoded.sequence, 42);
+  EXPECT_EQ(decoded.timestamp_ms, 1234567890123ULL);
+  EXPECT_EQ(decoded.message.header.type, MessageType::S2C_BROADCAST);
+  EXPECT_EQ(decoded.message.header.sender_id, 7);
+  EXPECT_EQ(decoded.message.payload, "hello");
+
+  // A flipped byte must be detected.
+  bytes.back() ^= 0x01;
+  EXPECT_EQ(decode_log_record(bytes.data(), bytes.size(), decoded), 0);
+}
+
+TEST_F(MessageLogTest, AppendAndReplayAcrossSegments) {
+  {
+    MessageLog log(directory_, 256);
+    ASSERT_TRUE(log.open());
+    for (int i = 0; i < 20; ++i) {
+      EXPECT_EQ(log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "message " + std::to_string(i))),
+                i + 1);
+    }
+  }
+
+  EXPECT_GT(MessageLog::list_segments(directory_).size(), 1);
+
+  MessageLog log(directory_, 256);
+  ASSERT_TRUE(log.open());
+  EXPECT_EQ(log.last_sequence(), 20);
+
+  std::vector<uint64_t> sequences;
+  size_t visited = log.replay(15, [&](const LogRecord &record) { sequences.push_back(record.sequence); });
+  EXPECT_EQ(visited, 5);
+  EXPECT_EQ(sequences, (std::vector<uint64_t>{16, 17, 18, 19, 20}));
+}
+
+TEST_F(MessageLogTest, TruncatesTornTailOnOpen) {
+  {
+    MessageLog log(directory_);
+    ASSERT_TRUE(log.open());
+    log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "first"));
+    log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "second"));
+  }
+
+  auto segments = MessageLog::list_segments(directory_);
+  ASSERT_EQ(segments.size(), 1);
+  {
+    std::ofstream out(segments.front(), std::ios::binary | std::ios::app);
+    out.write("\x00\x00\x00\x40garbage", 11);
+  }
+
+  MessageLog log(directory_);
+  ASSERT_TRUE(log.open());
+  EXPECT_EQ(log.last_sequence(), 2);
+  EXPECT_EQ(log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "third")), 3);
+  EXPECT_EQ(log.replay(0, [](const LogRecord &) {}), 3);
+}
+
+TEST_F(MessageLogTest, AppendRecordRejectsGaps) {
+  MessageLog log(directory_);
+  ASSERT_TRUE(log.open());
+
+  LogRecord record;
+  record.message = Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "x");
+  record.sequence = 1;
+  EXPECT_TRUE(log.append_record(record));
+  EXPECT_TRUE(log.append_record(record)) << "Re-delivered records should be ignored";
+  record.sequence = 3;
+  EXPECT_FALSE(log.append_record(record));
+  EXPECT_EQ(log.last_sequence(), 1);
+}
+
+TEST_F(MessageLogTest, CutsOffARecordThatFailedPartway) {
+  MessageLog log(directory_);
+  ASSERT_TRUE(log.open());
+  ASSERT_EQ(log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "first")), 1);
+  const auto segment = MessageLog::list_segments(directory_).front();
+  const auto size = std::filesystem::file_size(segment);
+
+  // A file size limit lets the next record be written only partly.
+  rlimit original{};
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &original), 0);
+  rlimit limited = original;
+  limited.rlim_cur = size + 10;
+  auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limited), 0);
+  const uint64_t failed = log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, std::string(100, 'x')));
+  setrlimit(RLIMIT_FSIZE, &original);
+  std::signal(SIGXFSZ, previous_handler);
+  EXPECT_EQ(failed, 0u);
+  EXPECT_EQ(std::filesystem::file_size(segment), size);
+
+  EXPECT_EQ(log.append(Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, "second")), 2);
+  std::vector<std::string> payloads;
+  log.replay(0, [&](const LogRecord &record) { payloads.push_back(record.message.payload); });
+  EXPECT_EQ(payloads, (std::vector<std::string>{"first", "second"}));
+}
@@ -0,0 +1,54 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/peer_connection.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+TEST(PeerConnectionTest, WritesEverythingThroughPartialWrites) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  int size = 4096;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  PeerConnection connection(std::make_unique<PosixSocket>(fds[0]));
+
+  // Far more than the socket takes at once, so most of it is written by later flushes.
+  std::vector<Message> sent;
+  for (int i = 0; i < 64; ++i) {
+    const std::string payload(8192, static_cast<char>('a' + i % 26));
+    sent.emplace_back(MessageType::S2S_PEER_BATCH, SERVER_ID, SERVER_ID, payload);
+    connection.queue_message(sent.back());
+  }
+  ASSERT_TRUE(connection.flush());
+  EXPECT_TRUE(connection.has_pending_writes());
+
+  std::vector<char> received;
+  std::vector<Message> messages;
+  while (messages.size() < sent.size()) {
+    char chunk[16384];
+    ssize_t count = recv(fds[1], chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (count > 0) {
+      received.insert(received.end(), chunk, chunk + count);
+    } else {
+      ASSERT_TRUE(connection.has_pending_writes()) << "Nothing left to write, but messages are missing";
+    }
+    ASSERT_TRUE(connection.flush());
+    while (true) {
+      auto [message, consumed] = deserialize_message(received);
+      if (!message) {
+        break;
+      }
+      received.erase(received.begin(), received.begin() + consumed);
+      messages.push_back(*message);
+    }
+  }
+  EXPECT_FALSE(connection.has_pending_writes());
+  for (size_t i = 0; i < sent.size(); ++i) {
+    EXPECT_EQ(messages[i].payload, sent[i].payload);
+  }
+  close(fds[1]);
+}
@@ -0,0 +1,320 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/prefork.h"
+#include "server/server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+TEST(SharedDirectoryTest, ClaimsEachUsernameOnce) {
+  auto shared = PreforkShared::create(2, 16);
+  ASSERT_NE(shared, nullptr);
+  auto &directory = shared->directory();
+
+  EXPECT_TRUE(directory.claim(1, "alice", 0, 7));
+  EXPECT_FALSE(directory.claim(2, "alice", 1, 9)) << "The name is taken on another worker";
+  EXPECT_TRUE(directory.claim(3, "bob", 1, 9));
+  EXPECT_FALSE(directory.claim(4, std::string(PREFORK_MAX_USERNAME + 1, 'x'), 0, 8));
+
+  auto alice = directory.find(1);
+  ASSERT_TRUE(alice.has_value());
+  EXPECT_EQ(alice->worker, 0u);
+  EXPECT_EQ(alice->slot, 7);
+  EXPECT_TRUE(directory.is_username_taken("bob"));
+  EXPECT_EQ(directory.entries().size(), 2u);
+
+  directory.release(1);
+  EXPECT_FALSE(directory.find(1).has_value());
+  EXPECT_FALSE(directory.is_username_taken("alice"));
+  EXPECT_TRUE(directory.claim(5, "alice", 1, 10));
+}
+
+TEST(SharedDirectoryTest, ReusesSlotsOfReleasedSessions) {
+  auto shared = PreforkShared::create(1, 8);
+  ASSERT_NE(shared, nullptr);
+  auto &directory = shared->directory();
+
+  // Far more joins and leaves than the table has slots: tombstones must not fill it up.
+  for (uint32_t id = 1; id <= 1000; ++id) {
+    ASSERT_TRUE(directory.claim(id, "user" + std::to_string(id), 0, static_cast<int32_t>(id)));
+    directory.release(id);
+  }
+  for (uint32_t id = 1; id <= 8; ++id) {
+    ASSERT_TRUE(directory.claim(id, "user" + std::to_string(id), 0, static_cast<int32_t>(id)));
+  }
+  EXPECT_FALSE(directory.claim(9, "user9", 0, 9)) << "The directory is full";
+  EXPECT_EQ(directory.entries().size(), 8u);
+}
+
+TEST(SharedDirectoryTest, PurgesTheSessionsOfAWorker) {
+  auto shared = PreforkShared::create(2, 16);
+  ASSERT_NE(shared, nullptr);
+  auto &directory = shared->directory();
+  directory.claim(1, "alice", 0, 7);
+  directory.claim(2, "bob", 1, 7);
+  directory.claim(3, "carol", 1, 8);
+
+  auto purged = directory.purge_worker(1);
+  EXPECT_EQ(purged.size(), 2u);
+  EXPECT_FALSE(directory.is_username_taken("bob"));
+  EXPECT_FALSE(directory.find(3).has_value());
+  EXPECT_TRUE(directory.find(1).has_value());
+}
+
+TEST(SharedMailboxesTest, DeliversPostedEventsInOrder) {
+  auto shared = PreforkShared::create(2, 16);
+  ASSERT_NE(shared, nullptr);
+  auto &mailboxes = shared->mailboxes();
+
+  // Enough traffic to wrap the ring several times.
+  const std::string payload(64 * 1024, 'p');
+  for (int round = 0; round < 200; ++round) {
+    ASSERT_TRUE(mailboxes.post(1, Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, payload), -1));
+    ASSERT_TRUE(mailboxes.post(1, Message(MessageType::S2C_PRIVATE, 1, 2, std::to_string(round)), 5));
+
+    std::vector<std::pair<Message, int32_t>> received;
+    mailboxes.drain(1, [&received](const Message &message, int32_t slot) { received.emplace_back(message, slot); });
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0].first.payload.size(), payload.size());
+    EXPECT_EQ(received[0].second, -1);
+    EXPECT_EQ(received[1].first.payload, std::to_string(round));
+    EXPECT_EQ(received[1].second, 5);
+  }
+}
+
+TEST(SharedMailboxesTest, DropsEventsWhenFullAndWakesOnlyWhenEmpty) {
+  auto shared = PreforkShared::create(2, 16);
+  ASSERT_NE(shared, nullptr);
+  auto &mailboxes = shared->mailboxes();
+  const std::string payload(1024 * 1024, 'p');
+
+  size_t posted = 0;
+  while (mailboxes.post(0, Message(MessageType::S2C_BROADCAST, 1, BROADCAST_ID, payload), -1)) {
+    ++posted;
+  }
+  EXPECT_EQ(posted, PREFORK_MAILBOX_BYTES / (1024 * 1024) - 1);
+
+  uint64_t wakeups = 0;
+  ASSERT_EQ(read(mailboxes.event_fd(0), &wakeups, sizeof(wakeups)), static_cast<ssize_t>(sizeof(wakeups)));
+  EXPECT_EQ(wakeups, 1u) << "Only the post to the empty mailbox signals";
+
+  size_t received = 0;
+  mailboxes.drain(0, [&received](const Message &, int32_t) { ++received; });
+  EXPECT_EQ(received, posted);
+}
+
+TEST(SharedMutexTest, RecoversFromAnOwnerThatDied) {
+  void *memory = mmap(nullptr, sizeof(SharedMutex), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(memory, MAP_FAILED);
+  auto *mutex = new (memory) SharedMutex();
+  mutex->init();
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    mutex->lock();
+    _exit(0); // Dies holding the lock
+  }
+  ASSERT_GT(pid, 0);
+  waitpid(pid, nullptr, 0);
+
+  EXPECT_FALSE(mutex->lock()) << "The next owner learns the previous one died";
+  mutex->unlock();
+  EXPECT_TRUE(mutex->lock());
+  mutex->unlock();
+  munmap(memory, sizeof(SharedMutex));
+}
+
+TEST(PreforkTest, SteersConnectionsToTheListenerOfTheirCpu) {
+  std::vector<std::unique_ptr<IListeningSocket>> listeners;
+  for (int i = 0; i < 2; ++i) {
+    listeners.push_back(PosixSocket::create_listener(true));
+    ASSERT_TRUE(listeners.back()->bind_socket(9953));
+    ASSERT_TRUE(listeners.back()->listen_socket(16));
+    listeners.back()->set_non_blocking(true);
+  }
+  ASSERT_TRUE(attach_cpu_steering(listeners[0]->get_fd(), 2));
+
+  // Loopback connections arrive on the connecting CPU.
+  cpu_set_t original;
+  sched_getaffinity(0, sizeof(original), &original);
+  cpu_set_t cpu0;
+  CPU_ZERO(&cpu0);
+  CPU_SET(0, &cpu0);
+  ASSERT_EQ(sched_setaffinity(0, sizeof(cpu0), &cpu0), 0);
+  std::vector<std::unique_ptr<IStreamSocket>> clients;
+  for (int i = 0; i < 8; ++i) {
+    clients.push_back(PosixSocket::create_connector("127.0.0.1", 9953));
+    ASSERT_NE(clients.back(), nullptr);
+  }
+  sched_setaffinity(0, sizeof(original), &original);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  size_t accepted[2] = {0, 0};
+  for (int i = 0; i < 2; ++i) {
+    while (listeners[i]->accept_connection()) {
+      ++accepted[i];
+    }
+  }
+  EXPECT_EQ(accepted[0], 8u) << "All connections arrived on CPU 0";
+  EXPECT_EQ(accepted[1], 0u);
+}
+
+TEST(PreforkTest, RejectsSettingsThatNeedASingleOwner) {
+  ServerConfig config;
+  config.data_dir = "/tmp/prefork_data";
+  EXPECT_EQ(run_prefork(9951, config, 2), 1);
+  EXPECT_EQ(run_prefork(9951, ServerConfig(), 0), 1);
+  EXPECT_EQ(run_prefork(9951, ServerConfig(), MAX_NODE_ID + 1), 1);
+
+  ServerConfig steered;
+  steered.cpu_steering = true;
+  EXPECT_EQ(run_prefork(9951, steered, sysconf(_SC_NPROCESSORS_ONLN) + 1), 1);
+}
+
+/**
+ * @brief Runs two prefork workers, each in its own thread and on its own port so that tests decide
+ * which worker a client lands on. Threads share the memory a forked worker would map.
+ */
+class PreforkWorkersTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    shared_ = PreforkShared::create(2, 64);
+    ASSERT_NE(shared_, nullptr);
+    for (uint32_t worker = 0; worker < 2; ++worker) {
+      threads_[worker] = std::thread([this, worker]() {
+        ServerConfig config;
+        config.housekeeping_interval_ms = 50;
+        Server server(ports_[worker], config);
+        server.set_prefork(shared_.get(), worker);
+        servers_[worker] = &server;
+        server.run();
+        servers_[worker] = nullptr;
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  void TearDown() override {
+    for (uint32_t worker = 0; worker < 2; ++worker) {
+      if (servers_[worker]) {
+        servers_[worker]->stop();
+      }
+      if (threads_[worker].joinable()) {
+        threads_[worker].join();
+      }
+    }
+  }
+
+  struct Client {
+    std::unique_ptr<IStreamSocket> socket;
+    std::vector<char> buffer;
+    uint32_t id{0};
+  };
+
+  // Connects and joins, returning a client whose id is set on success.
+  Client join(int port, const std::string &username) {
+    Client client;
+    client.socket = PosixSocket::create_connector("127.0.0.1", port);
+    if (!client.socket) {
+      return client;
+    }
+    client.socket->set_non_blocking(true);
+    client.socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    auto response = read_until(client, MessageType::S2C_JOIN_SUCCESS);
+    if (response) {
+      client.id = response->header.receiver_id;
+    }
+    return client;
+  }
+
+  // Reads messages until one of the given type arrives, with a timeout.
+  std::optional<Message> read_until(Client &client, MessageType type,
+                                    std::chrono::milliseconds timeout = std::chrono::seconds(3)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+      auto [message, consumed] = deserialize_message(client.buffer);
+      if (message) {
+        client.buffer.erase(client.buffer.begin(), client.buffer.begin() + consumed);
+        if (message->header.type == type) {
+          return message;
+        }
+        continue;
+      }
+
+      std::vector<char> chunk(1024);
+      auto result = client.socket->receive_data(chunk);
+      if (result.status == SocketStatus::OK) {
+        client.buffer.insert(client.buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+      } else if (result.status == SocketStatus::WOULD_BLOCK) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      } else {
+        return std::nullopt;
+      }
+    }
+    return std::nullopt;
+  }
+
+  const int ports_[2] = {9951, 9952};
+  std::unique_ptr<PreforkShared> shared_;
+  std::thread threads_[2];
+  Server *servers_[2] = {nullptr, nullptr};
+};
+
+TEST_F(PreforkWorkersTest, SharesSessionsAndMessagesAcrossWorkers) {
+  Client alice = join(ports_[0], "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(ports_[1], "bob");
+  ASSERT_NE(bob.id, 0u);
+  EXPECT_NE(alice.id >> NODE_ID_SHIFT, bob.id >> NODE_ID_SHIFT) << "Workers hand out disjoint user IDs";
+
+  auto joined = read_until(alice, MessageType::S2C_USER_JOINED);
+  ASSERT_TRUE(joined.has_value());
+  EXPECT_EQ(joined->payload, "bob");
+
+  Client impostor = join(ports_[0], "bob");
+  EXPECT_EQ(impostor.id, 0u) << "The name is taken on the other worker";
+
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, alice.id, BROADCAST_ID, "hi all")));
+  auto broadcast = read_until(bob, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(broadcast.has_value());
+  EXPECT_EQ(broadcast->payload, "hi all");
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_PRIVATE, bob.id, alice.id, "psst")));
+  auto private_message = read_until(alice, MessageType::S2C_PRIVATE);
+  ASSERT_TRUE(private_message.has_value());
+  EXPECT_EQ(private_message->header.sender_id, bob.id);
+  EXPECT_EQ(private_message->payload, "psst");
+
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_USER_JOINED_LIST, alice.id, SERVER_ID, "")));
+  auto user_list = read_until(alice, MessageType::S2C_USER_JOINED_LIST);
+  ASSERT_TRUE(user_list.has_value());
+  EXPECT_EQ(user_list->payload, "bob:" + std::to_string(bob.id));
+
+  bob.socket->close_socket();
+  auto left = read_until(alice, MessageType::S2C_USER_LEFT);
+  ASSERT_TRUE(left.has_value());
+  EXPECT_EQ(left->header.sender_id, bob.id);
+  EXPECT_FALSE(shared_->directory().is_username_taken("bob"));
+}
+
+TEST_F(PreforkWorkersTest, ReportsTheConnectionBalance) {
+  Client alice = join(ports_[0], "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client carol = join(ports_[0], "carol");
+  ASSERT_NE(carol.id, 0u);
+  Client bob = join(ports_[1], "bob");
+  ASSERT_NE(bob.id, 0u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(150)); // A housekeeping tick
+
+  const auto &metrics = servers_[1]->get_metrics();
+  EXPECT_EQ(metrics.get_gauge("worker_0_connections"), 2);
+  EXPECT_EQ(metrics.get_gauge("worker_1_connections"), 1);
+  EXPECT_EQ(metrics.get_gauge("worker_connection_skew_percent"), 50);
+}
@@ -0,0 +1,116 @@
+#include "server/presence_table.h"
+#include "gtest/gtest.h"
+#include <memory>
+#include <random>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+namespace {
+
+// One push-pull exchange from `from` to `to`, as the federation does over a peer link.
+size_t exchange(PresenceTable &from, PresenceTable &to) {
+  bool to_is_behind = false;
+  size_t messages = 1;
+  for (const auto &delta : to.answer_digest(from.make_digest(false), to_is_behind)) {
+    from.apply_delta(delta);
+    ++messages;
+  }
+  if (to_is_behind) {
+    bool unused = false;
+    for (const auto &delta : from.answer_digest(to.make_digest(true), unused)) {
+      to.apply_delta(delta);
+      ++messages;
+    }
+  }
+  return messages;
+}
+
+} // namespace
+
+TEST(PresenceTableTest, DeltasCarryChangesAndEvents) {
+  PresenceTable a(1, 1000);
+  PresenceTable b(2, 2000);
+  a.local_join(10, "alice");
+  exchange(b, a);
+  EXPECT_EQ(b.users_of(1).at(10), "alice");
+  EXPECT_EQ(b.version_of(1), 1001u);
+
+  a.local_join(11, "bob");
+  a.local_leave(10);
+  bool a_is_behind = false;
+  auto deltas = a.answer_digest(b.make_digest(false), a_is_behind);
+  EXPECT_FALSE(a_is_behind);
+  ASSERT_EQ(deltas.size(), 1u);
+  EXPECT_EQ(deltas[0].payload[0], 'D') << "Logged changes travel as a delta, not a full copy";
+
+  auto events = b.apply_delta(deltas[0]);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].header.type, MessageType::S2C_USER_JOINED);
+  EXPECT_EQ(events[0].header.sender_id, 11u);
+  EXPECT_EQ(events[1].header.type, MessageType::S2C_USER_LEFT);
+  EXPECT_EQ(events[1].header.sender_id, 10u);
+  EXPECT_EQ(b.users_of(1).size(), 1u);
+
+  EXPECT_TRUE(b.apply_delta(deltas[0]).empty()) << "A delta is applied only once";
+}
+
+TEST(PresenceTableTest, FarBehindPeersGetAFullCopy) {
+  PresenceTable a(1, 0);
+  PresenceTable b(2, 0);
+  a.local_join(1, "first");
+  exchange(b, a);
+  for (uint32_t user = 2; user < PRESENCE_LOG_LENGTH + 10; ++user) {
+    a.local_join(user, "user" + std::to_string(user));
+    a.local_leave(user - 1);
+  }
+
+  bool unused = false;
+  auto deltas = a.answer_digest(b.make_digest(false), unused);
+  ASSERT_EQ(deltas.size(), 1u);
+  EXPECT_EQ(deltas[0].payload[0], 'F');
+  auto events = b.apply_delta(deltas[0]);
+  ASSERT_EQ(events.size(), 2u); // "first" left, the last user joined
+  EXPECT_EQ(b.users_of(1).size(), 1u);
+  EXPECT_EQ(b.version_of(1), a.version_of(1));
+}
+
+TEST(PresenceTableTest, GossipConvergesWithBoundedFanOut) {
+  constexpr uint32_t nodes = 32;
+  constexpr size_t fan_out = 3;
+  std::vector<std::unique_ptr<PresenceTable>> tables;
+  for (uint32_t node = 1; node <= nodes; ++node) {
+    tables.push_back(std::make_unique<PresenceTable>(node, 0));
+    tables.back()->local_join(node << 24, "user" + std::to_string(node));
+  }
+
+  auto converged = [&]() {
+    for (const auto &table : tables) {
+      for (uint32_t node = 1; node <= nodes; ++node) {
+        if (table->users_of(node).size() != 1) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  std::mt19937 random(42);
+  int rounds = 0;
+  size_t messages = 0;
+  while (!converged() && rounds < 20) {
+    for (auto &table : tables) {
+      for (size_t i = 0; i < fan_out; ++i) {
+        auto &peer = tables[random() % nodes];
+        if (peer != table) {
+          messages += exchange(*table, *peer);
+        }
+      }
+    }
+    ++rounds;
+  }
+
+  EXPECT_TRUE(converged());
+  EXPECT_LE(rounds, 8) << "Push-pull gossip spreads in O(log n) rounds";
+  EXPECT_LT(messages, size_t(nodes) * nodes * 4);
+}
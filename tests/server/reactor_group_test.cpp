@@ -0,0 +1,167 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/reactor_group.h"
+#include "server/server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+/**
+ * @brief Runs a group of two reactors, each on its own port so that tests decide which reactor a
+ * client lands on.
+ */
+class ReactorGroupServersTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ServerConfig config;
+    config.housekeeping_interval_ms = 50;
+    for (uint32_t reactor = 0; reactor < 2; ++reactor) {
+      servers_[reactor] = std::make_unique<Server>(ports_[reactor], config);
+      servers_[reactor]->set_reactor_group(&group_, reactor);
+      threads_[reactor] = std::thread([this, reactor]() { servers_[reactor]->run(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  void TearDown() override {
+    for (uint32_t reactor = 0; reactor < 2; ++reactor) {
+      servers_[reactor]->stop();
+      threads_[reactor].join();
+    }
+  }
+
+  struct Client {
+    std::unique_ptr<IStreamSocket> socket;
+    std::vector<char> buffer;
+    uint32_t id{0};
+  };
+
+  // Connects and joins, returning a client whose id is set on success.
+  Client join(int port, const std::string &username) {
+    Client client;
+    client.socket = PosixSocket::create_connector("127.0.0.1", port);
+    if (!client.socket) {
+      return client;
+    }
+    client.socket->set_non_blocking(true);
+    client.socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    auto response = read_until(client, MessageType::S2C_JOIN_SUCCESS);
+    if (response) {
+      client.id = response->header.receiver_id;
+    }
+    return client;
+  }
+
+  // Reads messages until one of the given type arrives, with a timeout.
+  std::optional<Message> read_until(Client &client, MessageType type,
+                                    std::chrono::milliseconds timeout = std::chrono::seconds(3)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+      auto [message, consumed] = deserialize_message(client.buffer);
+      if (message) {
+        client.buffer.erase(client.buffer.begin(), client.buffer.begin() + consumed);
+        if (message->header.type == type) {
+          return message;
+        }
+        continue;
+      }
+
+      std::vector<char> chunk(1024);
+      auto result = client.socket->receive_data(chunk);
+      if (result.status == SocketStatus::OK) {
+        client.buffer.insert(client.buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+      } else if (result.status == SocketStatus::WOULD_BLOCK) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      } else {
+        return std::nullopt;
+      }
+    }
+    return std::nullopt;
+  }
+
+  const int ports_[2] = {9954, 9955};
+  ReactorGroup group_{2};
+  std::unique_ptr<Server> servers_[2];
+  std::thread threads_[2];
+};
+
+TEST_F(ReactorGroupServersTest, SharesSessionsAndMessagesAcrossReactors) {
+  Client alice = join(ports_[0], "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(ports_[1], "bob");
+  ASSERT_NE(bob.id, 0u);
+  EXPECT_NE(alice.id >> NODE_ID_SHIFT, bob.id >> NODE_ID_SHIFT) << "Reactors hand out disjoint user IDs";
+
+  auto joined = read_until(alice, MessageType::S2C_USER_JOINED);
+  ASSERT_TRUE(joined.has_value());
+  EXPECT_EQ(joined->payload, "bob");
+
+  Client impostor = join(ports_[0], "bob");
+  EXPECT_EQ(impostor.id, 0u) << "The name is taken on the other reactor";
+
+  bob.socket->send_data(serialize_message(Message(MessageType::C2S_PRIVATE, bob.id, alice.id, "psst")));
+  auto private_message = read_until(alice, MessageType::S2C_PRIVATE);
+  ASSERT_TRUE(private_message.has_value());
+  EXPECT_EQ(private_message->header.sender_id, bob.id);
+  EXPECT_EQ(private_message->payload, "psst");
+
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_USER_JOINED_LIST, alice.id, SERVER_ID, "")));
+  auto user_list = read_until(alice, MessageType::S2C_USER_JOINED_LIST);
+  ASSERT_TRUE(user_list.has_value());
+  EXPECT_EQ(user_list->payload, "bob:" + std::to_string(bob.id));
+
+  bob.socket->close_socket();
+  auto left = read_until(alice, MessageType::S2C_USER_LEFT);
+  ASSERT_TRUE(left.has_value());
+  EXPECT_EQ(left->header.sender_id, bob.id);
+  EXPECT_FALSE(group_.directory().is_username_taken("bob"));
+}
+
+TEST_F(ReactorGroupServersTest, SendsOneFramePerReactorForABroadcast) {
+  Client alice = join(ports_[0], "alice");
+  ASSERT_NE(alice.id, 0u);
+  Client bob = join(ports_[1], "bob");
+  ASSERT_NE(bob.id, 0u);
+  Client carol = join(ports_[1], "carol");
+  ASSERT_NE(carol.id, 0u);
+
+  const uint64_t sent_before = servers_[0]->get_metrics().get_counter("reactor_frames_sent");
+  alice.socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, alice.id, BROADCAST_ID, "hi all")));
+  auto to_bob = read_until(bob, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(to_bob.has_value());
+  EXPECT_EQ(to_bob->payload, "hi all");
+  auto to_carol = read_until(carol, MessageType::S2C_BROADCAST);
+  ASSERT_TRUE(to_carol.has_value());
+  EXPECT_EQ(to_carol->payload, "hi all");
+  EXPECT_EQ(servers_[0]->get_metrics().get_counter("reactor_frames_sent"), sent_before + 1)
+      << "Both recipients share one delivery to their reactor";
+}
+
+TEST(ReactorsTest, RejectsSettingsThatNeedASingleOwner) {
+  ServerConfig config;
+  config.data_dir = "/tmp/reactors";
+  EXPECT_EQ(run_reactors(9954, config, 2), 1);
+  EXPECT_EQ(run_reactors(9954, ServerConfig(), 0), 1);
+}
+
+TEST(ReactorsTest, StopsTheGroupWhenAReactorFailsToStart) {
+  auto taken = PosixSocket::create_listener(); // Without SO_REUSEPORT, so no reactor can join the port
+  ASSERT_TRUE(taken && taken->bind_socket(9957) && taken->listen_socket(4));
+
+  // In a child, as run_reactors() blocks the stop signals of the thread it runs on.
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    alarm(10); // Kills the child if the group waits for a stop signal instead
+    _exit(run_reactors(9957, ServerConfig(), 2));
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status)) << "The group kept waiting after its reactors failed";
+  EXPECT_EQ(WEXITSTATUS(status), 1);
+}
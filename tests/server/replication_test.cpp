@@ -0,0 +1,119 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/server.h"
+#include "test_server.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <filesystem>
+#include <stdlib.h>
+#include <thread>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+/**
+ * @brief Runs a primary and a warm standby server, each in its own thread with its own data directory.
+ */
+class ReplicationTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    primary_dir_ = make_temp_dir();
+    standby_dir_ = make_temp_dir();
+
+    ServerConfig primary_config;
+    primary_config.data_dir = primary_dir_;
+    primary_config.replication_port = replication_port_;
+    primary_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(primary_.start(primary_port_, primary_config)) << "The primary failed to start";
+
+    ServerConfig standby_config;
+    standby_config.data_dir = standby_dir_;
+    standby_config.replicate_from = "127.0.0.1:" + std::to_string(replication_port_);
+    standby_config.housekeeping_interval_ms = 50;
+    ASSERT_TRUE(standby_.start(standby_port_, standby_config)) << "The standby failed to start";
+  }
+
+  void TearDown() override {
+    primary_.stop();
+    standby_.stop();
+    std::filesystem::remove_all(primary_dir_);
+    std::filesystem::remove_all(standby_dir_);
+  }
+
+  static std::string make_temp_dir() {
+    char dir_template[] = "/tmp/replication_test_XXXXXX";
+    return mkdtemp(dir_template);
+  }
+
+  std::optional<Message> join(IStreamSocket *socket, const std::string &username) {
+    socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, username)));
+    std::vector<char> buffer(1024);
+    auto result = socket->receive_data(buffer);
+    if (result.status != SocketStatus::OK) {
+      return std::nullopt;
+    }
+    buffer.resize(result.bytes_transferred);
+    return deserialize_message(buffer).first;
+  }
+
+  bool wait_for(const std::function<bool()> &condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (std::chrono::steady_clock::now() < deadline) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+  }
+
+  const int primary_port_ = 9911;
+  const int standby_port_ = 9912;
+  const int replication_port_ = 9913;
+  std::string primary_dir_;
+  std::string standby_dir_;
+  TestServer primary_;
+  TestServer standby_;
+};
+
+TEST_F(ReplicationTest, StandbyAppliesShippedRecordsAndReportsLag) {
+  EXPECT_TRUE(standby_->is_standby());
+
+  auto alice = PosixSocket::create_connector("127.0.0.1", primary_port_);
+  ASSERT_TRUE(alice);
+  auto response = join(alice.get(), "alice");
+  ASSERT_TRUE(response.has_value());
+  EXPECT_EQ(response->header.type, MessageType::S2C_JOIN_SUCCESS);
+
+  alice->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, 0, BROADCAST_ID, "hello")));
+
+  EXPECT_TRUE(wait_for([this]() { return standby_->get_metrics().get_gauge("replication_applied_sequence") == 2; }));
+  EXPECT_EQ(standby_->get_metrics().get_gauge("replication_lag_records"), 0);
+  EXPECT_TRUE(wait_for([this]() { return primary_->get_metrics().get_gauge("replication_standbys") == 1; }));
+}
+
+TEST_F(ReplicationTest, StandbyRejectsJoinsUntilItTakesOver) {
+  auto alice = PosixSocket::create_connector("127.0.0.1", primary_port_);
+  ASSERT_TRUE(alice);
+  auto response = join(alice.get(), "alice");
+  ASSERT_TRUE(response.has_value());
+  const uint32_t alice_id = response->header.receiver_id;
+
+  auto early = PosixSocket::create_connector("127.0.0.1", standby_port_);
+  ASSERT_TRUE(early);
+  response = join(early.get(), "bob");
+  ASSERT_TRUE(response.has_value());
+  EXPECT_EQ(response->header.type, MessageType::S2C_JOIN_FAILURE);
+
+  ASSERT_TRUE(wait_for([this]() { return standby_->get_metrics().get_gauge("replication_applied_sequence") >= 1; }));
+  alice.reset();
+  primary_.stop();
+  ASSERT_TRUE(wait_for([this]() { return !standby_->is_standby(); }));
+
+  auto bob = PosixSocket::create_connector("127.0.0.1", standby_port_);
+  ASSERT_TRUE(bob);
+  response = join(bob.get(), "bob");
+  ASSERT_TRUE(response.has_value());
+  EXPECT_EQ(response->header.type, MessageType::S2C_JOIN_SUCCESS);
+  EXPECT_GT(response->header.receiver_id, alice_id) << "User IDs must continue after the primary's";
+}
@@ -2,11 +2,13 @@
 #include "common/socket.h"
 #include "server/server.h"
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <thread>
 
 #include <arpa/inet.h>
+#include <unistd.h>
 
 using namespace chat_app::server;
 using namespace chat_app::common;
@@ -16,7 +18,9 @@ protected:
   void SetUp() override {
     // Start the server in a background thread
     server_thread_ = std::thread([this]() {
-      Server server(port_);
+      ServerConfig config;
+      config.unix_socket_path = unix_path_;
+      Server server(port_, config);
       server_instance_ = &server;
       server.run();
       server_instance_ = nullptr;
@@ -64,6 +68,7 @@ protected:
   }
 
   const int port_ = 9999;
+  const std::string unix_path_ = "/tmp/chat_server_test_" + std::to_string(getpid()) + ".sock";
   std::thread server_thread_;
   Server *server_instance_ = nullptr;
 };
@@ -156,6 +161,176 @@ TEST_F(ServerIntegrationTest, RejectsClientWithTakenUsername) {
   EXPECT_EQ(response2->payload, "Username already exists");
 }
 
+TEST_F(ServerIntegrationTest, DropsWhatAClientSendsAfterLeaving) {
+  auto alice = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(alice && alice->is_valid());
+  alice->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice")));
+  ASSERT_TRUE(read_message(alice.get()).has_value());
+
+  auto bob = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(bob && bob->is_valid());
+  bob->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "bob")));
+  auto welcome = read_message(bob.get());
+  ASSERT_TRUE(welcome.has_value());
+  auto joined = read_message(alice.get());
+  ASSERT_TRUE(joined.has_value());
+  EXPECT_EQ(joined->header.type, MessageType::S2C_USER_JOINED);
+
+  // The leave and a broadcast after it arrive in one read, so the broadcast is decoded from the
+  // read buffer of a session that has just been disconnected.
+  const uint32_t bob_id = welcome->header.receiver_id;
+  auto leave = serialize_message(Message(MessageType::C2S_LEAVE, bob_id, SERVER_ID, ""));
+  auto after = serialize_message(Message(MessageType::C2S_BROADCAST, bob_id, BROADCAST_ID, "after leaving"));
+  leave.insert(leave.end(), after.begin(), after.end());
+  bob->send_data(leave);
+
+  // A join after that shows the server is still serving, and the broadcast must not come before it.
+  auto carol = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(carol && carol->is_valid());
+  carol->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "carol")));
+
+  alice->set_non_blocking(true);
+  std::vector<char> buffer;
+  std::vector<Message> received;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (std::chrono::steady_clock::now() < deadline &&
+         (received.empty() || received.back().header.type != MessageType::S2C_USER_JOINED)) {
+    std::vector<char> chunk(1024);
+    auto result = alice->receive_data(chunk);
+    if (result.status == SocketStatus::OK) {
+      buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    while (true) {
+      auto [message, consumed] = deserialize_message(buffer);
+      if (!message) {
+        break;
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + consumed);
+      received.push_back(*message);
+    }
+  }
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].header.type, MessageType::S2C_USER_LEFT);
+  EXPECT_EQ(received[1].header.type, MessageType::S2C_USER_JOINED);
+  EXPECT_EQ(received[1].payload, "carol");
+}
+
+TEST_F(ServerIntegrationTest, KeepsTheOrderOfChatOverTheBudget) {
+  auto alice = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(alice && alice->is_valid());
+  alice->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice")));
+  ASSERT_TRUE(read_message(alice.get()).has_value());
+
+  auto bob = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(bob && bob->is_valid());
+  bob->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "bob")));
+  auto welcome = read_message(bob.get());
+  ASSERT_TRUE(welcome.has_value());
+  ASSERT_TRUE(read_message(alice.get()).has_value()); // Bob joined
+
+  // More chat than one tick's budget, then a leave, in one read: the leave waits for all of it.
+  const uint32_t bob_id = welcome->header.receiver_id;
+  const size_t count = CLIENT_CHAT_BUDGET * 3 + 1;
+  std::vector<char> flood;
+  for (size_t i = 0; i < count; ++i) {
+    auto frame = serialize_message(Message(MessageType::C2S_BROADCAST, bob_id, BROADCAST_ID, std::to_string(i)));
+    flood.insert(flood.end(), frame.begin(), frame.end());
+  }
+  auto leave = serialize_message(Message(MessageType::C2S_LEAVE, bob_id, SERVER_ID, ""));
+  flood.insert(flood.end(), leave.begin(), leave.end());
+  bob->send_data(flood);
+
+  alice->set_non_blocking(true);
+  std::vector<char> buffer;
+  std::vector<Message> received;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (std::chrono::steady_clock::now() < deadline &&
+         (received.empty() || received.back().header.type != MessageType::S2C_USER_LEFT)) {
+    std::vector<char> chunk(4096);
+    auto result = alice->receive_data(chunk);
+    if (result.status == SocketStatus::OK) {
+      buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    while (true) {
+      auto [message, consumed] = deserialize_message(buffer);
+      if (!message) {
+        break;
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + consumed);
+      received.push_back(*message);
+    }
+  }
+  ASSERT_EQ(received.size(), count + 1);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(received[i].payload, std::to_string(i));
+  }
+  EXPECT_EQ(received.back().header.type, MessageType::S2C_USER_LEFT);
+}
+
+TEST_F(ServerIntegrationTest, AnswersJoinsWhileAClientFloodsChat) {
+  auto alice = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(alice && alice->is_valid());
+  alice->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice")));
+  ASSERT_TRUE(read_message(alice.get()).has_value());
+
+  auto bob = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(bob && bob->is_valid());
+  bob->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "bob")));
+  auto welcome = read_message(bob.get());
+  ASSERT_TRUE(welcome.has_value());
+  ASSERT_TRUE(read_message(alice.get()).has_value()); // Bob joined
+
+  auto carol = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(carol && carol->is_valid());
+
+  // Many ticks' worth of chat from bob, then carol's join: it is answered before bob's flood is through.
+  const uint32_t bob_id = welcome->header.receiver_id;
+  const size_t count = CLIENT_CHAT_BUDGET * 64;
+  std::vector<char> flood;
+  for (size_t i = 0; i < count; ++i) {
+    auto frame = serialize_message(Message(MessageType::C2S_BROADCAST, bob_id, BROADCAST_ID, std::to_string(i)));
+    flood.insert(flood.end(), frame.begin(), frame.end());
+  }
+  bob->send_data(flood);
+  carol->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "carol")));
+  auto carol_welcome = read_message(carol.get());
+  ASSERT_TRUE(carol_welcome.has_value());
+  EXPECT_EQ(carol_welcome->header.type, MessageType::S2C_JOIN_SUCCESS);
+
+  alice->set_non_blocking(true);
+  std::vector<char> buffer;
+  std::vector<Message> received;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (std::chrono::steady_clock::now() < deadline && received.size() < count + 1) {
+    std::vector<char> chunk(4096);
+    auto result = alice->receive_data(chunk);
+    if (result.status == SocketStatus::OK) {
+      buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + result.bytes_transferred);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    while (true) {
+      auto [message, consumed] = deserialize_message(buffer);
+      if (!message) {
+        break;
+      }
+      buffer.erase(buffer.begin(), buffer.begin() + consumed);
+      received.push_back(*message);
+    }
+  }
+  ASSERT_EQ(received.size(), count + 1);
+  auto joined = std::find_if(received.begin(), received.end(), [](const Message &message) {
+    return message.header.type == MessageType::S2C_USER_JOINED;
+  });
+  ASSERT_NE(joined, received.end());
+  EXPECT_EQ(joined->payload, "carol");
+  EXPECT_LT(joined - received.begin(), static_cast<std::ptrdiff_t>(count));
+}
+
 TEST_F(ServerIntegrationTest, IgnoresInvalidMessages) {
   // 1. Connect to the server
   auto client_socket = PosixSocket::create_connector("127.0.0.1", port_);
@@ -188,3 +363,62 @@ TEST_F(ServerIntegrationTest, IgnoresMessagesFromUnauthenticatedClient) {
   auto response = read_message(client_socket.get());
   EXPECT_FALSE(response.has_value());
 }
+
+TEST_F(ServerIntegrationTest, PasswordProtectsUsername) {
+  // 1. The first join with a password registers it
+  auto client_socket1 = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(client_socket1 && client_socket1->is_valid());
+  client_socket1->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice\nsecret")));
+
+  auto join_response1 = read_message(client_socket1.get());
+  ASSERT_TRUE(join_response1.has_value());
+  EXPECT_EQ(join_response1->header.type, MessageType::S2C_JOIN_SUCCESS);
+  uint32_t alice_id = join_response1->header.receiver_id;
+  client_socket1->close_socket();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // 2. A wrong password is refused
+  auto client_socket2 = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(client_socket2 && client_socket2->is_valid());
+  client_socket2->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice\nguess")));
+
+  auto join_response2 = read_message(client_socket2.get());
+  ASSERT_TRUE(join_response2.has_value());
+  EXPECT_EQ(join_response2->header.type, MessageType::S2C_JOIN_FAILURE);
+  EXPECT_EQ(join_response2->payload, "Authentication failed");
+
+  // 3. The right password gets the same user ID back
+  auto client_socket3 = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(client_socket3 && client_socket3->is_valid());
+  client_socket3->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "alice\nsecret")));
+
+  auto join_response3 = read_message(client_socket3.get());
+  ASSERT_TRUE(join_response3.has_value());
+  EXPECT_EQ(join_response3->header.type, MessageType::S2C_JOIN_SUCCESS);
+  EXPECT_EQ(join_response3->header.receiver_id, alice_id);
+}
+
+TEST_F(ServerIntegrationTest, LocalClientsConnectOverUnixSocket) {
+  auto local_socket = PosixSocket::create_unix_connector(unix_path_);
+  ASSERT_TRUE(local_socket && local_socket->is_valid());
+  local_socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "local_user")));
+  auto local_join = read_message(local_socket.get());
+  ASSERT_TRUE(local_join.has_value());
+  EXPECT_EQ(local_join->header.type, MessageType::S2C_JOIN_SUCCESS);
+  uint32_t local_id = local_join->header.receiver_id;
+
+  auto tcp_socket = PosixSocket::create_connector("127.0.0.1", port_);
+  ASSERT_TRUE(tcp_socket && tcp_socket->is_valid());
+  tcp_socket->send_data(serialize_message(Message(MessageType::C2S_JOIN, 0, 0, "tcp_user")));
+  auto tcp_join = read_message(tcp_socket.get());
+  ASSERT_TRUE(tcp_join.has_value());
+  EXPECT_EQ(tcp_join->header.type, MessageType::S2C_JOIN_SUCCESS);
+
+  // Both kinds of clients share one session table.
+  local_socket->send_data(serialize_message(Message(MessageType::C2S_BROADCAST, local_id, 0, "Hello over AF_UNIX")));
+  auto broadcast_response = read_message(tcp_socket.get());
+  ASSERT_TRUE(broadcast_response.has_value());
+  EXPECT_EQ(broadcast_response->header.type, MessageType::S2C_BROADCAST);
+  EXPECT_EQ(broadcast_response->header.sender_id, local_id);
+  EXPECT_EQ(broadcast_response->payload, "Hello over AF_UNIX");
+}
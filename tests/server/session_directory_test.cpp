@@ -0,0 +1,86 @@
+#include "server/session_directory.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace chat_app::server;
+
+TEST(SessionDirectoryTest, ClaimsEachUsernameOnce) {
+  SessionDirectory directory(2);
+
+  EXPECT_TRUE(directory.claim(1, "alice", 0, 7));
+  EXPECT_FALSE(directory.claim(2, "alice", 1, 9)) << "The name is taken on another worker";
+  EXPECT_TRUE(directory.claim(3, "bob", 1, 9));
+
+  auto alice = directory.find(1);
+  ASSERT_TRUE(alice.has_value());
+  EXPECT_EQ(alice->session.worker, 0u);
+  EXPECT_EQ(alice->session.username, "alice");
+  EXPECT_EQ(alice->slot, 7);
+  EXPECT_EQ(directory.sessions().size(), 2u);
+
+  directory.release(1);
+  EXPECT_FALSE(directory.find(1).has_value());
+  EXPECT_FALSE(directory.is_username_taken("alice"));
+  EXPECT_TRUE(directory.claim(4, "alice", 1, 11));
+}
+
+TEST(SessionDirectoryTest, FreesRetiredShardsOnceEveryReaderQuiesced) {
+  SessionDirectory directory(2);
+  directory.claim(1, "alice", 0, 7);
+  EXPECT_EQ(directory.retired_shards(), 2u);
+
+  directory.quiesce(0);
+  directory.claim(2, "bob", 0, 8);
+  EXPECT_EQ(directory.retired_shards(), 4u) << "Reader 1 may still hold the first shards";
+
+  directory.quiesce(0);
+  directory.quiesce(1);
+  directory.claim(3, "carol", 1, 9);
+  EXPECT_EQ(directory.retired_shards(), 2u) << "Only the shards retired by the last claim are left";
+}
+
+TEST(SessionDirectoryTest, ReadersSeeWholeEntriesWhileWritersReplaceShards) {
+  constexpr uint32_t USERS = 64;
+  constexpr int ROUNDS = 20;
+  SessionDirectory directory(2);
+  std::atomic<bool> done{false};
+  std::atomic<int> torn{0};
+
+  std::thread writer([&]() {
+    for (int round = 0; round < ROUNDS; ++round) {
+      for (uint32_t user = 1; user <= USERS; ++user) {
+        directory.claim(user, "user" + std::to_string(user), round % 2, static_cast<int32_t>(user));
+      }
+      for (uint32_t user = 1; user <= USERS; ++user) {
+        directory.release(user);
+      }
+      std::this_thread::yield();
+    }
+    done = true;
+  });
+  std::vector<std::thread> readers;
+  for (size_t reader = 0; reader < 2; ++reader) {
+    readers.emplace_back([&, reader]() {
+      while (!done) {
+        for (uint32_t user = 1; user <= USERS; ++user) {
+          auto entry = directory.find(user);
+          if (entry && (entry->session.user_id != user || entry->session.username != "user" + std::to_string(user) ||
+                        entry->slot != static_cast<int32_t>(user))) {
+            ++torn;
+          }
+        }
+        directory.quiesce(reader);
+        std::this_thread::yield();
+      }
+    });
+  }
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_TRUE(directory.sessions().empty());
+}
@@ -0,0 +1,201 @@
+#include "common/protocol.h"
+#include "common/socket.h"
+#include "server/client_session.h"
+#include "server/epoll_manager.h"
+#include "server/session_flows.h"
+#include "server/timer_wheel.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <fcntl.h>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+namespace {
+
+// A login-like flow: waits for the client's hello, pauses, then greets it back.
+SessionTask greet(SessionFlows &flows, ClientSession &session, std::optional<bool> &sent) {
+  SessionInput input(flows, session.get_fd());
+  std::optional<Message> hello = co_await input.recv_frame();
+  if (!hello) {
+    sent = false;
+    co_return;
+  }
+  co_await flows.sleep_for(std::chrono::milliseconds(20));
+  sent = co_await flows.send_frame(session, Message(MessageType::S2C_JOIN_SUCCESS, 0, 1, "hello " + hello->payload));
+}
+
+SessionTask send_one(SessionFlows &flows, ClientSession &session, const Message &message, std::optional<bool> &sent) {
+  sent = co_await flows.send_frame(session, message);
+}
+
+SessionTask finish_at_once(int &runs) {
+  ++runs;
+  co_return;
+}
+
+} // namespace
+
+TEST(TimerWheelTest, FiresTimersInTheOrderTheyFallDue) {
+  TimerWheel wheel(std::chrono::milliseconds(10), 8);
+  std::string fired;
+  wheel.schedule(std::chrono::milliseconds(30), [&]() { fired += 'c'; });
+  wheel.schedule(std::chrono::milliseconds(5), [&]() { fired += 'a'; });
+  wheel.schedule(std::chrono::milliseconds(20), [&]() { fired += 'b'; });
+  EXPECT_EQ(wheel.pending(), 3u);
+
+  EXPECT_EQ(wheel.advance(1), 1u);
+  EXPECT_EQ(fired, "a");
+  EXPECT_EQ(wheel.advance(2), 2u);
+  EXPECT_EQ(fired, "abc");
+  EXPECT_EQ(wheel.pending(), 0u);
+}
+
+TEST(TimerWheelTest, WaitsWholeTurnsForTimersBeyondTheWheel) {
+  TimerWheel wheel(std::chrono::milliseconds(10), 4);
+  int fired = 0;
+  wheel.schedule(std::chrono::milliseconds(90), [&]() { ++fired; });
+
+  EXPECT_EQ(wheel.advance(8), 0u);
+  EXPECT_EQ(fired, 0);
+  EXPECT_EQ(wheel.advance(1), 1u);
+  EXPECT_EQ(fired, 1);
+}
+
+TEST(TimerWheelTest, CancelledTimersDoNotFire) {
+  TimerWheel wheel(std::chrono::milliseconds(10), 8);
+  int fired = 0;
+  const uint64_t id = wheel.schedule(std::chrono::milliseconds(10), [&]() { ++fired; });
+  wheel.schedule(std::chrono::milliseconds(10), [&]() { ++fired; });
+
+  EXPECT_TRUE(wheel.cancel(id));
+  EXPECT_FALSE(wheel.cancel(id));
+  EXPECT_EQ(wheel.advance(1), 1u);
+  EXPECT_EQ(fired, 1);
+}
+
+class SessionFlowsTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+    fcntl(fds_[0], F_SETFL, fcntl(fds_[0], F_GETFL) | O_NONBLOCK);
+    session_ = std::make_unique<ClientSession>(1, std::make_unique<PosixSocket>(fds_[0]));
+    ASSERT_TRUE(epoll_manager_.add_fd(fds_[0], EPOLLIN | EPOLLET));
+    ASSERT_TRUE(flows_.start());
+  }
+
+  void TearDown() override { close(fds_[1]); }
+
+  // Runs the reactor's side of the flows until done() holds or the timeout passes.
+  template <typename Done> bool run_until(Done done, std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+      pollfd timer{flows_.get_timer_fd(), POLLIN, 0};
+      if (poll(&timer, 1, 0) > 0) {
+        flows_.handle_timer();
+      }
+      int ready = epoll_manager_.wait(5);
+      for (int i = 0; i < ready; ++i) {
+        const epoll_event &event = epoll_manager_.get_events()[i];
+        if (event.events & EPOLLOUT) {
+          flows_.writable(event.data.fd);
+        }
+      }
+    }
+    return done();
+  }
+
+  Message read_message() {
+    std::vector<char> buffer;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (std::chrono::steady_clock::now() < deadline) {
+      char chunk[4096];
+      ssize_t received = recv(fds_[1], chunk, sizeof(chunk), MSG_DONTWAIT);
+      if (received > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + received);
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      auto [message, consumed] = deserialize_message(buffer);
+      if (message) {
+        return *message;
+      }
+    }
+    return Message();
+  }
+
+  int fds_[2]{-1, -1};
+  EpollManager epoll_manager_;
+  SessionFlows flows_{epoll_manager_};
+  std::unique_ptr<ClientSession> session_;
+};
+
+TEST_F(SessionFlowsTest, RunsAFlowAcrossAMessageADelayAndAWrite) {
+  std::optional<bool> sent;
+  greet(flows_, *session_, sent);
+  EXPECT_EQ(flows_.suspended(), 1u);
+  EXPECT_FALSE(sent.has_value());
+
+  EXPECT_TRUE(flows_.deliver(fds_[0], Message(MessageType::C2S_JOIN, 0, 0, "alice")));
+  EXPECT_EQ(flows_.suspended(), 1u);
+  ASSERT_TRUE(run_until([&]() { return sent.has_value(); }));
+  EXPECT_TRUE(*sent);
+  EXPECT_EQ(flows_.suspended(), 0u);
+
+  Message reply = read_message();
+  EXPECT_EQ(reply.header.type, MessageType::S2C_JOIN_SUCCESS);
+  EXPECT_EQ(reply.payload, "hello alice");
+
+  // The flow released the session's input, so its messages go back to the server.
+  EXPECT_FALSE(flows_.deliver(fds_[0], Message(MessageType::C2S_BROADCAST, 0, 0, "hi")));
+}
+
+TEST_F(SessionFlowsTest, DisconnectingWakesTheFlowWithNothing) {
+  std::optional<bool> sent;
+  greet(flows_, *session_, sent);
+  ASSERT_EQ(flows_.suspended(), 1u);
+
+  flows_.close(fds_[0]);
+  ASSERT_TRUE(sent.has_value());
+  EXPECT_FALSE(*sent);
+  EXPECT_EQ(flows_.suspended(), 0u);
+  EXPECT_FALSE(flows_.deliver(fds_[0], Message(MessageType::C2S_JOIN, 0, 0, "alice")));
+}
+
+TEST_F(SessionFlowsTest, SendWaitsForTheSocketToTakeMore) {
+  int size = 4096;
+  setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  const Message large(MessageType::S2C_BROADCAST, 0, 1, std::string(1 << 20, 'x'));
+
+  std::optional<bool> sent;
+  send_one(flows_, *session_, large, sent);
+  ASSERT_FALSE(sent.has_value());
+  EXPECT_EQ(flows_.suspended(), 1u);
+
+  Message received;
+  std::thread peer([&]() { received = read_message(); });
+  EXPECT_TRUE(run_until([&]() { return sent.has_value(); }, std::chrono::seconds(5)));
+  peer.join();
+  ASSERT_TRUE(sent.has_value());
+  EXPECT_TRUE(*sent);
+  EXPECT_EQ(received.payload.size(), large.payload.size());
+}
+
+TEST_F(SessionFlowsTest, ReusesTheFramesOfFinishedFlows) {
+  int runs = 0;
+  finish_at_once(runs);
+  const uint64_t allocated = CoroutineFramePool::allocated();
+  const uint64_t reused = CoroutineFramePool::reused();
+
+  finish_at_once(runs);
+  finish_at_once(runs);
+  EXPECT_EQ(runs, 3);
+  EXPECT_EQ(CoroutineFramePool::allocated(), allocated);
+  EXPECT_EQ(CoroutineFramePool::reused(), reused + 2);
+}
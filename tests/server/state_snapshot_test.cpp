@@ -0,0 +1,96 @@
+#include "server/state_snapshot.h"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <stdlib.h>
+
+using namespace chat_app::server;
+using namespace chat_app::common;
+
+class StateSnapshotTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/state_snapshot_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    directory_ = dir_template;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  static LogRecord make_join(uint64_t sequence, uint32_t user_id, const std::string &username) {
+    LogRecord record;
+    record.sequence = sequence;
+    record.message = Message(MessageType::S2C_USER_JOINED, user_id, BROADCAST_ID, username);
+    return record;
+  }
+
+  std::string directory_;
+};
+
+TEST_F(StateSnapshotTest, ApplyTracksLastSequence) {
+  ServerState state;
+  state.apply(make_join(1, 4, "alice"));
+  state.apply(make_join(2, 2, "bob"));
+  EXPECT_EQ(state.last_sequence, 2);
+}
+
+TEST_F(StateSnapshotTest, LoadLatestWithoutSnapshot) {
+  StateSnapshotter snapshotter(directory_);
+  EXPECT_FALSE(snapshotter.load_latest().has_value());
+}
+
+TEST_F(StateSnapshotTest, ForkedSnapshotRoundTrip) {
+  ServerState state;
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    state.apply(make_join(i, i, "user" + std::to_string(i)));
+  }
+
+  StateSnapshotter snapshotter(directory_);
+  ASSERT_TRUE(snapshotter.begin(state));
+  EXPECT_FALSE(snapshotter.begin(state)) << "Only one snapshot may be in progress";
+
+  // Mutations after the fork must not leak into the snapshot.
+  state.apply(make_join(1001, 1001, "late_user"));
+
+  snapshotter.wait();
+  EXPECT_EQ(snapshotter.last_snapshot_sequence(), 1000);
+
+  auto loaded = snapshotter.load_latest();
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->last_sequence, 1000);
+}
+
+TEST_F(StateSnapshotTest, WriteNowOverwritesPreviousSnapshot) {
+  StateSnapshotter snapshotter(directory_);
+  ServerState state;
+  state.apply(make_join(1, 1, "alice"));
+  ASSERT_TRUE(snapshotter.write_now(state));
+
+  state.apply(make_join(2, 2, "bob"));
+  ASSERT_TRUE(snapshotter.write_now(state));
+
+  auto loaded = snapshotter.load_latest();
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->last_sequence, 2);
+}
+
+TEST_F(StateSnapshotTest, PasswordHashesSurviveSnapshot) {
+  auto hash = PasswordHash::create("secret", 1000);
+  ASSERT_TRUE(hash.has_value());
+
+  ServerState state;
+  LogRecord record;
+  record.sequence = 1;
+  record.message = Message(MessageType::S2S_USER_CREDENTIAL, SERVER_ID, 1, "alice\n" + hash->encode());
+  state.apply(record);
+  ASSERT_EQ(state.password_hashes.count("alice"), 1u);
+
+  StateSnapshotter snapshotter(directory_);
+  ASSERT_TRUE(snapshotter.begin(state));
+  snapshotter.wait();
+
+  auto loaded = snapshotter.load_latest();
+  ASSERT_TRUE(loaded.has_value());
+  ASSERT_EQ(loaded->password_hashes.count("alice"), 1u);
+  EXPECT_TRUE(loaded->password_hashes.at("alice").verify("secret"));
+  EXPECT_FALSE(loaded->password_hashes.at("alice").verify("guess"));
+}
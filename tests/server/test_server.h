@@ -0,0 +1,62 @@
+#ifndef TESTS_SERVER_TEST_SERVER_H
+#define TESTS_SERVER_TEST_SERVER_H
+
+#include "server/server.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+/**
+ * @brief A Server running in its own thread. The Server is published once constructed and lives until
+ * stop(), even if run() returned early, so the test thread can use it until then.
+ */
+class TestServer {
+public:
+  TestServer() = default;
+  ~TestServer() { stop(); }
+
+  TestServer(const TestServer &) = delete;
+  TestServer &operator=(const TestServer &) = delete;
+
+  chat_app::server::Server *operator->() const { return server_.load(); }
+  bool running() const { return server_.load() && !exited_.load(); }
+
+  // Starts the server and waits until it has had time to bind its ports.
+  // Returns running(): false if run() already returned, e.g. because a port was taken.
+  bool start(int port, const chat_app::server::ServerConfig &config) {
+    thread_ = std::thread([this, port, config, released = release_.get_future()]() {
+      chat_app::server::Server server(port, config);
+      server_.store(&server);
+      server.run();
+      exited_.store(true);
+      released.wait();
+      server_.store(nullptr);
+    });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!server_.load() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return running();
+  }
+
+  void stop() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    if (chat_app::server::Server *server = server_.load()) {
+      server->stop();
+    }
+    release_.set_value();
+    thread_.join();
+  }
+
+private:
+  std::thread thread_;
+  std::atomic<chat_app::server::Server *> server_{nullptr};
+  std::atomic<bool> exited_{false}; // run() returned
+  std::promise<void> release_;      // Lets the thread destroy its Server
+};
+
+#endif // TESTS_SERVER_TEST_SERVER_H
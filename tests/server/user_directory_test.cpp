@@ -0,0 +1,47 @@
+#include "server/user_directory.h"
+#include "gtest/gtest.h"
+
+using namespace chat_app::server;
+
+TEST(UserDirectoryTest, HomeEntriesFollowUpdates) {
+  UserDirectory directory;
+  directory.set_home(7, 2);
+  EXPECT_EQ(directory.find_home(7), 2u);
+
+  directory.set_home(7, 3); // The user reconnected elsewhere
+  directory.remove_home(7, 2);
+  EXPECT_EQ(directory.find_home(7), 3u) << "A stale leave must not remove the newer entry";
+
+  directory.remove_home(7, 3);
+  EXPECT_FALSE(directory.find_home(7).has_value());
+}
+
+TEST(UserDirectoryTest, CacheEvictsLeastRecentlyUsed) {
+  UserDirectory directory(2);
+  directory.cache(1, 5);
+  directory.cache(2, 5);
+  EXPECT_EQ(directory.find_cached(1), 5u); // 2 is now the least recently used
+  directory.cache(3, 6);
+
+  EXPECT_EQ(directory.cache_size(), 2u);
+  EXPECT_FALSE(directory.find_cached(2).has_value());
+  EXPECT_EQ(directory.find_cached(1), 5u);
+  EXPECT_EQ(directory.find_cached(3), 6u);
+
+  directory.forget(1);
+  EXPECT_FALSE(directory.find_cached(1).has_value());
+}
+
+TEST(UserDirectoryTest, ForgetsLostNodes) {
+  UserDirectory directory;
+  directory.set_home(1, 2);
+  directory.set_home(2, 3);
+  directory.cache(10, 2);
+  directory.cache(11, 3);
+
+  directory.forget_node(2);
+  EXPECT_FALSE(directory.find_home(1).has_value());
+  EXPECT_EQ(directory.find_home(2), 3u);
+  EXPECT_FALSE(directory.find_cached(10).has_value());
+  EXPECT_EQ(directory.find_cached(11), 3u);
+}
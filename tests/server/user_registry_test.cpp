@@ -0,0 +1,108 @@
+#include "server/user_registry.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <filesystem>
+#include <stdlib.h>
+
+using namespace chat_app::server;
+
+class UserRegistryTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/user_registry_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    directory_ = dir_template;
+    path_ = directory_ + "/users.registry";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  std::string directory_;
+  std::string path_;
+};
+
+TEST_F(UserRegistryTest, RegisterAssignsStableIds) {
+  UserRegistry registry;
+  ASSERT_TRUE(registry.open());
+
+  EXPECT_EQ(registry.register_user("alice"), 1u);
+  EXPECT_EQ(registry.register_user("bob"), 2u);
+  EXPECT_EQ(registry.register_user("alice"), 1u) << "A returning user keeps their ID";
+  EXPECT_EQ(registry.find("bob"), 2u);
+  EXPECT_FALSE(registry.find("carol").has_value());
+  EXPECT_EQ(registry.size(), 2u);
+  EXPECT_EQ(registry.next_user_id(), 3u);
+}
+
+TEST_F(UserRegistryTest, RejectsInvalidNames) {
+  UserRegistry registry;
+  ASSERT_TRUE(registry.open());
+
+  EXPECT_FALSE(registry.register_user("").has_value());
+  EXPECT_FALSE(registry.register_user(std::string(MAX_REGISTERED_USERNAME + 1, 'x')).has_value());
+  EXPECT_TRUE(registry.register_user(std::string(MAX_REGISTERED_USERNAME, 'x')).has_value());
+}
+
+TEST_F(UserRegistryTest, StopsAtTheEndOfItsIdRange) {
+  UserRegistry registry;
+  ASSERT_TRUE(registry.open(1024, 100, 101));
+
+  EXPECT_EQ(registry.register_user("alice"), 100u);
+  EXPECT_EQ(registry.register_user("bob"), 101u);
+  EXPECT_FALSE(registry.register_user("carol").has_value()) << "102 belongs to the next range";
+  EXPECT_EQ(registry.register_user("alice"), 100u) << "Registered users are still found";
+  EXPECT_EQ(registry.size(), 2u);
+}
+
+TEST_F(UserRegistryTest, GrowsAndKeepsEntries) {
+  UserRegistry registry(path_);
+  ASSERT_TRUE(registry.open(16));
+
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    ASSERT_EQ(registry.register_user("user" + std::to_string(i)), i);
+  }
+  EXPECT_GE(registry.capacity(), 2000u);
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    EXPECT_EQ(registry.find("user" + std::to_string(i)), i);
+  }
+  EXPECT_FALSE(std::filesystem::exists(path_ + ".tmp"));
+}
+
+TEST_F(UserRegistryTest, PersistsAcrossReopen) {
+  {
+    UserRegistry registry(path_);
+    ASSERT_TRUE(registry.open(16));
+    for (uint32_t i = 1; i <= 100; ++i) {
+      registry.register_user("user" + std::to_string(i));
+    }
+  }
+
+  UserRegistry registry(path_);
+  ASSERT_TRUE(registry.open());
+  EXPECT_EQ(registry.size(), 100u);
+  EXPECT_EQ(registry.find("user42"), 42u);
+  EXPECT_EQ(registry.register_user("newcomer"), 101u);
+}
+
+TEST_F(UserRegistryTest, InsertKeepsKnownIds) {
+  UserRegistry registry;
+  ASSERT_TRUE(registry.open());
+
+  EXPECT_TRUE(registry.insert("alice", 7));
+  EXPECT_TRUE(registry.insert("alice", 7)) << "Replaying the same record is harmless";
+  EXPECT_FALSE(registry.insert("alice", 8));
+  EXPECT_EQ(registry.find("alice"), 7u);
+  EXPECT_EQ(registry.register_user("bob"), 8u) << "New IDs continue after the highest inserted one";
+}
+
+TEST_F(UserRegistryTest, RejectsCorruptedFile) {
+  {
+    std::FILE *file = std::fopen(path_.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    std::fputs("not a registry, but long enough to hold a header of sixty-four bytes......", file);
+    std::fclose(file);
+  }
+
+  UserRegistry registry(path_);
+  EXPECT_FALSE(registry.open());
+}